@@ -4,6 +4,7 @@
 #include "socketcanbackend.h"
 
 #include "libsocketcan.h"
+#include "socketcanreader.h"
 
 #include <QtSerialBus/qcanbusdevice.h>
 
@@ -14,6 +15,8 @@
 #include <QtCore/qloggingcategory.h>
 #include <QtCore/qsocketnotifier.h>
 
+#include <utility>
+
 #include <linux/can/error.h>
 #include <linux/can/raw.h>
 #include <linux/sockios.h>
@@ -139,6 +142,7 @@ QCanBusDeviceInfo SocketCanBackend::deviceInfo() const
 }
 
 SocketCanBackend::SocketCanBackend(const QString &name) :
+    receiver(new SocketCanReceiver),
     canSocketName(name)
 {
     QString errorString;
@@ -187,6 +191,11 @@ bool SocketCanBackend::open()
 
 void SocketCanBackend::close()
 {
+    if (channel) {
+        SocketCanReader::instance()->remove(channel);
+        channel.reset();
+    }
+
     ::close(canSocket);
     canSocket = -1;
 
@@ -356,17 +365,21 @@ bool SocketCanBackend::connectSocket()
         return false;
     }
 
-    m_iov.iov_base = &m_frame;
-    m_msg.msg_name = &m_address;
-    m_msg.msg_iov = &m_iov;
-    m_msg.msg_iovlen = 1;
-    m_msg.msg_control = &m_ctrlmsg;
-
     delete notifier;
+    notifier = nullptr;
 
-    notifier = new QSocketNotifier(canSocket, QSocketNotifier::Read, this);
-    connect(notifier, &QSocketNotifier::activated,
-            this, &SocketCanBackend::readSocket);
+    if (SocketCanReader::isEnabled()) {
+        QString errorString;
+        channel = SocketCanReader::instance()->add(int(canSocket), this, &errorString);
+        if (Q_UNLIKELY(!channel)) {
+            setError(errorString, QCanBusDevice::CanBusError::ConnectionError);
+            return false;
+        }
+    } else {
+        notifier = new QSocketNotifier(canSocket, QSocketNotifier::Read, this);
+        connect(notifier, &QSocketNotifier::activated,
+                this, &SocketCanBackend::readSocket);
+    }
 
     //apply all stored configurations
     const auto keys = configurationKeys();
@@ -655,62 +668,38 @@ QString SocketCanBackend::interpretErrorFrame(const QCanBusFrame &errorFrame)
 void SocketCanBackend::readSocket()
 {
     QList<QCanBusFrame> newFrames;
+    QStringList errors;
+    receiver->receive(int(canSocket), &newFrames, &errors);
 
-    for (;;) {
-        m_frame = {};
-        m_iov.iov_len = sizeof(m_frame);
-        m_msg.msg_namelen = sizeof(m_addr);
-        m_msg.msg_controllen = sizeof(m_ctrlmsg);
-        m_msg.msg_flags = 0;
-
-        const int bytesReceived = ::recvmsg(canSocket, &m_msg, 0);
-
-        if (bytesReceived <= 0) {
-            break;
-        } else if (Q_UNLIKELY(bytesReceived != CANFD_MTU && bytesReceived != CAN_MTU)) {
-            setError(tr("ERROR SocketCanBackend: incomplete CAN frame"),
-                     QCanBusDevice::CanBusError::ReadError);
-            continue;
-        } else if (Q_UNLIKELY(m_frame.len > bytesReceived - offsetof(canfd_frame, data))) {
-            setError(tr("ERROR SocketCanBackend: invalid CAN frame length"),
-                     QCanBusDevice::CanBusError::ReadError);
-            continue;
-        }
-
-        struct timeval timeStamp = {};
-        if (Q_UNLIKELY(ioctl(canSocket, SIOCGSTAMP, &timeStamp) < 0)) {
-            setError(qt_error_string(errno),
-                     QCanBusDevice::CanBusError::ReadError);
-            timeStamp = {};
-        }
-
-        const QCanBusFrame::TimeStamp stamp(timeStamp.tv_sec, timeStamp.tv_usec);
-        QCanBusFrame bufferedFrame;
-        bufferedFrame.setTimeStamp(stamp);
-        bufferedFrame.setFlexibleDataRateFormat(bytesReceived == CANFD_MTU);
-
-        bufferedFrame.setExtendedFrameFormat(m_frame.can_id & CAN_EFF_FLAG);
-        Q_ASSERT(m_frame.len <= CANFD_MAX_DLEN);
-
-        if (m_frame.can_id & CAN_RTR_FLAG)
-            bufferedFrame.setFrameType(QCanBusFrame::RemoteRequestFrame);
-        if (m_frame.can_id & CAN_ERR_FLAG)
-            bufferedFrame.setFrameType(QCanBusFrame::ErrorFrame);
-        if (m_frame.flags & CANFD_BRS)
-            bufferedFrame.setBitrateSwitch(true);
-        if (m_frame.flags & CANFD_ESI)
-            bufferedFrame.setErrorStateIndicator(true);
-        if (m_msg.msg_flags & MSG_CONFIRM)
-            bufferedFrame.setLocalEcho(true);
-
-        bufferedFrame.setFrameId(m_frame.can_id & CAN_EFF_MASK);
+    for (const QString &error : std::as_const(errors))
+        setError(error, QCanBusDevice::CanBusError::ReadError);
+    enqueueReceivedFrames(newFrames);
+}
 
-        const QByteArray load(reinterpret_cast<char *>(m_frame.data), m_frame.len);
-        bufferedFrame.setPayload(load);
+// Takes the frames the shared SocketCanReader received for this device.
+void SocketCanBackend::readChannel()
+{
+    if (!channel)
+        return;
 
-        newFrames.append(std::move(bufferedFrame));
+    QList<QCanBusFrame> newFrames;
+    QStringList errors;
+    qint64 droppedFrames = 0;
+    {
+        QMutexLocker locker(&channel->mutex);
+        newFrames.swap(channel->frames);
+        errors.swap(channel->errors);
+        droppedFrames = std::exchange(channel->droppedFrames, 0);
+        channel->notified = false;
     }
 
+    for (const QString &error : std::as_const(errors))
+        setError(error, QCanBusDevice::CanBusError::ReadError);
+    if (Q_UNLIKELY(droppedFrames > 0)) {
+        setError(tr("ERROR SocketCanBackend: %1 received frames dropped, they were not read "
+                    "in time").arg(droppedFrames),
+                 QCanBusDevice::CanBusError::ReadError);
+    }
     enqueueReceivedFrames(newFrames);
 }
 
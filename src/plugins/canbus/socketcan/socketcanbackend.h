@@ -48,6 +48,8 @@ struct canfd_frame {
 QT_BEGIN_NAMESPACE
 
 class LibSocketCan;
+class SocketCanReceiver;
+struct SocketCanChannel;
 
 class SocketCanBackend : public QCanBusDevice
 {
@@ -75,6 +77,7 @@ public:
 
 private Q_SLOTS:
     void readSocket();
+    void readChannel();
 
 private:
     void resetConfigurations();
@@ -82,15 +85,12 @@ private:
     bool applyConfigurationParameter(ConfigurationKey key, const QVariant &value);
 
     int protocol = CAN_RAW;
-    canfd_frame m_frame;
     sockaddr_can m_address;
-    msghdr m_msg;
-    iovec m_iov;
-    sockaddr_can m_addr;
-    char m_ctrlmsg[CMSG_SPACE(sizeof(timeval)) + CMSG_SPACE(sizeof(__u32))];
 
     qint64 canSocket = -1;
     QSocketNotifier *notifier = nullptr;
+    std::unique_ptr<SocketCanReceiver> receiver;
+    std::shared_ptr<SocketCanChannel> channel; // set when read by the shared SocketCanReader
     std::unique_ptr<LibSocketCan> libSocketCan;
     QString canSocketName;
     bool canFdOptionEnabled = false;
@@ -0,0 +1,362 @@
+// Copyright (C) 2023 The Qt Company Ltd.
+// SPDX-License-Identifier: LicenseRef-Qt-Commercial OR LGPL-3.0-only OR GPL-2.0-only OR GPL-3.0-only
+
+#include "socketcanreader.h"
+
+#include <QtCore/qloggingcategory.h>
+
+#include <utility>
+
+#include <errno.h>
+#include <unistd.h>
+#include <linux/sockios.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/ioctl.h>
+
+#ifndef CANFD_BRS
+#   define CANFD_BRS 0x01 /* bit rate switch (second bitrate for payload data) */
+#endif
+#ifndef CANFD_ESI
+#   define CANFD_ESI 0x02 /* error state indicator of the transmitting node */
+#endif
+
+QT_BEGIN_NAMESPACE
+
+Q_DECLARE_LOGGING_CATEGORY(QT_CANBUS_PLUGINS_SOCKETCAN)
+
+enum : quint64 {
+    WakeupId = 0 // the channel ids start at 1
+};
+
+enum {
+    MaximumEvents = 64,
+    BatchSize = 64, // frames read from one socket before the other sockets get their turn
+    MaximumPendingFrames = 65536 // frames kept for a device until it takes them
+};
+
+Q_GLOBAL_STATIC(SocketCanReader, socketCanReader)
+
+SocketCanReceiver::SocketCanReceiver()
+{
+    m_frame = {};
+    m_addr = {};
+    m_msg = {};
+    m_iov = {};
+    m_iov.iov_base = &m_frame;
+    m_msg.msg_name = &m_addr;
+    m_msg.msg_iov = &m_iov;
+    m_msg.msg_iovlen = 1;
+    m_msg.msg_control = &m_ctrlmsg;
+}
+
+bool SocketCanReceiver::receive(int socket, QList<QCanBusFrame> *frames, QStringList *errors,
+                                int maximum)
+{
+    for (int i = 0; i < maximum; ++i) {
+        m_frame = {};
+        m_iov.iov_len = sizeof(m_frame);
+        m_msg.msg_namelen = sizeof(m_addr);
+        m_msg.msg_controllen = sizeof(m_ctrlmsg);
+        m_msg.msg_flags = 0;
+
+        const int bytesReceived = ::recvmsg(socket, &m_msg, 0);
+
+        if (bytesReceived <= 0) {
+            return false;
+        } else if (Q_UNLIKELY(bytesReceived != CANFD_MTU && bytesReceived != CAN_MTU)) {
+            errors->append(SocketCanBackend::tr("ERROR SocketCanBackend: incomplete CAN frame"));
+            continue;
+        } else if (Q_UNLIKELY(m_frame.len > bytesReceived - offsetof(canfd_frame, data))) {
+            errors->append(
+                    SocketCanBackend::tr("ERROR SocketCanBackend: invalid CAN frame length"));
+            continue;
+        }
+
+        struct timeval timeStamp = {};
+        if (Q_UNLIKELY(ioctl(socket, SIOCGSTAMP, &timeStamp) < 0)) {
+            errors->append(qt_error_string(errno));
+            timeStamp = {};
+        }
+
+        const QCanBusFrame::TimeStamp stamp(timeStamp.tv_sec, timeStamp.tv_usec);
+        QCanBusFrame bufferedFrame;
+        bufferedFrame.setTimeStamp(stamp);
+        bufferedFrame.setFlexibleDataRateFormat(bytesReceived == CANFD_MTU);
+
+        bufferedFrame.setExtendedFrameFormat(m_frame.can_id & CAN_EFF_FLAG);
+        Q_ASSERT(m_frame.len <= CANFD_MAX_DLEN);
+
+        if (m_frame.can_id & CAN_RTR_FLAG)
+            bufferedFrame.setFrameType(QCanBusFrame::RemoteRequestFrame);
+        if (m_frame.can_id & CAN_ERR_FLAG)
+            bufferedFrame.setFrameType(QCanBusFrame::ErrorFrame);
+        if (m_frame.flags & CANFD_BRS)
+            bufferedFrame.setBitrateSwitch(true);
+        if (m_frame.flags & CANFD_ESI)
+            bufferedFrame.setErrorStateIndicator(true);
+        if (m_msg.msg_flags & MSG_CONFIRM)
+            bufferedFrame.setLocalEcho(true);
+
+        bufferedFrame.setFrameId(m_frame.can_id & CAN_EFF_MASK);
+
+        const QByteArray load(reinterpret_cast<char *>(m_frame.data), m_frame.len);
+        bufferedFrame.setPayload(load);
+
+        frames->append(std::move(bufferedFrame));
+    }
+
+    return true;
+}
+
+bool SocketCanDispatcher::enqueue(const std::shared_ptr<SocketCanChannel> &channel)
+{
+    QMutexLocker locker(&m_mutex);
+    m_ready.push_back(channel);
+    return !std::exchange(m_posted, true);
+}
+
+void SocketCanDispatcher::dispatch()
+{
+    std::vector<std::weak_ptr<SocketCanChannel>> ready;
+    {
+        QMutexLocker locker(&m_mutex);
+        ready.swap(m_ready);
+        m_posted = false;
+    }
+
+    for (const auto &weakChannel : ready) {
+        const std::shared_ptr<SocketCanChannel> channel = weakChannel.lock();
+        if (!channel)
+            continue;
+
+        SocketCanBackend *device = nullptr;
+        {
+            QMutexLocker locker(&channel->mutex);
+            device = channel->device;
+            if (!device)
+                continue;
+            if (Q_UNLIKELY(device->thread() != thread())) {
+                // The device was moved to another thread after it connected.
+                QMetaObject::invokeMethod(device, "readChannel", Qt::QueuedConnection);
+                continue;
+            }
+        }
+        // Devices of this thread are only removed in this thread, between the events.
+        QMetaObject::invokeMethod(device, "readChannel", Qt::DirectConnection);
+    }
+}
+
+SocketCanReader::SocketCanReader()
+{
+    setObjectName(QStringLiteral("SocketCanReader"));
+
+    m_epoll = epoll_create1(EPOLL_CLOEXEC);
+    m_wakeup = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    if (Q_UNLIKELY(m_epoll < 0 || m_wakeup < 0)) {
+        qCWarning(QT_CANBUS_PLUGINS_SOCKETCAN, "Cannot create the shared reader: %ls",
+                  qUtf16Printable(qt_error_string(errno)));
+        return;
+    }
+
+    epoll_event event = {};
+    event.events = EPOLLIN;
+    event.data.u64 = WakeupId;
+    if (Q_UNLIKELY(epoll_ctl(m_epoll, EPOLL_CTL_ADD, m_wakeup, &event) < 0)) {
+        qCWarning(QT_CANBUS_PLUGINS_SOCKETCAN, "Cannot create the shared reader: %ls",
+                  qUtf16Printable(qt_error_string(errno)));
+        ::close(m_epoll);
+        m_epoll = -1;
+    }
+}
+
+SocketCanReader::~SocketCanReader()
+{
+    if (isRunning())
+        stop();
+
+    if (m_wakeup >= 0)
+        ::close(m_wakeup);
+    if (m_epoll >= 0)
+        ::close(m_epoll);
+}
+
+bool SocketCanReader::isEnabled()
+{
+    static const bool enabled =
+            qEnvironmentVariableIntValue("QT_CANBUS_SOCKETCAN_SHARED_READER") != 0;
+    return enabled;
+}
+
+SocketCanReader *SocketCanReader::instance()
+{
+    return socketCanReader();
+}
+
+std::shared_ptr<SocketCanChannel> SocketCanReader::add(int socket, SocketCanBackend *device,
+                                                       QString *error)
+{
+    QMutexLocker control(&m_controlMutex);
+
+    if (Q_UNLIKELY(m_epoll < 0 || m_wakeup < 0)) {
+        *error = SocketCanBackend::tr("The shared SocketCAN reader is not available.");
+        return {};
+    }
+
+    auto channel = std::make_shared<SocketCanChannel>();
+    channel->socket = socket;
+    channel->device = device;
+    channel->dispatcher = dispatcher(device->thread());
+    {
+        QMutexLocker locker(&m_mutex);
+        channel->id = ++m_nextId;
+        m_channels.insert(channel->id, channel);
+    }
+
+    epoll_event event = {};
+    event.events = EPOLLIN;
+    event.data.u64 = channel->id;
+    if (Q_UNLIKELY(epoll_ctl(m_epoll, EPOLL_CTL_ADD, socket, &event) < 0)) {
+        *error = qt_error_string(errno);
+        QMutexLocker locker(&m_mutex);
+        m_channels.remove(channel->id);
+        return {};
+    }
+
+    if (!isRunning()) {
+        m_stopping.store(false, std::memory_order_relaxed);
+        start();
+    }
+    return channel;
+}
+
+// Once this returns, the reader thread neither reads the socket nor notifies the device.
+void SocketCanReader::remove(const std::shared_ptr<SocketCanChannel> &channel)
+{
+    if (!channel)
+        return;
+
+    QMutexLocker control(&m_controlMutex);
+
+    epoll_ctl(m_epoll, EPOLL_CTL_DEL, channel->socket, nullptr);
+    {
+        QMutexLocker locker(&channel->mutex);
+        channel->device = nullptr;
+        channel->socket = -1;
+    }
+
+    bool empty = false;
+    {
+        QMutexLocker locker(&m_mutex);
+        m_channels.remove(channel->id);
+        empty = m_channels.isEmpty();
+    }
+
+    // The thread only runs as long as there are sockets to read.
+    if (empty && isRunning())
+        stop();
+}
+
+std::shared_ptr<SocketCanDispatcher> SocketCanReader::dispatcher(QThread *thread)
+{
+    m_dispatchers.removeIf([](decltype(m_dispatchers)::iterator it) {
+        return it.value().expired();
+    });
+
+    std::shared_ptr<SocketCanDispatcher> dispatcher = m_dispatchers.value(thread).lock();
+    if (!dispatcher) {
+        // The last reference may be dropped by the reader thread, delete it in its own thread.
+        dispatcher.reset(new SocketCanDispatcher, [](SocketCanDispatcher *d) {
+            d->deleteLater();
+        });
+        dispatcher->moveToThread(thread);
+        m_dispatchers.insert(thread, dispatcher);
+    }
+    return dispatcher;
+}
+
+void SocketCanReader::run()
+{
+    epoll_event events[MaximumEvents];
+    std::vector<std::shared_ptr<SocketCanDispatcher>> posted;
+
+    while (!m_stopping.load(std::memory_order_acquire)) {
+        const int count = epoll_wait(m_epoll, events, MaximumEvents, -1);
+        if (Q_UNLIKELY(count < 0)) {
+            if (errno == EINTR)
+                continue;
+            qCWarning(QT_CANBUS_PLUGINS_SOCKETCAN, "Cannot wait for CAN sockets: %ls",
+                      qUtf16Printable(qt_error_string(errno)));
+            return;
+        }
+
+        for (int i = 0; i < count; ++i) {
+            const quint64 id = events[i].data.u64;
+            if (id == WakeupId) {
+                quint64 value = 0;
+                [[maybe_unused]] const auto bytesRead = ::read(m_wakeup, &value, sizeof(value));
+                continue;
+            }
+
+            // The channel may have been removed since epoll_wait() returned.
+            std::shared_ptr<SocketCanChannel> channel;
+            {
+                QMutexLocker locker(&m_mutex);
+                channel = m_channels.value(id);
+            }
+            if (channel && readChannel(channel.get()) && channel->dispatcher->enqueue(channel))
+                posted.push_back(channel->dispatcher);
+        }
+
+        // One event per thread and round, however many of its devices received frames.
+        for (const auto &dispatcher : posted) {
+            SocketCanDispatcher *target = dispatcher.get();
+            QMetaObject::invokeMethod(target, [target]() { target->dispatch(); },
+                                      Qt::QueuedConnection);
+        }
+        posted.clear();
+    }
+}
+
+/*
+    Reads a batch of frames from the socket of the channel. Sockets with more
+    frames are reported again by the level-triggered epoll set, so a busy
+    socket cannot starve the others. Returns true if the device needs to be
+    told about the frames.
+
+    A device that does not take its frames keeps at most MaximumPendingFrames,
+    further frames are dropped and counted, as the socket's receive buffer
+    would do without the shared reader.
+*/
+bool SocketCanReader::readChannel(SocketCanChannel *channel)
+{
+    QMutexLocker locker(&channel->mutex);
+    if (!channel->device)
+        return false;
+
+    const qsizetype room = MaximumPendingFrames - channel->frames.size();
+    if (room > 0) {
+        m_receiver.receive(channel->socket, &channel->frames, &channel->errors,
+                           int(qMin<qsizetype>(room, BatchSize)));
+    } else {
+        m_dropped.clear();
+        m_receiver.receive(channel->socket, &m_dropped, &channel->errors, BatchSize);
+        channel->droppedFrames += m_dropped.size();
+    }
+    if (channel->notified || (channel->frames.isEmpty() && channel->errors.isEmpty()))
+        return false;
+
+    // Further frames are added to the same batch until the device takes it.
+    channel->notified = true;
+    return true;
+}
+
+void SocketCanReader::stop()
+{
+    m_stopping.store(true, std::memory_order_release);
+    const quint64 value = 1;
+    [[maybe_unused]] const auto bytesWritten = ::write(m_wakeup, &value, sizeof(value));
+    wait();
+}
+
+QT_END_NAMESPACE
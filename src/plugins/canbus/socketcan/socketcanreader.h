@@ -0,0 +1,109 @@
+// Copyright (C) 2023 The Qt Company Ltd.
+// SPDX-License-Identifier: LicenseRef-Qt-Commercial OR LGPL-3.0-only OR GPL-2.0-only OR GPL-3.0-only
+
+#ifndef SOCKETCANREADER_H
+#define SOCKETCANREADER_H
+
+#include "socketcanbackend.h"
+
+#include <QtCore/qhash.h>
+#include <QtCore/qlist.h>
+#include <QtCore/qmutex.h>
+#include <QtCore/qobject.h>
+#include <QtCore/qstringlist.h>
+#include <QtCore/qthread.h>
+
+#include <atomic>
+#include <limits>
+#include <memory>
+#include <vector>
+
+QT_BEGIN_NAMESPACE
+
+// Receives frames from a SocketCAN socket and converts them to QCanBusFrame.
+class SocketCanReceiver
+{
+public:
+    SocketCanReceiver();
+
+    // Returns false when the socket has no more frames, true when maximum messages were read.
+    bool receive(int socket, QList<QCanBusFrame> *frames, QStringList *errors,
+                 int maximum = std::numeric_limits<int>::max());
+
+private:
+    canfd_frame m_frame;
+    msghdr m_msg;
+    iovec m_iov;
+    sockaddr_can m_addr;
+    char m_ctrlmsg[CMSG_SPACE(sizeof(timeval)) + CMSG_SPACE(sizeof(__u32))];
+};
+
+class SocketCanDispatcher;
+
+// A socket registered with the SocketCanReader. The reader thread appends the frames it
+// receives, the device takes them in its own thread.
+struct SocketCanChannel
+{
+    QMutex mutex;
+    quint64 id = 0;
+    int socket = -1;
+    SocketCanBackend *device = nullptr; // nullptr once the channel is removed
+    std::shared_ptr<SocketCanDispatcher> dispatcher;
+    QList<QCanBusFrame> frames;
+    QStringList errors;
+    qint64 droppedFrames = 0; // received while frames was full
+    bool notified = false; // the device was told about the frames and did not take them yet
+};
+
+// Lives in the thread of one or more devices. The reader posts one event per epoll round to
+// it, which tells every device with new frames in that thread.
+class SocketCanDispatcher : public QObject
+{
+public:
+    // Returns true if the dispatcher needs to be posted.
+    bool enqueue(const std::shared_ptr<SocketCanChannel> &channel);
+    void dispatch();
+
+private:
+    QMutex m_mutex;
+    std::vector<std::weak_ptr<SocketCanChannel>> m_ready;
+    bool m_posted = false;
+};
+
+// Reads all registered sockets in one thread through one epoll set. Each thread with devices
+// is woken up once per epoll round, instead of once per readable socket by a socket notifier.
+class SocketCanReader : public QThread
+{
+public:
+    SocketCanReader();
+    ~SocketCanReader() override;
+
+    static bool isEnabled();
+    static SocketCanReader *instance();
+
+    std::shared_ptr<SocketCanChannel> add(int socket, SocketCanBackend *device, QString *error);
+    void remove(const std::shared_ptr<SocketCanChannel> &channel);
+
+protected:
+    void run() override;
+
+private:
+    std::shared_ptr<SocketCanDispatcher> dispatcher(QThread *thread);
+    bool readChannel(SocketCanChannel *channel);
+    void stop();
+
+    int m_epoll = -1;
+    int m_wakeup = -1;
+    std::atomic<bool> m_stopping = false;
+    QMutex m_controlMutex; // serializes starting and stopping the thread, guards m_dispatchers
+    QMutex m_mutex; // guards m_channels
+    QHash<quint64, std::shared_ptr<SocketCanChannel>> m_channels;
+    QHash<QThread *, std::weak_ptr<SocketCanDispatcher>> m_dispatchers;
+    quint64 m_nextId = 0;
+    SocketCanReceiver m_receiver;
+    QList<QCanBusFrame> m_dropped; // used by the reader thread only
+};
+
+QT_END_NAMESPACE
+
+#endif // SOCKETCANREADER_H
@@ -2,10 +2,13 @@
 // SPDX-License-Identifier: LicenseRef-Qt-Commercial OR LGPL-3.0-only OR GPL-2.0-only OR GPL-3.0-only
 
 #include "virtualcanbackend.h"
+#include "virtualcanprotocol.h"
 
 #include <QtCore/qdatetime.h>
+#include <QtCore/qendian.h>
 #include <QtCore/qloggingcategory.h>
 #include <QtCore/qregularexpression.h>
+#include <QtCore/qtimer.h>
 
 #include <QtNetwork/qtcpserver.h>
 #include <QtNetwork/qtcpsocket.h>
@@ -13,20 +16,20 @@
 QT_BEGIN_NAMESPACE
 
 using namespace Qt::Literals::StringLiterals;
+using namespace VirtualCanProtocol;
 
 Q_DECLARE_LOGGING_CATEGORY(QT_CANBUS_PLUGINS_VIRTUALCAN)
 
 enum {
     ServerDefaultTcpPort = 35468,
-    VirtualChannels = 2
+    SharedMemoryPollInterval = 1,
+    SharedMemoryIdlePollInterval = 100
 };
 
-static const char RemoteRequestFlag    = 'R';
-static const char ExtendedFormatFlag   = 'X';
-static const char FlexibleDataRateFlag = 'F';
-static const char BitRateSwitchFlag    = 'B';
-static const char ErrorStateFlag       = 'E';
-static const char LocalEchoFlag        = 'L';
+#if QT_CONFIG(sharedmemory)
+static_assert(FrameHeaderSize + MaximumPayloadSize
+              <= VirtualCanSharedMemoryBus::MaximumMessageSize);
+#endif
 
 VirtualCanServer::VirtualCanServer(QObject *parent)
     : QObject(parent)
@@ -70,7 +73,7 @@ void VirtualCanServer::connected()
     while (m_server->hasPendingConnections()) {
         qCInfo(QT_CANBUS_PLUGINS_VIRTUALCAN, "Server [%p] client connected.", this);
         QTcpSocket *next = m_server->nextPendingConnection();
-        m_serverSockets.append(next);
+        m_clients.insert(next, Client());
         connect(next, &QIODevice::readyRead, this, &VirtualCanServer::readyRead);
         connect(next, &QTcpSocket::disconnected, this, &VirtualCanServer::disconnected);
     }
@@ -83,7 +86,17 @@ void VirtualCanServer::disconnected()
     auto socket = qobject_cast<QTcpSocket *>(sender());
     Q_ASSERT(socket);
 
-    m_serverSockets.removeOne(socket);
+    const auto it = m_clients.find(socket);
+    if (it != m_clients.end()) {
+        for (quint8 channel : std::as_const(it->channels))
+            m_subscribers[channel].removeOne(socket);
+        m_clients.erase(it);
+    }
+    for (VirtualCanBusSimulation *simulation : m_simulations) {
+        if (simulation)
+            simulation->removeSender(socket);
+    }
+    m_pendingWrites.removeOne(socket);
     socket->deleteLater();
 }
 
@@ -92,44 +105,156 @@ void VirtualCanServer::readyRead()
     auto readSocket = qobject_cast<QTcpSocket *>(sender());
     Q_ASSERT(readSocket);
 
-    while (readSocket->canReadLine()) {
-        const QByteArray command = readSocket->readLine().trimmed();
-        qCDebug(QT_CANBUS_PLUGINS_VIRTUALCAN,
-                "Server [%p] received: '%s'.", this, command.constData());
-
-        if (command.startsWith("connect:")) {
-            const QVariant interfaces = readSocket->property("interfaces");
-            QStringList list = interfaces.toStringList();
-            list.append(command.mid(int(strlen("connect:"))));
-            readSocket->setProperty("interfaces", list);
-
-        } else if (command.startsWith("disconnect:")) {
-            const QVariant interfaces = readSocket->property("interfaces");
-            QStringList list = interfaces.toStringList();
-            list.removeAll(command.mid(int(strlen("disconnect:"))));
-            readSocket->setProperty("interfaces", list);
-            readSocket->disconnectFromHost();
-
-        } else {
-            const QByteArrayList commandList = command.split(':');
-            Q_ASSERT(commandList.size() == 2);
-
-            for (QTcpSocket *writeSocket : std::as_const(m_serverSockets)) {
-                // Don't send the frame back to its origin
-                if (writeSocket == readSocket)
-                    continue;
-
-                // Send frame to all clients registered to the same interface as sender
-                const QVariant property = writeSocket->property("interfaces");
-                if (!property.isValid())
-                    continue;
-
-                const QStringList propertyList = property.toStringList();
-                if (propertyList.contains(commandList.first()))
-                    writeSocket->write(commandList.last() + '\n');
+    const auto it = m_clients.find(readSocket);
+    if (it == m_clients.end())
+        return;
+    Client &client = *it;
+
+    // All complete messages received are routed first, and the messages for each
+    // destination are then written with a single call.
+    client.input.append(readSocket->readAll());
+    const char *data = client.input.constData();
+    const qsizetype available = client.input.size();
+    qsizetype offset = 0;
+    bool invalid = false;
+    bool closing = false;
+    while (!closing) {
+        const qsizetype size = messageSize(data + offset, available - offset);
+        if (size <= 0) {
+            invalid = size < 0;
+            break;
+        }
+
+        const char *message = data + offset;
+        const quint8 channel = quint8(message[3]);
+        switch (quint8(message[2])) {
+        case ConnectMessage: {
+            qCDebug(QT_CANBUS_PLUGINS_VIRTUALCAN,
+                    "Server [%p] received connect for channel %d.", this, channel);
+            // The answer tells the client the version of the server, also on a mismatch.
+            readSocket->write(connectMessage(channel));
+            const quint16 version = protocolVersion(message);
+            if (version != ProtocolVersion) {
+                qCWarning(QT_CANBUS_PLUGINS_VIRTUALCAN,
+                          "Server [%p] rejected a client with protocol version %u, "
+                          "expected version %u.", this, uint(version), uint(ProtocolVersion));
+                closing = true;
+                break;
             }
+            subscribe(readSocket, client, channel);
+            break;
         }
+        case DisconnectMessage:
+            qCDebug(QT_CANBUS_PLUGINS_VIRTUALCAN,
+                    "Server [%p] received disconnect for channel %d.", this, channel);
+            unsubscribe(readSocket, client, channel);
+            closing = true;
+            break;
+        case ConfigureMessage:
+            configure(channel, qFromLittleEndian<quint32>(message + 4),
+                      qFromLittleEndian<quint32>(message + 8));
+            break;
+        case FrameMessage:
+            if (VirtualCanBusSimulation *simulation = m_simulations[channel]) {
+                simulation->enqueue(readSocket, decodeFrame(message, size, 0),
+                                    QByteArray(message, size));
+            } else {
+                route(readSocket, channel, message, size);
+            }
+            break;
+        }
+        offset += size;
+    }
+    client.input.remove(0, offset);
+    writePending();
+
+    // Both may emit disconnected() immediately, which removes the client.
+    if (invalid) {
+        qCWarning(QT_CANBUS_PLUGINS_VIRTUALCAN,
+                  "Server [%p] received an invalid message, closing the connection.", this);
+        readSocket->abort();
+    } else if (closing) {
+        readSocket->disconnectFromHost();
+    }
+}
+
+void VirtualCanServer::route(const QObject *origin, quint8 channel, const char *message,
+                             qsizetype size)
+{
+    for (QTcpSocket *writeSocket : std::as_const(m_subscribers[channel])) {
+        // Don't send the frame back to its origin
+        if (writeSocket == origin)
+            continue;
+
+        Client &destination = *m_clients.find(writeSocket);
+        if (destination.output.isEmpty())
+            m_pendingWrites.append(writeSocket);
+        destination.output.append(message, size);
+    }
+}
+
+void VirtualCanServer::writePending()
+{
+    for (QTcpSocket *writeSocket : std::as_const(m_pendingWrites)) {
+        Client &destination = *m_clients.find(writeSocket);
+        writeSocket->write(destination.output);
+        destination.output.resize(0); // keeps the capacity for the next batch
+    }
+    m_pendingWrites.clear();
+}
+
+// The bit rates apply to all devices of the channel, the last configuration wins.
+void VirtualCanServer::configure(quint8 channel, quint32 bitRate, quint32 dataBitRate)
+{
+    VirtualCanBusSimulation *&simulation = m_simulations[channel];
+    if (bitRate == 0) {
+        if (!simulation)
+            return;
+        qCDebug(QT_CANBUS_PLUGINS_VIRTUALCAN,
+                "Server [%p] stops simulating channel %d.", this, channel);
+        // The frames still pending are routed immediately, the caller writes them.
+        routeTransmissions(channel, simulation->takeTransmissions());
+        delete simulation;
+        simulation = nullptr;
+        return;
+    }
+
+    qCDebug(QT_CANBUS_PLUGINS_VIRTUALCAN,
+            "Server [%p] simulates channel %d with %u bit/s and %u bit/s data bit rate.",
+            this, channel, bitRate, dataBitRate);
+    if (!simulation) {
+        simulation = new VirtualCanBusSimulation(this);
+        connect(simulation, &VirtualCanBusSimulation::transmitted, this,
+                [this, channel](const QList<VirtualCanBusSimulation::Transmission> &frames) {
+            routeTransmissions(channel, frames);
+            writePending();
+        });
     }
+    simulation->setBitRates(bitRate, dataBitRate);
+}
+
+void VirtualCanServer::routeTransmissions(
+        quint8 channel, const QList<VirtualCanBusSimulation::Transmission> &transmissions)
+{
+    for (VirtualCanBusSimulation::Transmission frame : transmissions) {
+        if (frame.timeStamp != 0)
+            qToLittleEndian<qint64>(frame.timeStamp, frame.message.data() + 9);
+        route(frame.sender, channel, frame.message.constData(), frame.message.size());
+    }
+}
+
+void VirtualCanServer::subscribe(QTcpSocket *socket, Client &client, quint8 channel)
+{
+    if (client.channels.contains(channel))
+        return;
+    client.channels.append(channel);
+    m_subscribers[channel].append(socket);
+}
+
+void VirtualCanServer::unsubscribe(QTcpSocket *socket, Client &client, quint8 channel)
+{
+    if (client.channels.removeOne(channel))
+        m_subscribers[channel].removeOne(socket);
 }
 
 Q_GLOBAL_STATIC(VirtualCanServer, g_server)
@@ -159,6 +284,18 @@ VirtualCanBackend::VirtualCanBackend(const QString &interface, QObject *parent)
     }
 
     m_channel = channel;
+
+    const QString scheme = m_url.scheme();
+    if (scheme == "local"_L1) {
+        m_transport = Transport::Local;
+    } else if (scheme == "shm"_L1) {
+#if QT_CONFIG(sharedmemory)
+        m_transport = Transport::SharedMemory;
+#else
+        qCWarning(QT_CANBUS_PLUGINS_VIRTUALCAN, "Shared memory is not supported.");
+        setError(tr("Shared memory is not supported."), QCanBusDevice::ConnectionError);
+#endif
+    }
 }
 
 VirtualCanBackend::~VirtualCanBackend()
@@ -170,6 +307,38 @@ bool VirtualCanBackend::open()
 {
     setState(QCanBusDevice::ConnectingState);
 
+    if (m_transport == Transport::Local) {
+        m_localNode = VirtualCanLocalBus::instance()->join(m_channel);
+        connect(m_localNode.get(), &VirtualCanLocalNode::framesAvailable,
+                this, &VirtualCanBackend::localFramesAvailable);
+        qCDebug(QT_CANBUS_PLUGINS_VIRTUALCAN, "Client [%p] joined the local bus.", this);
+        setState(QCanBusDevice::ConnectedState);
+        return true;
+    }
+
+#if QT_CONFIG(sharedmemory)
+    if (m_transport == Transport::SharedMemory) {
+        // Other processes cannot wake this one up, the ring is polled instead.
+        const QString name = m_url.host().isEmpty() ? u"qtvirtualcan"_s : m_url.host();
+        m_sharedMemoryBus = std::make_unique<VirtualCanSharedMemoryBus>();
+        if (!m_sharedMemoryBus->attach(name, m_channel)) {
+            setError(tr("Cannot attach to the shared memory bus '%1': %2")
+                     .arg(name, m_sharedMemoryBus->errorString()),
+                     QCanBusDevice::ConnectionError);
+            m_sharedMemoryBus.reset();
+            return false;
+        }
+        m_pollTimer = new QTimer(this);
+        m_pollTimer->setTimerType(Qt::PreciseTimer);
+        connect(m_pollTimer, &QTimer::timeout, this, &VirtualCanBackend::sharedMemoryReadyRead);
+        m_pollTimer->start(SharedMemoryPollInterval);
+        qCDebug(QT_CANBUS_PLUGINS_VIRTUALCAN, "Client [%p] attached to the shared memory bus.",
+                this);
+        setState(QCanBusDevice::ConnectedState);
+        return true;
+    }
+#endif
+
     const QString host = m_url.host();
     const QHostAddress address = host.isEmpty() ? QHostAddress::LocalHost : QHostAddress(host);
     const quint16 port = static_cast<quint16>(m_url.port(ServerDefaultTcpPort));
@@ -188,36 +357,55 @@ bool VirtualCanBackend::open()
 
 void VirtualCanBackend::close()
 {
+    if (m_transport == Transport::Local) {
+        VirtualCanLocalBus::instance()->leave(m_channel, m_localNode);
+        m_localNode.reset();
+        setState(QCanBusDevice::UnconnectedState);
+        return;
+    }
+
+#if QT_CONFIG(sharedmemory)
+    if (m_transport == Transport::SharedMemory) {
+        delete m_pollTimer;
+        m_pollTimer = nullptr;
+        m_sharedMemoryBus.reset();
+        setState(QCanBusDevice::UnconnectedState);
+        return;
+    }
+#endif
+
     qCDebug(QT_CANBUS_PLUGINS_VIRTUALCAN, "Client [%p] sends disconnect to server.", this);
 
-    m_clientSocket->write(QByteArray("disconnect:can"_ba + QByteArray::number(m_channel) + '\n'));
+    m_clientSocket->write(disconnectMessage(m_channel));
 }
 
 void VirtualCanBackend::setConfigurationParameter(ConfigurationKey key, const QVariant &value)
 {
     if (key == QCanBusDevice::ReceiveOwnKey || key == QCanBusDevice::CanFdKey)
         QCanBusDevice::setConfigurationParameter(key, value);
-}
-
-/*
-    Protocol format: All data is in ASCII, one CAN message per line,
-    each line ends with line feed '\n'.
 
-    Format:  "<CAN-Channel>:<Flags>#<CAN-ID>#<Data-Bytes>\n"
-    Example: "can0:XF#123#123456\n"
-
-    The first part is the destination CAN channel, "can0" or "can1",
-    followed by the flags list:
+    if (key == QCanBusDevice::BitRateKey || key == QCanBusDevice::DataBitRateKey) {
+        QCanBusDevice::setConfigurationParameter(key, value);
+        if (m_transport != Transport::Tcp || state() != QCanBusDevice::ConnectedState)
+            return;
+        // Resetting the bit rate stops the simulation of the channel.
+        if (key == QCanBusDevice::BitRateKey && !value.isValid())
+            m_clientSocket->write(configureMessage(m_channel, 0, 0));
+        else
+            sendConfiguration();
+    }
+}
 
-    * R - Remote Request
-    * X - Extended Frame Format
-    * F - Flexible Data Rate Format
-    * B - Bitrate Switch
-    * E - Error State Indicator
-    * L - Local Echo
+// A bit rate makes the server simulate the timing of the channel.
+void VirtualCanBackend::sendConfiguration()
+{
+    const QVariant bitRate = configurationParameter(QCanBusDevice::BitRateKey);
+    if (!bitRate.isValid())
+        return;
 
-    Afterwards the CAN-ID and the data follows, both separated by '#'.
-*/
+    const QVariant dataBitRate = configurationParameter(QCanBusDevice::DataBitRateKey);
+    m_clientSocket->write(configureMessage(m_channel, bitRate.toUInt(), dataBitRate.toUInt()));
+}
 
 bool VirtualCanBackend::writeFrame(const QCanBusFrame &frame)
 {
@@ -233,23 +421,26 @@ bool VirtualCanBackend::writeFrame(const QCanBusFrame &frame)
         return false;
     }
 
-    QByteArray flags;
-    if (frame.frameType() == QCanBusFrame::RemoteRequestFrame)
-        flags.append(RemoteRequestFlag);
-    if (frame.hasExtendedFrameFormat())
-        flags.append(ExtendedFormatFlag);
-    if (frame.hasFlexibleDataRateFormat())
-        flags.append(FlexibleDataRateFlag);
-    if (frame.hasBitrateSwitch())
-        flags.append(BitRateSwitchFlag);
-    if (frame.hasErrorStateIndicator())
-        flags.append(ErrorStateFlag);
-    if (frame.hasLocalEcho())
-        flags.append(LocalEchoFlag);
-    const QByteArray frameId = QByteArray::number(frame.frameId());
-    const QByteArray command = "can" + QByteArray::number(m_channel)
-            + ':' + frameId + '#' + flags + '#' + frame.payload().toHex() + '\n';
-    m_clientSocket->write(command);
+    if (Q_UNLIKELY(frame.payload().size() > MaximumPayloadSize)) {
+        qCWarning(QT_CANBUS_PLUGINS_VIRTUALCAN,
+                "Error: Cannot write frame with more than %d data bytes!", MaximumPayloadSize);
+        return false;
+    }
+
+    if (m_transport == Transport::Local) {
+        VirtualCanLocalBus::instance()->write(m_channel, frame, m_localNode.get());
+    } else {
+        char message[FrameHeaderSize + MaximumPayloadSize];
+        const qsizetype size = encodeFrame(message, m_channel, frame);
+        // The socket buffers the message, all messages written until the next
+        // event loop iteration are sent together.
+        if (m_transport == Transport::Tcp)
+            m_clientSocket->write(message, size);
+#if QT_CONFIG(sharedmemory)
+        if (m_transport == Transport::SharedMemory)
+            m_sharedMemoryBus->write(message, size);
+#endif
+    }
 
     if (configurationParameter(QCanBusDevice::ReceiveOwnKey).toBool()) {
         const qint64 timeStamp = QDateTime::currentDateTime().toMSecsSinceEpoch();
@@ -296,7 +487,8 @@ QCanBusDeviceInfo VirtualCanBackend::deviceInfo() const
 void VirtualCanBackend::clientConnected()
 {
     qCInfo(QT_CANBUS_PLUGINS_VIRTUALCAN, "Client [%p] socket connected.", this);
-    m_clientSocket->write(QByteArray("connect:can"_ba + QByteArray::number(m_channel) + '\n'));
+    m_clientSocket->write(connectMessage(m_channel));
+    sendConfiguration();
 
     setState(QCanBusDevice::ConnectedState);
 }
@@ -310,34 +502,101 @@ void VirtualCanBackend::clientDisconnected()
 
 void VirtualCanBackend::clientReadyRead()
 {
-    while (m_clientSocket->canReadLine()) {
-        const QByteArray answer = m_clientSocket->readLine().trimmed();
-        qCDebug(QT_CANBUS_PLUGINS_VIRTUALCAN, "Client [%p] received: '%s'.",
-                this, answer.constData());
-
-        if (answer.startsWith(QByteArray("disconnect:can"_ba + QByteArray::number(m_channel)))) {
-            m_clientSocket->disconnectFromHost();
+    m_input.append(m_clientSocket->readAll());
+    const char *data = m_input.constData();
+    const qsizetype available = m_input.size();
+    qsizetype offset = 0;
+    qsizetype size = 0;
+
+    QList<QCanBusFrame> frames;
+    quint16 serverVersion = ProtocolVersion;
+    const qint64 timeStamp = QDateTime::currentDateTime().toMSecsSinceEpoch();
+    while ((size = messageSize(data + offset, available - offset)) > 0) {
+        const char *message = data + offset;
+        offset += size;
+        if (quint8(message[2]) == ConnectMessage) {
+            serverVersion = protocolVersion(message); // the server answered the connect
             continue;
         }
+        if (quint8(message[2]) != FrameMessage || quint8(message[3]) != m_channel)
+            continue;
 
-        const QByteArrayList list = answer.split('#');
-        Q_ASSERT(list.size() == 3);
+        frames.append(decodeFrame(message, size, timeStamp * 1000));
+    }
+    m_input.remove(0, offset);
 
-        const QCanBusFrame::FrameId id = list.at(0).toUInt();
-        const QByteArray flags = list.at(1);
-        const QByteArray data = QByteArray::fromHex(list.at(2));
-        const qint64 timeStamp = QDateTime::currentDateTime().toMSecsSinceEpoch();
-        QCanBusFrame frame(id, data);
+    if (!frames.isEmpty())
+        enqueueReceivedFrames(frames);
+
+    if (Q_UNLIKELY(serverVersion != ProtocolVersion)) {
+        setError(tr("The virtual CAN server uses protocol version %1, expected version %2.")
+                 .arg(serverVersion).arg(uint(ProtocolVersion)), QCanBusDevice::ConnectionError);
+        m_input.clear();
+        m_clientSocket->abort();
+    } else if (Q_UNLIKELY(size < 0)) {
+        qCWarning(QT_CANBUS_PLUGINS_VIRTUALCAN,
+                  "Client [%p] received an invalid message, closing the connection.", this);
+        m_input.clear();
+        m_clientSocket->abort();
+    }
+}
+
+void VirtualCanBackend::localFramesAvailable()
+{
+    if (!m_localNode)
+        return;
+
+    QList<QCanBusFrame> frames;
+    QCanBusFrame frame;
+    const qint64 timeStamp = QDateTime::currentDateTime().toMSecsSinceEpoch();
+    while (m_localNode->pop(&frame)) {
         frame.setTimeStamp(QCanBusFrame::TimeStamp::fromMicroSeconds(timeStamp * 1000));
-        if (flags.contains(RemoteRequestFlag))
-            frame.setFrameType(QCanBusFrame::RemoteRequestFrame);
-        frame.setExtendedFrameFormat(flags.contains(ExtendedFormatFlag));
-        frame.setFlexibleDataRateFormat(flags.contains(FlexibleDataRateFlag));
-        frame.setBitrateSwitch(flags.contains(BitRateSwitchFlag));
-        frame.setErrorStateIndicator(flags.contains(ErrorStateFlag));
-        frame.setLocalEcho(flags.contains(LocalEchoFlag));
-        enqueueReceivedFrames({frame});
+        frames.append(frame);
     }
+
+    if (!frames.isEmpty())
+        enqueueReceivedFrames(frames);
+    reportDroppedFrames(m_localNode->takeDroppedFrames());
+}
+
+void VirtualCanBackend::sharedMemoryReadyRead()
+{
+#if QT_CONFIG(sharedmemory)
+    if (!m_sharedMemoryBus)
+        return;
+
+    QList<QCanBusFrame> frames;
+    const qint64 timeStamp = QDateTime::currentDateTime().toMSecsSinceEpoch();
+    const qint64 dropped = m_sharedMemoryBus->read([&](const char *message, qsizetype size) {
+        if (messageSize(message, size) != size || quint8(message[2]) != FrameMessage
+            || quint8(message[3]) != m_channel) {
+            return;
+        }
+        frames.append(decodeFrame(message, size, timeStamp * 1000));
+    });
+
+    if (!frames.isEmpty())
+        enqueueReceivedFrames(frames);
+    reportDroppedFrames(dropped);
+
+    // Without other devices on the bus, only watch out for new ones now and then.
+    const int interval = m_sharedMemoryBus->isIdle() ? SharedMemoryIdlePollInterval
+                                                      : SharedMemoryPollInterval;
+    if (m_pollTimer->interval() != interval)
+        m_pollTimer->setInterval(interval);
+#endif
+}
+
+// Like a real controller, the device loses frames when it cannot keep up with the bus.
+void VirtualCanBackend::reportDroppedFrames(qint64 dropped)
+{
+    if (Q_LIKELY(dropped == 0))
+        return;
+
+    qCWarning(QT_CANBUS_PLUGINS_VIRTUALCAN, "Client [%p] dropped %lld received frames.",
+              this, dropped);
+    setError(tr("Dropped %1 received frames, the receive buffer was full.").arg(dropped),
+             QCanBusDevice::ReadError);
 }
 
 QT_END_NAMESPACE
@@ -4,18 +4,26 @@
 #ifndef VIRTUALCANBACKEND_H
 #define VIRTUALCANBACKEND_H
 
+#include "virtualcanbussimulation.h"
+#include "virtualcanlocalbus.h"
+
 #include <QtSerialBus/qcanbusdevice.h>
 #include <QtSerialBus/qcanbusdeviceinfo.h>
 #include <QtSerialBus/qcanbusframe.h>
 
+#include <QtCore/qhash.h>
 #include <QtCore/qlist.h>
 #include <QtCore/qurl.h>
 #include <QtCore/qvariant.h>
 
+#include <array>
+#include <memory>
+
 QT_BEGIN_NAMESPACE
 
 class QTcpServer;
 class QTcpSocket;
+class QTimer;
 
 class VirtualCanServer : public QObject
 {
@@ -29,12 +37,29 @@ public:
     void start(quint16 port);
 
 private:
+    struct Client
+    {
+        QByteArray input;  // an incomplete message
+        QByteArray output; // messages to be written at the end of the current batch
+        QList<quint8> channels;
+    };
+
     void connected();
     void disconnected();
     void readyRead();
+    void route(const QObject *origin, quint8 channel, const char *message, qsizetype size);
+    void writePending();
+    void configure(quint8 channel, quint32 bitRate, quint32 dataBitRate);
+    void routeTransmissions(quint8 channel,
+                            const QList<VirtualCanBusSimulation::Transmission> &transmissions);
+    void subscribe(QTcpSocket *socket, Client &client, quint8 channel);
+    void unsubscribe(QTcpSocket *socket, Client &client, quint8 channel);
 
     QTcpServer *m_server = nullptr;
-    QList<QTcpSocket *> m_serverSockets;
+    QHash<QTcpSocket *, Client> m_clients;
+    std::array<QList<QTcpSocket *>, 256> m_subscribers; // the sockets of each channel
+    QList<QTcpSocket *> m_pendingWrites;
+    std::array<VirtualCanBusSimulation *, 256> m_simulations = {}; // if a bit rate is set
 };
 
 class VirtualCanBackend : public QCanBusDevice
@@ -60,15 +85,28 @@ public:
     QCanBusDeviceInfo deviceInfo() const override;
 
 private:
+    enum class Transport { Tcp, Local, SharedMemory };
+
     static QCanBusDeviceInfo virtualCanDeviceInfo(uint channel);
 
     void clientConnected();
     void clientDisconnected();
     void clientReadyRead();
+    void sendConfiguration();
+    void localFramesAvailable();
+    void sharedMemoryReadyRead();
+    void reportDroppedFrames(qint64 dropped);
 
     QUrl m_url;
     uint m_channel = 0;
+    Transport m_transport = Transport::Tcp;
     QTcpSocket *m_clientSocket = nullptr;
+    QByteArray m_input; // an incomplete message
+    VirtualCanLocalNodePointer m_localNode;
+#if QT_CONFIG(sharedmemory)
+    std::unique_ptr<VirtualCanSharedMemoryBus> m_sharedMemoryBus;
+    QTimer *m_pollTimer = nullptr;
+#endif
 };
 
 QT_END_NAMESPACE
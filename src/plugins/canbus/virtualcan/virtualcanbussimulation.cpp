@@ -0,0 +1,271 @@
+// Copyright (C) 2023 The Qt Company Ltd.
+// SPDX-License-Identifier: LicenseRef-Qt-Commercial OR LGPL-3.0-only OR GPL-2.0-only OR GPL-3.0-only
+
+#include "virtualcanbussimulation.h"
+
+#include <QtCore/qdatetime.h>
+#include <QtCore/qtimer.h>
+
+#include <algorithm>
+#include <iterator>
+
+QT_BEGIN_NAMESPACE
+
+namespace {
+
+// Counts the bits of a frame, including a stuff bit after every five consecutive bits of the
+// same value, and computes the CRC-15 of classic CAN frames over the unstuffed bits.
+class BitCounter
+{
+public:
+    void append(quint32 value, int count)
+    {
+        for (int i = count - 1; i >= 0; --i)
+            appendBit((value >> i) & 1);
+    }
+
+    int bits() const { return m_bits; }
+    quint16 crc() const { return m_crc; }
+
+private:
+    void appendBit(bool bit)
+    {
+        const bool crcNext = bit != bool(m_crc & 0x4000);
+        m_crc = (m_crc << 1) & 0x7fff;
+        if (crcNext)
+            m_crc ^= 0x4599;
+
+        ++m_bits;
+        if (m_run > 0 && bit == m_last) {
+            ++m_run;
+        } else {
+            m_last = bit;
+            m_run = 1;
+        }
+        if (m_run == 5) {
+            ++m_bits; // the complementary stuff bit starts a new run
+            m_last = !bit;
+            m_run = 1;
+        }
+    }
+
+    int m_bits = 0;
+    int m_run = 0;
+    bool m_last = false;
+    quint16 m_crc = 0;
+};
+
+// The data length code of a payload size, with CAN FD sizes rounded up to the next valid one.
+int dataLengthCode(qsizetype size, qsizetype *paddedSize)
+{
+    static constexpr int sizes[] = { 0, 1, 2, 3, 4, 5, 6, 7, 8, 12, 16, 20, 24, 32, 48, 64 };
+    for (int code = 0; code < int(std::size(sizes)); ++code) {
+        if (size <= sizes[code]) {
+            *paddedSize = sizes[code];
+            return code;
+        }
+    }
+    *paddedSize = 64;
+    return 15;
+}
+
+// The CRC delimiter, the acknowledge slot and delimiter, the end of frame and the interframe
+// space, none of which is stuffed.
+constexpr int TrailingBits = 1 + 1 + 1 + 7 + 3;
+
+} // namespace
+
+VirtualCanBusSimulation::VirtualCanBusSimulation(QObject *parent)
+    : QObject(parent),
+      m_timer(new QTimer(this))
+{
+    m_timer->setSingleShot(true);
+    m_timer->setTimerType(Qt::PreciseTimer);
+    connect(m_timer, &QTimer::timeout, this, &VirtualCanBusSimulation::process);
+
+    m_epoch = QDateTime::currentMSecsSinceEpoch() * 1000;
+    m_clock.start();
+}
+
+VirtualCanBusSimulation::~VirtualCanBusSimulation() = default;
+
+void VirtualCanBusSimulation::setBitRates(quint32 bitRate, quint32 dataBitRate)
+{
+    m_bitRate = bitRate;
+    m_dataBitRate = dataBitRate > 0 ? dataBitRate : bitRate;
+}
+
+void VirtualCanBusSimulation::enqueue(QObject *sender, const QCanBusFrame &frame,
+                                      const QByteArray &message)
+{
+    Pending pending;
+    pending.transmission.sender = sender;
+    pending.transmission.message = message;
+    pending.priority = arbitrationPriority(frame);
+    pending.order = m_order++;
+    pending.arrival = m_clock.nsecsElapsed();
+    pending.duration = m_bitRate > 0 ? frameDuration(frame, m_bitRate, m_dataBitRate) : 0;
+    m_pending.push_back(pending);
+
+    // Frames written in the same event loop iteration take part in the same arbitration.
+    if (!m_current && !m_timer->isActive())
+        m_timer->start(0);
+}
+
+// A device that leaves the bus stops sending, the frame on the bus is completed though.
+void VirtualCanBusSimulation::removeSender(QObject *sender)
+{
+    m_pending.erase(std::remove_if(m_pending.begin(), m_pending.end(), [sender](const Pending &p) {
+        return p.transmission.sender == sender;
+    }), m_pending.end());
+}
+
+// Returns the frame on the bus and the pending frames in the order written, and forgets them.
+// Only the frame on the bus has a time stamp.
+QList<VirtualCanBusSimulation::Transmission> VirtualCanBusSimulation::takeTransmissions()
+{
+    m_timer->stop();
+
+    QList<Transmission> transmissions;
+    if (m_current)
+        transmissions.append(std::move(m_current->transmission));
+    m_current.reset();
+    for (Pending &pending : m_pending)
+        transmissions.append(std::move(pending.transmission));
+    m_pending.clear();
+    return transmissions;
+}
+
+/*
+    Returns the arbitration field of the frame as a number; the frame with
+    the lower number wins the arbitration. The bits are in the order they
+    are sent: the 11 base identifier bits, the RTR or SRR bit, the IDE bit,
+    and for extended frames the 18 identifier extension bits and the RTR bit.
+*/
+quint32 VirtualCanBusSimulation::arbitrationPriority(const QCanBusFrame &frame)
+{
+    const bool remote = frame.frameType() == QCanBusFrame::RemoteRequestFrame;
+    const QCanBusFrame::FrameId id = frame.frameId();
+    if (!frame.hasExtendedFrameFormat())
+        return ((id & 0x7ff) << 21) | (quint32(remote) << 20);
+
+    return ((id >> 18 & 0x7ff) << 21) | (1u << 20) | (1u << 19) | ((id & 0x3ffff) << 1)
+            | quint32(remote);
+}
+
+/*
+    Returns the time the frame occupies the bus in nanoseconds, including
+    the stuff bits and the interframe space. In CAN FD frames with the
+    bitrate switch, the bits from the ESI bit to the CRC are sent at the
+    data bit rate.
+*/
+qint64 VirtualCanBusSimulation::frameDuration(const QCanBusFrame &frame, quint32 bitRate,
+                                              quint32 dataBitRate)
+{
+    const bool extended = frame.hasExtendedFrameFormat();
+    const bool remote = frame.frameType() == QCanBusFrame::RemoteRequestFrame;
+    const QCanBusFrame::FrameId id = frame.frameId();
+    const QByteArray payload = frame.payload();
+
+    BitCounter counter;
+    counter.append(0, 1); // start of frame
+    if (extended) {
+        counter.append(id >> 18, 11);
+        counter.append(0b11, 2); // SRR and IDE
+        counter.append(id, 18);
+    } else {
+        counter.append(id, 11);
+    }
+
+    if (!frame.hasFlexibleDataRateFormat()) {
+        const int length = int(qMin(payload.size(), qsizetype(8)));
+        // RTR, followed by IDE and r0 in standard frames, or by r1 and r0 in extended frames
+        counter.append(quint32(remote) << 2, 3);
+        counter.append(quint32(remote ? qMin(payload.size(), qsizetype(15)) : length), 4);
+        for (int i = 0; !remote && i < length; ++i)
+            counter.append(quint8(payload.at(i)), 8);
+        counter.append(counter.crc(), 15);
+        return qint64(counter.bits() + TrailingBits) * 1000000000 / bitRate;
+    }
+
+    // RRS, IDE (standard frames only), FDF, res and BRS
+    if (extended)
+        counter.append(0b0100 | quint32(frame.hasBitrateSwitch()), 4);
+    else
+        counter.append(0b00100 | quint32(frame.hasBitrateSwitch()), 5);
+    const int nominalBits = counter.bits() + TrailingBits;
+
+    qsizetype paddedSize = 0;
+    const int code = dataLengthCode(payload.size(), &paddedSize);
+    counter.append(frame.hasErrorStateIndicator(), 1);
+    counter.append(code, 4);
+    for (qsizetype i = 0; i < paddedSize; ++i)
+        counter.append(i < payload.size() ? quint8(payload.at(i)) : 0xcc, 8);
+
+    // The stuff count and the CRC-17 or CRC-21 have a fixed stuff bit every four bits.
+    const int crcFieldBits = paddedSize <= 16 ? 4 + 17 + 6 : 4 + 21 + 7;
+    const int dataBits = counter.bits() - (nominalBits - TrailingBits) + crcFieldBits;
+    const quint32 dataPhaseRate = frame.hasBitrateSwitch() ? dataBitRate : bitRate;
+    return qint64(nominalBits) * 1000000000 / bitRate
+            + qint64(dataBits) * 1000000000 / dataPhaseRate;
+}
+
+void VirtualCanBusSimulation::process()
+{
+    const qint64 now = m_clock.nsecsElapsed();
+    QList<Transmission> done;
+
+    if (m_current) {
+        if (m_currentEnd > now) {
+            schedule(now);
+            return;
+        }
+        done.append(m_current->transmission);
+        m_current.reset();
+    }
+
+    while (!m_pending.empty()) {
+        // An idle bus starts with the first frame written.
+        const auto first = std::min_element(m_pending.cbegin(), m_pending.cend(),
+                                            [](const Pending &l, const Pending &r) {
+            return l.arrival < r.arrival;
+        });
+        const qint64 start = qMax(m_busTime, first->arrival);
+
+        // All frames pending at the start of the transmission take part in the arbitration.
+        auto winner = m_pending.end();
+        for (auto it = m_pending.begin(); it != m_pending.end(); ++it) {
+            if (it->arrival > start)
+                continue;
+            if (winner == m_pending.end() || it->priority < winner->priority
+                || (it->priority == winner->priority && it->order < winner->order)) {
+                winner = it;
+            }
+        }
+
+        Pending pending = std::move(*winner);
+        m_pending.erase(winner);
+        m_busTime = start + pending.duration;
+        pending.transmission.timeStamp = m_epoch + m_busTime / 1000;
+        if (m_busTime > now) {
+            m_current = std::move(pending);
+            m_currentEnd = m_busTime;
+            schedule(now);
+            break;
+        }
+        done.append(pending.transmission);
+    }
+
+    if (!done.isEmpty())
+        emit transmitted(done);
+}
+
+// Timers have a resolution of milliseconds. Frames are therefore delivered in batches, their
+// time stamps however tell the exact end of each frame.
+void VirtualCanBusSimulation::schedule(qint64 now)
+{
+    const qint64 remaining = m_currentEnd - now;
+    m_timer->start(int((remaining + 999999) / 1000000));
+}
+
+QT_END_NAMESPACE
@@ -0,0 +1,77 @@
+// Copyright (C) 2023 The Qt Company Ltd.
+// SPDX-License-Identifier: LicenseRef-Qt-Commercial OR LGPL-3.0-only OR GPL-2.0-only OR GPL-3.0-only
+
+#ifndef VIRTUALCANBUSSIMULATION_H
+#define VIRTUALCANBUSSIMULATION_H
+
+#include <QtSerialBus/qcanbusframe.h>
+
+#include <QtCore/qelapsedtimer.h>
+#include <QtCore/qlist.h>
+#include <QtCore/qobject.h>
+
+#include <optional>
+#include <vector>
+
+QT_BEGIN_NAMESPACE
+
+class QTimer;
+
+// Simulates the timing of one CAN channel. Frames occupy the bus for the time their bits take
+// at the configured bit rates, one frame at a time. When the bus becomes idle, the pending
+// frame with the highest priority wins the arbitration, as on a real bus.
+class VirtualCanBusSimulation : public QObject
+{
+    Q_OBJECT
+    Q_DISABLE_COPY(VirtualCanBusSimulation)
+
+public:
+    struct Transmission
+    {
+        QObject *sender = nullptr;
+        QByteArray message;
+        qint64 timeStamp = 0; // end of the frame, in microseconds since the epoch, or 0
+    };
+
+    explicit VirtualCanBusSimulation(QObject *parent = nullptr);
+    ~VirtualCanBusSimulation() override;
+
+    void setBitRates(quint32 bitRate, quint32 dataBitRate);
+    void enqueue(QObject *sender, const QCanBusFrame &frame, const QByteArray &message);
+    void removeSender(QObject *sender);
+    QList<Transmission> takeTransmissions();
+
+    static quint32 arbitrationPriority(const QCanBusFrame &frame);
+    static qint64 frameDuration(const QCanBusFrame &frame, quint32 bitRate, quint32 dataBitRate);
+
+signals:
+    void transmitted(const QList<VirtualCanBusSimulation::Transmission> &transmissions);
+
+private:
+    struct Pending
+    {
+        Transmission transmission;
+        quint32 priority = 0;
+        quint64 order = 0; // frames of the same priority are sent in the order written
+        qint64 arrival = 0;
+        qint64 duration = 0;
+    };
+
+    void process();
+    void schedule(qint64 now);
+
+    QTimer *m_timer = nullptr;
+    QElapsedTimer m_clock;
+    qint64 m_epoch = 0; // the time of m_clock's start, in microseconds since the epoch
+    quint32 m_bitRate = 0;
+    quint32 m_dataBitRate = 0;
+    qint64 m_busTime = 0; // the time the bus becomes idle, in nanoseconds of m_clock
+    quint64 m_order = 0;
+    std::vector<Pending> m_pending;
+    std::optional<Pending> m_current;
+    qint64 m_currentEnd = 0;
+};
+
+QT_END_NAMESPACE
+
+#endif // VIRTUALCANBUSSIMULATION_H
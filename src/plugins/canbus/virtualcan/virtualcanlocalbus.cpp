@@ -0,0 +1,235 @@
+// Copyright (C) 2023 The Qt Company Ltd.
+// SPDX-License-Identifier: LicenseRef-Qt-Commercial OR LGPL-3.0-only OR GPL-2.0-only OR GPL-3.0-only
+
+#include "virtualcanlocalbus.h"
+
+#include <QtCore/qglobalstatic.h>
+#include <QtCore/qloggingcategory.h>
+#include <QtCore/qrandom.h>
+
+#include <algorithm>
+#include <iterator>
+
+QT_BEGIN_NAMESPACE
+
+Q_DECLARE_LOGGING_CATEGORY(QT_CANBUS_PLUGINS_VIRTUALCAN)
+
+VirtualCanLocalNode::VirtualCanLocalNode(QObject *parent)
+    : QObject(parent),
+      m_cells(new Cell[QueueSize])
+{
+    for (size_t i = 0; i < QueueSize; ++i)
+        m_cells[i].sequence.store(i, std::memory_order_relaxed);
+}
+
+VirtualCanLocalNode::~VirtualCanLocalNode() = default;
+
+bool VirtualCanLocalNode::push(const QCanBusFrame &frame)
+{
+    Cell *cell = nullptr;
+    size_t position = m_enqueuePosition.load(std::memory_order_relaxed);
+    for (;;) {
+        cell = &m_cells[position & (QueueSize - 1)];
+        const size_t sequence = cell->sequence.load(std::memory_order_acquire);
+        const qintptr difference = qintptr(sequence) - qintptr(position);
+        if (difference == 0) {
+            if (m_enqueuePosition.compare_exchange_weak(position, position + 1,
+                                                        std::memory_order_relaxed)) {
+                break;
+            }
+        } else if (difference < 0) {
+            m_droppedFrames.fetch_add(1, std::memory_order_relaxed);
+            return false; // full
+        } else {
+            position = m_enqueuePosition.load(std::memory_order_relaxed);
+        }
+    }
+
+    cell->frame = frame;
+    cell->sequence.store(position + 1, std::memory_order_release);
+    return true;
+}
+
+// Wakes up the thread of the node, unless a wake up is already pending.
+void VirtualCanLocalNode::notify()
+{
+    if (!m_notified.exchange(true, std::memory_order_acq_rel))
+        QMetaObject::invokeMethod(this, &VirtualCanLocalNode::deliver, Qt::QueuedConnection);
+}
+
+bool VirtualCanLocalNode::pop(QCanBusFrame *frame)
+{
+    Cell *cell = &m_cells[m_dequeuePosition & (QueueSize - 1)];
+    if (cell->sequence.load(std::memory_order_acquire) != m_dequeuePosition + 1)
+        return false;
+
+    *frame = std::move(cell->frame);
+    cell->sequence.store(m_dequeuePosition + QueueSize, std::memory_order_release);
+    ++m_dequeuePosition;
+    return true;
+}
+
+qint64 VirtualCanLocalNode::takeDroppedFrames()
+{
+    return m_droppedFrames.exchange(0, std::memory_order_relaxed);
+}
+
+void VirtualCanLocalNode::deliver()
+{
+    // Cleared before the frames are popped, so frames pushed meanwhile trigger a new wake up.
+    m_notified.store(false, std::memory_order_release);
+    emit framesAvailable();
+}
+
+Q_GLOBAL_STATIC(VirtualCanLocalBus, g_localBus)
+
+VirtualCanLocalBus *VirtualCanLocalBus::instance()
+{
+    return g_localBus();
+}
+
+VirtualCanLocalNodePointer VirtualCanLocalBus::join(uint channel)
+{
+    if (channel >= std::size(m_channels))
+        return nullptr;
+
+    // The last reference may be dropped by a writer in another thread.
+    VirtualCanLocalNodePointer node(new VirtualCanLocalNode, [](VirtualCanLocalNode *n) {
+        n->deleteLater();
+    });
+
+    Channel &c = m_channels[channel];
+    const QMutexLocker locker(&c.mutex);
+    auto nodes = std::make_shared<NodeList>();
+    if (const auto current = std::atomic_load(&c.nodes))
+        *nodes = *current;
+    nodes->push_back(node);
+    std::atomic_store(&c.nodes, std::shared_ptr<const NodeList>(std::move(nodes)));
+    return node;
+}
+
+void VirtualCanLocalBus::leave(uint channel, const VirtualCanLocalNodePointer &node)
+{
+    if (channel >= std::size(m_channels) || !node)
+        return;
+
+    Channel &c = m_channels[channel];
+    const QMutexLocker locker(&c.mutex);
+    const auto current = std::atomic_load(&c.nodes);
+    if (!current)
+        return;
+    auto nodes = std::make_shared<NodeList>(*current);
+    nodes->erase(std::remove(nodes->begin(), nodes->end(), node), nodes->end());
+    std::atomic_store(&c.nodes, std::shared_ptr<const NodeList>(std::move(nodes)));
+}
+
+void VirtualCanLocalBus::write(uint channel, const QCanBusFrame &frame,
+                               const VirtualCanLocalNode *sender)
+{
+    if (channel >= std::size(m_channels))
+        return;
+
+    // Writers work on a snapshot of the nodes, which keeps the nodes alive meanwhile.
+    const auto nodes = std::atomic_load(&m_channels[channel].nodes);
+    if (!nodes)
+        return;
+    for (const VirtualCanLocalNodePointer &node : *nodes) {
+        if (node.get() == sender)
+            continue;
+        if (node->push(frame))
+            node->notify();
+    }
+}
+
+#if QT_CONFIG(sharedmemory)
+
+VirtualCanSharedMemoryBus::VirtualCanSharedMemoryBus()
+{
+    // Identifies the own messages in the ring.
+    while (m_sender == 0)
+        m_sender = QRandomGenerator::global()->generate64();
+}
+
+VirtualCanSharedMemoryBus::~VirtualCanSharedMemoryBus()
+{
+    detach();
+}
+
+bool VirtualCanSharedMemoryBus::attach(const QString &name, uint channel)
+{
+    detach();
+
+    const QString key = QStringLiteral("qtvirtualcan-%1-can%2").arg(name).arg(channel);
+    m_memory.setNativeKey(QSharedMemory::legacyNativeKey(key));
+
+    // The first device creates the segment, which is zero-initialized: an empty ring.
+    const qsizetype size = qsizetype(sizeof(Header) + SlotCount * sizeof(Slot));
+    if (!m_memory.create(size)) {
+        if (m_memory.error() != QSharedMemory::AlreadyExists || !m_memory.attach()) {
+            qCWarning(QT_CANBUS_PLUGINS_VIRTUALCAN, "Cannot attach to shared memory '%ls': %ls",
+                      qUtf16Printable(key), qUtf16Printable(m_memory.errorString()));
+            return false;
+        }
+    }
+    if (m_memory.size() < size) {
+        qCWarning(QT_CANBUS_PLUGINS_VIRTUALCAN, "Shared memory '%ls' is too small.",
+                  qUtf16Printable(key));
+        m_memory.detach();
+        return false;
+    }
+
+    m_header = static_cast<Header *>(m_memory.data());
+    m_header->attachedCount.ref();
+    m_cursor = m_header->writeSequence.loadAcquire(); // only frames written from now on
+    m_stallTimer.invalidate();
+    return true;
+}
+
+void VirtualCanSharedMemoryBus::detach()
+{
+    if (m_header)
+        m_header->attachedCount.deref();
+    m_header = nullptr;
+    if (m_memory.isAttached())
+        m_memory.detach();
+}
+
+QString VirtualCanSharedMemoryBus::errorString() const
+{
+    return m_memory.errorString();
+}
+
+void VirtualCanSharedMemoryBus::write(const char *message, qsizetype size)
+{
+    if (!m_header || size > MaximumMessageSize)
+        return;
+
+    // A sequence of 0 marks the slot as being written, readers copying it meanwhile
+    // notice the change of the sequence and drop the message.
+    const quint64 index = m_header->writeSequence.fetchAndAddRelaxed(1);
+    Slot *current = slot(index);
+    current->sequence.storeRelaxed(0);
+    std::atomic_thread_fence(std::memory_order_release);
+    current->sender = m_sender;
+    current->size = quint8(size);
+    memcpy(current->message, message, size_t(size));
+    current->sequence.storeRelease(index + 1);
+}
+
+bool VirtualCanSharedMemoryBus::isIdle() const
+{
+    // A device that crashed stays counted, which only keeps the others polling fast.
+    return m_header && m_header->attachedCount.loadRelaxed() <= 1
+            && m_cursor == m_header->writeSequence.loadAcquire();
+}
+
+VirtualCanSharedMemoryBus::Slot *VirtualCanSharedMemoryBus::slot(quint64 index)
+{
+    auto slotArray = reinterpret_cast<Slot *>(static_cast<char *>(m_memory.data())
+                                              + sizeof(Header));
+    return slotArray + index % SlotCount;
+}
+
+#endif // QT_CONFIG(sharedmemory)
+
+QT_END_NAMESPACE
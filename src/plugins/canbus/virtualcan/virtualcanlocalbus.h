@@ -0,0 +1,209 @@
+// Copyright (C) 2023 The Qt Company Ltd.
+// SPDX-License-Identifier: LicenseRef-Qt-Commercial OR LGPL-3.0-only OR GPL-2.0-only OR GPL-3.0-only
+
+#ifndef VIRTUALCANLOCALBUS_H
+#define VIRTUALCANLOCALBUS_H
+
+#include <QtSerialBus/qcanbusframe.h>
+
+#include <QtCore/qatomic.h>
+#include <QtCore/qelapsedtimer.h>
+#include <QtCore/qmutex.h>
+#include <QtCore/qobject.h>
+
+#if QT_CONFIG(sharedmemory)
+#include <QtCore/qsharedmemory.h>
+#endif
+
+#include <atomic>
+#include <memory>
+#include <vector>
+
+QT_BEGIN_NAMESPACE
+
+enum { VirtualChannels = 2 }; // "can0" and "can1"
+
+// The receiving end of a device on the in-process bus. Any thread may push frames, only the
+// thread of the node pops them.
+class VirtualCanLocalNode : public QObject
+{
+    Q_OBJECT
+    Q_DISABLE_COPY(VirtualCanLocalNode)
+
+public:
+    // Frames a node buffers before further frames are dropped, a power of two.
+    static constexpr size_t QueueSize = 4096;
+
+    explicit VirtualCanLocalNode(QObject *parent = nullptr);
+    ~VirtualCanLocalNode() override;
+
+    bool push(const QCanBusFrame &frame);
+    void notify();
+
+    bool pop(QCanBusFrame *frame);
+    qint64 takeDroppedFrames();
+
+signals:
+    void framesAvailable();
+
+private:
+    void deliver();
+
+    // A bounded multi-producer queue after Dmitry Vyukov. The sequence of a cell tells
+    // producers and the consumer whether the cell is free or holds a frame.
+    struct Cell
+    {
+        std::atomic<size_t> sequence;
+        QCanBusFrame frame;
+    };
+
+    std::unique_ptr<Cell[]> m_cells;
+    alignas(64) std::atomic<size_t> m_enqueuePosition = 0;
+    alignas(64) size_t m_dequeuePosition = 0;
+    alignas(64) std::atomic<bool> m_notified = false;
+    std::atomic<qint64> m_droppedFrames = 0;
+};
+
+using VirtualCanLocalNodePointer = std::shared_ptr<VirtualCanLocalNode>;
+
+// The in-process bus. Writing a frame pushes it into the queues of all other nodes of the
+// channel without taking a lock, only joining and leaving the bus do.
+class VirtualCanLocalBus
+{
+    Q_DISABLE_COPY(VirtualCanLocalBus)
+
+public:
+    VirtualCanLocalBus() = default;
+
+    VirtualCanLocalNodePointer join(uint channel);
+    void leave(uint channel, const VirtualCanLocalNodePointer &node);
+    void write(uint channel, const QCanBusFrame &frame, const VirtualCanLocalNode *sender);
+
+    static VirtualCanLocalBus *instance();
+
+private:
+    using NodeList = std::vector<VirtualCanLocalNodePointer>;
+
+    struct Channel
+    {
+        QMutex mutex; // serializes joining and leaving
+        std::shared_ptr<const NodeList> nodes;
+    };
+
+    Channel m_channels[VirtualChannels];
+};
+
+#if QT_CONFIG(sharedmemory)
+
+// A bus in a shared memory segment, for devices in several processes on one host. The segment
+// is a ring of slots holding messages of the virtual CAN protocol. Writers claim slots with an
+// atomic counter, every reader follows the ring with its own cursor.
+class VirtualCanSharedMemoryBus
+{
+    Q_DISABLE_COPY(VirtualCanSharedMemoryBus)
+
+public:
+    enum { MaximumMessageSize = 81 };
+    enum : quint64 { SlotCount = 8192 };
+
+    VirtualCanSharedMemoryBus();
+    ~VirtualCanSharedMemoryBus();
+
+    bool attach(const QString &name, uint channel);
+    void detach();
+    QString errorString() const;
+
+    void write(const char *message, qsizetype size);
+
+    // Returns true when no other device is attached and all messages were read.
+    bool isIdle() const;
+
+    // Calls handler with each message written by other devices since the last call and
+    // returns the number of messages that were overwritten before they could be read.
+    template <typename Handler>
+    qint64 read(Handler handler);
+
+private:
+    struct Slot
+    {
+        QBasicAtomicInteger<quint64> sequence; // index + 1 once written, 0 while writing
+        quint64 sender;
+        quint8 size;
+        char message[MaximumMessageSize];
+    };
+
+    struct Header
+    {
+        QBasicAtomicInteger<quint64> writeSequence;
+        QBasicAtomicInteger<quint32> attachedCount;
+    };
+
+    // A writer that dies between claiming a slot and publishing it leaves the slot unfinished
+    // for good. Readers give up on such a slot after this many milliseconds.
+    enum { StallTimeout = 100 };
+
+    Slot *slot(quint64 index);
+
+    QSharedMemory m_memory;
+    Header *m_header = nullptr;
+    quint64 m_sender = 0;
+    quint64 m_cursor = 0;
+    quint64 m_stalledCursor = 0;
+    QElapsedTimer m_stallTimer;
+};
+
+template <typename Handler>
+qint64 VirtualCanSharedMemoryBus::read(Handler handler)
+{
+    if (!m_header)
+        return 0;
+
+    qint64 dropped = 0;
+    const quint64 end = m_header->writeSequence.loadAcquire();
+    if (end - m_cursor > SlotCount) {
+        dropped += qint64(end - m_cursor - SlotCount);
+        m_cursor = end - SlotCount;
+    }
+
+    char message[MaximumMessageSize];
+    while (m_cursor < end) {
+        Slot *current = slot(m_cursor);
+        const quint64 sequence = current->sequence.loadAcquire();
+        if (sequence == 0 || sequence < m_cursor + 1) {
+            // The writer has not finished the slot yet.
+            if (!m_stallTimer.isValid() || m_stalledCursor != m_cursor) {
+                m_stalledCursor = m_cursor;
+                m_stallTimer.start();
+                break;
+            }
+            if (!m_stallTimer.hasExpired(StallTimeout))
+                break;
+            m_stallTimer.invalidate();
+            ++dropped;
+            ++m_cursor;
+            continue;
+        }
+
+        // The slot may be overwritten while it is copied, the sequence tells afterwards.
+        const quint64 sender = current->sender;
+        const quint8 size = qMin(current->size, quint8(MaximumMessageSize));
+        memcpy(message, current->message, size);
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (sequence != m_cursor + 1 || current->sequence.loadRelaxed() != sequence) {
+            ++dropped;
+            ++m_cursor;
+            continue;
+        }
+
+        ++m_cursor;
+        if (sender != m_sender)
+            handler(message, qsizetype(size));
+    }
+    return dropped;
+}
+
+#endif // QT_CONFIG(sharedmemory)
+
+QT_END_NAMESPACE
+
+#endif // VIRTUALCANLOCALBUS_H
@@ -0,0 +1,140 @@
+// Copyright (C) 2023 The Qt Company Ltd.
+// SPDX-License-Identifier: LicenseRef-Qt-Commercial OR LGPL-3.0-only OR GPL-2.0-only OR GPL-3.0-only
+
+#include "virtualcanprotocol.h"
+
+#include <QtCore/qendian.h>
+
+QT_BEGIN_NAMESPACE
+
+namespace VirtualCanProtocol {
+
+// Returns the size of the message at the beginning of data, 0 if the message is incomplete,
+// or -1 if the data does not start with a valid message.
+qsizetype messageSize(const char *data, qsizetype available)
+{
+    if (available < SizeFieldLength)
+        return 0;
+    const qsizetype size = SizeFieldLength + qFromLittleEndian<quint16>(data);
+    if (size < MessageHeaderSize)
+        return -1;
+    if (available < size)
+        return 0;
+
+    switch (quint8(data[2])) {
+    case ConnectMessage:
+        // Later protocol versions may append fields, the version is checked by the receiver.
+        return size >= ConnectMessageSize ? size : -1;
+    case DisconnectMessage:
+        return size == MessageHeaderSize ? size : -1;
+    case ConfigureMessage:
+        return size == ConfigureMessageSize ? size : -1;
+    case FrameMessage:
+        return size >= FrameHeaderSize && size <= FrameHeaderSize + MaximumPayloadSize
+                ? size : -1;
+    default:
+        return -1;
+    }
+}
+
+// Returns the protocol version of the sender of a connect message, or 0 if the message does
+// not start with ProtocolMagic.
+quint16 protocolVersion(const char *connectMessage)
+{
+    if (qFromLittleEndian<quint16>(connectMessage + 4) != ProtocolMagic)
+        return 0;
+    return qFromLittleEndian<quint16>(connectMessage + 6);
+}
+
+QByteArray connectMessage(uint channel)
+{
+    QByteArray message(ConnectMessageSize, Qt::Uninitialized);
+    qToLittleEndian<quint16>(ConnectMessageSize - SizeFieldLength, message.data());
+    message[2] = char(ConnectMessage);
+    message[3] = char(channel);
+    qToLittleEndian<quint16>(ProtocolMagic, message.data() + 4);
+    qToLittleEndian<quint16>(ProtocolVersion, message.data() + 6);
+    return message;
+}
+
+QByteArray disconnectMessage(uint channel)
+{
+    QByteArray message(MessageHeaderSize, Qt::Uninitialized);
+    qToLittleEndian<quint16>(MessageHeaderSize - SizeFieldLength, message.data());
+    message[2] = char(DisconnectMessage);
+    message[3] = char(channel);
+    return message;
+}
+
+QByteArray configureMessage(uint channel, quint32 bitRate, quint32 dataBitRate)
+{
+    QByteArray message(ConfigureMessageSize, Qt::Uninitialized);
+    qToLittleEndian<quint16>(ConfigureMessageSize - SizeFieldLength, message.data());
+    message[2] = char(ConfigureMessage);
+    message[3] = char(channel);
+    qToLittleEndian<quint32>(bitRate, message.data() + 4);
+    qToLittleEndian<quint32>(dataBitRate, message.data() + 8);
+    return message;
+}
+
+// Writes the frame message to buffer, which holds at least FrameHeaderSize + MaximumPayloadSize
+// bytes, and returns its size.
+qsizetype encodeFrame(char *buffer, uint channel, const QCanBusFrame &frame)
+{
+    quint8 flags = 0;
+    if (frame.frameType() == QCanBusFrame::RemoteRequestFrame)
+        flags |= RemoteRequestFlag;
+    else if (frame.frameType() == QCanBusFrame::ErrorFrame)
+        flags |= ErrorFrameFlag;
+    if (frame.hasExtendedFrameFormat())
+        flags |= ExtendedFormatFlag;
+    if (frame.hasFlexibleDataRateFormat())
+        flags |= FlexibleDataRateFlag;
+    if (frame.hasBitrateSwitch())
+        flags |= BitRateSwitchFlag;
+    if (frame.hasErrorStateIndicator())
+        flags |= ErrorStateFlag;
+    if (frame.hasLocalEcho())
+        flags |= LocalEchoFlag;
+
+    const QByteArray payload = frame.payload();
+    const qsizetype size = FrameHeaderSize + payload.size();
+    qToLittleEndian<quint16>(quint16(size - SizeFieldLength), buffer);
+    buffer[2] = char(FrameMessage);
+    buffer[3] = char(channel);
+    buffer[4] = char(flags);
+    // Error frames carry their error class in place of the identifier.
+    qToLittleEndian<quint32>(frame.frameType() == QCanBusFrame::ErrorFrame
+                             ? quint32(frame.error().toInt()) : frame.frameId(), buffer + 5);
+    qToLittleEndian<qint64>(0, buffer + 9);
+    memcpy(buffer + FrameHeaderSize, payload.constData(), size_t(payload.size()));
+    return size;
+}
+
+// Frames without a time stamp get the receiveTime in microseconds since the epoch.
+QCanBusFrame decodeFrame(const char *message, qsizetype size, qint64 receiveTime)
+{
+    const quint8 flags = quint8(message[4]);
+    const quint32 id = qFromLittleEndian<quint32>(message + 5);
+    const qint64 timeStamp = qFromLittleEndian<qint64>(message + 9);
+    QCanBusFrame frame(flags & ErrorFrameFlag ? 0 : id,
+                       QByteArray(message + FrameHeaderSize, size - FrameHeaderSize));
+    frame.setTimeStamp(QCanBusFrame::TimeStamp::fromMicroSeconds(timeStamp ? timeStamp
+                                                                           : receiveTime));
+    if (flags & RemoteRequestFlag) {
+        frame.setFrameType(QCanBusFrame::RemoteRequestFrame);
+    } else if (flags & ErrorFrameFlag) {
+        frame.setFrameType(QCanBusFrame::ErrorFrame);
+        frame.setError(QCanBusFrame::FrameErrors::fromInt(id));
+    }
+    frame.setExtendedFrameFormat(flags & ExtendedFormatFlag);
+    frame.setFlexibleDataRateFormat(flags & FlexibleDataRateFlag);
+    frame.setBitrateSwitch(flags & BitRateSwitchFlag);
+    frame.setErrorStateIndicator(flags & ErrorStateFlag);
+    frame.setLocalEcho(flags & LocalEchoFlag);
+    return frame;
+}
+
+} // namespace VirtualCanProtocol
+
+QT_END_NAMESPACE
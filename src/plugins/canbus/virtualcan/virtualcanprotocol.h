@@ -0,0 +1,98 @@
+// Copyright (C) 2023 The Qt Company Ltd.
+// SPDX-License-Identifier: LicenseRef-Qt-Commercial OR LGPL-3.0-only OR GPL-2.0-only OR GPL-3.0-only
+
+#ifndef VIRTUALCANPROTOCOL_H
+#define VIRTUALCANPROTOCOL_H
+
+#include <QtSerialBus/qcanbusframe.h>
+
+#include <QtCore/qbytearray.h>
+
+QT_BEGIN_NAMESPACE
+
+/*
+    Protocol format: All data is binary, a stream of length-prefixed messages.
+    Multi-byte values are in little endian byte order.
+
+    Offset  Size  Field
+    0       2     Size of the message following this field
+    2       1     Message type, one of MessageType
+    3       1     CAN channel, 0 for "can0", 1 for "can1"
+
+    Connect messages continue with:
+
+    4       2     ProtocolMagic
+    6       2     ProtocolVersion of the sender
+
+    Frame messages continue with:
+
+    4       1     Flags, a combination of FrameFlag
+    5       4     CAN-ID
+    9       8     Time stamp in microseconds since the epoch, or 0
+    17      n     Data bytes, up to 64
+
+    Configure messages continue with:
+
+    4       4     Bit rate in bit/s, 0 to disable the bus simulation
+    8       4     CAN FD data bit rate in bit/s, 0 for the bit rate
+
+    A client sends a connect message to receive the frames sent to a
+    channel, and a disconnect message before it closes the connection.
+    The server answers a connect message with one of its own. If the
+    protocol versions differ, the server closes the connection after
+    answering, and the client reports the mismatch.
+
+    The server forwards frame messages to all other clients connected to
+    the channel of the frame. Unless a client configured a bit rate for
+    the channel, this happens immediately and the messages are unchanged.
+    Otherwise, the server simulates the timing of the bus and sets the
+    time stamp to the end of the frame on the simulated bus.
+*/
+namespace VirtualCanProtocol {
+
+enum : quint16 {
+    ProtocolMagic   = 0x4356, // "VC"
+    ProtocolVersion = 1
+};
+
+enum MessageType : quint8 {
+    ConnectMessage    = 1,
+    DisconnectMessage = 2,
+    FrameMessage      = 3,
+    ConfigureMessage  = 4
+};
+
+enum FrameFlag : quint8 {
+    RemoteRequestFlag    = 0x01,
+    ExtendedFormatFlag   = 0x02,
+    FlexibleDataRateFlag = 0x04,
+    BitRateSwitchFlag    = 0x08,
+    ErrorStateFlag       = 0x10,
+    LocalEchoFlag        = 0x20,
+    ErrorFrameFlag       = 0x40
+};
+
+enum {
+    SizeFieldLength = 2,
+    MessageHeaderSize = 4,
+    ConnectMessageSize = 8,
+    FrameHeaderSize = 17,
+    ConfigureMessageSize = 12,
+    MaximumPayloadSize = 64
+};
+
+qsizetype messageSize(const char *data, qsizetype available);
+quint16 protocolVersion(const char *connectMessage);
+
+QByteArray connectMessage(uint channel);
+QByteArray disconnectMessage(uint channel);
+QByteArray configureMessage(uint channel, quint32 bitRate, quint32 dataBitRate);
+
+qsizetype encodeFrame(char *buffer, uint channel, const QCanBusFrame &frame);
+QCanBusFrame decodeFrame(const char *message, qsizetype size, qint64 receiveTime);
+
+} // namespace VirtualCanProtocol
+
+QT_END_NAMESPACE
+
+#endif // VIRTUALCANPROTOCOL_H
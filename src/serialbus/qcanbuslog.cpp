@@ -0,0 +1,370 @@
+// Copyright (C) 2023 The Qt Company Ltd.
+// SPDX-License-Identifier: LicenseRef-Qt-Commercial OR LGPL-3.0-only OR GPL-2.0-only OR GPL-3.0-only
+
+#include "qcanbuslog_p.h"
+
+QT_BEGIN_NAMESPACE
+
+namespace QCanBusLog {
+
+static int hexValue(char c)
+{
+    if (c >= '0' && c <= '9')
+        return c - '0';
+    if (c >= 'a' && c <= 'f')
+        return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F')
+        return c - 'A' + 10;
+    return -1;
+}
+
+static bool isSpace(char c)
+{
+    return c == ' ' || c == '\t' || c == '\r';
+}
+
+// Splits line at white space into at most N tokens, returns the number of tokens found.
+template <qsizetype N>
+static qsizetype tokenize(QByteArrayView line, QByteArrayView (&tokens)[N])
+{
+    qsizetype count = 0;
+    qsizetype i = 0;
+    while (count < N) {
+        while (i < line.size() && isSpace(line.at(i)))
+            ++i;
+        if (i == line.size())
+            break;
+        const qsizetype begin = i;
+        while (i < line.size() && !isSpace(line.at(i)))
+            ++i;
+        tokens[count++] = line.sliced(begin, i - begin);
+    }
+    return count;
+}
+
+// Calls handler for each line of log with the line and its 1-based number. Stops and returns
+// the number of the line the handler failed for, or 0 if all succeeded.
+template <typename Handler>
+static qsizetype forEachLine(QByteArrayView log, Handler handler)
+{
+    qsizetype lineNumber = 0;
+    while (!log.isEmpty()) {
+        ++lineNumber;
+        const qsizetype end = log.indexOf('\n');
+        const QByteArrayView line = end < 0 ? log : log.first(end);
+        log = end < 0 ? QByteArrayView() : log.sliced(end + 1);
+        if (!handler(line))
+            return lineNumber;
+    }
+    return 0;
+}
+
+static bool readBinary(QByteArrayView log, QList<QCanBusFrame> *frames, qsizetype *errorPosition)
+{
+    if (log.size() < HeaderSize || std::memcmp(log.data(), Magic, sizeof(Magic)) != 0
+        || qFromLittleEndian<quint32>(log.data() + 8) != Version) {
+        if (errorPosition)
+            *errorPosition = 0;
+        return false;
+    }
+
+    const char *data = log.data();
+    qsizetype offset = HeaderSize;
+    while (offset < log.size()) {
+        const qsizetype remaining = log.size() - offset;
+        const char *record = data + offset;
+        if (remaining < RecordHeaderSize || quint8(record[14]) > 64
+            || remaining < RecordHeaderSize + quint8(record[14])
+            || quint8(record[12]) > QCanBusFrame::InvalidFrame) {
+            if (errorPosition)
+                *errorPosition = offset;
+            return false;
+        }
+
+        const quint32 id = qFromLittleEndian<quint32>(record + 8);
+        const quint8 flags = quint8(record[13]);
+        const int size = quint8(record[14]);
+
+        QCanBusFrame frame(QCanBusFrame::FrameType(quint8(record[12])));
+        if (frame.frameType() == QCanBusFrame::ErrorFrame)
+            frame.setError(QCanBusFrame::FrameErrors::fromInt(id));
+        else
+            frame.setFrameId(id);
+        frame.setExtendedFrameFormat(flags & ExtendedFrameFormat);
+        frame.setFlexibleDataRateFormat(flags & FlexibleDataRate);
+        frame.setBitrateSwitch(flags & BitrateSwitch);
+        frame.setErrorStateIndicator(flags & ErrorStateIndicator);
+        frame.setLocalEcho(flags & LocalEcho);
+        frame.setPayload(QByteArray(record + RecordHeaderSize, size));
+        frame.setTimeStamp(QCanBusFrame::TimeStamp::fromMicroSeconds(
+                qFromLittleEndian<qint64>(record)));
+        frames->append(frame);
+
+        offset += RecordHeaderSize + size;
+    }
+    return true;
+}
+
+// Parses "ID#DATA", "ID##FDATA" or "ID#R[LEN]" as written by candump -l.
+static bool parseCandumpFrame(QByteArrayView token, QCanBusFrame *frame)
+{
+    const qsizetype hashMark = token.indexOf('#');
+    if (hashMark <= 0 || hashMark > 8)
+        return false;
+
+    quint32 id = 0;
+    for (char c : token.first(hashMark)) {
+        const int digit = hexValue(c);
+        if (digit < 0)
+            return false;
+        id = (id << 4) | quint32(digit);
+    }
+
+    QByteArrayView data = token.sliced(hashMark + 1);
+    if (id & CandumpErrorFlag) {
+        frame->setFrameType(QCanBusFrame::ErrorFrame);
+        frame->setError(QCanBusFrame::FrameErrors::fromInt(id & 0x1FFFFFFFU));
+    } else {
+        frame->setFrameId(id & 0x1FFFFFFFU);
+        frame->setExtendedFrameFormat(hashMark == 8 || id > 0x7FF);
+    }
+
+    if (!data.isEmpty() && (data.front() == 'R' || data.front() == 'r')) {
+        if (frame->frameType() == QCanBusFrame::ErrorFrame || data.size() > 2)
+            return false;
+        frame->setFrameType(QCanBusFrame::RemoteRequestFrame);
+        if (data.size() == 2) {
+            const int length = hexValue(data.at(1));
+            if (length < 0 || length > 8)
+                return false;
+            frame->setPayload(QByteArray(length, 0));
+        }
+        return true;
+    }
+
+    if (!data.isEmpty() && data.front() == '#') {
+        if (data.size() < 2 || hexValue(data.at(1)) < 0)
+            return false;
+        const int flags = hexValue(data.at(1));
+        frame->setFlexibleDataRateFormat(true);
+        frame->setBitrateSwitch(flags & 1);
+        frame->setErrorStateIndicator(flags & 2);
+        data = data.sliced(2);
+    }
+
+    char payload[64];
+    int size = 0;
+    for (qsizetype i = 0; i < data.size(); ++i) {
+        if (data.at(i) == '.')
+            continue; // cansend style byte separator
+        if (i + 1 >= data.size() || size == int(sizeof(payload)))
+            return false;
+        const int high = hexValue(data.at(i));
+        const int low = hexValue(data.at(i + 1));
+        if (high < 0 || low < 0)
+            return false;
+        payload[size++] = char((high << 4) | low);
+        ++i;
+    }
+    frame->setPayload(QByteArray(payload, size));
+    return true;
+}
+
+static bool readCandump(QByteArrayView log, QList<QCanBusFrame> *frames, qsizetype *errorPosition)
+{
+    const qsizetype failedLine = forEachLine(log, [frames](QByteArrayView line) {
+        QByteArrayView tokens[3];
+        const qsizetype count = tokenize(line, tokens);
+        if (count == 0)
+            return true;
+        if (count < 3 || tokens[0].size() < 3 || tokens[0].front() != '('
+            || tokens[0].back() != ')') {
+            return false;
+        }
+
+        // "(seconds.microseconds)", the fraction has six digits
+        const QByteArrayView stamp = tokens[0].sliced(1, tokens[0].size() - 2);
+        const qsizetype dot = stamp.indexOf('.');
+        bool ok = false;
+        const qint64 seconds = stamp.first(dot < 0 ? stamp.size() : dot).toLongLong(&ok);
+        if (!ok)
+            return false;
+        qint64 microseconds = 0;
+        if (dot >= 0) {
+            const QByteArrayView fraction = stamp.sliced(dot + 1).first(
+                    qMin<qsizetype>(stamp.size() - dot - 1, 6));
+            microseconds = fraction.toLongLong(&ok);
+            if (!ok)
+                return false;
+            for (qsizetype i = fraction.size(); i < 6; ++i)
+                microseconds *= 10;
+        }
+
+        QCanBusFrame frame;
+        if (!parseCandumpFrame(tokens[2], &frame))
+            return false;
+        frame.setTimeStamp(QCanBusFrame::TimeStamp::fromMicroSeconds(
+                seconds * 1000000 + microseconds));
+        frames->append(frame);
+        return true;
+    });
+
+    if (failedLine && errorPosition)
+        *errorPosition = failedLine;
+    return failedLine == 0;
+}
+
+// Parses a number of a Vector ASC log, hexadecimal or decimal depending on the "base" line.
+static bool parseAscNumber(QByteArrayView token, int base, quint32 *value)
+{
+    bool ok = false;
+    *value = token.toUInt(&ok, base);
+    return ok;
+}
+
+static bool parseAscId(QByteArrayView token, int base, QCanBusFrame *frame)
+{
+    const bool extended = token.endsWith('x') || token.endsWith('X');
+    if (extended)
+        token.chop(1);
+    quint32 id = 0;
+    if (!parseAscNumber(token, base, &id) || id > 0x1FFFFFFFU)
+        return false;
+    frame->setFrameId(id);
+    frame->setExtendedFrameFormat(extended || id > 0x7FF);
+    return true;
+}
+
+static bool readAsc(QByteArrayView log, QList<QCanBusFrame> *frames, qsizetype *errorPosition)
+{
+    // Classic:  <time> <channel> <id>[x] <Rx|Tx> d <dlc> <data...>
+    //           <time> <channel> <id>[x] <Rx|Tx> r [<dlc>]
+    //           <time> <channel> ErrorFrame
+    // CAN FD:   <time> CANFD <channel> <Rx|Tx> <id>[x] [<name>] <brs> <esi> <dlc> <size> <data...>
+    // Other lines, such as the header, trigger blocks and events, are skipped.
+    int base = 16;
+    const qsizetype failedLine = forEachLine(log, [frames, &base](QByteArrayView line) {
+        // The longest line is a named CAN FD frame: ten fields and 64 data bytes.
+        QByteArrayView tokens[10 + 64];
+        const qsizetype count = tokenize(line, tokens);
+        if (count == 0)
+            return true;
+        if (tokens[0] == "base" && count >= 2) {
+            base = tokens[1] == "dec" ? 10 : 16;
+            return true;
+        }
+
+        bool ok = false;
+        const double seconds = tokens[0].toDouble(&ok);
+        if (!ok || count < 3)
+            return true; // not a frame
+        const qint64 stamp = qRound64(seconds * 1000000.0);
+
+        QCanBusFrame frame;
+        qsizetype next = 0;
+        if (tokens[1] == "CANFD") {
+            if (count < 9)
+                return false;
+            if (!parseAscId(tokens[4], base, &frame))
+                return false;
+            // The symbolic name is optional, the bit rate switch flag always follows.
+            next = (tokens[5] == "0" || tokens[5] == "1") ? 5 : 6;
+            if (count < next + 4)
+                return false;
+            quint32 size = 0;
+            if (!parseAscNumber(tokens[next + 3], 10, &size) || size > 64)
+                return false;
+            frame.setFlexibleDataRateFormat(true);
+            frame.setBitrateSwitch(tokens[next] == "1");
+            frame.setErrorStateIndicator(tokens[next + 1] == "1");
+            next += 4;
+            if (count < next + qsizetype(size))
+                return false;
+            char payload[64];
+            for (quint32 i = 0; i < size; ++i) {
+                quint32 byte = 0;
+                if (!parseAscNumber(tokens[next + i], base, &byte) || byte > 0xff)
+                    return false;
+                payload[i] = char(byte);
+            }
+            frame.setPayload(QByteArray(payload, size));
+        } else if (tokens[2] == "ErrorFrame") {
+            frame.setFrameType(QCanBusFrame::ErrorFrame);
+        } else {
+            if (count < 5 || (tokens[3] != "Rx" && tokens[3] != "Tx"))
+                return true; // an event, not a frame
+            if (!parseAscId(tokens[2], base, &frame))
+                return false;
+            if (tokens[4] == "r") {
+                frame.setFrameType(QCanBusFrame::RemoteRequestFrame);
+                quint32 dlc = 0;
+                if (count > 5 && parseAscNumber(tokens[5], 16, &dlc) && dlc <= 8)
+                    frame.setPayload(QByteArray(dlc, 0));
+            } else if (tokens[4] == "d") {
+                quint32 dlc = 0;
+                if (count < 6 || !parseAscNumber(tokens[5], 16, &dlc) || dlc > 8
+                    || count < 6 + qsizetype(dlc)) {
+                    return false;
+                }
+                char payload[8];
+                for (quint32 i = 0; i < dlc; ++i) {
+                    quint32 byte = 0;
+                    if (!parseAscNumber(tokens[6 + i], base, &byte) || byte > 0xff)
+                        return false;
+                    payload[i] = char(byte);
+                }
+                frame.setPayload(QByteArray(payload, dlc));
+            } else {
+                return false;
+            }
+        }
+
+        frame.setTimeStamp(QCanBusFrame::TimeStamp::fromMicroSeconds(stamp));
+        frames->append(frame);
+        return true;
+    });
+
+    if (failedLine && errorPosition)
+        *errorPosition = failedLine;
+    return failedLine == 0;
+}
+
+Format detectFormat(QByteArrayView log)
+{
+    if (log.size() >= qsizetype(sizeof(Magic))
+        && std::memcmp(log.data(), Magic, sizeof(Magic)) == 0) {
+        return Format::Binary;
+    }
+
+    for (char c : log) {
+        if (isSpace(c) || c == '\n')
+            continue;
+        if (c == '(')
+            return Format::Candump;
+        if ((c >= '0' && c <= '9') || c == 'd' || c == 'b')
+            return Format::Asc; // a relative time stamp, or the "date" or "base" header line
+        break;
+    }
+    return Format::Unknown;
+}
+
+bool read(QByteArrayView log, QList<QCanBusFrame> *frames, qsizetype *errorPosition)
+{
+    switch (detectFormat(log)) {
+    case Format::Binary:
+        return readBinary(log, frames, errorPosition);
+    case Format::Candump:
+        return readCandump(log, frames, errorPosition);
+    case Format::Asc:
+        return readAsc(log, frames, errorPosition);
+    case Format::Unknown:
+        break;
+    }
+    if (errorPosition)
+        *errorPosition = 0;
+    return false;
+}
+
+} // namespace QCanBusLog
+
+QT_END_NAMESPACE
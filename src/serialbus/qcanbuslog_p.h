@@ -0,0 +1,204 @@
+// Copyright (C) 2023 The Qt Company Ltd.
+// SPDX-License-Identifier: LicenseRef-Qt-Commercial OR LGPL-3.0-only OR GPL-2.0-only OR GPL-3.0-only
+
+#ifndef QCANBUSLOG_P_H
+#define QCANBUSLOG_P_H
+
+#include <QtCore/qbytearray.h>
+#include <QtCore/qbytearrayview.h>
+#include <QtCore/qendian.h>
+#include <QtCore/qlist.h>
+#include <QtSerialBus/qcanbusframe.h>
+#include <QtSerialBus/qtserialbusglobal.h>
+
+#include <cstring>
+
+//
+//  W A R N I N G
+//  -------------
+//
+// This file is not part of the Qt API. It exists purely as an
+// implementation detail. This header file may change from version to
+// version without notice, or even be removed.
+//
+// We mean it.
+//
+
+QT_BEGIN_NAMESPACE
+
+/*
+    Encodings of CAN frame logs, shared by canbusutil and the library.
+
+    The native binary log starts with a header of HeaderSize bytes: the eight
+    characters of Magic followed by the format Version as a little-endian
+    quint32 and four reserved bytes. Each frame follows as a record of
+    RecordHeaderSize bytes and the payload, all numbers in little-endian:
+
+        qint64   time stamp in microseconds
+        quint32  frame identifier, or the error classes of an error frame
+        quint8   QCanBusFrame::FrameType
+        quint8   flags, see Flag
+        quint8   payload size
+        payload
+
+    The candump log is the text format of the Linux can-utils: one frame per
+    line as "(seconds.microseconds) interface id#payload", with "##" and a
+    flags digit for CAN FD frames and "#R" for remote requests.
+
+    Besides these, logs in the Vector ASC text format can be read.
+*/
+namespace QCanBusLog {
+
+inline constexpr char Magic[8] = { 'Q', 't', 'C', 'a', 'n', 'L', 'o', 'g' };
+inline constexpr quint32 Version = 1;
+inline constexpr int HeaderSize = 16;
+inline constexpr int RecordHeaderSize = 15;
+inline constexpr int MaximumRecordSize = RecordHeaderSize + 64;
+
+enum class Format { Unknown, Binary, Candump, Asc };
+
+enum Flag : quint8 {
+    ExtendedFrameFormat = 0x01,
+    FlexibleDataRate = 0x02,
+    BitrateSwitch = 0x04,
+    ErrorStateIndicator = 0x08,
+    LocalEcho = 0x10
+};
+
+// The socketcan error flag, set in the identifier of error frames in candump logs.
+inline constexpr quint32 CandumpErrorFlag = 0x20000000U;
+
+inline qint64 timeStampMicroseconds(const QCanBusFrame &frame)
+{
+    const QCanBusFrame::TimeStamp stamp = frame.timeStamp();
+    return stamp.seconds() * 1000000 + stamp.microSeconds();
+}
+
+inline void appendHeader(QByteArray *log)
+{
+    char header[HeaderSize] = {};
+    std::memcpy(header, Magic, sizeof(Magic));
+    qToLittleEndian<quint32>(Version, header + 8);
+    log->append(header, HeaderSize);
+}
+
+// Appends one binary record to log, without allocating if log has capacity left.
+inline void appendBinary(QByteArray *log, const QCanBusFrame &frame)
+{
+    // Only read once, payload() returns a shared copy.
+    const QByteArray payload = frame.payload();
+    const qsizetype size = qMin<qsizetype>(payload.size(), 64);
+
+    quint8 flags = 0;
+    if (frame.hasExtendedFrameFormat())
+        flags |= ExtendedFrameFormat;
+    if (frame.hasFlexibleDataRateFormat())
+        flags |= FlexibleDataRate;
+    if (frame.hasBitrateSwitch())
+        flags |= BitrateSwitch;
+    if (frame.hasErrorStateIndicator())
+        flags |= ErrorStateIndicator;
+    if (frame.hasLocalEcho())
+        flags |= LocalEcho;
+
+    const quint32 id = frame.frameType() == QCanBusFrame::ErrorFrame
+        ? quint32(frame.error().toInt()) : frame.frameId();
+
+    const qsizetype offset = log->size();
+    log->resize(offset + RecordHeaderSize + size);
+    char *out = log->data() + offset;
+    qToLittleEndian<qint64>(timeStampMicroseconds(frame), out);
+    qToLittleEndian<quint32>(id, out + 8);
+    out[12] = char(frame.frameType());
+    out[13] = char(flags);
+    out[14] = char(size);
+    std::memcpy(out + RecordHeaderSize, payload.constData(), size_t(size));
+}
+
+inline char *writeHex(char *out, quint32 value, int digits)
+{
+    static constexpr char hex[] = "0123456789ABCDEF";
+    for (int i = digits - 1; i >= 0; --i) {
+        out[i] = hex[value & 0xf];
+        value >>= 4;
+    }
+    return out + digits;
+}
+
+// Appends one line in candump log format to log.
+inline void appendCandump(QByteArray *log, const QCanBusFrame &frame,
+                          const QByteArray &interfaceName)
+{
+    const QByteArray payload = frame.payload();
+    const qsizetype size = qMin<qsizetype>(payload.size(), 64);
+
+    // "(" 10 digits "." 6 digits ") " interface " " 8 digits "##" flag, two digits per byte
+    char line[32 + 128 + 16];
+    char *out = line;
+    const qint64 stamp = qMax<qint64>(timeStampMicroseconds(frame), 0);
+    *out++ = '(';
+    qint64 seconds = stamp / 1000000;
+    char digits[20];
+    int count = 0;
+    do {
+        digits[count++] = char('0' + seconds % 10);
+        seconds /= 10;
+    } while (seconds > 0);
+    for (int i = count; i < 10; ++i)
+        *out++ = '0';
+    while (count > 0)
+        *out++ = digits[--count];
+    *out++ = '.';
+    qint64 microseconds = stamp % 1000000;
+    for (int i = 5; i >= 0; --i) {
+        out[i] = char('0' + microseconds % 10);
+        microseconds /= 10;
+    }
+    out += 6;
+    *out++ = ')';
+    *out++ = ' ';
+    log->append(line, out - line);
+    log->append(interfaceName);
+    out = line;
+    *out++ = ' ';
+
+    if (frame.frameType() == QCanBusFrame::ErrorFrame) {
+        out = writeHex(out, CandumpErrorFlag | quint32(frame.error().toInt()), 8);
+    } else {
+        out = writeHex(out, frame.frameId(), frame.hasExtendedFrameFormat() ? 8 : 3);
+    }
+    *out++ = '#';
+
+    if (frame.frameType() == QCanBusFrame::RemoteRequestFrame) {
+        *out++ = 'R';
+        if (size > 0)
+            out = writeHex(out, quint32(size), 1);
+    } else {
+        if (frame.hasFlexibleDataRateFormat()) {
+            *out++ = '#';
+            quint32 flags = 0;
+            if (frame.hasBitrateSwitch())
+                flags |= 1;
+            if (frame.hasErrorStateIndicator())
+                flags |= 2;
+            out = writeHex(out, flags, 1);
+        }
+        for (qsizetype i = 0; i < size; ++i)
+            out = writeHex(out, quint8(payload.at(i)), 2);
+    }
+    *out++ = '\n';
+    log->append(line, out - line);
+}
+
+Q_SERIALBUS_EXPORT Format detectFormat(QByteArrayView log);
+
+// Appends the frames of log to frames. On a malformed record, returns false and sets
+// errorPosition to the line number of text logs, or the byte offset into binary logs.
+Q_SERIALBUS_EXPORT bool read(QByteArrayView log, QList<QCanBusFrame> *frames,
+                             qsizetype *errorPosition = nullptr);
+
+} // namespace QCanBusLog
+
+QT_END_NAMESPACE
+
+#endif // QCANBUSLOG_P_H
@@ -0,0 +1,392 @@
+// Copyright (C) 2023 The Qt Company Ltd.
+// SPDX-License-Identifier: LicenseRef-Qt-Commercial OR LGPL-3.0-only OR GPL-2.0-only OR GPL-3.0-only
+
+#include "qcanbusmultiplexer.h"
+#include "qcanbusmultiplexer_p.h"
+
+#include <QtCore/qdatetime.h>
+#include <QtCore/qtimer.h>
+#include <QtSerialBus/qcanbusdevice.h>
+
+#include <algorithm>
+
+QT_BEGIN_NAMESPACE
+
+/*!
+    \class QCanBusMultiplexer
+    \inmodule QtSerialBus
+    \since 6.7
+
+    \brief The QCanBusMultiplexer class merges the frames received by
+    several CAN bus devices into one stream in time stamp order.
+
+    Each QCanBusDevice emits \l {QCanBusDevice::}{framesReceived()} for its
+    own frames. QCanBusMultiplexer reads the frames of all devices added with
+    addDevice() and offers them through readFrame() and readAllFrames(),
+    sorted by their time stamps, together with the device that received
+    them. The devices can belong to any plugin, and the multiplexer takes
+    ownership of them.
+
+    A frame can only be passed on when no device can still deliver a frame
+    with an earlier time stamp. The multiplexer therefore keeps the latest
+    time stamp received from every device, the watermark of the device, and
+    passes on all frames that are not later than the smallest watermark. As
+    long as all devices receive frames, the merge adds little delay. A quiet
+    device would hold back the frames of all others, so frames are passed on
+    at the latest maximumLatency() milliseconds after their reception,
+    together with all frames with an earlier time stamp. A frame that a
+    device delivers even later than that is passed on out of order.
+
+    All devices should use the same clock for their time stamps, as the
+    devices of one plugin usually do. Frames without a time stamp get the
+    time of their reception.
+
+    \code
+        auto multiplexer = new QCanBusMultiplexer(this);
+        for (const QString &name : { u"can0"_s, u"can1"_s }) {
+            QCanBusDevice *device = QCanBus::instance()->createDevice(u"socketcan"_s, name);
+            multiplexer->addDevice(device);
+            device->connectDevice();
+        }
+        connect(multiplexer, &QCanBusMultiplexer::framesReceived, this, [multiplexer] {
+            QCanBusDevice *source = nullptr;
+            while (multiplexer->framesAvailable() > 0) {
+                const QCanBusFrame frame = multiplexer->readFrame(&source);
+                qDebug() << source->deviceInfo().name() << frame.toString();
+            }
+        });
+    \endcode
+*/
+
+/*!
+    \fn void QCanBusMultiplexer::framesReceived()
+
+    This signal is emitted when merged frames are available for reading.
+
+    \sa framesAvailable(), readFrame(), readAllFrames()
+*/
+
+/*!
+    Constructs a multiplexer with the specified \a parent.
+*/
+QCanBusMultiplexer::QCanBusMultiplexer(QObject *parent)
+    : QObject(*new QCanBusMultiplexerPrivate, parent)
+{
+    Q_D(QCanBusMultiplexer);
+    d->setupTimer();
+    d->m_clock.start();
+}
+
+/*!
+    Destroys the multiplexer and the devices it owns.
+*/
+QCanBusMultiplexer::~QCanBusMultiplexer() = default;
+
+/*!
+    Adds \a device to the multiplexer, which takes ownership of it. The
+    frames it receives from then on are merged into the stream.
+
+    \sa removeDevice(), devices()
+*/
+void QCanBusMultiplexer::addDevice(QCanBusDevice *device)
+{
+    Q_D(QCanBusMultiplexer);
+
+    const auto known = [device](const QCanBusMultiplexerPrivate::Source &s) {
+        return s.device == device;
+    };
+    if (!device || std::any_of(d->m_sources.cbegin(), d->m_sources.cend(), known))
+        return;
+
+    device->setParent(this);
+    QCanBusMultiplexerPrivate::Source source;
+    source.device = device;
+    d->m_sources.push_back(std::move(source));
+
+    connect(device, &QCanBusDevice::framesReceived, this, [d, device]() {
+        d->readFrames(device);
+    });
+    connect(device, &QObject::destroyed, this, [d, device]() {
+        // Frames merged before are kept, but can no longer name their device.
+        for (QCanBusMultiplexerPrivate::Entry &entry : d->m_merged) {
+            if (entry.source == device)
+                entry.source = nullptr;
+        }
+        d->removeSource(device);
+    });
+}
+
+/*!
+    Removes \a device from the multiplexer, and passes the ownership of the
+    device to the caller. Frames the device received that were not merged
+    yet are discarded.
+
+    \sa addDevice()
+*/
+void QCanBusMultiplexer::removeDevice(QCanBusDevice *device)
+{
+    Q_D(QCanBusMultiplexer);
+
+    if (!device)
+        return;
+
+    disconnect(device, nullptr, this, nullptr);
+    if (device->parent() == this)
+        device->setParent(nullptr);
+    d->removeSource(device);
+}
+
+/*!
+    Returns the devices of the multiplexer.
+*/
+QList<QCanBusDevice *> QCanBusMultiplexer::devices() const
+{
+    Q_D(const QCanBusMultiplexer);
+
+    QList<QCanBusDevice *> result;
+    result.reserve(qsizetype(d->m_sources.size()));
+    for (const QCanBusMultiplexerPrivate::Source &source : d->m_sources)
+        result.append(source.device);
+    return result;
+}
+
+/*!
+    Returns the longest time in milliseconds a received frame is held back
+    to wait for frames with earlier time stamps from other devices. The
+    default is 100 ms.
+
+    \sa setMaximumLatency()
+*/
+int QCanBusMultiplexer::maximumLatency() const
+{
+    Q_D(const QCanBusMultiplexer);
+    return d->m_maximumLatency;
+}
+
+/*!
+    Sets the maximum latency to \a msecs milliseconds. A larger value lets
+    the merge order frames of devices with larger reception delays correctly,
+    a smaller value passes frames on sooner when some devices are quiet. With
+    0, frames are passed on as soon as they are received, sorted only within
+    the frames received together.
+
+    \sa maximumLatency()
+*/
+void QCanBusMultiplexer::setMaximumLatency(int msecs)
+{
+    Q_D(QCanBusMultiplexer);
+
+    d->m_maximumLatency = qMax(0, msecs);
+    d->mergeDue();
+}
+
+/*!
+    Returns the number of merged frames ready for reading.
+
+    \sa framesPending(), readFrame()
+*/
+qint64 QCanBusMultiplexer::framesAvailable() const
+{
+    Q_D(const QCanBusMultiplexer);
+    return qint64(d->m_merged.size());
+}
+
+/*!
+    Returns the number of received frames that are held back to wait for
+    frames with earlier time stamps.
+
+    \sa framesAvailable(), flush()
+*/
+qint64 QCanBusMultiplexer::framesPending() const
+{
+    Q_D(const QCanBusMultiplexer);
+
+    qint64 pending = 0;
+    for (const QCanBusMultiplexerPrivate::Source &source : d->m_sources)
+        pending += qint64(source.frames.size());
+    return pending;
+}
+
+/*!
+    Returns the next merged frame and removes it from the stream. If
+    \a source is not \c nullptr, it is set to the device that received the
+    frame. Returns an invalid frame if no frame is available.
+
+    \sa readAllFrames(), framesAvailable()
+*/
+QCanBusFrame QCanBusMultiplexer::readFrame(QCanBusDevice **source)
+{
+    Q_D(QCanBusMultiplexer);
+
+    if (d->m_merged.empty()) {
+        if (source)
+            *source = nullptr;
+        return QCanBusFrame(QCanBusFrame::InvalidFrame);
+    }
+
+    QCanBusMultiplexerPrivate::Entry entry = std::move(d->m_merged.front());
+    d->m_merged.pop_front();
+    if (source)
+        *source = entry.source;
+    return entry.frame;
+}
+
+/*!
+    Returns all merged frames and removes them from the stream. If
+    \a sources is not \c nullptr, it is set to the devices that received the
+    frames, in the same order.
+
+    \sa readFrame(), framesAvailable()
+*/
+QList<QCanBusFrame> QCanBusMultiplexer::readAllFrames(QList<QCanBusDevice *> *sources)
+{
+    Q_D(QCanBusMultiplexer);
+
+    QList<QCanBusFrame> frames;
+    frames.reserve(qsizetype(d->m_merged.size()));
+    if (sources) {
+        sources->clear();
+        sources->reserve(qsizetype(d->m_merged.size()));
+    }
+    for (QCanBusMultiplexerPrivate::Entry &entry : d->m_merged) {
+        frames.append(std::move(entry.frame));
+        if (sources)
+            sources->append(entry.source);
+    }
+    d->m_merged.clear();
+    return frames;
+}
+
+/*!
+    Merges all frames held back, without waiting for frames with earlier time
+    stamps, for example before the devices are disconnected.
+
+    \sa framesPending()
+*/
+void QCanBusMultiplexer::flush()
+{
+    Q_D(QCanBusMultiplexer);
+
+    d->merge(std::numeric_limits<qint64>::max());
+    d->m_timer->stop();
+}
+
+void QCanBusMultiplexerPrivate::setupTimer()
+{
+    Q_Q(QCanBusMultiplexer);
+
+    m_timer = new QTimer(q);
+    m_timer->setSingleShot(true);
+    m_timer->setTimerType(Qt::PreciseTimer);
+    QObject::connect(m_timer, &QTimer::timeout, q, [this]() { mergeDue(); });
+}
+
+void QCanBusMultiplexerPrivate::readFrames(QCanBusDevice *device)
+{
+    const auto source = std::find_if(m_sources.begin(), m_sources.end(),
+                                     [device](const Source &s) { return s.device == device; });
+    if (source == m_sources.end())
+        return;
+
+    const QList<QCanBusFrame> frames = device->readAllFrames();
+    const qint64 now = m_clock.elapsed();
+    const qint64 receptionTime = QDateTime::currentMSecsSinceEpoch() * 1000;
+    for (const QCanBusFrame &frame : frames) {
+        const QCanBusFrame::TimeStamp stamp = frame.timeStamp();
+        Entry entry;
+        entry.frame = frame;
+        entry.source = device;
+        entry.timeStamp = stamp.seconds() * 1000000 + stamp.microSeconds();
+        if (entry.timeStamp == 0)
+            entry.timeStamp = receptionTime;
+        entry.arrival = now;
+        source->watermark = qMax(source->watermark, entry.timeStamp);
+        source->frames.push_back(std::move(entry));
+    }
+
+    mergeDue();
+}
+
+void QCanBusMultiplexerPrivate::removeSource(QCanBusDevice *device)
+{
+    const auto source = std::find_if(m_sources.begin(), m_sources.end(),
+                                     [device](const Source &s) { return s.device == device; });
+    if (source == m_sources.end())
+        return;
+
+    m_sources.erase(source);
+    mergeDue(); // the device may have held back the frames of the others
+}
+
+/*
+    Moves the frames with a time stamp up to threshold to the merged stream,
+    always taking the earliest frame at the front of the device queues, as in
+    a k-way merge of sorted lists.
+*/
+void QCanBusMultiplexerPrivate::merge(qint64 threshold)
+{
+    Q_Q(QCanBusMultiplexer);
+
+    qint64 merged = 0;
+    for (;;) {
+        Source *next = nullptr;
+        for (Source &source : m_sources) {
+            if (source.frames.empty())
+                continue;
+            if (!next || source.frames.front().timeStamp < next->frames.front().timeStamp)
+                next = &source;
+        }
+        if (!next || next->frames.front().timeStamp > threshold)
+            break;
+
+        m_merged.push_back(std::move(next->frames.front()));
+        next->frames.pop_front();
+        ++merged;
+    }
+
+    if (merged > 0)
+        emit q->framesReceived();
+}
+
+/*
+    Returns the time stamp up to which frames can be merged: the smallest
+    watermark of the devices, or the time stamp of the latest frame held back
+    for the maximum latency, whichever is later.
+*/
+qint64 QCanBusMultiplexerPrivate::releaseThreshold(qint64 now) const
+{
+    qint64 watermark = std::numeric_limits<qint64>::max();
+    qint64 expired = std::numeric_limits<qint64>::min();
+    for (const Source &source : m_sources) {
+        watermark = qMin(watermark, source.watermark);
+        for (const Entry &entry : source.frames) {
+            if (entry.arrival + m_maximumLatency > now)
+                break; // the frames are in the order of their arrival
+            expired = qMax(expired, entry.timeStamp);
+        }
+    }
+    return qMax(watermark, expired);
+}
+
+void QCanBusMultiplexerPrivate::scheduleTimeout(qint64 now)
+{
+    qint64 earliest = std::numeric_limits<qint64>::max();
+    for (const Source &source : m_sources) {
+        if (!source.frames.empty())
+            earliest = qMin(earliest, source.frames.front().arrival);
+    }
+
+    if (earliest == std::numeric_limits<qint64>::max())
+        m_timer->stop();
+    else
+        m_timer->start(int(qMax(earliest + m_maximumLatency - now, qint64(0))));
+}
+
+void QCanBusMultiplexerPrivate::mergeDue()
+{
+    const qint64 now = m_clock.elapsed();
+    merge(releaseThreshold(now));
+    scheduleTimeout(now);
+}
+
+QT_END_NAMESPACE
@@ -0,0 +1,48 @@
+// Copyright (C) 2023 The Qt Company Ltd.
+// SPDX-License-Identifier: LicenseRef-Qt-Commercial OR LGPL-3.0-only OR GPL-2.0-only OR GPL-3.0-only
+
+#ifndef QCANBUSMULTIPLEXER_H
+#define QCANBUSMULTIPLEXER_H
+
+#include <QtCore/qlist.h>
+#include <QtCore/qobject.h>
+#include <QtSerialBus/qcanbusframe.h>
+#include <QtSerialBus/qtserialbusglobal.h>
+
+QT_BEGIN_NAMESPACE
+
+class QCanBusDevice;
+class QCanBusMultiplexerPrivate;
+
+class Q_SERIALBUS_EXPORT QCanBusMultiplexer : public QObject
+{
+    Q_OBJECT
+    Q_DECLARE_PRIVATE(QCanBusMultiplexer)
+
+public:
+    explicit QCanBusMultiplexer(QObject *parent = nullptr);
+    ~QCanBusMultiplexer() override;
+
+    void addDevice(QCanBusDevice *device);
+    void removeDevice(QCanBusDevice *device);
+    QList<QCanBusDevice *> devices() const;
+
+    int maximumLatency() const;
+    void setMaximumLatency(int msecs);
+
+    qint64 framesAvailable() const;
+    qint64 framesPending() const;
+    QCanBusFrame readFrame(QCanBusDevice **source = nullptr);
+    QList<QCanBusFrame> readAllFrames(QList<QCanBusDevice *> *sources = nullptr);
+    void flush();
+
+Q_SIGNALS:
+    void framesReceived();
+
+private:
+    Q_DISABLE_COPY_MOVE(QCanBusMultiplexer)
+};
+
+QT_END_NAMESPACE
+
+#endif // QCANBUSMULTIPLEXER_H
@@ -0,0 +1,68 @@
+// Copyright (C) 2023 The Qt Company Ltd.
+// SPDX-License-Identifier: LicenseRef-Qt-Commercial OR LGPL-3.0-only OR GPL-2.0-only OR GPL-3.0-only
+
+#ifndef QCANBUSMULTIPLEXER_P_H
+#define QCANBUSMULTIPLEXER_P_H
+
+#include <QtCore/qelapsedtimer.h>
+#include <QtSerialBus/qcanbusmultiplexer.h>
+
+#include <private/qobject_p.h>
+
+#include <deque>
+#include <limits>
+#include <vector>
+
+//
+//  W A R N I N G
+//  -------------
+//
+// This file is not part of the Qt API. It exists purely as an
+// implementation detail. This header file may change from version to
+// version without notice, or even be removed.
+//
+// We mean it.
+//
+
+QT_BEGIN_NAMESPACE
+
+class QTimer;
+
+class QCanBusMultiplexerPrivate : public QObjectPrivate
+{
+    Q_DECLARE_PUBLIC(QCanBusMultiplexer)
+
+public:
+    struct Entry
+    {
+        QCanBusFrame frame;
+        QCanBusDevice *source = nullptr;
+        qint64 timeStamp = 0; // microseconds
+        qint64 arrival = 0; // milliseconds of m_clock
+    };
+
+    struct Source
+    {
+        QCanBusDevice *device = nullptr;
+        std::deque<Entry> frames; // not merged yet, in the order received
+        qint64 watermark = std::numeric_limits<qint64>::min(); // latest time stamp received
+    };
+
+    void setupTimer();
+    void readFrames(QCanBusDevice *device);
+    void removeSource(QCanBusDevice *device);
+    void merge(qint64 threshold);
+    qint64 releaseThreshold(qint64 now) const;
+    void scheduleTimeout(qint64 now);
+    void mergeDue();
+
+    std::vector<Source> m_sources;
+    std::deque<Entry> m_merged; // ready to be read, in time stamp order
+    int m_maximumLatency = 100;
+    QElapsedTimer m_clock;
+    QTimer *m_timer = nullptr;
+};
+
+QT_END_NAMESPACE
+
+#endif // QCANBUSMULTIPLEXER_P_H
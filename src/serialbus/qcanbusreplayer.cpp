@@ -0,0 +1,502 @@
+// Copyright (C) 2023 The Qt Company Ltd.
+// SPDX-License-Identifier: LicenseRef-Qt-Commercial OR LGPL-3.0-only OR GPL-2.0-only OR GPL-3.0-only
+
+#include "qcanbusreplayer.h"
+#include "qcanbusreplayer_p.h"
+#include "qcanbuslog_p.h"
+
+#include <QtCore/qfile.h>
+#include <QtCore/qloggingcategory.h>
+#include <QtCore/qtimer.h>
+
+#include <climits>
+
+QT_BEGIN_NAMESPACE
+
+Q_DECLARE_LOGGING_CATEGORY(QT_CANBUS)
+
+/*!
+    \class QCanBusReplayer
+    \inmodule QtSerialBus
+    \since 6.7
+
+    \brief The QCanBusReplayer class writes recorded CAN bus frames to a
+    device with their original timing.
+
+    QCanBusReplayer feeds a log of CAN bus frames to any QCanBusDevice, for
+    example to drive a test rig or a virtual bus with recorded traffic. The
+    frames are loaded from a file with load(), or set directly with
+    setFrames(). The following log formats are read:
+
+    \list
+        \li The candump log format of the Linux can-utils, as written by
+            \c {candump -l} and \c {canbusutil --capture --format candump}.
+        \li The native binary log format written by
+            \c {canbusutil --capture}.
+        \li The Vector ASC text format, for CAN and CAN FD frames.
+    \endlist
+
+    After start(), every frame is written with \l {QCanBusDevice::}{writeFrame()}
+    when the time since its first frame has passed on the replay clock. The
+    time stamps of the frames define that timing; frames with a time stamp
+    earlier than their predecessor are written right after it. The speed
+    factor set with setSpeed() scales the timing, and with setLooping() the
+    log restarts after its last frame. Error frames cannot be written and are
+    skipped.
+
+    The due time of every frame is computed ahead from the start of the
+    replay and compared to a monotonic clock, so that the lateness of one
+    frame does not delay the following ones; the replay does not drift. The
+    replayer wakes up before a frame is due and writes it as close to its due
+    time as the event loop permits. The achieved timing is reported by
+    averageTimingError() and maximumTimingError().
+*/
+
+/*!
+    \enum QCanBusReplayer::ReplayerError
+
+    This enum describes the errors that may occur.
+
+    \value NoError          No errors have occurred.
+    \value ReadError        The log file could not be read.
+    \value FormatError      The log has an unknown format or contains an
+                            invalid record.
+    \value WriteError       A frame could not be written to the device.
+*/
+
+/*!
+    \enum QCanBusReplayer::ReplayerState
+
+    This enum describes the states of the replayer.
+
+    \value StoppedState     The replayer does not write frames.
+    \value RunningState     The replayer writes frames to the device.
+*/
+
+/*!
+    \fn void QCanBusReplayer::stateChanged(QCanBusReplayer::ReplayerState state)
+
+    This signal is emitted every time the state of the replayer changes. The
+    new state is represented by \a state.
+*/
+
+/*!
+    \fn void QCanBusReplayer::errorOccurred(QCanBusReplayer::ReplayerError error)
+
+    This signal is emitted when an \a error occurs.
+*/
+
+/*!
+    \fn void QCanBusReplayer::finished()
+
+    This signal is emitted when the last frame of the log was written and
+    looping is disabled.
+*/
+
+/*!
+    Constructs a replayer with the specified \a parent.
+*/
+QCanBusReplayer::QCanBusReplayer(QObject *parent)
+    : QObject(*new QCanBusReplayerPrivate, parent)
+{
+    Q_D(QCanBusReplayer);
+    d->setupTimer();
+}
+
+/*!
+    Destroys the replayer.
+*/
+QCanBusReplayer::~QCanBusReplayer()
+{
+    stop();
+}
+
+/*!
+    Loads the frames of the log file \a fileName, replacing all frames. The
+    format of the log is detected from its content. Stops a running replay.
+
+    Returns \c true on success; otherwise \c false, and error() and
+    errorString() describe the problem.
+
+    \sa setFrames()
+*/
+bool QCanBusReplayer::load(const QString &fileName)
+{
+    Q_D(QCanBusReplayer);
+    stop();
+    d->m_frames.clear();
+
+    QFile file(fileName);
+    if (!file.open(QIODevice::ReadOnly)) {
+        d->setError(ReadError, tr("Cannot open log file '%1': %2")
+                    .arg(fileName, file.errorString()));
+        return false;
+    }
+
+    // Logs are large, parse them from a mapping instead of a copy when possible.
+    QByteArray contents;
+    QByteArrayView log;
+    if (const uchar *mapped = file.size() > 0 ? file.map(0, file.size()) : nullptr) {
+        log = QByteArrayView(mapped, file.size());
+    } else {
+        contents = file.readAll();
+        if (file.error() != QFileDevice::NoError) {
+            d->setError(ReadError, tr("Cannot read log file '%1': %2")
+                        .arg(fileName, file.errorString()));
+            return false;
+        }
+        log = contents;
+    }
+
+    const QCanBusLog::Format format = QCanBusLog::detectFormat(log);
+    if (format == QCanBusLog::Format::Unknown) {
+        d->setError(FormatError, tr("Unknown format of log file '%1'.").arg(fileName));
+        return false;
+    }
+
+    qsizetype position = 0;
+    if (!QCanBusLog::read(log, &d->m_frames, &position)) {
+        d->m_frames.clear();
+        d->setError(FormatError, format == QCanBusLog::Format::Binary
+                    ? tr("Invalid record at offset %1 of log file '%2'.").arg(position)
+                                                                       .arg(fileName)
+                    : tr("Invalid record in line %1 of log file '%2'.").arg(position)
+                                                                      .arg(fileName));
+        return false;
+    }
+
+    qCDebug(QT_CANBUS, "Loaded %lld frames from '%ls'.", qlonglong(d->m_frames.size()),
+            qUtf16Printable(fileName));
+    d->m_error = NoError;
+    d->m_errorString.clear();
+    return true;
+}
+
+/*!
+    Sets the frames to replay to \a frames, replacing all frames. Stops a
+    running replay.
+
+    \sa frames(), load()
+*/
+void QCanBusReplayer::setFrames(const QList<QCanBusFrame> &frames)
+{
+    Q_D(QCanBusReplayer);
+    stop();
+    d->m_frames = frames;
+}
+
+/*!
+    Returns the frames to replay.
+
+    \sa setFrames()
+*/
+QList<QCanBusFrame> QCanBusReplayer::frames() const
+{
+    Q_D(const QCanBusReplayer);
+    return d->m_frames;
+}
+
+/*!
+    Returns the device the frames are written to, or \c nullptr if none is
+    set.
+
+    \sa setDevice()
+*/
+QCanBusDevice *QCanBusReplayer::device() const
+{
+    Q_D(const QCanBusReplayer);
+    return d->m_device;
+}
+
+/*!
+    Sets the device the frames are written to to \a device. The replayer
+    does not take ownership of \a device. It must be connected while the
+    replay runs.
+
+    \sa device()
+*/
+void QCanBusReplayer::setDevice(QCanBusDevice *device)
+{
+    Q_D(QCanBusReplayer);
+    d->m_device = device;
+}
+
+/*!
+    Returns the speed factor of the replay. The default is \c 1.0.
+
+    \sa setSpeed()
+*/
+double QCanBusReplayer::speed() const
+{
+    Q_D(const QCanBusReplayer);
+    return d->m_speed;
+}
+
+/*!
+    Sets the speed factor of the replay to \a factor. With a factor of \c 2.0,
+    the frames are written twice as fast as they were recorded. Factors not
+    greater than \c 0 are ignored. The factor applies from the next start().
+
+    \sa speed()
+*/
+void QCanBusReplayer::setSpeed(double factor)
+{
+    Q_D(QCanBusReplayer);
+    if (!(factor > 0.0)) {
+        qCWarning(QT_CANBUS, "QCanBusReplayer::setSpeed: Invalid speed factor %f.", factor);
+        return;
+    }
+    d->m_speed = factor;
+}
+
+/*!
+    Returns \c true if the log restarts after its last frame; otherwise
+    \c false. The default is \c false.
+
+    \sa setLooping()
+*/
+bool QCanBusReplayer::isLooping() const
+{
+    Q_D(const QCanBusReplayer);
+    return d->m_looping;
+}
+
+/*!
+    Sets whether the log restarts after its last frame to \a looping. The
+    first frame of the next round is due one average frame interval after
+    the last frame, so that the round trip keeps the rate of the log.
+
+    \sa isLooping()
+*/
+void QCanBusReplayer::setLooping(bool looping)
+{
+    Q_D(QCanBusReplayer);
+    d->m_looping = looping;
+}
+
+/*!
+    Returns the current state of the replayer.
+*/
+QCanBusReplayer::ReplayerState QCanBusReplayer::state() const
+{
+    Q_D(const QCanBusReplayer);
+    return d->m_state;
+}
+
+/*!
+    Returns the last error that occurred.
+
+    \sa errorString()
+*/
+QCanBusReplayer::ReplayerError QCanBusReplayer::error() const
+{
+    Q_D(const QCanBusReplayer);
+    return d->m_error;
+}
+
+/*!
+    Returns a human-readable description of the last error that occurred.
+
+    \sa error()
+*/
+QString QCanBusReplayer::errorString() const
+{
+    Q_D(const QCanBusReplayer);
+    return d->m_errorString;
+}
+
+/*!
+    Returns the number of frames written since the last start().
+*/
+qint64 QCanBusReplayer::framesReplayed() const
+{
+    Q_D(const QCanBusReplayer);
+    return d->m_framesReplayed;
+}
+
+/*!
+    Returns the average time in microseconds by which the frames written
+    since the last start() missed their due time.
+
+    \sa maximumTimingError()
+*/
+qint64 QCanBusReplayer::averageTimingError() const
+{
+    Q_D(const QCanBusReplayer);
+    return d->m_framesReplayed > 0 ? d->m_totalTimingError / d->m_framesReplayed : 0;
+}
+
+/*!
+    Returns the largest time in microseconds by which a frame written since
+    the last start() missed its due time.
+
+    \sa averageTimingError()
+*/
+qint64 QCanBusReplayer::maximumTimingError() const
+{
+    Q_D(const QCanBusReplayer);
+    return d->m_maximumTimingError;
+}
+
+/*!
+    Starts the replay from the first frame. Does nothing if the replay runs
+    already. Emits finished() right away if there are no frames.
+
+    \sa stop()
+*/
+void QCanBusReplayer::start()
+{
+    Q_D(QCanBusReplayer);
+    if (d->m_state == RunningState)
+        return;
+
+    if (!d->m_device) {
+        d->setError(WriteError, tr("No device to replay to."));
+        return;
+    }
+
+    d->m_error = NoError;
+    d->m_errorString.clear();
+    d->m_framesReplayed = 0;
+    d->m_totalTimingError = 0;
+    d->m_maximumTimingError = 0;
+    d->buildSchedule();
+
+    d->setState(RunningState);
+    d->m_clock.start();
+    d->scheduleNext();
+}
+
+/*!
+    Stops the replay. Frames written already stay written.
+
+    \sa start()
+*/
+void QCanBusReplayer::stop()
+{
+    Q_D(QCanBusReplayer);
+    if (d->m_state == StoppedState)
+        return;
+    d->m_timer->stop();
+    d->setState(StoppedState);
+}
+
+void QCanBusReplayerPrivate::setupTimer()
+{
+    Q_Q(QCanBusReplayer);
+
+    m_timer = new QTimer(q);
+    m_timer->setSingleShot(true);
+    m_timer->setTimerType(Qt::PreciseTimer);
+    QObject::connect(m_timer, &QTimer::timeout, q, [this]() { replayDueFrames(); });
+}
+
+void QCanBusReplayerPrivate::setError(QCanBusReplayer::ReplayerError error,
+                                      const QString &errorText)
+{
+    Q_Q(QCanBusReplayer);
+
+    m_error = error;
+    m_errorString = errorText;
+    qCWarning(QT_CANBUS, "%ls", qUtf16Printable(errorText));
+    emit q->errorOccurred(error);
+}
+
+void QCanBusReplayerPrivate::setState(QCanBusReplayer::ReplayerState state)
+{
+    Q_Q(QCanBusReplayer);
+
+    if (m_state == state)
+        return;
+    m_state = state;
+    emit q->stateChanged(state);
+}
+
+void QCanBusReplayerPrivate::buildSchedule()
+{
+    m_schedule.clear();
+    m_schedule.reserve(size_t(m_frames.size()));
+    m_loopOffset = 0;
+    m_next = 0;
+    if (m_frames.isEmpty()) {
+        m_loopPeriod = 0;
+        return;
+    }
+
+    const auto microseconds = [](const QCanBusFrame &frame) {
+        return frame.timeStamp().seconds() * 1000000 + frame.timeStamp().microSeconds();
+    };
+    const qint64 first = microseconds(m_frames.constFirst());
+    qint64 due = 0;
+    for (const QCanBusFrame &frame : std::as_const(m_frames)) {
+        const qint64 offset = qint64((microseconds(frame) - first) * 1000.0 / m_speed);
+        due = qMax(due, offset);
+        m_schedule.push_back(due);
+    }
+
+    // Restart one average frame interval after the last frame, and never in a busy loop.
+    const qint64 span = m_schedule.back();
+    const qint64 interval = m_schedule.size() > 1 ? span / qint64(m_schedule.size() - 1) : 0;
+    m_loopPeriod = qMax<qint64>(span + interval, 1000000);
+}
+
+void QCanBusReplayerPrivate::scheduleNext()
+{
+    Q_Q(QCanBusReplayer);
+
+    if (m_next == qsizetype(m_schedule.size())) {
+        if (!m_looping || m_schedule.empty()) {
+            q->stop();
+            emit q->finished();
+            return;
+        }
+        m_next = 0;
+        m_loopOffset += m_loopPeriod;
+    }
+
+    // Wake up in time and write the frame on the first wake up at or after its due time; a
+    // timer due within the current millisecond is polled through the event loop.
+    const qint64 remaining = dueTime(m_next) - m_clock.nsecsElapsed();
+    m_timer->start(remaining > 0 ? int(qMin<qint64>(remaining / 1000000, INT_MAX)) : 0);
+}
+
+void QCanBusReplayerPrivate::replayDueFrames()
+{
+    Q_Q(QCanBusReplayer);
+
+    if (m_state != QCanBusReplayer::RunningState)
+        return;
+
+    while (m_next < qsizetype(m_schedule.size())) {
+        const qint64 due = dueTime(m_next);
+        const qint64 now = m_clock.nsecsElapsed();
+        if (due > now)
+            break;
+
+        const QCanBusFrame &frame = m_frames.at(m_next);
+        ++m_next;
+        if (frame.frameType() == QCanBusFrame::ErrorFrame)
+            continue;
+
+        if (!m_device || !m_device->writeFrame(frame)) {
+            setError(QCanBusReplayer::WriteError, m_device
+                     ? QCanBusReplayer::tr("Cannot write frame: %1").arg(m_device->errorString())
+                     : QCanBusReplayer::tr("No device to replay to."));
+            q->stop();
+            return;
+        }
+
+        const qint64 error = (now - due) / 1000;
+        ++m_framesReplayed;
+        m_totalTimingError += error;
+        m_maximumTimingError = qMax(m_maximumTimingError, error);
+
+        // Writing may have stopped the replay through a signal of the device.
+        if (m_state != QCanBusReplayer::RunningState)
+            return;
+    }
+
+    scheduleNext();
+}
+
+QT_END_NAMESPACE
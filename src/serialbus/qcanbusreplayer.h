@@ -0,0 +1,76 @@
+// Copyright (C) 2023 The Qt Company Ltd.
+// SPDX-License-Identifier: LicenseRef-Qt-Commercial OR LGPL-3.0-only OR GPL-2.0-only OR GPL-3.0-only
+
+#ifndef QCANBUSREPLAYER_H
+#define QCANBUSREPLAYER_H
+
+#include <QtCore/qlist.h>
+#include <QtCore/qobject.h>
+#include <QtSerialBus/qcanbusframe.h>
+#include <QtSerialBus/qtserialbusglobal.h>
+
+QT_BEGIN_NAMESPACE
+
+class QCanBusDevice;
+class QCanBusReplayerPrivate;
+
+class Q_SERIALBUS_EXPORT QCanBusReplayer : public QObject
+{
+    Q_OBJECT
+    Q_DECLARE_PRIVATE(QCanBusReplayer)
+
+public:
+    enum ReplayerError {
+        NoError,
+        ReadError,
+        FormatError,
+        WriteError
+    };
+    Q_ENUM(ReplayerError)
+
+    enum ReplayerState {
+        StoppedState,
+        RunningState
+    };
+    Q_ENUM(ReplayerState)
+
+    explicit QCanBusReplayer(QObject *parent = nullptr);
+    ~QCanBusReplayer() override;
+
+    bool load(const QString &fileName);
+    void setFrames(const QList<QCanBusFrame> &frames);
+    QList<QCanBusFrame> frames() const;
+
+    QCanBusDevice *device() const;
+    void setDevice(QCanBusDevice *device);
+
+    double speed() const;
+    void setSpeed(double factor);
+
+    bool isLooping() const;
+    void setLooping(bool looping);
+
+    ReplayerState state() const;
+    ReplayerError error() const;
+    QString errorString() const;
+
+    qint64 framesReplayed() const;
+    qint64 averageTimingError() const;
+    qint64 maximumTimingError() const;
+
+public Q_SLOTS:
+    void start();
+    void stop();
+
+Q_SIGNALS:
+    void stateChanged(QCanBusReplayer::ReplayerState state);
+    void errorOccurred(QCanBusReplayer::ReplayerError error);
+    void finished();
+
+private:
+    Q_DISABLE_COPY_MOVE(QCanBusReplayer)
+};
+
+QT_END_NAMESPACE
+
+#endif // QCANBUSREPLAYER_H
@@ -0,0 +1,70 @@
+// Copyright (C) 2023 The Qt Company Ltd.
+// SPDX-License-Identifier: LicenseRef-Qt-Commercial OR LGPL-3.0-only OR GPL-2.0-only OR GPL-3.0-only
+
+#ifndef QCANBUSREPLAYER_P_H
+#define QCANBUSREPLAYER_P_H
+
+#include <QtCore/qelapsedtimer.h>
+#include <QtCore/qpointer.h>
+#include <QtSerialBus/qcanbusdevice.h>
+#include <QtSerialBus/qcanbusreplayer.h>
+
+#include <private/qobject_p.h>
+
+#include <vector>
+
+//
+//  W A R N I N G
+//  -------------
+//
+// This file is not part of the Qt API. It exists purely as an
+// implementation detail. This header file may change from version to
+// version without notice, or even be removed.
+//
+// We mean it.
+//
+
+QT_BEGIN_NAMESPACE
+
+class QTimer;
+
+class QCanBusReplayerPrivate : public QObjectPrivate
+{
+    Q_DECLARE_PUBLIC(QCanBusReplayer)
+
+public:
+    void setupTimer();
+    void setError(QCanBusReplayer::ReplayerError error, const QString &errorText);
+    void setState(QCanBusReplayer::ReplayerState state);
+
+    void buildSchedule();
+    qint64 dueTime(qsizetype index) const { return m_loopOffset + m_schedule[size_t(index)]; }
+    void scheduleNext();
+    void replayDueFrames();
+
+    QList<QCanBusFrame> m_frames;
+    QPointer<QCanBusDevice> m_device;
+    double m_speed = 1.0;
+    bool m_looping = false;
+
+    QCanBusReplayer::ReplayerState m_state = QCanBusReplayer::StoppedState;
+    QCanBusReplayer::ReplayerError m_error = QCanBusReplayer::NoError;
+    QString m_errorString;
+
+    // Due times of the frames in nanoseconds since the start of the replay, computed once
+    // per start() from the time stamps of the frames.
+    std::vector<qint64> m_schedule;
+    qint64 m_loopPeriod = 0;
+    qint64 m_loopOffset = 0;
+    qsizetype m_next = 0;
+    QElapsedTimer m_clock;
+    QTimer *m_timer = nullptr;
+
+    qint64 m_framesReplayed = 0;
+    qint64 m_totalTimingError = 0;
+    qint64 m_maximumTimingError = 0;
+};
+
+QT_END_NAMESPACE
+
+#endif // QCANBUSREPLAYER_P_H
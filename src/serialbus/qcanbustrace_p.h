@@ -0,0 +1,200 @@
+// Copyright (C) 2023 The Qt Company Ltd.
+// SPDX-License-Identifier: LicenseRef-Qt-Commercial OR LGPL-3.0-only OR GPL-2.0-only OR GPL-3.0-only
+
+#ifndef QCANBUSTRACE_P_H
+#define QCANBUSTRACE_P_H
+
+#include "qcanbuslog_p.h"
+
+#include <QtCore/qendian.h>
+#include <QtSerialBus/qcanbusframe.h>
+
+#include <cstring>
+
+//
+//  W A R N I N G
+//  -------------
+//
+// This file is not part of the Qt API. It exists purely as an
+// implementation detail. This header file may change from version to
+// version without notice, or even be removed.
+//
+// We mean it.
+//
+
+QT_BEGIN_NAMESPACE
+
+/*
+    The indexed trace format of QCanBusTraceWriter and QCanBusTraceReader.
+
+    The file starts with a header of FileHeaderSize bytes: the eight
+    characters of FileMagic, the format Version and the block size as
+    little-endian quint32, and reserved bytes. Blocks of the block size
+    follow; block n starts at FileHeaderSize + n * block size. A block begins
+    with a header of BlockHeaderSize bytes, all numbers in little-endian:
+
+        quint32  BlockMagic
+        quint32  number of frames
+        qint64   smallest time stamp in microseconds
+        qint64   largest time stamp in microseconds
+        quint32  bytes used by the block, including this header
+        quint32  reserved
+        2048 bit identifier bitmap, see identifierBit()
+
+    The frame records follow, each RecordHeaderSize bytes and the payload:
+
+        qint64   time stamp in microseconds
+        quint32  frame identifier, or the error classes of an error frame
+        quint8   QCanBusFrame::FrameType
+        quint8   flags, see QCanBusLog::Flag
+        quint8   payload size
+        quint8   channel
+        payload
+
+    The last block may be shorter than the block size on disk, and is
+    rewritten in place while it fills.
+*/
+namespace QCanBusTrace {
+
+inline constexpr char FileMagic[8] = { 'Q', 't', 'C', 'a', 'n', 'T', 'r', 'c' };
+inline constexpr quint32 Version = 1;
+inline constexpr int FileHeaderSize = 32;
+inline constexpr quint32 BlockMagic = 0x42544351; // "QCTB"
+inline constexpr int BitmapBits = 2048;
+inline constexpr int BitmapOffset = 32;
+inline constexpr int BlockHeaderSize = BitmapOffset + BitmapBits / 8;
+inline constexpr int RecordHeaderSize = 16;
+inline constexpr int MaximumRecordSize = RecordHeaderSize + 64;
+inline constexpr int MinimumBlockSize = 4096;
+inline constexpr int DefaultBlockSize = 64 * 1024;
+
+// Standard identifiers have a bit of their own, extended ones share a hashed bit with others.
+inline constexpr int identifierBit(quint32 frameId) noexcept
+{
+    if (frameId < quint32(BitmapBits))
+        return int(frameId);
+    return int(((frameId * 0x9E3779B1U) >> 21) & (BitmapBits - 1));
+}
+
+inline bool testIdentifierBit(const uchar *block, quint32 frameId) noexcept
+{
+    const int bit = identifierBit(frameId);
+    return block[BitmapOffset + bit / 8] & (1 << (bit % 8));
+}
+
+inline void setIdentifierBit(uchar *block, quint32 frameId) noexcept
+{
+    const int bit = identifierBit(frameId);
+    block[BitmapOffset + bit / 8] |= uchar(1 << (bit % 8));
+}
+
+struct BlockHeader
+{
+    quint32 frameCount = 0;
+    qint64 firstTimeStamp = 0;
+    qint64 lastTimeStamp = 0;
+    quint32 usedBytes = BlockHeaderSize;
+};
+
+inline void writeBlockHeader(uchar *block, const BlockHeader &header) noexcept
+{
+    qToLittleEndian<quint32>(BlockMagic, block);
+    qToLittleEndian<quint32>(header.frameCount, block + 4);
+    qToLittleEndian<qint64>(header.firstTimeStamp, block + 8);
+    qToLittleEndian<qint64>(header.lastTimeStamp, block + 16);
+    qToLittleEndian<quint32>(header.usedBytes, block + 24);
+    qToLittleEndian<quint32>(0, block + 28);
+}
+
+inline bool readBlockHeader(const uchar *block, BlockHeader *header) noexcept
+{
+    if (qFromLittleEndian<quint32>(block) != BlockMagic)
+        return false;
+    header->frameCount = qFromLittleEndian<quint32>(block + 4);
+    header->firstTimeStamp = qFromLittleEndian<qint64>(block + 8);
+    header->lastTimeStamp = qFromLittleEndian<qint64>(block + 16);
+    header->usedBytes = qFromLittleEndian<quint32>(block + 24);
+    return true;
+}
+
+inline int recordSize(const uchar *record) noexcept
+{
+    return RecordHeaderSize + record[14];
+}
+
+inline qint64 recordTimeStamp(const uchar *record) noexcept
+{
+    return qFromLittleEndian<qint64>(record);
+}
+
+// The identifier a filter compares, or -1 for error frames.
+inline qint64 recordFrameId(const uchar *record) noexcept
+{
+    if (record[12] == QCanBusFrame::ErrorFrame)
+        return -1;
+    return qFromLittleEndian<quint32>(record + 8);
+}
+
+inline int recordChannel(const uchar *record) noexcept
+{
+    return record[15];
+}
+
+// Writes the record of frame to out, which has room for MaximumRecordSize bytes.
+// Returns the size of the record.
+inline int writeRecord(uchar *out, const QCanBusFrame &frame, int channel)
+{
+    const QByteArray payload = frame.payload();
+    const int size = int(qMin<qsizetype>(payload.size(), 64));
+
+    quint8 flags = 0;
+    if (frame.hasExtendedFrameFormat())
+        flags |= QCanBusLog::ExtendedFrameFormat;
+    if (frame.hasFlexibleDataRateFormat())
+        flags |= QCanBusLog::FlexibleDataRate;
+    if (frame.hasBitrateSwitch())
+        flags |= QCanBusLog::BitrateSwitch;
+    if (frame.hasErrorStateIndicator())
+        flags |= QCanBusLog::ErrorStateIndicator;
+    if (frame.hasLocalEcho())
+        flags |= QCanBusLog::LocalEcho;
+
+    const quint32 id = frame.frameType() == QCanBusFrame::ErrorFrame
+        ? quint32(frame.error().toInt()) : frame.frameId();
+
+    qToLittleEndian<qint64>(QCanBusLog::timeStampMicroseconds(frame), out);
+    qToLittleEndian<quint32>(id, out + 8);
+    out[12] = uchar(frame.frameType());
+    out[13] = flags;
+    out[14] = uchar(size);
+    out[15] = uchar(channel);
+    std::memcpy(out + RecordHeaderSize, payload.constData(), size_t(size));
+    return RecordHeaderSize + size;
+}
+
+inline QCanBusFrame readRecord(const uchar *record)
+{
+    const quint32 id = qFromLittleEndian<quint32>(record + 8);
+    const quint8 flags = record[13];
+
+    QCanBusFrame frame(QCanBusFrame::FrameType(record[12]));
+    if (frame.frameType() == QCanBusFrame::ErrorFrame)
+        frame.setError(QCanBusFrame::FrameErrors::fromInt(id));
+    else
+        frame.setFrameId(id);
+    frame.setExtendedFrameFormat(flags & QCanBusLog::ExtendedFrameFormat);
+    frame.setFlexibleDataRateFormat(flags & QCanBusLog::FlexibleDataRate);
+    frame.setBitrateSwitch(flags & QCanBusLog::BitrateSwitch);
+    frame.setErrorStateIndicator(flags & QCanBusLog::ErrorStateIndicator);
+    frame.setLocalEcho(flags & QCanBusLog::LocalEcho);
+    frame.setPayload(QByteArray(reinterpret_cast<const char *>(record) + RecordHeaderSize,
+                                record[14]));
+    frame.setTimeStamp(QCanBusFrame::TimeStamp::fromMicroSeconds(recordTimeStamp(record)));
+    return frame;
+}
+
+} // namespace QCanBusTrace
+
+QT_END_NAMESPACE
+
+#endif // QCANBUSTRACE_P_H
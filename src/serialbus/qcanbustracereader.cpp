@@ -0,0 +1,307 @@
+// Copyright (C) 2023 The Qt Company Ltd.
+// SPDX-License-Identifier: LicenseRef-Qt-Commercial OR LGPL-3.0-only OR GPL-2.0-only OR GPL-3.0-only
+
+#include "qcanbustracereader.h"
+#include "qcanbustracereader_p.h"
+
+#include <QtCore/qloggingcategory.h>
+
+#include <algorithm>
+
+QT_BEGIN_NAMESPACE
+
+Q_DECLARE_LOGGING_CATEGORY(QT_CANBUS)
+
+/*!
+    \class QCanBusTraceReader
+    \inmodule QtSerialBus
+    \since 6.7
+
+    \brief The QCanBusTraceReader class gives random access to the frames of
+    a trace file written by QCanBusTraceWriter.
+
+    The reader maps the trace file into memory. open() reads only the headers
+    of the blocks, which hold the time range of their frames and a bitmap of
+    their identifiers. Queries use this index: frames() and forEachFrame()
+    decode only the blocks that can contain frames of the requested time
+    window and identifiers, and frameAt() decodes only the block containing
+    the requested frame.
+
+    All time stamps are in microseconds, as returned by
+    \l {QCanBusFrame::TimeStamp::}{fromMicroSeconds()}. A trace that is still
+    being written can be opened; it shows the frames written until then.
+*/
+
+/*!
+    \typealias QCanBusTraceReader::FrameHandler
+
+    The type of the function called by forEachFrame() for every frame found,
+    with the frame and its channel. Returning \c false stops the iteration.
+*/
+
+/*!
+    Constructs a trace reader.
+*/
+QCanBusTraceReader::QCanBusTraceReader()
+    : d(std::make_unique<QCanBusTraceReaderPrivate>())
+{
+}
+
+/*!
+    Destroys the reader, closing the trace file.
+*/
+QCanBusTraceReader::~QCanBusTraceReader()
+{
+    close();
+}
+
+/*!
+    Opens the trace file \a fileName and reads its index. Returns \c true on
+    success; otherwise \c false, and errorString() describes the problem.
+
+    \sa close()
+*/
+bool QCanBusTraceReader::open(const QString &fileName)
+{
+    close();
+    d->m_errorString.clear();
+
+    d->m_file.setFileName(fileName);
+    if (!d->m_file.open(QIODevice::ReadOnly)) {
+        return d->setError(tr("Cannot open trace file '%1': %2")
+                           .arg(fileName, d->m_file.errorString()));
+    }
+
+    const qint64 size = d->m_file.size();
+    if (size < QCanBusTrace::FileHeaderSize
+        || !(d->m_map = d->m_file.map(0, size))) {
+        d->setError(tr("Cannot map trace file '%1'.").arg(fileName));
+        close();
+        return false;
+    }
+
+    const uchar *map = d->m_map;
+    const quint32 blockSize = qFromLittleEndian<quint32>(map + 12);
+    if (std::memcmp(map, QCanBusTrace::FileMagic, sizeof(QCanBusTrace::FileMagic)) != 0
+        || qFromLittleEndian<quint32>(map + 8) != QCanBusTrace::Version
+        || blockSize < quint32(QCanBusTrace::MinimumBlockSize)) {
+        d->setError(tr("'%1' is not a CAN bus trace file.").arg(fileName));
+        close();
+        return false;
+    }
+
+    // Only the block headers are read here, the pages of the records stay untouched.
+    for (qint64 offset = QCanBusTrace::FileHeaderSize;
+         offset + QCanBusTrace::BlockHeaderSize <= size; offset += blockSize) {
+        QCanBusTraceReaderPrivate::Block block;
+        block.data = map + offset;
+        if (!QCanBusTrace::readBlockHeader(block.data, &block.header))
+            break; // a block the writer has not written yet
+        if (block.header.usedBytes > blockSize
+            || block.header.usedBytes < quint32(QCanBusTrace::BlockHeaderSize)
+            || offset + block.header.usedBytes > size) {
+            d->setError(tr("Corrupt block at offset %1 of trace file '%2'.")
+                        .arg(offset).arg(fileName));
+            close();
+            return false;
+        }
+        if (block.header.frameCount == 0)
+            continue;
+
+        block.firstFrame = d->m_frameCount;
+        d->m_frameCount += block.header.frameCount;
+        if (d->m_blocks.empty()) {
+            d->m_startTime = block.header.firstTimeStamp;
+            d->m_endTime = block.header.lastTimeStamp;
+        } else {
+            d->m_startTime = qMin(d->m_startTime, block.header.firstTimeStamp);
+            d->m_endTime = qMax(d->m_endTime, block.header.lastTimeStamp);
+        }
+        d->m_blocks.push_back(block);
+    }
+
+    qCDebug(QT_CANBUS, "Opened trace '%ls' with %lld frames in %lld blocks.",
+            qUtf16Printable(fileName), d->m_frameCount, qlonglong(d->m_blocks.size()));
+    return true;
+}
+
+/*!
+    Closes the trace file.
+*/
+void QCanBusTraceReader::close()
+{
+    if (d->m_map)
+        d->m_file.unmap(const_cast<uchar *>(d->m_map));
+    d->m_map = nullptr;
+    d->m_file.close();
+    d->m_blocks.clear();
+    d->m_frameCount = 0;
+    d->m_startTime = 0;
+    d->m_endTime = 0;
+}
+
+/*!
+    Returns \c true if a trace file is open; otherwise \c false.
+*/
+bool QCanBusTraceReader::isOpen() const
+{
+    return d->m_map != nullptr;
+}
+
+/*!
+    Returns a human-readable description of the last error that occurred.
+*/
+QString QCanBusTraceReader::errorString() const
+{
+    return d->m_errorString;
+}
+
+/*!
+    Returns the number of frames in the trace.
+*/
+qint64 QCanBusTraceReader::frameCount() const
+{
+    return d->m_frameCount;
+}
+
+/*!
+    Returns the number of blocks holding frames in the trace.
+*/
+qint64 QCanBusTraceReader::blockCount() const
+{
+    return qint64(d->m_blocks.size());
+}
+
+/*!
+    Returns the smallest time stamp of the frames in the trace, in
+    microseconds.
+
+    \sa endTime()
+*/
+qint64 QCanBusTraceReader::startTime() const
+{
+    return d->m_startTime;
+}
+
+/*!
+    Returns the largest time stamp of the frames in the trace, in
+    microseconds.
+
+    \sa startTime()
+*/
+qint64 QCanBusTraceReader::endTime() const
+{
+    return d->m_endTime;
+}
+
+/*!
+    Returns the frame at position \a index of the trace, in the order the
+    frames were written. If \a channel is not \c nullptr, it is set to the
+    channel of the frame. Returns an invalid frame if \a index is out of
+    range.
+*/
+QCanBusFrame QCanBusTraceReader::frameAt(qint64 index, int *channel) const
+{
+    if (index < 0 || index >= d->m_frameCount)
+        return QCanBusFrame(QCanBusFrame::InvalidFrame);
+
+    const auto block = std::prev(std::upper_bound(d->m_blocks.cbegin(), d->m_blocks.cend(),
+            index, [](qint64 value, const QCanBusTraceReaderPrivate::Block &b) {
+        return value < b.firstFrame;
+    }));
+
+    const uchar *record = block->data + QCanBusTrace::BlockHeaderSize;
+    const uchar *end = block->data + block->header.usedBytes;
+    for (qint64 i = block->firstFrame; i < index && record < end; ++i)
+        record += QCanBusTrace::recordSize(record);
+    if (record + QCanBusTrace::RecordHeaderSize > end
+        || record + QCanBusTrace::recordSize(record) > end) {
+        return QCanBusFrame(QCanBusFrame::InvalidFrame); // truncated
+    }
+    if (channel)
+        *channel = QCanBusTrace::recordChannel(record);
+    return QCanBusTrace::readRecord(record);
+}
+
+/*!
+    Returns the frames with a time stamp from \a from up to, but excluding,
+    \a to, in the order they were written. If \a frameIds is not empty, only
+    the frames with one of these identifiers are returned; error frames are
+    then excluded.
+
+    \sa forEachFrame()
+*/
+QList<QCanBusFrame> QCanBusTraceReader::frames(qint64 from, qint64 to,
+                                               const QList<QCanBusFrame::FrameId> &frameIds) const
+{
+    QList<QCanBusFrame> result;
+    forEachFrame(from, to, frameIds, [&result](const QCanBusFrame &frame, int) {
+        result.append(frame);
+        return true;
+    });
+    return result;
+}
+
+/*!
+    Calls \a handler for each frame with a time stamp from \a from up to, but
+    excluding, \a to, in the order the frames were written, until \a handler
+    returns \c false. If \a frameIds is not empty, only the frames with one of
+    these identifiers are passed; error frames are then excluded. Returns the
+    number of frames passed to \a handler.
+
+    \sa frames()
+*/
+qint64 QCanBusTraceReader::forEachFrame(qint64 from, qint64 to,
+                                        const QList<QCanBusFrame::FrameId> &frameIds,
+                                        const FrameHandler &handler) const
+{
+    qint64 count = 0;
+    for (const QCanBusTraceReaderPrivate::Block &block : d->m_blocks) {
+        if (!d->blockMatches(block, from, to, frameIds))
+            continue;
+
+        const uchar *record = block.data + QCanBusTrace::BlockHeaderSize;
+        const uchar *end = block.data + block.header.usedBytes;
+        for (quint32 i = 0; i < block.header.frameCount
+                            && record + QCanBusTrace::RecordHeaderSize <= end; ++i) {
+            const uchar *current = record;
+            record += QCanBusTrace::recordSize(record);
+            if (record > end)
+                break; // truncated
+
+            const qint64 stamp = QCanBusTrace::recordTimeStamp(current);
+            if (stamp < from || stamp >= to)
+                continue;
+            if (!frameIds.isEmpty()) {
+                const qint64 id = QCanBusTrace::recordFrameId(current);
+                if (id < 0 || !frameIds.contains(QCanBusFrame::FrameId(id)))
+                    continue;
+            }
+            ++count;
+            if (!handler(QCanBusTrace::readRecord(current), QCanBusTrace::recordChannel(current)))
+                return count;
+        }
+    }
+    return count;
+}
+
+bool QCanBusTraceReaderPrivate::setError(const QString &errorText)
+{
+    m_errorString = errorText;
+    qCWarning(QT_CANBUS, "%ls", qUtf16Printable(errorText));
+    return false;
+}
+
+bool QCanBusTraceReaderPrivate::blockMatches(const Block &block, qint64 from, qint64 to,
+                                             const QList<QCanBusFrame::FrameId> &frameIds) const
+{
+    if (block.header.lastTimeStamp < from || block.header.firstTimeStamp >= to)
+        return false;
+    if (frameIds.isEmpty())
+        return true;
+    return std::any_of(frameIds.cbegin(), frameIds.cend(), [&block](QCanBusFrame::FrameId id) {
+        return QCanBusTrace::testIdentifierBit(block.data, id);
+    });
+}
+
+QT_END_NAMESPACE
@@ -0,0 +1,53 @@
+// Copyright (C) 2023 The Qt Company Ltd.
+// SPDX-License-Identifier: LicenseRef-Qt-Commercial OR LGPL-3.0-only OR GPL-2.0-only OR GPL-3.0-only
+
+#ifndef QCANBUSTRACEREADER_H
+#define QCANBUSTRACEREADER_H
+
+#include <QtCore/qcoreapplication.h>
+#include <QtCore/qlist.h>
+#include <QtSerialBus/qcanbusframe.h>
+#include <QtSerialBus/qtserialbusglobal.h>
+
+#include <functional>
+#include <memory>
+
+QT_BEGIN_NAMESPACE
+
+class QCanBusTraceReaderPrivate;
+
+class Q_SERIALBUS_EXPORT QCanBusTraceReader
+{
+    Q_DECLARE_TR_FUNCTIONS(QCanBusTraceReader)
+
+public:
+    using FrameHandler = std::function<bool(const QCanBusFrame &frame, int channel)>;
+
+    QCanBusTraceReader();
+    ~QCanBusTraceReader();
+
+    bool open(const QString &fileName);
+    void close();
+    bool isOpen() const;
+    QString errorString() const;
+
+    qint64 frameCount() const;
+    qint64 blockCount() const;
+    qint64 startTime() const;
+    qint64 endTime() const;
+
+    QCanBusFrame frameAt(qint64 index, int *channel = nullptr) const;
+    QList<QCanBusFrame> frames(qint64 from, qint64 to,
+                               const QList<QCanBusFrame::FrameId> &frameIds = {}) const;
+    qint64 forEachFrame(qint64 from, qint64 to, const QList<QCanBusFrame::FrameId> &frameIds,
+                        const FrameHandler &handler) const;
+
+private:
+    std::unique_ptr<QCanBusTraceReaderPrivate> d;
+
+    Q_DISABLE_COPY_MOVE(QCanBusTraceReader)
+};
+
+QT_END_NAMESPACE
+
+#endif // QCANBUSTRACEREADER_H
@@ -0,0 +1,52 @@
+// Copyright (C) 2023 The Qt Company Ltd.
+// SPDX-License-Identifier: LicenseRef-Qt-Commercial OR LGPL-3.0-only OR GPL-2.0-only OR GPL-3.0-only
+
+#ifndef QCANBUSTRACEREADER_P_H
+#define QCANBUSTRACEREADER_P_H
+
+//
+//  W A R N I N G
+//  -------------
+//
+// This file is not part of the Qt API. It exists purely as an
+// implementation detail. This header file may change from version to
+// version without notice, or even be removed.
+//
+// We mean it.
+//
+
+#include "qcanbustrace_p.h"
+#include "qcanbustracereader.h"
+
+#include <QtCore/qfile.h>
+
+#include <vector>
+
+QT_BEGIN_NAMESPACE
+
+class QCanBusTraceReaderPrivate
+{
+public:
+    struct Block
+    {
+        const uchar *data = nullptr;
+        QCanBusTrace::BlockHeader header;
+        qint64 firstFrame = 0; // index of the first frame of the block in the trace
+    };
+
+    bool setError(const QString &errorText);
+    bool blockMatches(const Block &block, qint64 from, qint64 to,
+                      const QList<QCanBusFrame::FrameId> &frameIds) const;
+
+    QFile m_file;
+    const uchar *m_map = nullptr;
+    QString m_errorString;
+    std::vector<Block> m_blocks;
+    qint64 m_frameCount = 0;
+    qint64 m_startTime = 0;
+    qint64 m_endTime = 0;
+};
+
+QT_END_NAMESPACE
+
+#endif // QCANBUSTRACEREADER_P_H
@@ -0,0 +1,311 @@
+// Copyright (C) 2023 The Qt Company Ltd.
+// SPDX-License-Identifier: LicenseRef-Qt-Commercial OR LGPL-3.0-only OR GPL-2.0-only OR GPL-3.0-only
+
+#include "qcanbustracewriter.h"
+#include "qcanbustracewriter_p.h"
+
+#include <QtCore/qloggingcategory.h>
+#include <QtCore/qtimer.h>
+
+QT_BEGIN_NAMESPACE
+
+Q_DECLARE_LOGGING_CATEGORY(QT_CANBUS)
+
+/*!
+    \class QCanBusTraceWriter
+    \inmodule QtSerialBus
+    \since 6.7
+
+    \brief The QCanBusTraceWriter class records CAN bus frames to an indexed
+    trace file.
+
+    Trace files keep long recordings of one or more CAN buses searchable.
+    The frames are stored in blocks of a fixed size, blockSize(); every block
+    records the time range of its frames and a bitmap of their identifiers.
+    QCanBusTraceReader uses this index to find a time window or the frames of
+    some identifiers without decoding unrelated blocks.
+
+    Frames are appended with writeFrame() or writeFrames(), typically from a
+    slot connected to \l {QCanBusDevice::}{framesReceived()}:
+
+    \code
+        connect(device, &QCanBusDevice::framesReceived, writer, [device, writer]() {
+            writer->writeFrames(device->readAllFrames());
+        });
+    \endcode
+
+    Each frame is tagged with a channel number from \c 0 to \c 255, which lets
+    one trace hold the traffic of several buses. The frames of a block are
+    collected in memory and written when the block is full, but no later than
+    maximumLatency() after a frame was appended, and on flush() and close().
+    A block written early is completed in place, so latency bounds do not
+    waste space in the file. The writer needs a running event loop for the
+    latency bound.
+*/
+
+/*!
+    Constructs a trace writer with the specified \a parent.
+*/
+QCanBusTraceWriter::QCanBusTraceWriter(QObject *parent)
+    : QObject(*new QCanBusTraceWriterPrivate, parent)
+{
+    Q_D(QCanBusTraceWriter);
+    d->setupTimer();
+}
+
+/*!
+    Destroys the writer, closing the trace file.
+*/
+QCanBusTraceWriter::~QCanBusTraceWriter()
+{
+    close();
+}
+
+/*!
+    Creates the trace file \a fileName, replacing an existing file. Returns
+    \c true on success; otherwise \c false, and errorString() describes the
+    problem.
+
+    \sa close()
+*/
+bool QCanBusTraceWriter::open(const QString &fileName)
+{
+    Q_D(QCanBusTraceWriter);
+    close();
+    d->m_errorString.clear();
+
+    d->m_file.setFileName(fileName);
+    if (!d->m_file.open(QIODevice::ReadWrite | QIODevice::Truncate))
+        return d->setError(tr("Cannot open trace file '%1': %2").arg(fileName,
+                                                                       d->m_file.errorString()));
+
+    char header[QCanBusTrace::FileHeaderSize] = {};
+    std::memcpy(header, QCanBusTrace::FileMagic, sizeof(QCanBusTrace::FileMagic));
+    qToLittleEndian<quint32>(QCanBusTrace::Version, header + 8);
+    qToLittleEndian<quint32>(quint32(d->m_blockSize), header + 12);
+    if (d->m_file.write(header, sizeof(header)) != qint64(sizeof(header))
+        || !d->m_file.flush()) {
+        d->setError(tr("Cannot write trace file '%1': %2").arg(fileName,
+                                                                d->m_file.errorString()));
+        d->m_file.close();
+        return false;
+    }
+
+    d->m_blockIndex = 0;
+    d->resetBlock();
+    return true;
+}
+
+/*!
+    Writes the frames collected and closes the trace file.
+
+    \sa open()
+*/
+void QCanBusTraceWriter::close()
+{
+    Q_D(QCanBusTraceWriter);
+    if (!d->m_file.isOpen())
+        return;
+    d->writeBlock();
+    d->m_timer->stop();
+    d->m_file.close();
+}
+
+/*!
+    Returns \c true if a trace file is open; otherwise \c false.
+*/
+bool QCanBusTraceWriter::isOpen() const
+{
+    Q_D(const QCanBusTraceWriter);
+    return d->m_file.isOpen();
+}
+
+/*!
+    Returns a human-readable description of the last error that occurred.
+*/
+QString QCanBusTraceWriter::errorString() const
+{
+    Q_D(const QCanBusTraceWriter);
+    return d->m_errorString;
+}
+
+/*!
+    Returns the size of the blocks of the trace in bytes. The default is
+    64 KiB.
+
+    \sa setBlockSize()
+*/
+int QCanBusTraceWriter::blockSize() const
+{
+    Q_D(const QCanBusTraceWriter);
+    return d->m_blockSize;
+}
+
+/*!
+    Sets the size of the blocks of the trace to \a bytes, at least 4 KiB.
+    Smaller blocks make queries more selective, larger blocks make the index
+    smaller. Applies to the next open().
+
+    \sa blockSize()
+*/
+void QCanBusTraceWriter::setBlockSize(int bytes)
+{
+    Q_D(QCanBusTraceWriter);
+    d->m_blockSize = qMax(bytes, QCanBusTrace::MinimumBlockSize);
+}
+
+/*!
+    Returns the longest time in milliseconds a frame stays in memory before
+    it is written to the file. The default is \c 1000.
+
+    \sa setMaximumLatency()
+*/
+int QCanBusTraceWriter::maximumLatency() const
+{
+    Q_D(const QCanBusTraceWriter);
+    return d->m_maximumLatency;
+}
+
+/*!
+    Sets the longest time a frame stays in memory before it is written to the
+    file to \a msec milliseconds. With \c 0, every call of writeFrame() and
+    writeFrames() writes to the file.
+
+    \sa maximumLatency(), flush()
+*/
+void QCanBusTraceWriter::setMaximumLatency(int msec)
+{
+    Q_D(QCanBusTraceWriter);
+    d->m_maximumLatency = qMax(0, msec);
+}
+
+/*!
+    Appends \a frame with the given \a channel to the trace. Returns \c false
+    if the trace file is not open or cannot be written.
+
+    \sa writeFrames()
+*/
+bool QCanBusTraceWriter::writeFrame(const QCanBusFrame &frame, int channel)
+{
+    Q_D(QCanBusTraceWriter);
+    if (!d->appendRecord(frame, channel))
+        return false;
+    return d->m_maximumLatency > 0 || d->writeBlock();
+}
+
+/*!
+    Appends \a frames with the given \a channel to the trace. Returns
+    \c false if the trace file is not open or cannot be written.
+
+    \sa writeFrame()
+*/
+bool QCanBusTraceWriter::writeFrames(const QList<QCanBusFrame> &frames, int channel)
+{
+    Q_D(QCanBusTraceWriter);
+    for (const QCanBusFrame &frame : frames) {
+        if (!d->appendRecord(frame, channel))
+            return false;
+    }
+    return d->m_maximumLatency > 0 || d->writeBlock();
+}
+
+/*!
+    Writes all frames collected to the file. Returns \c false if the trace
+    file is not open or cannot be written.
+*/
+bool QCanBusTraceWriter::flush()
+{
+    Q_D(QCanBusTraceWriter);
+    if (!d->m_file.isOpen())
+        return false;
+    return d->writeBlock();
+}
+
+void QCanBusTraceWriterPrivate::setupTimer()
+{
+    Q_Q(QCanBusTraceWriter);
+
+    m_timer = new QTimer(q);
+    m_timer->setSingleShot(true);
+    QObject::connect(m_timer, &QTimer::timeout, q, [this]() { writeBlock(); });
+}
+
+void QCanBusTraceWriterPrivate::resetBlock()
+{
+    m_block.fill(0, m_blockSize);
+    m_header = QCanBusTrace::BlockHeader();
+    m_writtenBytes = 0;
+}
+
+bool QCanBusTraceWriterPrivate::appendRecord(const QCanBusFrame &frame, int channel)
+{
+    if (!m_file.isOpen())
+        return setError(QCanBusTraceWriter::tr("The trace file is not open."));
+    if (channel < 0 || channel > 255)
+        return setError(QCanBusTraceWriter::tr("Invalid channel %1.").arg(channel));
+
+    const qsizetype needed = QCanBusTrace::RecordHeaderSize
+            + qMin<qsizetype>(frame.payload().size(), 64);
+    if (m_header.usedBytes + needed > m_blockSize) {
+        if (!writeBlock())
+            return false;
+        ++m_blockIndex;
+        resetBlock();
+    }
+
+    uchar *block = reinterpret_cast<uchar *>(m_block.data());
+    const int size = QCanBusTrace::writeRecord(block + m_header.usedBytes, frame, channel);
+    const qint64 stamp = QCanBusTrace::recordTimeStamp(block + m_header.usedBytes);
+    if (m_header.frameCount == 0) {
+        m_header.firstTimeStamp = stamp;
+        m_header.lastTimeStamp = stamp;
+    } else {
+        m_header.firstTimeStamp = qMin(m_header.firstTimeStamp, stamp);
+        m_header.lastTimeStamp = qMax(m_header.lastTimeStamp, stamp);
+    }
+    if (frame.frameType() != QCanBusFrame::ErrorFrame)
+        QCanBusTrace::setIdentifierBit(block, frame.frameId());
+    ++m_header.frameCount;
+    m_header.usedBytes += quint32(size);
+
+    if (m_maximumLatency > 0 && !m_timer->isActive())
+        m_timer->start(m_maximumLatency);
+    return true;
+}
+
+bool QCanBusTraceWriterPrivate::writeBlock()
+{
+    m_timer->stop();
+    if (m_header.frameCount == 0 || m_writtenBytes == m_header.usedBytes)
+        return true;
+
+    uchar *block = reinterpret_cast<uchar *>(m_block.data());
+    QCanBusTrace::writeBlockHeader(block, m_header);
+
+    // Write the new records before the header that counts them, so that the file is never
+    // ahead of itself.
+    const qint64 offset = QCanBusTrace::FileHeaderSize + m_blockIndex * m_blockSize;
+    const quint32 from = qMax<quint32>(m_writtenBytes, QCanBusTrace::BlockHeaderSize);
+    bool ok = m_file.seek(offset + from)
+            && m_file.write(m_block.constData() + from, m_header.usedBytes - from)
+                    == qint64(m_header.usedBytes - from)
+            && m_file.seek(offset)
+            && m_file.write(m_block.constData(), QCanBusTrace::BlockHeaderSize)
+                    == QCanBusTrace::BlockHeaderSize
+            && m_file.flush();
+    if (!ok) {
+        return setError(QCanBusTraceWriter::tr("Cannot write trace file '%1': %2")
+                        .arg(m_file.fileName(), m_file.errorString()));
+    }
+    m_writtenBytes = m_header.usedBytes;
+    return true;
+}
+
+bool QCanBusTraceWriterPrivate::setError(const QString &errorText)
+{
+    m_errorString = errorText;
+    qCWarning(QT_CANBUS, "%ls", qUtf16Printable(errorText));
+    return false;
+}
+
+QT_END_NAMESPACE
@@ -0,0 +1,46 @@
+// Copyright (C) 2023 The Qt Company Ltd.
+// SPDX-License-Identifier: LicenseRef-Qt-Commercial OR LGPL-3.0-only OR GPL-2.0-only OR GPL-3.0-only
+
+#ifndef QCANBUSTRACEWRITER_H
+#define QCANBUSTRACEWRITER_H
+
+#include <QtCore/qlist.h>
+#include <QtCore/qobject.h>
+#include <QtSerialBus/qcanbusframe.h>
+#include <QtSerialBus/qtserialbusglobal.h>
+
+QT_BEGIN_NAMESPACE
+
+class QCanBusTraceWriterPrivate;
+
+class Q_SERIALBUS_EXPORT QCanBusTraceWriter : public QObject
+{
+    Q_OBJECT
+    Q_DECLARE_PRIVATE(QCanBusTraceWriter)
+
+public:
+    explicit QCanBusTraceWriter(QObject *parent = nullptr);
+    ~QCanBusTraceWriter() override;
+
+    bool open(const QString &fileName);
+    void close();
+    bool isOpen() const;
+    QString errorString() const;
+
+    int blockSize() const;
+    void setBlockSize(int bytes);
+
+    int maximumLatency() const;
+    void setMaximumLatency(int msec);
+
+    bool writeFrame(const QCanBusFrame &frame, int channel = 0);
+    bool writeFrames(const QList<QCanBusFrame> &frames, int channel = 0);
+    bool flush();
+
+private:
+    Q_DISABLE_COPY_MOVE(QCanBusTraceWriter)
+};
+
+QT_END_NAMESPACE
+
+#endif // QCANBUSTRACEWRITER_H
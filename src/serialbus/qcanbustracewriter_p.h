@@ -0,0 +1,56 @@
+// Copyright (C) 2023 The Qt Company Ltd.
+// SPDX-License-Identifier: LicenseRef-Qt-Commercial OR LGPL-3.0-only OR GPL-2.0-only OR GPL-3.0-only
+
+#ifndef QCANBUSTRACEWRITER_P_H
+#define QCANBUSTRACEWRITER_P_H
+
+#include "qcanbustrace_p.h"
+
+#include <QtCore/qfile.h>
+#include <QtSerialBus/qcanbustracewriter.h>
+
+#include <private/qobject_p.h>
+
+//
+//  W A R N I N G
+//  -------------
+//
+// This file is not part of the Qt API. It exists purely as an
+// implementation detail. This header file may change from version to
+// version without notice, or even be removed.
+//
+// We mean it.
+//
+
+QT_BEGIN_NAMESPACE
+
+class QTimer;
+
+class QCanBusTraceWriterPrivate : public QObjectPrivate
+{
+    Q_DECLARE_PUBLIC(QCanBusTraceWriter)
+
+public:
+    void setupTimer();
+    void resetBlock();
+    bool appendRecord(const QCanBusFrame &frame, int channel);
+    bool writeBlock();
+    bool setError(const QString &errorText);
+
+    QFile m_file;
+    QString m_errorString;
+    int m_blockSize = QCanBusTrace::DefaultBlockSize;
+    int m_maximumLatency = 1000;
+    QTimer *m_timer = nullptr;
+
+    // The block being filled, written to the file when full, when its oldest unwritten frame
+    // is m_maximumLatency old, and on flush().
+    QByteArray m_block;
+    QCanBusTrace::BlockHeader m_header;
+    qint64 m_blockIndex = 0;
+    quint32 m_writtenBytes = 0; // bytes of m_block in the file already
+};
+
+QT_END_NAMESPACE
+
+#endif // QCANBUSTRACEWRITER_P_H
@@ -4,9 +4,12 @@
 #ifndef QMODBUSADU_P_H
 #define QMODBUSADU_P_H
 
+#include <QtCore/qendian.h>
 #include <QtSerialBus/qmodbuspdu.h>
 #include <QtCore/private/qglobal_p.h>
 
+#include <private/qmodbuspdubuffer_p.h>
+
 //
 //  W A R N I N G
 //  -------------
@@ -120,16 +123,18 @@ public:
 
     inline static QByteArray create(Type type, int serverAddress, const QModbusPdu &pdu,
                                     char delimiter = '\n') {
-        QByteArray result;
-        QDataStream out(&result, QIODevice::WriteOnly);
-        out << quint8(serverAddress) << pdu;
+        // server address + PDU + checksum, the checksum takes at most two bytes
+        const qsizetype size = 1 + pdu.size();
+        QByteArray result(size + (type == Ascii ? 1 : 2), Qt::Uninitialized);
+        char *out = result.data();
+        out[0] = char(serverAddress);
+        QModbusPduView(pdu).copyTo(out + 1);
 
         if (type == Ascii) {
-            out << calculateLRC(result, result.size());
+            out[size] = char(calculateLRC(out, qint32(size)));
             return ":" + result.toHex() + "\r" + delimiter;
-        } else {
-            out << calculateCRC(result, result.size());
         }
+        qToBigEndian<quint16>(calculateCRC(out, qint32(size)), out + size);
         return result;
     }
 
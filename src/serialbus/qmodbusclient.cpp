@@ -4,9 +4,14 @@
 #include "qmodbusclient.h"
 #include "qmodbusclient_p.h"
 #include "qmodbus_symbols_p.h"
+#include "qmodbuspdubuffer_p.h"
 
 #include <QtCore/qdebug.h>
 #include <QtCore/qloggingcategory.h>
+#include <QtCore/qmath.h>
+
+#include <algorithm>
+#include <utility>
 
 QT_BEGIN_NAMESPACE
 
@@ -106,6 +111,111 @@ QModbusReply *QModbusClient::sendRawRequest(const QModbusRequest &request, int s
     return d_func()->sendRequest(request, serverAddress, nullptr);
 }
 
+/*!
+    \typedef QModbusClient::ResultHandler
+    \since 6.7
+
+    Synonym for \c {std::function<void(const QModbusResult &)>}, the type of
+    the handlers passed to the request functions not returning a
+    QModbusReply.
+
+    The handler type is declared here rather than with QModbusResult, so
+    that the value class does not depend on \c {<functional>}.
+*/
+
+/*!
+    \since 6.7
+    \overload
+
+    Sends a request to read the contents of the data pointed by \a read to the
+    server with the address \a serverAddress. Once the request finished,
+    \a handler is called with its QModbusResult. Returns \c true if the
+    request was sent; otherwise \c false, and \a handler is never called.
+
+    Unlike sendReadRequest() returning a QModbusReply, no object is created
+    for the request, which makes this function suitable for sending many
+    requests per second. \a handler is called in the thread of the client,
+    unless \a context was destroyed before; pass \c nullptr as \a context if
+    the handler does not depend on an object. Once \a context is destroyed,
+    its requests are dropped instead of waiting for their timeout.
+
+    \code
+        client->sendReadRequest(QModbusDataUnit(QModbusDataUnit::HoldingRegisters, 0, 10), 1,
+                                this, [this](const QModbusResult &result) {
+            if (result.error() == QModbusDevice::NoError)
+                updateValues(result.result());
+        });
+    \endcode
+
+    \note The handler API is supported by QModbusTcpClient and
+    QModbusRtuSerialClient.
+*/
+bool QModbusClient::sendReadRequest(const QModbusDataUnit &read, int serverAddress,
+                                    const QObject *context, ResultHandler handler)
+{
+    Q_D(QModbusClient);
+    return d->sendRequest(d->createReadRequest(read), serverAddress, &read, context,
+                          std::move(handler));
+}
+
+/*!
+    \since 6.7
+    \overload
+
+    Sends a request to modify the contents of the data pointed by \a write on
+    the server with the address \a serverAddress. Once the request finished,
+    \a handler is called with its QModbusResult, unless \a context was
+    destroyed before. Returns \c true if the request was sent; otherwise
+    \c false.
+
+    \sa sendReadRequest()
+*/
+bool QModbusClient::sendWriteRequest(const QModbusDataUnit &write, int serverAddress,
+                                     const QObject *context, ResultHandler handler)
+{
+    Q_D(QModbusClient);
+    return d->sendRequest(d->createWriteRequest(write), serverAddress, &write, context,
+                          std::move(handler));
+}
+
+/*!
+    \since 6.7
+    \overload
+
+    Sends a request to read the contents of the data pointed by \a read and to
+    modify the contents of the data pointed by \a write on the server with the
+    address \a serverAddress. Once the request finished, \a handler is called
+    with its QModbusResult, unless \a context was destroyed before. Returns
+    \c true if the request was sent; otherwise \c false.
+
+    \sa sendReadRequest()
+*/
+bool QModbusClient::sendReadWriteRequest(const QModbusDataUnit &read, const QModbusDataUnit &write,
+                                         int serverAddress, const QObject *context,
+                                         ResultHandler handler)
+{
+    Q_D(QModbusClient);
+    return d->sendRequest(d->createRWRequest(read, write), serverAddress, &read, context,
+                          std::move(handler));
+}
+
+/*!
+    \since 6.7
+    \overload
+
+    Sends the raw Modbus \a request to the server with the address
+    \a serverAddress. Once the request finished, \a handler is called with its
+    QModbusResult, unless \a context was destroyed before. Returns \c true if
+    the request was sent; otherwise \c false.
+
+    \sa sendReadRequest(), QModbusResult::rawResult()
+*/
+bool QModbusClient::sendRawRequest(const QModbusRequest &request, int serverAddress,
+                                   const QObject *context, ResultHandler handler)
+{
+    return d_func()->sendRequest(request, serverAddress, nullptr, context, std::move(handler));
+}
+
 /*!
     Returns the timeout value used by this QModbusClient instance in ms.
     A timeout is indicated by a \l TimeoutError. The default value is 1000 ms.
@@ -176,6 +286,316 @@ void QModbusClient::setNumberOfRetries(int number)
         d->m_numberOfRetries = number;
 }
 
+/*!
+    \since 6.7
+
+    Returns the response timeout in milliseconds currently used for requests
+    to \a serverAddress. Without \l adaptiveTimeout(), this is timeout().
+
+    \sa setAdaptiveTimeout()
+*/
+int QModbusClient::timeout(int serverAddress) const
+{
+    Q_D(const QModbusClient);
+    return d->responseTimeout(serverAddress);
+}
+
+/*!
+    \since 6.7
+
+    Returns \c true if the response timeout adapts to the observed response
+    times of each server; otherwise \c false. The default value is \c false.
+
+    \sa setAdaptiveTimeout()
+*/
+bool QModbusClient::adaptiveTimeout() const
+{
+    Q_D(const QModbusClient);
+    return d->m_adaptiveTimeout;
+}
+
+/*!
+    \since 6.7
+
+    Enables adaptive response timeouts if \a enable is \c true.
+
+    By default, the client waits timeout() milliseconds for every response,
+    no matter how fast a server usually answers. If a server stops
+    responding, each request to it holds up the requests queued behind it
+    for the full timeout and each retry.
+
+    With adaptive timeouts, the client tracks the smoothed response time of
+    each server address and its variation, in the same way TCP estimates its
+    retransmission timeout. The response timeout of a server is derived from
+    these statistics and bounded by minimumTimeout() and timeout(). Until
+    the first response arrives, timeout() is used. Every timeout doubles the
+    response timeout of the server, within the same bounds. Responses to
+    retried requests are not used for the statistics, since they cannot be
+    told apart from late responses to the earlier attempt.
+
+    \sa timeout(int), setMinimumTimeout(), setServerFailureThreshold()
+*/
+void QModbusClient::setAdaptiveTimeout(bool enable)
+{
+    Q_D(QModbusClient);
+    d->m_adaptiveTimeout = enable;
+    for (auto &timing : d->m_serverTimings) {
+        timing.timeout = -1;
+        timing.measured = false;
+    }
+}
+
+/*!
+    \since 6.7
+
+    Returns the lower bound of adaptive response timeouts in milliseconds.
+    The default value is \c 50.
+
+    \sa setAdaptiveTimeout()
+*/
+int QModbusClient::minimumTimeout() const
+{
+    Q_D(const QModbusClient);
+    return d->m_minimumTimeout;
+}
+
+/*!
+    \since 6.7
+
+    Sets the lower bound of adaptive response timeouts to \a msec. The
+    value should leave room for the processing time of the slowest request a
+    server answers, since adaptive timeouts are not adjusted per function
+    code. Values below \c 10 are ignored.
+
+    \sa setAdaptiveTimeout()
+*/
+void QModbusClient::setMinimumTimeout(int msec)
+{
+    Q_D(QModbusClient);
+    if (msec >= 10)
+        d->m_minimumTimeout = msec;
+}
+
+/*!
+    \since 6.7
+
+    Returns the number of consecutive failed requests after which a server
+    is considered unavailable. The default value is \c 0, which disables
+    the detection.
+
+    \sa setServerFailureThreshold()
+*/
+int QModbusClient::serverFailureThreshold() const
+{
+    Q_D(const QModbusClient);
+    return d->m_serverFailureThreshold;
+}
+
+/*!
+    \since 6.7
+
+    Sets the number of consecutive failed requests after which a server is
+    considered unavailable to \a count. A request fails if neither the
+    first attempt nor any retry is answered in time. A value of \c 0
+    disables the detection, negative values are ignored.
+
+    While a server is unavailable, requests to it finish right away with a
+    \l TimeoutError, without being sent. This includes requests that were
+    queued before the server became unavailable and did not go out yet, so
+    that requests to other servers are not held up. Once serverRecoveryTime()
+    has passed, the next request is sent again. If it is answered, the
+    server is available again, otherwise it stays unavailable for another
+    serverRecoveryTime().
+
+    \sa isServerAvailable(), setServerRecoveryTime()
+*/
+void QModbusClient::setServerFailureThreshold(int count)
+{
+    Q_D(QModbusClient);
+    if (count >= 0)
+        d->m_serverFailureThreshold = count;
+}
+
+/*!
+    \since 6.7
+
+    Returns the time in milliseconds a server is considered unavailable,
+    before a request is sent to it again. The default value is \c 10000.
+
+    \sa setServerFailureThreshold()
+*/
+int QModbusClient::serverRecoveryTime() const
+{
+    Q_D(const QModbusClient);
+    return d->m_serverRecoveryTime;
+}
+
+/*!
+    \since 6.7
+
+    Sets the time a server is considered unavailable to \a msec. Negative
+    values are ignored.
+
+    \sa setServerFailureThreshold()
+*/
+void QModbusClient::setServerRecoveryTime(int msec)
+{
+    Q_D(QModbusClient);
+    if (msec >= 0)
+        d->m_serverRecoveryTime = msec;
+}
+
+/*!
+    \since 6.7
+
+    Returns \c false while requests to \a serverAddress are not sent, since
+    the server did not answer serverFailureThreshold() requests in a row;
+    otherwise returns \c true.
+
+    \sa setServerFailureThreshold()
+*/
+bool QModbusClient::isServerAvailable(int serverAddress) const
+{
+    Q_D(const QModbusClient);
+    return !d->isServerDown(serverAddress);
+}
+
+/*!
+    \since 6.7
+
+    Returns the time in milliseconds a read response is kept in the response
+    cache, unless a range specific value applies. The default value is \c 0,
+    which disables the cache.
+
+    \sa setCacheTimeToLive()
+*/
+int QModbusClient::cacheTimeToLive() const
+{
+    Q_D(const QModbusClient);
+    return d->m_cacheTimeToLive;
+}
+
+/*!
+    \since 6.7
+
+    Sets the time in milliseconds a read response is kept in the response
+    cache to \a msec. A value of \c 0 disables the cache, negative values are
+    ignored.
+
+    With the cache enabled, a read request for the same server address,
+    function code and address range as an earlier request is answered from
+    the cached response, until \a msec milliseconds have passed since that
+    response arrived. A read request issued while an identical request is
+    still in flight is answered with the same response. In both cases,
+    nothing is sent to the server. The returned QModbusReply finishes
+    asynchronously, just like an uncached reply.
+
+    Read requests sent through sendReadRequest() and sendRawRequest() are
+    cached. Requests using \l QModbusPdu::ReadWriteMultipleRegisters are
+    never cached. Only successful responses are cached.
+
+    Any write request to a range overlapping a cached range of the same
+    server removes the cached response, a broadcast write removes the
+    responses of all servers. Changes made to the server by other means,
+    for example by a second client, are not detected. Choose \a msec
+    accordingly.
+
+    \sa cacheTimeToLive(), clearCache()
+*/
+void QModbusClient::setCacheTimeToLive(int msec)
+{
+    Q_D(QModbusClient);
+    if (msec >= 0)
+        d->m_cacheTimeToLive = msec;
+}
+
+/*!
+    \since 6.7
+    \overload
+
+    Sets the time in milliseconds read responses are kept in the response
+    cache to \a msec, for reads that fall entirely within \a range. The
+    register type, start address and value count of \a range are used,
+    its values are ignored. If several ranges contain a read, the range set
+    last applies. A value of \c 0 disables caching within \a range, a
+    negative value removes the setting for \a range.
+
+    This allows, for example, to cache slowly changing configuration
+    registers for minutes while measurements are cached for a short time.
+*/
+void QModbusClient::setCacheTimeToLive(const QModbusDataUnit &range, int msec)
+{
+    Q_D(QModbusClient);
+    if (range.registerType() == QModbusDataUnit::Invalid || range.startAddress() < 0)
+        return;
+
+    d->m_cacheRules.removeIf([&range](const QModbusClientPrivate::CacheRule &rule) {
+        return rule.type == range.registerType() && rule.startAddress == range.startAddress()
+            && rule.valueCount == int(range.valueCount());
+    });
+    if (msec >= 0) {
+        d->m_cacheRules.append({ range.registerType(), range.startAddress(),
+                                 int(range.valueCount()), msec });
+    }
+}
+
+/*!
+    \since 6.7
+
+    Removes all responses from the response cache.
+
+    \sa setCacheTimeToLive()
+*/
+void QModbusClient::clearCache()
+{
+    Q_D(QModbusClient);
+    d->m_cache.clear();
+}
+
+/*!
+    \since 6.7
+
+    Returns a snapshot of the request statistics of the client: the number of
+    requests, responses, exceptions, retries, timeouts and checksum errors,
+    and a histogram of the response latencies, per server address and
+    function code. Also returns the number of pending requests and its
+    maximum.
+
+    Recording the statistics takes a hash lookup per request, response and
+    timeout; the snapshot is only assembled when calling this function.
+
+    \sa resetMetrics(), QModbusClientMetrics
+*/
+QModbusClientMetrics QModbusClient::metrics() const
+{
+    Q_D(const QModbusClient);
+    QModbusClientMetrics metrics;
+    metrics.entries = d->m_metrics.values();
+    std::sort(metrics.entries.begin(), metrics.entries.end(),
+              [](const QModbusClientMetrics::Entry &lhs, const QModbusClientMetrics::Entry &rhs) {
+        return lhs.serverAddress != rhs.serverAddress ? lhs.serverAddress < rhs.serverAddress
+                                                      : lhs.functionCode < rhs.functionCode;
+    });
+    metrics.queueDepth = d->queueDepth();
+    metrics.queueHighWaterMark = qMax(d->m_queueHighWaterMark, metrics.queueDepth);
+    return metrics;
+}
+
+/*!
+    \since 6.7
+
+    Clears the request statistics of the client. The high-water mark of the
+    queue depth starts again at the number of pending requests.
+
+    \sa metrics()
+*/
+void QModbusClient::resetMetrics()
+{
+    Q_D(QModbusClient);
+    d->m_metrics.clear();
+    d->m_queueHighWaterMark = d->queueDepth();
+}
+
 /*!
     \internal
 */
@@ -209,26 +629,550 @@ bool QModbusClient::processPrivateResponse(const QModbusResponse &response, QMod
     return false;
 }
 
+static QModbusDataUnit::RegisterType readRegisterType(QModbusPdu::FunctionCode code)
+{
+    switch (code) {
+    case QModbusRequest::ReadCoils:
+        return QModbusDataUnit::Coils;
+    case QModbusRequest::ReadDiscreteInputs:
+        return QModbusDataUnit::DiscreteInputs;
+    case QModbusRequest::ReadHoldingRegisters:
+        return QModbusDataUnit::HoldingRegisters;
+    case QModbusRequest::ReadInputRegisters:
+        return QModbusDataUnit::InputRegisters;
+    default:
+        break;
+    }
+    return QModbusDataUnit::Invalid;
+}
+
 QModbusReply *QModbusClientPrivate::sendRequest(const QModbusRequest &request, int serverAddress,
                                                 const QModbusDataUnit *const unit)
 {
     Q_Q(QModbusClient);
 
+    if (!canSendRequest(request))
+        return nullptr;
+
+    quint64 probe = 0;
+    if (isServerUnavailable(serverAddress, request, &probe)) {
+        auto reply = new QModbusReply(unit ? QModbusReply::Common : QModbusReply::Raw,
+                                      serverAddress, q);
+        QTimer::singleShot(0, reply, [reply]() {
+            reply->setError(QModbusDevice::TimeoutError,
+                            QModbusClient::tr("Server is unavailable."));
+        });
+        return reply;
+    }
+
+    QModbusReply *reply = nullptr;
+    CacheKey key {};
+    const int timeToLive = cacheTimeToLive(request, serverAddress, &key);
+    if (timeToLive > 0) {
+        reply = sendCachedRequest(key, timeToLive, request, unit);
+    } else {
+        invalidateCache(request, serverAddress);
+        reply = enqueueRequest(request, serverAddress, unit ? *unit : QModbusDataUnit(),
+                               unit ? QModbusReply::Common : QModbusReply::Raw);
+    }
+
+    if (probe)
+        watchProbe(serverAddress, probe, reply);
+    return reply;
+}
+
+bool QModbusClientPrivate::sendRequest(const QModbusRequest &request, int serverAddress,
+                                       const QModbusDataUnit *const unit, const QObject *context,
+                                       QModbusClient::ResultHandler &&handler)
+{
+    Q_Q(QModbusClient);
+
+    if (!canSendRequest(request))
+        return false;
+
+    const QueueElement element(std::make_shared<Completion>(unit ? QModbusReply::Common
+                                                                 : QModbusReply::Raw,
+                                                            serverAddress, context,
+                                                            std::move(handler)),
+                               request, unit ? *unit : QModbusDataUnit());
+
+    quint64 probe = 0;
+    if (isServerUnavailable(serverAddress, request, &probe)) {
+        QTimer::singleShot(0, q, [element]() {
+            element.setError(QModbusDevice::TimeoutError,
+                             QModbusClient::tr("Server is unavailable."));
+        });
+        return true;
+    }
+
+    bool sent = false;
+    CacheKey key {};
+    const int timeToLive = cacheTimeToLive(request, serverAddress, &key);
+    if (timeToLive > 0) {
+        sent = sendCachedRequest(key, timeToLive, element);
+    } else {
+        invalidateCache(request, serverAddress);
+        sent = enqueueElement(element);
+    }
+
+    if (probe) {
+        if (sent)
+            watchProbe(serverAddress, probe, element);
+        else
+            finishProbe(serverAddress, probe);
+    }
+    if (sent)
+        watchContext(context);
+    return sent;
+}
+
+void QModbusClientPrivate::watchContext(const QObject *context)
+{
+    Q_Q(QModbusClient);
+
+    // One connection per context object, not per request.
+    if (!context || context == q || m_contexts.contains(context))
+        return;
+    m_contexts.insert(context);
+    QObject::connect(context, &QObject::destroyed, q, [this, context]() {
+        m_contexts.remove(context);
+        dropAbandoned();
+    });
+}
+
+bool QModbusClientPrivate::canSendRequest(const QModbusRequest &request)
+{
+    Q_Q(QModbusClient);
+
     if (!isOpen() || q->state() != QModbusDevice::ConnectedState) {
         qCWarning(QT_MODBUS) << "(Client) Device is not connected";
         q->setError(QModbusClient::tr("Device not connected."), QModbusDevice::ConnectionError);
-        return nullptr;
+        return false;
     }
 
     if (!request.isValid()) {
         qCWarning(QT_MODBUS) << "(Client) Refuse to send invalid request.";
         q->setError(QModbusClient::tr("Invalid Modbus request."), QModbusDevice::ProtocolError);
+        return false;
+    }
+    return true;
+}
+
+/*
+    Returns true if \a request must not be sent since the server is down, see
+    QModbusClient::setServerFailureThreshold(). Once the recovery time passed,
+    one request is let through to find out whether the server is back; \a probe
+    is set to its id then. The caller passes the id to watchProbe().
+*/
+bool QModbusClientPrivate::isServerUnavailable(int serverAddress, const QModbusRequest &request,
+                                               quint64 *probe)
+{
+    if (m_serverFailureThreshold <= 0 || serverAddress == 0)
+        return false;
+
+    auto it = m_serverTimings.find(serverAddress);
+    if (it == m_serverTimings.end() || !it->down)
+        return false;
+
+    if (it->recovery.hasExpired() && it->probe == 0) {
+        it->probe = ++m_lastProbe;
+        *probe = it->probe;
+        return false;
+    }
+
+    qCDebug(QT_MODBUS) << "(Client) Server" << serverAddress << "is unavailable, "
+        "not sending request:" << request;
+    return true;
+}
+
+int QModbusClientPrivate::cacheTimeToLive(QModbusDataUnit::RegisterType type, quint16 address,
+                                          quint16 count) const
+{
+    for (auto it = m_cacheRules.crbegin(); it != m_cacheRules.crend(); ++it) {
+        if (it->type == type && address >= it->startAddress
+            && address + count <= it->startAddress + it->valueCount) {
+            return it->timeToLive;
+        }
+    }
+    return m_cacheTimeToLive;
+}
+
+/*
+    Returns the time to live of the response to \a request, or 0 if it is not
+    cached. For cached read requests, \a key is set.
+*/
+int QModbusClientPrivate::cacheTimeToLive(const QModbusRequest &request, int serverAddress,
+                                          CacheKey *key) const
+{
+    if (m_cacheTimeToLive <= 0 && m_cacheRules.isEmpty())
+        return 0;
+
+    const QModbusDataUnit::RegisterType type = readRegisterType(request.functionCode());
+    if (type == QModbusDataUnit::Invalid || serverAddress == 0 || request.dataSize() != 4)
+        return 0;
+
+    quint16 address = 0, count = 0;
+    request.decodeData(&address, &count);
+    const int timeToLive = cacheTimeToLive(type, address, count);
+    if (timeToLive > 0)
+        *key = { serverAddress, request.functionCode(), address, count };
+    return timeToLive;
+}
+
+/*
+    Returns the cache entry for \a key, or nullptr if there is none or it
+    expired. Expired entries are removed.
+*/
+QModbusClientPrivate::CacheEntry *QModbusClientPrivate::cacheEntry(const CacheKey &key)
+{
+    auto it = m_cache.find(key);
+    if (it == m_cache.end())
+        return nullptr;
+    if (it->expiry.hasExpired()) {
+        m_cache.erase(it);
+        return nullptr;
+    }
+    return &it.value();
+}
+
+/*
+    Adds the entry for a read in flight. It expires when the read should long
+    have finished, so an entry that is never released cannot hold back the
+    requests for its range. The requests that joined it are still answered
+    when the read finishes.
+*/
+void QModbusClientPrivate::insertCacheEntry(const CacheKey &key,
+                                            const std::shared_ptr<Waiting> &waiting)
+{
+    // Drop expired entries once in a while, so polling many ranges does not grow the cache.
+    if (m_cache.size() >= 1024) {
+        m_cache.removeIf([](const auto &entry) {
+            return entry.value().expiry.hasExpired();
+        });
+    }
+    const qint64 inFlight = qint64(m_responseTimeoutDuration) * (m_numberOfRetries + 2);
+    m_cache.insert(key, { QModbusResponse(), QDeadlineTimer(inFlight), waiting });
+}
+
+/*
+    Releases the entry for \a key once the read sent for it, \a element,
+    finishes. Requests that join the entry meanwhile are added to \a waiting.
+    The element carries a Completion, which keeps the read in flight as long
+    as its finished callback is set, even if nobody else waits for it.
+*/
+void QModbusClientPrivate::watchCachedRead(const CacheKey &key, int timeToLive,
+                                           const std::shared_ptr<Waiting> &waiting,
+                                           const QueueElement &element)
+{
+    Q_ASSERT(element.completion);
+    element.completion->finished = [this, key, timeToLive, waiting](
+                                           const QModbusResult &result) {
+        finishCachedRead(key, timeToLive, waiting, result.rawResult(), result.error(),
+                         result.errorString());
+    };
+}
+
+/*
+    Called once the read sent for \a key finished, either successfully with
+    \a response or with \a error. Answers the requests that joined meanwhile.
+*/
+void QModbusClientPrivate::finishCachedRead(const CacheKey &key, int timeToLive,
+                                            const std::shared_ptr<Waiting> &waiting,
+                                            const QModbusResponse &response,
+                                            QModbusDevice::Error error,
+                                            const QString &errorString)
+{
+    const bool success = (error == QModbusDevice::NoError);
+
+    // The entry is gone if a write to the range was sent meanwhile, do not store the
+    // response then. Requests that joined are answered either way.
+    auto it = m_cache.find(key);
+    if (it != m_cache.end() && it->waiting == waiting) {
+        if (success) {
+            it->response = response;
+            it->expiry = QDeadlineTimer(timeToLive);
+            it->waiting.reset();
+        } else {
+            m_cache.erase(it);
+        }
+    }
+
+    const Waiting joined = std::exchange(*waiting, {});
+    for (const QueueElement &element : joined) {
+        if (element.isAbandoned())
+            continue;
+        if (success)
+            processQueueElement(response, element);
+        else
+            element.setError(error, errorString, response);
+    }
+}
+
+QModbusReply *QModbusClientPrivate::sendCachedRequest(const CacheKey &key, int timeToLive,
+                                                      const QModbusRequest &request,
+                                                      const QModbusDataUnit *const unit)
+{
+    Q_Q(QModbusClient);
+    const QModbusReply::ReplyType type = unit ? QModbusReply::Common : QModbusReply::Raw;
+    const QModbusDataUnit data = unit ? *unit : QModbusDataUnit();
+
+    if (CacheEntry *entry = cacheEntry(key)) {
+        auto reply = new QModbusReply(type, key.serverAddress, q);
+        const QueueElement element(reply, request, data, 0);
+        if (entry->waiting) {
+            qCDebug(QT_MODBUS) << "(Client) Joining read request in flight:" << request;
+            entry->waiting->append(element);
+        } else {
+            qCDebug(QT_MODBUS) << "(Client) Answering read request from cache:" << request;
+            QTimer::singleShot(0, reply, [this, response = entry->response, element]() {
+                processQueueElement(response, element);
+            });
+        }
+        return reply;
+    }
+
+    // The read is sent on behalf of the cache and the reply waits for it like a joined
+    // request. Deleting the reply then does not cancel the read the others wait for.
+    const QueueElement read(std::make_shared<Completion>(type, key.serverAddress, nullptr,
+                                                         QModbusClient::ResultHandler()),
+                            request, data);
+    auto reply = new QModbusReply(type, key.serverAddress, q);
+    auto waiting = std::make_shared<Waiting>(Waiting { QueueElement(reply, request, data, 0) });
+    insertCacheEntry(key, waiting);
+    watchCachedRead(key, timeToLive, waiting, read);
+    if (!enqueueElement(read)) {
+        m_cache.remove(key);
+        read.completion->finished = nullptr;
+        delete reply;
         return nullptr;
     }
+    return reply;
+}
+
+bool QModbusClientPrivate::sendCachedRequest(const CacheKey &key, int timeToLive,
+                                             const QueueElement &element)
+{
+    Q_Q(QModbusClient);
+
+    if (CacheEntry *entry = cacheEntry(key)) {
+        if (entry->waiting) {
+            qCDebug(QT_MODBUS) << "(Client) Joining read request in flight:"
+                               << element.requestPdu;
+            entry->waiting->append(element);
+        } else {
+            qCDebug(QT_MODBUS) << "(Client) Answering read request from cache:"
+                               << element.requestPdu;
+            QTimer::singleShot(0, q, [this, response = entry->response, element]() {
+                processQueueElement(response, element);
+            });
+        }
+        return true;
+    }
+
+    auto waiting = std::make_shared<Waiting>();
+    insertCacheEntry(key, waiting);
+    watchCachedRead(key, timeToLive, waiting, element);
+    if (!enqueueElement(element)) {
+        m_cache.remove(key);
+        if (element.completion)
+            element.completion->finished = nullptr;
+        return false;
+    }
+    return true;
+}
+
+int QModbusClientPrivate::responseTimeout(int serverAddress) const
+{
+    if (!m_adaptiveTimeout)
+        return m_responseTimeoutDuration;
+    const auto it = m_serverTimings.constFind(serverAddress);
+    if (it == m_serverTimings.cend() || it->timeout < 0)
+        return m_responseTimeoutDuration;
+    return qBound(qMin(m_minimumTimeout, m_responseTimeoutDuration), it->timeout,
+                  m_responseTimeoutDuration);
+}
+
+/*
+    A probe that ends without a response or a final timeout, for example with
+    a connection error or since its reply was deleted, leaves the server down.
+    The next request after it probes again.
+*/
+void QModbusClientPrivate::watchProbe(int serverAddress, quint64 probe, QModbusReply *reply)
+{
+    Q_Q(QModbusClient);
+
+    if (!reply) {
+        finishProbe(serverAddress, probe);
+        return;
+    }
+    const auto finish = [this, serverAddress, probe]() { finishProbe(serverAddress, probe); };
+    QObject::connect(reply, &QModbusReply::finished, q, finish);
+    QObject::connect(reply, &QObject::destroyed, q, finish);
+}
+
+void QModbusClientPrivate::watchProbe(int serverAddress, quint64 probe,
+                                      const QueueElement &element)
+{
+    // The probe is always processed, even if the handler's context is gone meanwhile.
+    auto finished = std::move(element.completion->finished);
+    element.completion->finished = [this, serverAddress, probe, finished](
+                                           const QModbusResult &result) {
+        finishProbe(serverAddress, probe);
+        if (finished)
+            finished(result);
+    };
+}
+
+void QModbusClientPrivate::finishProbe(int serverAddress, quint64 probe)
+{
+    auto it = m_serverTimings.find(serverAddress);
+    if (it != m_serverTimings.end() && it->probe == probe)
+        it->probe = 0;
+}
+
+bool QModbusClientPrivate::isServerDown(int serverAddress) const
+{
+    const auto it = m_serverTimings.constFind(serverAddress);
+    return it != m_serverTimings.cend() && it->down && !it->recovery.hasExpired();
+}
+
+void QModbusClientPrivate::recordResponse(int serverAddress, const QueueElement &element)
+{
+    if (serverAddress == 0 || (!m_adaptiveTimeout && m_serverFailureThreshold == 0))
+        return;
+
+    ServerTiming &timing = m_serverTimings[serverAddress];
+    if (timing.down)
+        qCDebug(QT_MODBUS) << "(Client) Server" << serverAddress << "is available again";
+    timing.consecutiveFailures = 0;
+    timing.down = false;
+    timing.probe = 0;
 
-    if (unit)
-        return enqueueRequest(request, serverAddress, *unit, QModbusReply::Common);
-    return enqueueRequest(request, serverAddress, QModbusDataUnit(), QModbusReply::Raw);
+    // Karn's algorithm: a response to a retried request might belong to any attempt.
+    if (m_adaptiveTimeout && element.attempts == 1 && element.sent.isValid())
+        updateRoundTrip(serverAddress, element.sent.elapsed());
+}
+
+void QModbusClientPrivate::recordResponse(const QueueElement &element,
+                                          const QModbusResponse &response)
+{
+    QModbusClientMetrics::Entry &entry = metricsEntry(element);
+    ++entry.responses;
+    if (response.isException())
+        ++entry.exceptions;
+    if (element.sent.isValid()) {
+        const qint64 latency = element.sent.nsecsElapsed() / 1000;
+        ++entry.latencyHistogram[QModbusClientMetrics::latencyBucket(latency)];
+        entry.totalLatency += latency;
+        entry.minimumLatency = entry.minimumLatency < 0 ? latency
+                                                        : qMin(entry.minimumLatency, latency);
+        entry.maximumLatency = qMax(entry.maximumLatency, latency);
+    }
+    recordResponse(element.serverAddress(), element);
+}
+
+void QModbusClientPrivate::updateRoundTrip(int serverAddress, qint64 msec)
+{
+    ServerTiming &timing = m_serverTimings[serverAddress];
+    const double roundTrip = double(msec);
+    if (!timing.measured) {
+        timing.measured = true;
+        timing.smoothedRoundTrip = roundTrip;
+        timing.roundTripVariation = roundTrip / 2;
+    } else {
+        timing.roundTripVariation = 0.75 * timing.roundTripVariation
+            + 0.25 * qAbs(timing.smoothedRoundTrip - roundTrip);
+        timing.smoothedRoundTrip = 0.875 * timing.smoothedRoundTrip + 0.125 * roundTrip;
+    }
+    // The variation term is at least one clock tick, the timer resolution is 1 ms.
+    timing.timeout = qBound(qMin(m_minimumTimeout, m_responseTimeoutDuration),
+        qCeil(timing.smoothedRoundTrip + qMax(1.0, 4 * timing.roundTripVariation)),
+        m_responseTimeoutDuration);
+}
+
+void QModbusClientPrivate::recordTimeout(int serverAddress, bool final)
+{
+    if (serverAddress == 0 || (!m_adaptiveTimeout && m_serverFailureThreshold == 0))
+        return;
+
+    ServerTiming &timing = m_serverTimings[serverAddress];
+    if (m_adaptiveTimeout) // back off, the estimate is kept for the next response
+        timing.timeout = qMin(2 * responseTimeout(serverAddress), m_responseTimeoutDuration);
+
+    if (!final || m_serverFailureThreshold == 0)
+        return;
+
+    timing.probe = 0;
+    if (++timing.consecutiveFailures < m_serverFailureThreshold)
+        return;
+
+    qCDebug(QT_MODBUS) << "(Client) Server" << serverAddress << "is unavailable for"
+                       << m_serverRecoveryTime << "ms";
+    timing.down = true;
+    timing.recovery = QDeadlineTimer(m_serverRecoveryTime);
+}
+
+void QModbusClientPrivate::recordTimeout(const QueueElement &element, bool final)
+{
+    QModbusClientMetrics::Entry &entry = metricsEntry(element);
+    if (final)
+        ++entry.timeouts;
+    else
+        ++entry.retries;
+    recordTimeout(element.serverAddress(), final);
+}
+
+void QModbusClientPrivate::invalidateCache(const QModbusRequest &request, int serverAddress)
+{
+    if (m_cache.isEmpty())
+        return;
+
+    quint16 address = 0, count = 1;
+    QModbusPdu::FunctionCode readFunctionCode;
+    switch (request.functionCode()) {
+    case QModbusRequest::WriteSingleCoil:
+    case QModbusRequest::WriteMultipleCoils:
+        readFunctionCode = QModbusRequest::ReadCoils;
+        break;
+    case QModbusRequest::WriteSingleRegister:
+    case QModbusRequest::WriteMultipleRegisters:
+    case QModbusRequest::MaskWriteRegister:
+    case QModbusRequest::ReadWriteMultipleRegisters:
+        readFunctionCode = QModbusRequest::ReadHoldingRegisters;
+        break;
+    default:
+        return;
+    }
+
+    switch (request.functionCode()) {
+    case QModbusRequest::WriteSingleCoil:
+    case QModbusRequest::WriteSingleRegister:
+    case QModbusRequest::MaskWriteRegister:
+        if (request.dataSize() < 2)
+            return;
+        request.decodeData(&address);
+        break;
+    case QModbusRequest::WriteMultipleCoils:
+    case QModbusRequest::WriteMultipleRegisters:
+        if (request.dataSize() < 4)
+            return;
+        request.decodeData(&address, &count);
+        break;
+    default: { // ReadWriteMultipleRegisters
+        if (request.dataSize() < 8)
+            return;
+        quint16 readAddress, readCount;
+        request.decodeData(&readAddress, &readCount, &address, &count);
+    }   break;
+    }
+
+    const int end = address + count;
+    m_cache.removeIf([&](const auto &entry) {
+        const CacheKey &key = entry.key();
+        return (serverAddress == 0 || key.serverAddress == serverAddress)
+            && key.functionCode == readFunctionCode
+            && key.address < end && address < key.address + key.count;
+    });
 }
 
 QModbusRequest QModbusClientPrivate::createReadRequest(const QModbusDataUnit &data) const
@@ -319,30 +1263,28 @@ QModbusRequest QModbusClientPrivate::createRWRequest(const QModbusDataUnit &read
 void QModbusClientPrivate::processQueueElement(const QModbusResponse &pdu,
                                                const QueueElement &element)
 {
-    if (element.reply.isNull())
+    if (element.isAbandoned())
         return;
 
-    element.reply->setRawResult(pdu);
     if (pdu.isException()) {
-        element.reply->setError(QModbusDevice::ProtocolError,
-            QModbusClient::tr("Modbus Exception Response."));
+        element.setError(QModbusDevice::ProtocolError,
+            QModbusClient::tr("Modbus Exception Response."), pdu);
         return;
     }
 
-    if (element.reply->type() == QModbusReply::Broadcast) {
-        element.reply->setFinished(true);
+    if (element.type() == QModbusReply::Broadcast) {
+        element.setResult(pdu, QModbusDataUnit());
         return;
     }
 
     QModbusDataUnit unit = element.unit;
     if (!q_func()->processResponse(pdu, &unit)) {
-        element.reply->setError(QModbusDevice::InvalidResponseError,
-            QModbusClient::tr("An invalid response has been received."));
+        element.setError(QModbusDevice::InvalidResponseError,
+            QModbusClient::tr("An invalid response has been received."), pdu);
         return;
     }
 
-    element.reply->setResult(unit);
-    element.reply->setFinished(true);
+    element.setResult(pdu, unit);
 }
 
 bool QModbusClientPrivate::processResponse(const QModbusResponse &response, QModbusDataUnit *data)
@@ -472,15 +1414,12 @@ bool QModbusClientPrivate::collateBytes(const QModbusPdu &response,
         return false;
 
     if (data) {
-        QDataStream stream(response.data().remove(0, 1));
-
-        QList<quint16> values;
+        // The registers follow the byte count, read them in place.
+        const QModbusPduView pdu(response);
         const quint8 itemCount = byteCount / 2;
-        for (int i = 0; i < itemCount; i++) {
-            quint16 tmp;
-            stream >> tmp;
-            values.append(tmp);
-        }
+        QList<quint16> values(itemCount);
+        for (int i = 0; i < itemCount; i++)
+            values[i] = pdu.wordAt(1 + 2 * i);
         data->setValues(values);
         data->setRegisterType(type);
     }
@@ -5,10 +5,14 @@
 #define QMODBUSCLIENT_H
 
 #include <QtCore/qobject.h>
+#include <QtSerialBus/qmodbusclientmetrics.h>
 #include <QtSerialBus/qmodbusdataunit.h>
 #include <QtSerialBus/qmodbusdevice.h>
 #include <QtSerialBus/qmodbuspdu.h>
 #include <QtSerialBus/qmodbusreply.h>
+#include <QtSerialBus/qmodbusresult.h>
+
+#include <functional>
 
 QT_BEGIN_NAMESPACE
 
@@ -29,12 +33,42 @@ public:
                                        int serverAddress);
     QModbusReply *sendRawRequest(const QModbusRequest &request, int serverAddress);
 
+    using ResultHandler = std::function<void(const QModbusResult &)>;
+    bool sendReadRequest(const QModbusDataUnit &read, int serverAddress, const QObject *context,
+                         ResultHandler handler);
+    bool sendWriteRequest(const QModbusDataUnit &write, int serverAddress,
+                          const QObject *context, ResultHandler handler);
+    bool sendReadWriteRequest(const QModbusDataUnit &read, const QModbusDataUnit &write,
+                              int serverAddress, const QObject *context, ResultHandler handler);
+    bool sendRawRequest(const QModbusRequest &request, int serverAddress, const QObject *context,
+                        ResultHandler handler);
+
     int timeout() const;
     void setTimeout(int newTimeout);
 
     int numberOfRetries() const;
     void setNumberOfRetries(int number);
 
+    int timeout(int serverAddress) const;
+    bool adaptiveTimeout() const;
+    void setAdaptiveTimeout(bool enable);
+    int minimumTimeout() const;
+    void setMinimumTimeout(int msec);
+
+    int serverFailureThreshold() const;
+    void setServerFailureThreshold(int count);
+    int serverRecoveryTime() const;
+    void setServerRecoveryTime(int msec);
+    bool isServerAvailable(int serverAddress) const;
+
+    int cacheTimeToLive() const;
+    void setCacheTimeToLive(int msec);
+    void setCacheTimeToLive(const QModbusDataUnit &range, int msec);
+    void clearCache();
+
+    QModbusClientMetrics metrics() const;
+    void resetMetrics();
+
 Q_SIGNALS:
     void timeoutChanged(int newTimeout);
 
@@ -4,6 +4,11 @@
 #ifndef QMODBUSCLIENT_P_H
 #define QMODBUSCLIENT_P_H
 
+#include <QtCore/qdeadlinetimer.h>
+#include <QtCore/qelapsedtimer.h>
+#include <QtCore/qhash.h>
+#include <QtCore/qpointer.h>
+#include <QtCore/qset.h>
 #include <QtCore/qtimer.h>
 #include <QtSerialBus/qmodbusclient.h>
 #include <QtSerialBus/qmodbuspdu.h>
@@ -11,6 +16,8 @@
 #include <private/qmodbusdevice_p.h>
 #include <limits.h>
 
+#include <memory>
+
 //
 //  W A R N I N G
 //  -------------
@@ -31,6 +38,15 @@ class Q_AUTOTEST_EXPORT QModbusClientPrivate : public QModbusDevicePrivate
 public:
     QModbusReply *sendRequest(const QModbusRequest &request, int serverAddress,
                               const QModbusDataUnit *const unit);
+    bool sendRequest(const QModbusRequest &request, int serverAddress,
+                     const QModbusDataUnit *const unit, const QObject *context,
+                     QModbusClient::ResultHandler &&handler);
+    bool canSendRequest(const QModbusRequest &request);
+    bool isServerUnavailable(int serverAddress, const QModbusRequest &request,
+                             quint64 *probe);
+    void watchProbe(int serverAddress, quint64 probe, QModbusReply *reply);
+    void watchProbe(int serverAddress, quint64 probe, const QueueElement &element);
+    void finishProbe(int serverAddress, quint64 probe);
     QModbusRequest createReadRequest(const QModbusDataUnit &data) const;
     QModbusRequest createWriteRequest(const QModbusDataUnit &data) const;
     QModbusRequest createRWRequest(const QModbusDataUnit &read, const QModbusDataUnit &write) const;
@@ -70,6 +86,42 @@ public:
     int m_numberOfRetries = 3;
     int m_responseTimeoutDuration = 1000;
 
+    /*
+        Receives the outcome of a request sent with a QModbusClient::ResultHandler,
+        in place of a QModbusReply. The handler is called once, unless the context
+        object was destroyed meanwhile.
+    */
+    struct Completion
+    {
+        Completion(QModbusReply::ReplyType type, int serverAddress, const QObject *context,
+                   QModbusClient::ResultHandler &&handler)
+            : result(type, serverAddress), context(context), guarded(context != nullptr)
+            , handler(std::move(handler))
+        {}
+
+        bool isAbandoned() const
+        {
+            return done || (!finished && (!handler || (guarded && context.isNull())));
+        }
+        void finish()
+        {
+            if (done)
+                return;
+            done = true;
+            if (finished)
+                finished(result);
+            if (handler && (!guarded || !context.isNull()))
+                handler(result);
+        }
+
+        QModbusResult result;
+        QPointer<const QObject> context;
+        bool guarded = false;
+        bool done = false;
+        QModbusClient::ResultHandler handler;
+        std::function<void(const QModbusResult &)> finished; // called first, see the read cache
+    };
+
     struct QueueElement {
         QueueElement() = default;
         QueueElement(QModbusReply *r, const QModbusRequest &req, const QModbusDataUnit &u, int num,
@@ -83,11 +135,72 @@ public:
                 timer->setInterval(timeout);
             }
         }
+        QueueElement(const std::shared_ptr<Completion> &c, const QModbusRequest &req,
+                     const QModbusDataUnit &u)
+            : completion(c), requestPdu(req), unit(u), numberOfRetries(0)
+        {}
         bool operator==(const QueueElement &other) const {
-            return reply == other.reply;
+            return reply == other.reply && completion == other.completion;
+        }
+
+        // Nobody waits for the outcome anymore, for example since the reply was deleted.
+        bool isAbandoned() const
+        {
+            return completion ? completion->isAbandoned() : reply.isNull();
+        }
+        int serverAddress() const
+        {
+            if (completion)
+                return completion->result.serverAddress();
+            return reply ? reply->serverAddress() : -1;
+        }
+        QModbusReply::ReplyType type() const
+        {
+            if (completion)
+                return completion->result.type();
+            return reply ? reply->type() : QModbusReply::Raw;
+        }
+
+        void setResult(const QModbusResponse &response, const QModbusDataUnit &data) const
+        {
+            if (completion) {
+                completion->result.setRawResult(response);
+                completion->result.setResult(data);
+                completion->finish();
+            } else if (reply) {
+                reply->setRawResult(response);
+                reply->setResult(data);
+                reply->setFinished(true);
+            }
+        }
+        void setError(QModbusDevice::Error error, const QString &text) const
+        {
+            if (completion) {
+                completion->result.setError(error, text);
+                completion->finish();
+            } else if (reply) {
+                reply->setError(error, text);
+            }
+        }
+        void setError(QModbusDevice::Error error, const QString &text,
+                      const QModbusResponse &response) const
+        {
+            if (completion)
+                completion->result.setRawResult(response);
+            else if (reply)
+                reply->setRawResult(response);
+            setError(error, text);
+        }
+        void addIntermediateError(QModbusDevice::IntermediateError error) const
+        {
+            if (completion)
+                completion->result.addIntermediateError(error);
+            else if (reply)
+                reply->addIntermediateError(error);
         }
 
         QPointer<QModbusReply> reply;
+        std::shared_ptr<Completion> completion; // set instead of reply, see Completion
         QModbusRequest requestPdu;
         QModbusDataUnit unit;
         int numberOfRetries;
@@ -95,8 +208,153 @@ public:
         QByteArray adu;
         qint64 bytesWritten = 0;
         qint32 m_timerId = INT_MIN;
+        QElapsedTimer sent; // restarted on every attempt
+        int attempts = 0;
     };
     void processQueueElement(const QModbusResponse &pdu, const QueueElement &element);
+
+    /*
+        Sends the request of \a element, which carries a Completion instead of a
+        reply. The transport sets the number of retries. Returns false if the
+        request cannot be sent; the default implementation does not support
+        such requests.
+    */
+    virtual bool enqueueElement(QueueElement element)
+    {
+        Q_UNUSED(element);
+        return false;
+    }
+
+    /*
+        Removes the requests whose Completion was abandoned, since the context
+        object of their handler was destroyed. Requests already sent are
+        forgotten, their responses are ignored. Called once a context object
+        passed to the client is destroyed, see watchContext().
+    */
+    virtual void dropAbandoned() {}
+    void watchContext(const QObject *context);
+
+    QSet<const QObject *> m_contexts;
+
+    /*
+        Response time statistics and availability of a server, see
+        QModbusClient::setAdaptiveTimeout() and setServerFailureThreshold().
+        The timeout follows the retransmission timeout estimation of TCP
+        (RFC 6298), using the smoothed round-trip time and its variation.
+    */
+    struct ServerTiming
+    {
+        double smoothedRoundTrip = 0.0;
+        double roundTripVariation = 0.0;
+        int timeout = -1; // none yet, use QModbusClient::timeout()
+        bool measured = false;
+        int consecutiveFailures = 0;
+        bool down = false;
+        quint64 probe = 0; // the request finding out whether the server is back, 0 if none
+        QDeadlineTimer recovery;
+    };
+
+    int responseTimeout(int serverAddress) const;
+    bool isServerDown(int serverAddress) const;
+    void recordResponse(int serverAddress, const QueueElement &element);
+    void updateRoundTrip(int serverAddress, qint64 msec);
+    void recordTimeout(int serverAddress, bool final);
+
+    bool m_adaptiveTimeout = false;
+    int m_minimumTimeout = 50;
+    int m_serverFailureThreshold = 0;
+    int m_serverRecoveryTime = 10000;
+    QHash<int, ServerTiming> m_serverTimings;
+    quint64 m_lastProbe = 0;
+
+    /*
+        Request statistics, see QModbusClient::metrics(). The transports record
+        every request they send and its outcome, queueDepth() returns the number
+        of requests waiting to be sent or for their response.
+    */
+    QModbusClientMetrics::Entry &metricsEntry(const QueueElement &element)
+    {
+        const quint32 key = (quint32(element.serverAddress()) << 8)
+            | quint8(element.requestPdu.functionCode());
+        auto it = m_metrics.find(key);
+        if (it == m_metrics.end()) {
+            it = m_metrics.insert(key, {});
+            it->serverAddress = element.serverAddress();
+            it->functionCode = element.requestPdu.functionCode();
+        }
+        return *it;
+    }
+    void recordRequest(const QueueElement &element, qsizetype queueDepth)
+    {
+        ++metricsEntry(element).requests;
+        m_queueHighWaterMark = qMax(m_queueHighWaterMark, queueDepth);
+    }
+    void recordResponse(const QueueElement &element, const QModbusResponse &response);
+    void recordTimeout(const QueueElement &element, bool final);
+    void recordCrcError(const QueueElement &element) { ++metricsEntry(element).crcErrors; }
+    virtual qsizetype queueDepth() const { return 0; }
+
+    QHash<quint32, QModbusClientMetrics::Entry> m_metrics;
+    qsizetype m_queueHighWaterMark = 0;
+
+    /*
+        Read response cache, see QModbusClient::setCacheTimeToLive(). Entries are
+        keyed by the server address and the read request, a write request to an
+        overlapping range of the same server removes them. While the first read
+        of a range is in flight, identical reads wait for its response instead of
+        being sent as well.
+    */
+    struct CacheKey
+    {
+        int serverAddress;
+        QModbusPdu::FunctionCode functionCode;
+        quint16 address;
+        quint16 count;
+
+        friend bool operator==(const CacheKey &lhs, const CacheKey &rhs) noexcept
+        {
+            return lhs.serverAddress == rhs.serverAddress && lhs.functionCode == rhs.functionCode
+                && lhs.address == rhs.address && lhs.count == rhs.count;
+        }
+        friend size_t qHash(const CacheKey &key, size_t seed = 0) noexcept
+        {
+            return qHashMulti(seed, key.serverAddress, int(key.functionCode), key.address,
+                              key.count);
+        }
+    };
+    using Waiting = QList<QueueElement>;
+    struct CacheEntry
+    {
+        QModbusResponse response;
+        QDeadlineTimer expiry; // of the response, or of the read in flight
+        std::shared_ptr<Waiting> waiting; // set while the read is in flight
+    };
+    struct CacheRule
+    {
+        QModbusDataUnit::RegisterType type;
+        int startAddress;
+        int valueCount;
+        int timeToLive;
+    };
+
+    int cacheTimeToLive(QModbusDataUnit::RegisterType type, quint16 address, quint16 count) const;
+    int cacheTimeToLive(const QModbusRequest &request, int serverAddress, CacheKey *key) const;
+    CacheEntry *cacheEntry(const CacheKey &key);
+    void insertCacheEntry(const CacheKey &key, const std::shared_ptr<Waiting> &waiting);
+    void watchCachedRead(const CacheKey &key, int timeToLive,
+                         const std::shared_ptr<Waiting> &waiting, const QueueElement &element);
+    void finishCachedRead(const CacheKey &key, int timeToLive,
+                          const std::shared_ptr<Waiting> &waiting, const QModbusResponse &response,
+                          QModbusDevice::Error error, const QString &errorString);
+    QModbusReply *sendCachedRequest(const CacheKey &key, int timeToLive,
+                                    const QModbusRequest &request,
+                                    const QModbusDataUnit *const unit);
+    bool sendCachedRequest(const CacheKey &key, int timeToLive, const QueueElement &element);
+    void invalidateCache(const QModbusRequest &request, int serverAddress);
+
+    int m_cacheTimeToLive = 0;
+    QList<CacheRule> m_cacheRules;
+    QHash<CacheKey, CacheEntry> m_cache;
 };
 
 QT_END_NAMESPACE
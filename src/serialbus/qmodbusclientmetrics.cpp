@@ -0,0 +1,159 @@
+// Copyright (C) 2023 The Qt Company Ltd.
+// SPDX-License-Identifier: LicenseRef-Qt-Commercial OR LGPL-3.0-only OR GPL-2.0-only OR GPL-3.0-only
+
+#include "qmodbusclientmetrics.h"
+
+QT_BEGIN_NAMESPACE
+
+/*!
+    \class QModbusClientMetrics
+    \inmodule QtSerialBus
+    \since 6.7
+
+    \brief The QModbusClientMetrics struct holds request statistics of a
+    QModbusClient.
+
+    A snapshot is returned by \l QModbusClient::metrics(). It contains one
+    \l Entry per combination of server address and function code the client
+    sent requests for, and the depth of the request queue.
+
+    Latencies are measured in microseconds from sending the last attempt of a
+    request until its response was received. They are counted in a histogram
+    with a fixed number of buckets: latencies below eight microseconds have a
+    bucket each, larger ones are split into eight buckets per power of two.
+    The width of a bucket is thereby never more than 12.5 percent of its
+    values, independent of the magnitude. The histogram covers latencies of
+    up to 2\sup{28} microseconds, about 268 seconds. Use
+    latencyBucketLowerBound() and latencyBucketUpperBound() to find the
+    range of a bucket.
+
+    \sa QModbusClient::metrics(), QModbusClient::resetMetrics()
+*/
+
+/*!
+    \class QModbusClientMetrics::Entry
+    \inmodule QtSerialBus
+    \since 6.7
+
+    \brief The Entry struct holds the statistics of the requests with one
+    function code sent to one server.
+
+    \list
+        \li \c serverAddress and \c functionCode identify the requests.
+        \li \c requests counts the requests passed to the transport, without
+            retries. Requests answered from the response cache are not
+            counted.
+        \li \c responses counts the responses received, including exception
+            responses, which are also counted in \c exceptions.
+        \li \c timeouts counts the requests that failed since no response was
+            received after the last retry, \c retries counts the requests
+            that were sent again.
+        \li \c crcErrors counts the responses dropped since their checksum
+            was wrong.
+        \li \c minimumLatency, \c maximumLatency and \c totalLatency are given
+            in microseconds. The minimum and maximum are \c -1 until a
+            response was received.
+        \li \c latencyHistogram holds the number of responses per latency
+            bucket, see latencyBucket().
+    \endlist
+*/
+
+/*!
+    \variable QModbusClientMetrics::entries
+
+    Holds the statistics per server address and function code.
+*/
+
+/*!
+    \variable QModbusClientMetrics::queueDepth
+
+    Holds the number of requests waiting to be sent or for their response.
+*/
+
+/*!
+    \variable QModbusClientMetrics::queueHighWaterMark
+
+    Holds the largest value of \l queueDepth since the client was created or
+    the metrics were reset.
+*/
+
+/*!
+    \fn int QModbusClientMetrics::latencyBucket(qint64 microseconds)
+
+    Returns the index of the histogram bucket counting a latency of
+    \a microseconds. Latencies beyond the range of the histogram are counted
+    in the last bucket.
+*/
+
+/*!
+    \fn qint64 QModbusClientMetrics::latencyBucketLowerBound(int bucket)
+
+    Returns the smallest latency in microseconds counted in \a bucket.
+*/
+
+/*!
+    \fn qint64 QModbusClientMetrics::latencyBucketUpperBound(int bucket)
+
+    Returns the latency in microseconds following the largest one counted in
+    \a bucket.
+*/
+
+/*!
+    Returns the sum of all entries for \a serverAddress, or of all entries if
+    \a serverAddress is \c -1. The function code of the result is
+    \l QModbusPdu::Invalid.
+*/
+QModbusClientMetrics::Entry QModbusClientMetrics::aggregate(int serverAddress) const
+{
+    Entry sum;
+    sum.serverAddress = serverAddress;
+    for (const Entry &entry : entries) {
+        if (serverAddress != -1 && entry.serverAddress != serverAddress)
+            continue;
+        sum.requests += entry.requests;
+        sum.responses += entry.responses;
+        sum.exceptions += entry.exceptions;
+        sum.timeouts += entry.timeouts;
+        sum.retries += entry.retries;
+        sum.crcErrors += entry.crcErrors;
+        sum.totalLatency += entry.totalLatency;
+        if (entry.minimumLatency >= 0) {
+            sum.minimumLatency = sum.minimumLatency < 0 ? entry.minimumLatency
+                                                        : qMin(sum.minimumLatency,
+                                                               entry.minimumLatency);
+            sum.maximumLatency = qMax(sum.maximumLatency, entry.maximumLatency);
+        }
+        for (int i = 0; i < LatencyBucketCount; ++i)
+            sum.latencyHistogram[i] += entry.latencyHistogram[i];
+    }
+    return sum;
+}
+
+/*!
+    Returns the latency in microseconds below which \a percentile percent of
+    the responses counted in \a entry were received, for example the median
+    for \c 50. The result is the upper bound of the histogram bucket holding
+    the percentile, limited to the maximum latency of \a entry. Returns \c -1
+    if no response was counted.
+*/
+qint64 QModbusClientMetrics::latencyPercentile(const Entry &entry, double percentile)
+{
+    quint64 total = 0;
+    for (quint64 count : entry.latencyHistogram)
+        total += count;
+    if (total == 0)
+        return -1;
+
+    const double rank = qBound(0.0, percentile, 100.0) / 100.0 * double(total);
+    quint64 seen = 0;
+    for (int i = 0; i < LatencyBucketCount; ++i) {
+        seen += entry.latencyHistogram[i];
+        if (seen == 0 || double(seen) < rank)
+            continue;
+        const qint64 bound = latencyBucketUpperBound(i);
+        return entry.maximumLatency >= 0 ? qMin(bound, entry.maximumLatency) : bound;
+    }
+    return entry.maximumLatency;
+}
+
+QT_END_NAMESPACE
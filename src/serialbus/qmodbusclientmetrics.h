@@ -0,0 +1,73 @@
+// Copyright (C) 2023 The Qt Company Ltd.
+// SPDX-License-Identifier: LicenseRef-Qt-Commercial OR LGPL-3.0-only OR GPL-2.0-only OR GPL-3.0-only
+
+#ifndef QMODBUSCLIENTMETRICS_H
+#define QMODBUSCLIENTMETRICS_H
+
+#include <QtCore/qalgorithms.h>
+#include <QtCore/qlist.h>
+#include <QtSerialBus/qmodbuspdu.h>
+#include <QtSerialBus/qtserialbusglobal.h>
+
+#include <array>
+
+QT_BEGIN_NAMESPACE
+
+struct QModbusClientMetrics
+{
+    // Latencies below 2^SubBucketBits microseconds are counted exactly, all
+    // others in 2^SubBucketBits buckets per power of two.
+    static constexpr int SubBucketBits = 3;
+    static constexpr int SubBucketCount = 1 << SubBucketBits;
+    static constexpr int LatencyBucketCount = SubBucketCount * 26;
+
+    static constexpr int latencyBucket(qint64 microseconds) noexcept
+    {
+        if (microseconds < SubBucketCount)
+            return microseconds > 0 ? int(microseconds) : 0;
+        const int exponent = 63 - qCountLeadingZeroBits(quint64(microseconds));
+        const int shift = exponent - SubBucketBits;
+        const int subBucket = int(microseconds >> shift) & (SubBucketCount - 1);
+        const int bucket = (shift + 1) * SubBucketCount + subBucket;
+        return bucket < LatencyBucketCount ? bucket : LatencyBucketCount - 1;
+    }
+    static constexpr qint64 latencyBucketLowerBound(int bucket) noexcept
+    {
+        if (bucket < SubBucketCount)
+            return bucket;
+        const int shift = bucket / SubBucketCount - 1;
+        return qint64(SubBucketCount + bucket % SubBucketCount) << shift;
+    }
+    static constexpr qint64 latencyBucketUpperBound(int bucket) noexcept
+    {
+        return latencyBucketLowerBound(bucket + 1);
+    }
+
+    struct Entry
+    {
+        int serverAddress = -1;
+        QModbusPdu::FunctionCode functionCode = QModbusPdu::Invalid;
+        quint64 requests = 0;
+        quint64 responses = 0;
+        quint64 exceptions = 0;
+        quint64 timeouts = 0;
+        quint64 retries = 0;
+        quint64 crcErrors = 0;
+        qint64 minimumLatency = -1;
+        qint64 maximumLatency = -1;
+        qint64 totalLatency = 0;
+        std::array<quint64, LatencyBucketCount> latencyHistogram = {};
+    };
+
+    Q_SERIALBUS_EXPORT Entry aggregate(int serverAddress = -1) const;
+    Q_SERIALBUS_EXPORT static qint64 latencyPercentile(const Entry &entry, double percentile);
+
+    QList<Entry> entries;
+    qsizetype queueDepth = 0;
+    qsizetype queueHighWaterMark = 0;
+};
+Q_DECLARE_TYPEINFO(QModbusClientMetrics::Entry, Q_RELOCATABLE_TYPE);
+
+QT_END_NAMESPACE
+
+#endif // QMODBUSCLIENTMETRICS_H
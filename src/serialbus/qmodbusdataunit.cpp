@@ -3,6 +3,10 @@
 
 #include "qmodbusdataunit.h"
 
+#include <QtCore/qendian.h>
+
+#include <cstring>
+
 QT_BEGIN_NAMESPACE
 
 /*!
@@ -22,6 +26,14 @@ QT_BEGIN_NAMESPACE
     \l QModbusDataUnit::DiscreteInputs and \l QModbusDataUnit::Coils
     only accept single bits. Therefore \c 0 is interpreted as \c 0 and anything
     else \c 1.
+
+    \section1 Typed Values
+
+    Many devices store values wider than \c 16 bits, such as 32-bit floating
+    point numbers or 64-bit integers, in consecutive registers. The order of
+    the registers and of the bytes within a register is not standardized. Use
+    decodeValues() and encodeValues() to convert whole arrays of such values
+    at once, in any of the orders listed in \l ByteOrder.
 */
 
 /*!
@@ -40,6 +52,28 @@ QT_BEGIN_NAMESPACE
                                 application program.
 */
 
+/*!
+    \enum QModbusDataUnit::ByteOrder
+    \since 6.7
+
+    This enum describes how values wider than \c 16 bits are stored in
+    consecutive registers. The examples show the bytes of a 32-bit value,
+    from the most significant byte \c A to the least significant byte \c D,
+    in the order they are transmitted.
+
+    \value BigEndian               \c {ABCD}: the most significant register
+                                   comes first, as in the Modbus
+                                   specification.
+    \value BigEndianByteSwap       \c {BADC}: the most significant register
+                                   comes first, the bytes of each register are
+                                   swapped.
+    \value LittleEndianByteSwap    \c {CDAB}: the least significant register
+                                   comes first.
+    \value LittleEndian            \c {DCBA}: the least significant register
+                                   comes first, the bytes of each register are
+                                   swapped.
+*/
+
 /*!
     \fn QModbusDataUnit::QModbusDataUnit()
 
@@ -178,4 +212,222 @@ QT_BEGIN_NAMESPACE
     Synonym for QMap<QModbusDataUnit::RegisterType, QModbusDataUnit>.
 */
 
+namespace {
+
+/*
+    The conversion kernels. The register and byte order are template parameters, so the inner
+    loops are free of branches and compilers can vectorize them.
+*/
+template <typename T, bool SwapWords, bool SwapBytes>
+void decodeRegisters(const quint16 *registers, T *values, qsizetype count)
+{
+    using UInt = typename QIntegerForSizeof<T>::Unsigned;
+    constexpr int Words = sizeof(T) / sizeof(quint16);
+    for (qsizetype i = 0; i < count; ++i, registers += Words) {
+        UInt value = 0;
+        for (int word = 0; word < Words; ++word) {
+            quint16 part = registers[SwapWords ? Words - 1 - word : word];
+            if constexpr (SwapBytes)
+                part = qbswap(part);
+            value = UInt(value << 16) | part;
+        }
+        std::memcpy(values + i, &value, sizeof(T));
+    }
+}
+
+template <typename T, bool SwapWords, bool SwapBytes>
+void encodeRegisters(const T *values, quint16 *registers, qsizetype count)
+{
+    using UInt = typename QIntegerForSizeof<T>::Unsigned;
+    constexpr int Words = sizeof(T) / sizeof(quint16);
+    for (qsizetype i = 0; i < count; ++i, registers += Words) {
+        UInt value;
+        std::memcpy(&value, values + i, sizeof(T));
+        for (int word = Words - 1; word >= 0; --word) {
+            quint16 part = quint16(value);
+            if constexpr (SwapBytes)
+                part = qbswap(part);
+            registers[SwapWords ? Words - 1 - word : word] = part;
+            value = UInt(value >> 16);
+        }
+    }
+}
+
+} // namespace
+
+template <typename T>
+bool QModbusDataUnit::decode(qsizetype index, T *values, qsizetype count, ByteOrder order) const
+{
+    constexpr qsizetype Words = sizeof(T) / sizeof(quint16);
+    if (index < 0 || count < 0 || count > (m_values.size() - index) / Words)
+        return false;
+    if (count == 0)
+        return true;
+
+    const quint16 *registers = m_values.constData() + index;
+    switch (order) {
+    case ByteOrder::BigEndian:
+        decodeRegisters<T, false, false>(registers, values, count);
+        break;
+    case ByteOrder::BigEndianByteSwap:
+        decodeRegisters<T, false, true>(registers, values, count);
+        break;
+    case ByteOrder::LittleEndianByteSwap:
+        decodeRegisters<T, true, false>(registers, values, count);
+        break;
+    case ByteOrder::LittleEndian:
+        decodeRegisters<T, true, true>(registers, values, count);
+        break;
+    }
+    return true;
+}
+
+template <typename T>
+bool QModbusDataUnit::encode(qsizetype index, const T *values, qsizetype count, ByteOrder order)
+{
+    constexpr qsizetype Words = sizeof(T) / sizeof(quint16);
+    if (index < 0 || count < 0)
+        return false;
+    if (count == 0)
+        return true;
+
+    const qsizetype size = index + count * Words;
+    if (size > m_values.size())
+        m_values.resize(size);
+    m_valueCount = qMax(m_valueCount, size);
+
+    quint16 *registers = m_values.data() + index;
+    switch (order) {
+    case ByteOrder::BigEndian:
+        encodeRegisters<T, false, false>(values, registers, count);
+        break;
+    case ByteOrder::BigEndianByteSwap:
+        encodeRegisters<T, false, true>(values, registers, count);
+        break;
+    case ByteOrder::LittleEndianByteSwap:
+        encodeRegisters<T, true, false>(values, registers, count);
+        break;
+    case ByteOrder::LittleEndian:
+        encodeRegisters<T, true, true>(values, registers, count);
+        break;
+    }
+    return true;
+}
+
+/*!
+    \since 6.7
+
+    Decodes \a count 32-bit floating point numbers stored in \a order from the
+    registers starting at position \a index into \a values. Each number takes
+    two registers. Returns \c false without changing \a values if the unit
+    holds fewer registers than needed.
+
+    \sa encodeValues(), {Typed Values}
+*/
+bool QModbusDataUnit::decodeValues(qsizetype index, float *values, qsizetype count,
+                                   ByteOrder order) const
+{
+    return decode(index, values, count, order);
+}
+
+/*!
+    \since 6.7
+    \overload
+
+    Decodes \a count 64-bit floating point numbers stored in \a order from the
+    registers starting at position \a index into \a values. Each number takes
+    four registers.
+*/
+bool QModbusDataUnit::decodeValues(qsizetype index, double *values, qsizetype count,
+                                   ByteOrder order) const
+{
+    return decode(index, values, count, order);
+}
+
+/*!
+    \since 6.7
+    \overload
+
+    Decodes \a count 32-bit integers stored in \a order from the registers
+    starting at position \a index into \a values. Each integer takes two
+    registers.
+*/
+bool QModbusDataUnit::decodeValues(qsizetype index, qint32 *values, qsizetype count,
+                                   ByteOrder order) const
+{
+    return decode(index, values, count, order);
+}
+
+/*!
+    \since 6.7
+    \overload
+
+    Decodes \a count 64-bit integers stored in \a order from the registers
+    starting at position \a index into \a values. Each integer takes four
+    registers.
+*/
+bool QModbusDataUnit::decodeValues(qsizetype index, qint64 *values, qsizetype count,
+                                   ByteOrder order) const
+{
+    return decode(index, values, count, order);
+}
+
+/*!
+    \since 6.7
+
+    Encodes \a count 32-bit floating point numbers from \a values in \a order
+    into the registers starting at position \a index. Each number takes two
+    registers. The unit grows if it holds fewer registers than needed, and
+    valueCount() is updated accordingly. Returns \c false if \a index or
+    \a count is negative.
+
+    \sa decodeValues(), {Typed Values}
+*/
+bool QModbusDataUnit::encodeValues(qsizetype index, const float *values, qsizetype count,
+                                   ByteOrder order)
+{
+    return encode(index, values, count, order);
+}
+
+/*!
+    \since 6.7
+    \overload
+
+    Encodes \a count 64-bit floating point numbers from \a values in \a order
+    into the registers starting at position \a index. Each number takes four
+    registers.
+*/
+bool QModbusDataUnit::encodeValues(qsizetype index, const double *values, qsizetype count,
+                                   ByteOrder order)
+{
+    return encode(index, values, count, order);
+}
+
+/*!
+    \since 6.7
+    \overload
+
+    Encodes \a count 32-bit integers from \a values in \a order into the
+    registers starting at position \a index. Each integer takes two registers.
+*/
+bool QModbusDataUnit::encodeValues(qsizetype index, const qint32 *values, qsizetype count,
+                                   ByteOrder order)
+{
+    return encode(index, values, count, order);
+}
+
+/*!
+    \since 6.7
+    \overload
+
+    Encodes \a count 64-bit integers from \a values in \a order into the
+    registers starting at position \a index. Each integer takes four
+    registers.
+*/
+bool QModbusDataUnit::encodeValues(qsizetype index, const qint64 *values, qsizetype count,
+                                   ByteOrder order)
+{
+    return encode(index, values, count, order);
+}
+
 QT_END_NAMESPACE
@@ -7,6 +7,7 @@
 #include <QtCore/qlist.h>
 #include <QtCore/qmap.h>
 #include <QtCore/qmetatype.h>
+#include <QtSerialBus/qtserialbusglobal.h>
 
 QT_BEGIN_NAMESPACE
 
@@ -21,6 +22,13 @@ public:
         HoldingRegisters
     };
 
+    enum class ByteOrder {
+        BigEndian,
+        BigEndianByteSwap,
+        LittleEndianByteSwap,
+        LittleEndian
+    };
+
     QModbusDataUnit() = default;
 
     constexpr explicit QModbusDataUnit(RegisterType type) noexcept
@@ -65,7 +73,30 @@ public:
 
     bool isValid() const { return m_type != Invalid && m_startAddress != -1; }
 
+    Q_SERIALBUS_EXPORT bool decodeValues(qsizetype index, float *values, qsizetype count,
+                                         ByteOrder order = ByteOrder::BigEndian) const;
+    Q_SERIALBUS_EXPORT bool decodeValues(qsizetype index, double *values, qsizetype count,
+                                         ByteOrder order = ByteOrder::BigEndian) const;
+    Q_SERIALBUS_EXPORT bool decodeValues(qsizetype index, qint32 *values, qsizetype count,
+                                         ByteOrder order = ByteOrder::BigEndian) const;
+    Q_SERIALBUS_EXPORT bool decodeValues(qsizetype index, qint64 *values, qsizetype count,
+                                         ByteOrder order = ByteOrder::BigEndian) const;
+
+    Q_SERIALBUS_EXPORT bool encodeValues(qsizetype index, const float *values, qsizetype count,
+                                         ByteOrder order = ByteOrder::BigEndian);
+    Q_SERIALBUS_EXPORT bool encodeValues(qsizetype index, const double *values, qsizetype count,
+                                         ByteOrder order = ByteOrder::BigEndian);
+    Q_SERIALBUS_EXPORT bool encodeValues(qsizetype index, const qint32 *values, qsizetype count,
+                                         ByteOrder order = ByteOrder::BigEndian);
+    Q_SERIALBUS_EXPORT bool encodeValues(qsizetype index, const qint64 *values, qsizetype count,
+                                         ByteOrder order = ByteOrder::BigEndian);
+
 private:
+    template <typename T>
+    bool decode(qsizetype index, T *values, qsizetype count, ByteOrder order) const;
+    template <typename T>
+    bool encode(qsizetype index, const T *values, qsizetype count, ByteOrder order);
+
     RegisterType m_type = Invalid;
     int m_startAddress = -1;
     QList<quint16> m_values;
@@ -75,9 +106,11 @@ typedef QMap<QModbusDataUnit::RegisterType, QModbusDataUnit> QModbusDataUnitMap;
 
 Q_DECLARE_TYPEINFO(QModbusDataUnit, Q_RELOCATABLE_TYPE);
 Q_DECLARE_TYPEINFO(QModbusDataUnit::RegisterType, Q_PRIMITIVE_TYPE);
+Q_DECLARE_TYPEINFO(QModbusDataUnit::ByteOrder, Q_PRIMITIVE_TYPE);
 
 QT_END_NAMESPACE
 
 Q_DECLARE_METATYPE(QModbusDataUnit::RegisterType)
+Q_DECLARE_METATYPE(QModbusDataUnit::ByteOrder)
 
 #endif // QMODBUSDATAUNIT_H
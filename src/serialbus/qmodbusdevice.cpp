@@ -7,6 +7,12 @@
 
 #include <QtCore/qloggingcategory.h>
 
+#if QT_CONFIG(modbus_serialport) && defined(Q_OS_LINUX)
+#include <linux/serial.h>
+#include <sys/ioctl.h>
+#include <errno.h>
+#endif
+
 QT_BEGIN_NAMESPACE
 
 /*!
@@ -370,4 +376,63 @@ QIODevice *QModbusDevice::device() const
 Q_LOGGING_CATEGORY(QT_MODBUS, "qt.modbus")
 Q_LOGGING_CATEGORY(QT_MODBUS_LOW, "qt.modbus.lowlevel")
 
+#if QT_CONFIG(modbus_serialport)
+/*!
+    \internal
+
+    Asks the driver of the opened serial \a port to pass received characters
+    on immediately, instead of collecting them for a few milliseconds. Without
+    that, silent intervals shorter than a millisecond cannot be measured. Only
+    supported on Linux, and only by drivers implementing \c TIOCSSERIAL; the
+    previous driver flags are restored by restoreLatencyMode().
+*/
+void QModbusDevicePrivate::enableLowLatencyMode(QSerialPort *port)
+{
+    m_savedSerialFlags = -1;
+    if (!m_lowLatencyMode || !port || !port->isOpen())
+        return;
+
+#if defined(Q_OS_LINUX)
+    serial_struct serial = {};
+    if (::ioctl(int(port->handle()), TIOCGSERIAL, &serial) != 0) {
+        qCDebug(QT_MODBUS) << "(RTU) Low latency mode not supported by" << port->portName()
+                           << qt_error_string(errno);
+        return;
+    }
+    if (serial.flags & ASYNC_LOW_LATENCY)
+        return;
+
+    const int flags = serial.flags;
+    serial.flags |= ASYNC_LOW_LATENCY;
+    if (::ioctl(int(port->handle()), TIOCSSERIAL, &serial) != 0) {
+        qCDebug(QT_MODBUS) << "(RTU) Cannot enable low latency mode of" << port->portName()
+                           << qt_error_string(errno);
+        return;
+    }
+    m_savedSerialFlags = flags;
+#endif
+}
+
+/*!
+    \internal
+
+    Restores the driver flags of the serial \a port changed by
+    enableLowLatencyMode(). Must be called before the port is closed.
+*/
+void QModbusDevicePrivate::restoreLatencyMode(QSerialPort *port)
+{
+    if (m_savedSerialFlags < 0 || !port || !port->isOpen())
+        return;
+
+#if defined(Q_OS_LINUX)
+    serial_struct serial = {};
+    if (::ioctl(int(port->handle()), TIOCGSERIAL, &serial) == 0) {
+        serial.flags = m_savedSerialFlags;
+        ::ioctl(int(port->handle()), TIOCSSERIAL, &serial);
+    }
+#endif
+    m_savedSerialFlags = -1;
+}
+#endif
+
 QT_END_NAMESPACE
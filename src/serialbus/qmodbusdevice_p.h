@@ -48,22 +48,63 @@ public:
         timeout for everything equal or greater than 19200 baud.
         If the user set the timeout to be longer than the calculated one,
         we'll keep the user defined.
+
+        In low latency mode the silent interval is always 3.5 times the
+        actual character time of the line, even above 19200 baud. The
+        interval is then shorter than the fixed one, so every device on
+        the line has to detect frame boundaries that precisely.
     */
     void calculateInterFrameDelay()
     {
         // The spec recommends a timeout value of 1.750 msec. Without such
         // precise single-shot timers use a approximated value of 1.750 msec.
-        int delayMilliSeconds = RecommendedDelay;
-        if (m_baudRate < 19200) {
+        int delayMicroSeconds = RecommendedDelay * 1000;
+        if (m_lowLatencyMode) {
+            // Always round up because the spec requests at least 3.5 char.
+            delayMicroSeconds = int((7 * characterDuration() + 1999) / 2000);
+        } else if (m_baudRate < 19200) {
             // Example: 9600 baud, 11 bit per packet -> 872 char/sec so:
             // 1000 ms / 872 char = 1.147 ms/char * 3.5 character = 4.0145 ms
             // Always round up because the spec requests at least 3.5 char.
-            delayMilliSeconds = qCeil(3500. / (qreal(m_baudRate) / 11.));
+            delayMicroSeconds = qCeil(3500. / (qreal(m_baudRate) / 11.)) * 1000;
         }
-        m_interFrameDelayMilliseconds = qMax(m_interFrameDelayMilliseconds, delayMilliSeconds);
+        m_interFrameDelayMicroseconds = qMax(m_requestedInterFrameDelay, delayMicroSeconds);
     }
+
+    /*!
+        Returns the time in nanoseconds it takes to transmit one character
+        with the current serial settings: a start bit, the data bits, the
+        optional parity bit and the stop bits.
+    */
+    qint64 characterDuration() const
+    {
+        if (m_baudRate <= 0)
+            return 0;
+
+        // Counted in half bits, to cover one and a half stop bits.
+        int halfBits = 2 * (1 + int(m_dataBits) + (m_parity == QSerialPort::NoParity ? 0 : 1));
+        switch (m_stopBits) {
+        case QSerialPort::OneAndHalfStop:
+            halfBits += 3;
+            break;
+        case QSerialPort::TwoStop:
+            halfBits += 4;
+            break;
+        default:
+            halfBits += 2;
+            break;
+        }
+        return (qint64(halfBits) * 1000000000 + 2 * m_baudRate - 1) / (2 * qint64(m_baudRate));
+    }
+
+    void enableLowLatencyMode(QSerialPort *port);
+    void restoreLatencyMode(QSerialPort *port);
+
     static constexpr int RecommendedDelay = 2; // A approximated value of 1.750 msec.
-    int m_interFrameDelayMilliseconds = RecommendedDelay;
+    int m_requestedInterFrameDelay = -1; // in microseconds, see setInterFrameDelay()
+    int m_interFrameDelayMicroseconds = RecommendedDelay * 1000;
+    bool m_lowLatencyMode = false;
+    int m_savedSerialFlags = -1; // driver flags to restore on close, see enableLowLatencyMode()
 #endif
 
     int m_networkPort = 502;
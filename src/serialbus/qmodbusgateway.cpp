@@ -0,0 +1,377 @@
+// Copyright (C) 2023 The Qt Company Ltd.
+// SPDX-License-Identifier: LicenseRef-Qt-Commercial OR LGPL-3.0-only OR GPL-2.0-only OR GPL-3.0-only
+
+#include "qmodbusgateway.h"
+#include "qmodbusgateway_p.h"
+#include "qmodbustcpserver_p.h"
+
+#include <algorithm>
+
+QT_BEGIN_NAMESPACE
+
+/*!
+    \class QModbusGateway
+    \inmodule QtSerialBus
+    \since 6.7
+
+    \brief The QModbusGateway class forwards requests received by a Modbus TCP
+    server to downstream Modbus lines.
+
+    A gateway bridges Modbus TCP clients onto serial lines, for example RS-485
+    buses driven by QModbusRtuSerialClient. Every line is a QModbusClient that
+    serves a set of server addresses, see addLine(). A request received by
+    server() whose unit identifier is routed to a line is forwarded to that
+    line; the response is sent back to the requesting TCP client with the
+    original transaction identifier. Requests for unit identifiers that are
+    not routed are processed by server() itself.
+
+    Each line carries one request at a time. Pending requests are queued per
+    TCP connection, and the connections take turns, so that a single client
+    issuing many requests cannot starve the others. The turnaround and
+    inter-frame delays of the line are applied by its QModbusClient.
+
+    If a line does not answer in time, the client receives a
+    \l {QModbusExceptionResponse::}{GatewayTargetDeviceFailedToRespond}
+    exception. If the request cannot be forwarded at all, for example since
+    the line is not connected, the client receives a
+    \l {QModbusExceptionResponse::}{GatewayPathUnavailable} exception.
+
+    The gateway neither opens nor closes the server or the lines. Set up and
+    connect them as usual:
+
+    \code
+        QModbusGateway gateway;
+
+        auto line = new QModbusRtuSerialClient(&gateway);
+        line->setConnectionParameter(QModbusDevice::SerialPortNameParameter, "ttyUSB0");
+        line->connectDevice();
+        gateway.addLine(line, { 1, 2, 3 });
+
+        gateway.server()->setConnectionParameter(QModbusDevice::NetworkPortParameter, 502);
+        gateway.server()->connectDevice();
+    \endcode
+*/
+
+/*!
+    Constructs a gateway with the specified \a parent. The gateway creates
+    its own server(), which has no lines attached yet.
+*/
+QModbusGateway::QModbusGateway(QObject *parent)
+    : QObject(*new QModbusGatewayPrivate, parent)
+{
+    Q_D(QModbusGateway);
+    d->init();
+}
+
+/*!
+    Destroys the gateway. Pending requests are dropped.
+*/
+QModbusGateway::~QModbusGateway()
+{
+    Q_D(QModbusGateway);
+    // Waits for handlers running on the server's worker threads.
+    d->m_serverPrivate->setRequestHandler(nullptr);
+    for (const auto &line : std::as_const(d->m_lines)) {
+        if (line->client)
+            line->client->disconnect(this);
+    }
+}
+
+/*!
+    Returns the Modbus TCP server receiving the requests. The server is owned
+    by the gateway.
+*/
+QModbusTcpServer *QModbusGateway::server() const
+{
+    Q_D(const QModbusGateway);
+    return d->m_server;
+}
+
+/*!
+    Adds \a line as a downstream line serving \a serverAddresses. Requests
+    received by server() for one of these unit identifiers are forwarded to
+    \a line. Returns \c true on success; otherwise \c false.
+
+    Adding fails if \a line is \c nullptr or already added, or if one of the
+    addresses is outside of the range \c 0 to \c 255 or routed to another
+    line.
+
+    The gateway does not take ownership of \a line. If \a line is destroyed,
+    it is removed from the gateway.
+
+    \sa removeLine()
+*/
+bool QModbusGateway::addLine(QModbusClient *line, const QList<int> &serverAddresses)
+{
+    Q_D(QModbusGateway);
+    if (!line)
+        return false;
+
+    for (const auto &existing : std::as_const(d->m_lines)) {
+        if (existing->client == line)
+            return false;
+    }
+
+    QWriteLocker locker(&d->m_routesLock);
+    for (int address : serverAddresses) {
+        if (address < 0 || address > 255 || d->m_routes[address])
+            return false;
+    }
+
+    auto entry = std::make_shared<QModbusGatewayPrivate::Line>();
+    entry->client = line;
+    for (int address : serverAddresses)
+        d->m_routes[address] = entry;
+    locker.unlock();
+
+    d->m_lines.push_back(entry);
+    connect(line, &QObject::destroyed, this, [this, line]() { removeLine(line); });
+    return true;
+}
+
+/*!
+    Removes \a line from the gateway. Requests queued for \a line are answered
+    with a \l {QModbusExceptionResponse::}{GatewayPathUnavailable} exception.
+
+    \sa addLine()
+*/
+void QModbusGateway::removeLine(QModbusClient *line)
+{
+    Q_D(QModbusGateway);
+    const auto it = std::find_if(d->m_lines.begin(), d->m_lines.end(),
+        [line](const auto &entry) { return entry->client == line; });
+    if (it == d->m_lines.end())
+        return;
+
+    const std::shared_ptr<QModbusGatewayPrivate::Line> entry = *it;
+    d->m_lines.erase(it);
+    {
+        QWriteLocker locker(&d->m_routesLock);
+        for (auto &route : d->m_routes) {
+            if (route == entry)
+                route.reset();
+        }
+    }
+
+    if (entry->client)
+        entry->client->disconnect(this);
+    entry->client = nullptr; // requests still in flight to the gateway fail from now on
+    d->abortLine(entry);
+}
+
+/*!
+    Returns the lines added to the gateway.
+
+    \sa addLine()
+*/
+QList<QModbusClient *> QModbusGateway::lines() const
+{
+    Q_D(const QModbusGateway);
+    QList<QModbusClient *> result;
+    for (const auto &line : d->m_lines) {
+        if (line->client)
+            result.append(line->client);
+    }
+    return result;
+}
+
+/*!
+    Returns the line serving \a serverAddress, or \c nullptr if requests for
+    \a serverAddress are not forwarded.
+*/
+QModbusClient *QModbusGateway::line(int serverAddress) const
+{
+    Q_D(const QModbusGateway);
+    if (serverAddress < 0 || serverAddress > 255)
+        return nullptr;
+
+    QReadLocker locker(&d->m_routesLock);
+    const auto &line = d->m_routes[serverAddress];
+    return line ? line->client : nullptr;
+}
+
+/*!
+    Returns the number of requests a single TCP connection may have queued
+    for one line. The default value is \c 16.
+*/
+int QModbusGateway::maximumQueueSize() const
+{
+    Q_D(const QModbusGateway);
+    return d->m_maximumQueueSize;
+}
+
+/*!
+    Sets the number of requests a single TCP connection may have queued for
+    one line to \a size. Further requests are answered with a
+    \l {QModbusExceptionResponse::}{ServerDeviceBusy} exception, until the
+    line caught up. Values smaller than \c 1 are ignored.
+*/
+void QModbusGateway::setMaximumQueueSize(int size)
+{
+    Q_D(QModbusGateway);
+    if (size > 0)
+        d->m_maximumQueueSize = size;
+}
+
+void QModbusGatewayPrivate::init()
+{
+    Q_Q(QModbusGateway);
+    m_server = new QModbusTcpServer(q);
+    m_serverPrivate = static_cast<QModbusTcpServerPrivate *>(QObjectPrivate::get(m_server));
+
+    m_serverPrivate->setRequestHandler([this](quint64 connectionId, quint16 transactionId,
+            quint16 protocolId, quint8 unitId, const QModbusRequest &request) {
+        return handleRequest(connectionId, transactionId, protocolId, unitId, request);
+    });
+
+    QObject::connect(m_server, &QModbusTcpServer::modbusClientDisconnected, q,
+                     [this](QTcpSocket *socket) {
+        dropConnection(m_serverPrivate->connectionId(socket));
+    });
+}
+
+/*
+    Called on the thread owning the socket of \a connectionId, which is a
+    worker thread if the server uses them.
+*/
+bool QModbusGatewayPrivate::handleRequest(quint64 connectionId, quint16 transactionId,
+                                          quint16 protocolId, quint8 unitId,
+                                          const QModbusRequest &request)
+{
+    std::shared_ptr<Line> line;
+    {
+        QReadLocker locker(&m_routesLock);
+        line = m_routes[unitId];
+    }
+    if (!line)
+        return false;
+
+    Q_Q(QModbusGateway);
+    QMetaObject::invokeMethod(q, [this, line, transaction = Transaction { connectionId,
+            transactionId, protocolId, unitId, request }]() mutable {
+        enqueue(line, std::move(transaction));
+    }, Qt::AutoConnection);
+    return true;
+}
+
+void QModbusGatewayPrivate::enqueue(const std::shared_ptr<Line> &line, Transaction &&transaction)
+{
+    if (!isConnected(transaction.connectionId))
+        return;
+
+    std::deque<Transaction> &queue = line->queues[transaction.connectionId];
+    if (queue.size() >= size_t(m_maximumQueueSize)) {
+        qCDebug(QT_MODBUS) << "(Gateway) Queue of connection full, rejecting request.";
+        respond(transaction, QModbusExceptionResponse::ServerDeviceBusy);
+        return;
+    }
+
+    if (queue.empty())
+        line->schedule.push_back(transaction.connectionId);
+    queue.push_back(std::move(transaction));
+    dispatch(line);
+}
+
+void QModbusGatewayPrivate::dispatch(const std::shared_ptr<Line> &line)
+{
+    while (!line->busy && !line->schedule.empty()) {
+        // Take the oldest request of the next connection in turn. If the connection has more
+        // requests queued, it moves to the back of the schedule.
+        const quint64 connectionId = line->schedule.front();
+        line->schedule.pop_front();
+        auto it = line->queues.find(connectionId);
+        if (it == line->queues.end())
+            continue;
+
+        Transaction transaction = std::move(it->front());
+        it->pop_front();
+        if (it->empty())
+            line->queues.erase(it);
+        else
+            line->schedule.push_back(connectionId);
+
+        if (!isConnected(connectionId))
+            continue;
+
+        if (!line->client || line->client->state() != QModbusDevice::ConnectedState) {
+            respond(transaction, QModbusExceptionResponse::GatewayPathUnavailable);
+            continue;
+        }
+
+        const auto handler = [this, line, transaction](const QModbusResult &result) {
+            line->busy = false;
+            finish(transaction, result);
+            dispatch(line);
+        };
+        line->busy = true;
+        if (!line->client->sendRawRequest(transaction.request, transaction.unitId, q_func(),
+                                          handler)) {
+            line->busy = false;
+            respond(transaction, QModbusExceptionResponse::GatewayPathUnavailable);
+        }
+    }
+}
+
+void QModbusGatewayPrivate::finish(const Transaction &transaction, const QModbusResult &result)
+{
+    // A broadcast is never answered, neither on the line nor towards the client.
+    if (result.type() == QModbusReply::Broadcast)
+        return;
+
+    switch (result.error()) {
+    case QModbusDevice::NoError:
+    case QModbusDevice::ProtocolError: // the line answered with an exception response
+        respond(transaction, result.rawResult());
+        break;
+    case QModbusDevice::TimeoutError:
+        respond(transaction, QModbusExceptionResponse::GatewayTargetDeviceFailedToRespond);
+        break;
+    default:
+        respond(transaction, QModbusExceptionResponse::GatewayPathUnavailable);
+        break;
+    }
+}
+
+void QModbusGatewayPrivate::dropConnection(quint64 connectionId)
+{
+    for (const auto &line : std::as_const(m_lines)) {
+        line->queues.remove(connectionId);
+        line->schedule.erase(std::remove(line->schedule.begin(), line->schedule.end(),
+                                         connectionId),
+                             line->schedule.end());
+    }
+}
+
+bool QModbusGatewayPrivate::isConnected(quint64 connectionId) const
+{
+    // Only compared, the socket may belong to another thread.
+    return m_serverPrivate->connectionSocket(connectionId) != nullptr;
+}
+
+void QModbusGatewayPrivate::abortLine(const std::shared_ptr<Line> &line)
+{
+    for (const auto &queue : std::as_const(line->queues)) {
+        for (const Transaction &transaction : queue)
+            respond(transaction, QModbusExceptionResponse::GatewayPathUnavailable);
+    }
+    line->queues.clear();
+    line->schedule.clear();
+}
+
+void QModbusGatewayPrivate::respond(const Transaction &transaction,
+                                    const QModbusResponse &response) const
+{
+    // The socket may live on one of the server's worker threads.
+    m_serverPrivate->postResponse(transaction.connectionId, transaction.transactionId,
+                                  transaction.protocolId, transaction.unitId, response);
+}
+
+void QModbusGatewayPrivate::respond(const Transaction &transaction,
+                                    QModbusExceptionResponse::ExceptionCode code) const
+{
+    respond(transaction, QModbusExceptionResponse(transaction.request.functionCode(), code));
+}
+
+QT_END_NAMESPACE
+
+#include "moc_qmodbusgateway.cpp"
@@ -0,0 +1,39 @@
+// Copyright (C) 2023 The Qt Company Ltd.
+// SPDX-License-Identifier: LicenseRef-Qt-Commercial OR LGPL-3.0-only OR GPL-2.0-only OR GPL-3.0-only
+
+#ifndef QMODBUSGATEWAY_H
+#define QMODBUSGATEWAY_H
+
+#include <QtCore/qlist.h>
+#include <QtCore/qobject.h>
+#include <QtSerialBus/qtserialbusglobal.h>
+
+QT_BEGIN_NAMESPACE
+
+class QModbusClient;
+class QModbusGatewayPrivate;
+class QModbusTcpServer;
+
+class Q_SERIALBUS_EXPORT QModbusGateway : public QObject
+{
+    Q_OBJECT
+    Q_DECLARE_PRIVATE(QModbusGateway)
+
+public:
+    explicit QModbusGateway(QObject *parent = nullptr);
+    ~QModbusGateway() override;
+
+    QModbusTcpServer *server() const;
+
+    bool addLine(QModbusClient *line, const QList<int> &serverAddresses);
+    void removeLine(QModbusClient *line);
+    QList<QModbusClient *> lines() const;
+    QModbusClient *line(int serverAddress) const;
+
+    int maximumQueueSize() const;
+    void setMaximumQueueSize(int size);
+};
+
+QT_END_NAMESPACE
+
+#endif // QMODBUSGATEWAY_H
@@ -0,0 +1,100 @@
+// Copyright (C) 2023 The Qt Company Ltd.
+// SPDX-License-Identifier: LicenseRef-Qt-Commercial OR LGPL-3.0-only OR GPL-2.0-only OR GPL-3.0-only
+
+#ifndef QMODBUSGATEWAY_P_H
+#define QMODBUSGATEWAY_P_H
+
+#include <QtCore/qhash.h>
+#include <QtCore/qreadwritelock.h>
+#include <QtSerialBus/qmodbusclient.h>
+#include <QtSerialBus/qmodbusgateway.h>
+#include <QtSerialBus/qmodbuspdu.h>
+#include <QtSerialBus/qmodbusresult.h>
+#include <QtSerialBus/qmodbustcpserver.h>
+
+#include <private/qobject_p.h>
+
+#include <array>
+#include <deque>
+#include <memory>
+#include <vector>
+
+//
+//  W A R N I N G
+//  -------------
+//
+// This file is not part of the Qt API. It exists purely as an
+// implementation detail. This header file may change from version to
+// version without notice, or even be removed.
+//
+// We mean it.
+//
+
+QT_BEGIN_NAMESPACE
+
+class QModbusTcpServerPrivate;
+
+class QModbusGatewayPrivate : public QObjectPrivate
+{
+    Q_DECLARE_PUBLIC(QModbusGateway)
+
+public:
+    /*
+        A request received from a TCP client, waiting to be forwarded. The
+        MBAP header fields are kept to answer the client once the line
+        responded. The connection is referred to by its id, since the socket
+        may live on a worker thread of the server and the client may go away.
+    */
+    struct Transaction
+    {
+        quint64 connectionId = 0;
+        quint16 transactionId = 0;
+        quint16 protocolId = 0;
+        quint8 unitId = 0;
+        QModbusRequest request;
+    };
+
+    /*
+        One downstream line. Requests are queued per TCP connection and the
+        connections are served round-robin, so a single busy client cannot
+        starve the others. Only one request per line is outstanding at a
+        time; the line's own client still applies its turnaround and
+        inter-frame delays.
+    */
+    struct Line
+    {
+        QModbusClient *client = nullptr; // removed from the gateway when destroyed
+        QHash<quint64, std::deque<Transaction>> queues;
+        std::deque<quint64> schedule;
+        bool busy = false;
+    };
+
+    void init();
+
+    bool handleRequest(quint64 connectionId, quint16 transactionId, quint16 protocolId,
+                       quint8 unitId, const QModbusRequest &request);
+    void enqueue(const std::shared_ptr<Line> &line, Transaction &&transaction);
+    void dispatch(const std::shared_ptr<Line> &line);
+    void finish(const Transaction &transaction, const QModbusResult &result);
+    void dropConnection(quint64 connectionId);
+    bool isConnected(quint64 connectionId) const;
+    void abortLine(const std::shared_ptr<Line> &line);
+
+    void respond(const Transaction &transaction, const QModbusResponse &response) const;
+    void respond(const Transaction &transaction,
+                 QModbusExceptionResponse::ExceptionCode code) const;
+
+    QModbusTcpServer *m_server = nullptr;
+    QModbusTcpServerPrivate *m_serverPrivate = nullptr;
+    std::vector<std::shared_ptr<Line>> m_lines;
+
+    // Read on the server's worker threads, see QModbusTcpServer::setWorkerThreadCount().
+    std::array<std::shared_ptr<Line>, 256> m_routes;
+    mutable QReadWriteLock m_routesLock;
+
+    int m_maximumQueueSize = 16;
+};
+
+QT_END_NAMESPACE
+
+#endif // QMODBUSGATEWAY_P_H
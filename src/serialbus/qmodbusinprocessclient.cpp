@@ -0,0 +1,191 @@
+// Copyright (C) 2023 The Qt Company Ltd.
+// SPDX-License-Identifier: LicenseRef-Qt-Commercial OR LGPL-3.0-only OR GPL-2.0-only OR GPL-3.0-only
+
+#include "qmodbusinprocessclient.h"
+#include "qmodbusinprocessclient_p.h"
+
+QT_BEGIN_NAMESPACE
+
+/*!
+    \class QModbusInProcessClient
+    \inmodule QtSerialBus
+    \since 6.7
+
+    \brief The QModbusInProcessClient class is a Modbus client talking to
+    Modbus servers in the same process, without a transport layer.
+
+    Simulations running many Modbus servers and clients in one process do not
+    need sockets or serial lines between them. QModbusInProcessClient hands its
+    requests directly to the \l {QModbusServer::}{processRequest()} function of
+    the server addressed, and the response back to the request. No frames are
+    encoded, no file descriptors are used, and the cost of a request is the
+    cost of processing it.
+
+    The servers are added with addServer(). A request is processed by the
+    first added server that serves its server address, see
+    \l {QModbusServer::}{serverAddress()} and
+    \l {QModbusServer::}{addServerAddress()}. Requests to server address \c 0
+    are broadcasts, processed by all servers without a response. Requests to
+    addresses no server serves time out, just as on a real bus. The servers
+    do not need to be connected, and the client works with every server type.
+    They must live in the thread of the client.
+
+    Requests and responses are always delivered through the event loop, never
+    from within the function sending the request. To simulate a network, a
+    latency and a jitter can be added in each direction, see setLatency() and
+    setJitter(). Responses may then arrive in a different order than the
+    requests were sent, as with Modbus TCP. Response timeouts and retries
+    apply as for the other clients.
+*/
+
+/*!
+    Constructs an in-process Modbus client with the specified \a parent.
+*/
+QModbusInProcessClient::QModbusInProcessClient(QObject *parent)
+    : QModbusClient(*new QModbusInProcessClientPrivate, parent)
+{
+    Q_D(QModbusInProcessClient);
+    d->setupScheduler();
+}
+
+/*!
+    Destroys the client. Pending requests are aborted.
+*/
+QModbusInProcessClient::~QModbusInProcessClient()
+{
+    close();
+}
+
+/*!
+    \internal
+*/
+QModbusInProcessClient::QModbusInProcessClient(QModbusInProcessClientPrivate &dd, QObject *parent)
+    : QModbusClient(dd, parent)
+{
+    Q_D(QModbusInProcessClient);
+    d->setupScheduler();
+}
+
+/*!
+    Adds \a server to the servers requests are delivered to. Returns \c false
+    if \a server is \c nullptr or was added already. The client does not take
+    ownership of \a server; a destroyed server is removed automatically.
+
+    \sa removeServer(), servers()
+*/
+bool QModbusInProcessClient::addServer(QModbusServer *server)
+{
+    Q_D(QModbusInProcessClient);
+    if (!server || d->m_servers.contains(server))
+        return false;
+    d->m_servers.append(server);
+    return true;
+}
+
+/*!
+    Removes \a server from the servers requests are delivered to. Requests
+    already processed by \a server are still answered.
+
+    \sa addServer()
+*/
+void QModbusInProcessClient::removeServer(QModbusServer *server)
+{
+    Q_D(QModbusInProcessClient);
+    d->m_servers.removeAll(server);
+}
+
+/*!
+    Returns the servers requests are delivered to, in the order they were
+    added.
+
+    \sa addServer()
+*/
+QList<QModbusServer *> QModbusInProcessClient::servers() const
+{
+    Q_D(const QModbusInProcessClient);
+    QList<QModbusServer *> result;
+    result.reserve(d->m_servers.size());
+    for (const QPointer<QModbusServer> &server : d->m_servers) {
+        if (server)
+            result.append(server);
+    }
+    return result;
+}
+
+/*!
+    Returns the delay in milliseconds added to every request on its way to the
+    server and to every response on its way back. The default is \c 0.
+
+    \sa setLatency(), jitter()
+*/
+int QModbusInProcessClient::latency() const
+{
+    Q_D(const QModbusInProcessClient);
+    return d->m_latency;
+}
+
+/*!
+    Sets the delay added to every request and every response to \a msec
+    milliseconds. A request thereby takes at least twice \a msec until its
+    response arrives. Negative values are treated as \c 0.
+
+    \sa latency(), setJitter()
+*/
+void QModbusInProcessClient::setLatency(int msec)
+{
+    Q_D(QModbusInProcessClient);
+    d->m_latency = qMax(0, msec);
+}
+
+/*!
+    Returns the maximum random delay in milliseconds added to the latency of
+    every request and response. The default is \c 0.
+
+    \sa setJitter(), latency()
+*/
+int QModbusInProcessClient::jitter() const
+{
+    Q_D(const QModbusInProcessClient);
+    return d->m_jitter;
+}
+
+/*!
+    Sets the maximum random delay added to the latency of every request and
+    every response to \a msec milliseconds. The delay is evenly distributed
+    between \c 0 and \a msec. Negative values are treated as \c 0.
+
+    \sa jitter(), setLatency()
+*/
+void QModbusInProcessClient::setJitter(int msec)
+{
+    Q_D(QModbusInProcessClient);
+    d->m_jitter = qMax(0, msec);
+}
+
+/*!
+    \reimp
+*/
+bool QModbusInProcessClient::open()
+{
+    Q_D(QModbusInProcessClient);
+    d->m_open = true;
+    setState(QModbusDevice::ConnectedState);
+    return true;
+}
+
+/*!
+    \reimp
+
+    Aborts all pending requests.
+*/
+void QModbusInProcessClient::close()
+{
+    Q_D(QModbusInProcessClient);
+    if (!d->m_open)
+        return;
+    d->m_open = false;
+    d->abortPending();
+    setState(QModbusDevice::UnconnectedState);
+}
+
+QT_END_NAMESPACE
@@ -0,0 +1,42 @@
+// Copyright (C) 2023 The Qt Company Ltd.
+// SPDX-License-Identifier: LicenseRef-Qt-Commercial OR LGPL-3.0-only OR GPL-2.0-only OR GPL-3.0-only
+
+#ifndef QMODBUSINPROCESSCLIENT_H
+#define QMODBUSINPROCESSCLIENT_H
+
+#include <QtCore/qlist.h>
+#include <QtSerialBus/qmodbusclient.h>
+
+QT_BEGIN_NAMESPACE
+
+class QModbusInProcessClientPrivate;
+class QModbusServer;
+
+class Q_SERIALBUS_EXPORT QModbusInProcessClient : public QModbusClient
+{
+    Q_OBJECT
+    Q_DECLARE_PRIVATE(QModbusInProcessClient)
+
+public:
+    explicit QModbusInProcessClient(QObject *parent = nullptr);
+    ~QModbusInProcessClient() override;
+
+    bool addServer(QModbusServer *server);
+    void removeServer(QModbusServer *server);
+    QList<QModbusServer *> servers() const;
+
+    int latency() const;
+    void setLatency(int msec);
+    int jitter() const;
+    void setJitter(int msec);
+
+protected:
+    QModbusInProcessClient(QModbusInProcessClientPrivate &dd, QObject *parent = nullptr);
+
+    bool open() override;
+    void close() override;
+};
+
+QT_END_NAMESPACE
+
+#endif // QMODBUSINPROCESSCLIENT_H
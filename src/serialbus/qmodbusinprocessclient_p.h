@@ -0,0 +1,303 @@
+// Copyright (C) 2023 The Qt Company Ltd.
+// SPDX-License-Identifier: LicenseRef-Qt-Commercial OR LGPL-3.0-only OR GPL-2.0-only OR GPL-3.0-only
+
+#ifndef QMODBUSINPROCESSCLIENT_P_H
+#define QMODBUSINPROCESSCLIENT_P_H
+
+#include <QtCore/qelapsedtimer.h>
+#include <QtCore/qhash.h>
+#include <QtCore/qloggingcategory.h>
+#include <QtCore/qpointer.h>
+#include <QtCore/qrandom.h>
+#include <QtCore/qtimer.h>
+#include <QtSerialBus/qmodbusinprocessclient.h>
+#include <QtSerialBus/qmodbusserver.h>
+
+#include <private/qmodbusclient_p.h>
+#include <private/qmodbusserver_p.h>
+
+#include <map>
+
+//
+//  W A R N I N G
+//  -------------
+//
+// This file is not part of the Qt API. It exists purely as an
+// implementation detail. This header file may change from version to
+// version without notice, or even be removed.
+//
+// We mean it.
+//
+
+QT_BEGIN_NAMESPACE
+
+Q_DECLARE_LOGGING_CATEGORY(QT_MODBUS)
+
+class QModbusInProcessClientPrivate : public QModbusClientPrivate
+{
+    Q_DECLARE_PUBLIC(QModbusInProcessClient)
+
+public:
+    /*
+        A step of a pending request, due at a point in time: the request reaches
+        the server, the response reaches the client, or the response timeout of
+        an attempt expires.
+    */
+    enum class Stage { Request, Response, Timeout };
+    struct Transfer
+    {
+        quint32 id = 0;
+        Stage stage = Stage::Request;
+        int attempt = 0;
+        QModbusResponse response;
+    };
+
+    void setupScheduler()
+    {
+        Q_Q(QModbusInProcessClient);
+
+        m_scheduler = new QTimer(q);
+        m_scheduler->setSingleShot(true);
+        m_scheduler->setTimerType(Qt::PreciseTimer);
+        QObject::connect(m_scheduler, &QTimer::timeout, q, [this]() { processSchedule(); });
+        m_clock.start();
+    }
+
+    // One-way transfer time in nanoseconds, the latency plus a random share of the jitter.
+    qint64 transferDelay() const
+    {
+        qint64 delay = qint64(m_latency) * 1000000;
+        if (m_jitter > 0)
+            delay += QRandomGenerator::global()->bounded(qint64(m_jitter) * 1000000 + 1);
+        return delay;
+    }
+
+    void schedule(qint64 delay, Transfer &&transfer)
+    {
+        const quint32 id = transfer.id;
+        m_scheduled.insert(id, m_schedule.emplace(m_clock.nsecsElapsed() + delay,
+                                                  std::move(transfer)));
+        startScheduler();
+    }
+
+    // Erases the transfers of a request that is no longer pending, for example the response
+    // timeout of an answered request.
+    void unschedule(quint32 id)
+    {
+        for (auto it = m_scheduled.constFind(id); it != m_scheduled.cend() && it.key() == id; ++it)
+            m_schedule.erase(it.value());
+        m_scheduled.remove(id);
+    }
+
+    void startScheduler()
+    {
+        if (m_schedule.empty()) {
+            m_scheduler->stop();
+            return;
+        }
+        const qint64 remaining = m_schedule.begin()->first - m_clock.nsecsElapsed();
+        const int msec = remaining > 0 ? int((remaining + 999999) / 1000000) : 0;
+        if (!m_scheduler->isActive() || m_scheduler->remainingTime() > msec)
+            m_scheduler->start(msec);
+    }
+
+    void processSchedule()
+    {
+        // Transfers scheduled meanwhile wait for the next round, even if they are due already,
+        // so that a client answering every response with a new request cannot block the event
+        // loop.
+        const qint64 now = m_clock.nsecsElapsed();
+        for (size_t count = m_schedule.size(); count > 0 && !m_schedule.empty(); --count) {
+            const auto next = m_schedule.begin();
+            if (next->first > now)
+                break;
+            Transfer transfer = std::move(next->second);
+            m_scheduled.remove(transfer.id, next);
+            m_schedule.erase(next);
+
+            switch (transfer.stage) {
+            case Stage::Request:
+                deliverRequest(transfer.id);
+                break;
+            case Stage::Response:
+                deliverResponse(transfer.id, transfer.response);
+                break;
+            case Stage::Timeout:
+                onResponseTimeout(transfer.id, transfer.attempt);
+                break;
+            }
+        }
+        startScheduler();
+    }
+
+    QModbusServer *serverFor(int serverAddress) const
+    {
+        for (const QPointer<QModbusServer> &server : m_servers) {
+            if (server && serverPrivate(server)->hasServerAddress(serverAddress))
+                return server;
+        }
+        return nullptr;
+    }
+    static QModbusServerPrivate *serverPrivate(QModbusServer *server)
+    {
+        return static_cast<QModbusServerPrivate *>(QObjectPrivate::get(server));
+    }
+
+    void deliverRequest(quint32 id)
+    {
+        const auto it = m_pending.constFind(id);
+        if (it == m_pending.cend())
+            return;
+
+        const int serverAddress = it->serverAddress();
+        const QModbusRequest request = it->requestPdu;
+        if (serverAddress == 0) {
+            // Every server processes a broadcast, none of them answers.
+            const QList<QPointer<QModbusServer>> servers = m_servers;
+            for (const QPointer<QModbusServer> &server : servers) {
+                if (server)
+                    serverPrivate(server)->processInProcessRequest(0, request);
+            }
+            const QueueElement element = m_pending.take(id);
+            processQueueElement({}, element);
+            return;
+        }
+
+        QModbusServer *target = serverFor(serverAddress);
+        if (!target) {
+            qCDebug(QT_MODBUS) << "(In-process client) No server with address" << serverAddress;
+            return; // the request times out
+        }
+
+        qCDebug(QT_MODBUS) << "(In-process client) Request PDU:" << request << "to server"
+                           << serverAddress;
+        QModbusResponse response = serverPrivate(target)->processInProcessRequest(serverAddress,
+                                                                                  request);
+        if (response.isValid())
+            schedule(transferDelay(), { id, Stage::Response, 0, std::move(response) });
+    }
+
+    void deliverResponse(quint32 id, const QModbusResponse &response)
+    {
+        const auto it = m_pending.constFind(id);
+        if (it == m_pending.cend())
+            return; // timed out meanwhile
+
+        qCDebug(QT_MODBUS) << "(In-process client) Response PDU:" << response;
+        const QueueElement element = m_pending.take(id);
+        unschedule(id);
+        if (!element.isAbandoned())
+            recordResponse(element, response);
+        processQueueElement(response, element);
+    }
+
+    void onResponseTimeout(quint32 id, int attempt)
+    {
+        const auto it = m_pending.constFind(id);
+        if (it == m_pending.cend() || it->attempts != attempt)
+            return;
+
+        QueueElement elem = m_pending.take(id);
+        if (elem.isAbandoned()) {
+            unschedule(id);
+            return;
+        }
+
+        recordTimeout(elem, elem.numberOfRetries <= 0);
+        if (elem.numberOfRetries > 0) {
+            elem.numberOfRetries--;
+            qCDebug(QT_MODBUS) << "(In-process client) Resend request with id:" << id;
+            send(id, std::move(elem));
+        } else {
+            qCDebug(QT_MODBUS) << "(In-process client) Timeout of request with id:" << id;
+            unschedule(id);
+            elem.setError(QModbusDevice::TimeoutError, QModbusClient::tr("Request timeout."));
+        }
+    }
+
+    void send(quint32 id, QueueElement &&element)
+    {
+        const int serverAddress = element.serverAddress();
+        element.attempts++;
+        element.sent.start();
+        const int attempt = element.attempts;
+        m_pending.insert(id, std::move(element));
+
+        schedule(transferDelay(), { id, Stage::Request, attempt, {} });
+        if (serverAddress != 0) {
+            schedule(qint64(responseTimeout(serverAddress)) * 1000000,
+                     { id, Stage::Timeout, attempt, {} });
+        }
+    }
+
+    QModbusReply *enqueueRequest(const QModbusRequest &request, int serverAddress,
+                                 const QModbusDataUnit &unit,
+                                 QModbusReply::ReplyType type) override
+    {
+        Q_Q(QModbusInProcessClient);
+        auto reply = new QModbusReply(serverAddress == 0 ? QModbusReply::Broadcast : type,
+                                      serverAddress, q);
+        enqueueElement(QueueElement(reply, request, unit, 0));
+        return reply;
+    }
+
+    bool enqueueElement(QueueElement element) override
+    {
+        if (element.completion && element.serverAddress() == 0)
+            element.completion->result.setType(QModbusReply::Broadcast);
+
+        element.numberOfRetries = m_numberOfRetries;
+        element.attempts = 0;
+        const quint32 id = m_nextId++;
+        recordRequest(element, m_pending.size() + 1);
+        send(id, std::move(element));
+        return true;
+    }
+
+    void abortPending()
+    {
+        m_schedule.clear();
+        m_scheduled.clear();
+        m_scheduler->stop();
+
+        // Answering a request may send the next one, work on a copy.
+        const QHash<quint32, QueueElement> pending = std::exchange(m_pending, {});
+        for (const QueueElement &elem : pending) {
+            if (elem.isAbandoned())
+                continue;
+            elem.setError(QModbusDevice::ReplyAbortedError,
+                          QModbusClient::tr("Reply aborted due to connection closure."));
+        }
+    }
+
+    void dropAbandoned() override
+    {
+        m_pending.removeIf([this](const auto &it) {
+            if (!it.value().isAbandoned())
+                return false;
+            unschedule(it.key());
+            return true;
+        });
+    }
+
+    qsizetype queueDepth() const override { return m_pending.size(); }
+
+    bool isOpen() const override { return m_open; }
+
+    QList<QPointer<QModbusServer>> m_servers;
+    int m_latency = 0;
+    int m_jitter = 0;
+    bool m_open = false;
+
+    QTimer *m_scheduler = nullptr;
+    QElapsedTimer m_clock;
+    using Schedule = std::multimap<qint64, Transfer>;
+    Schedule m_schedule; // keyed by due time, see m_clock
+    QMultiHash<quint32, Schedule::iterator> m_scheduled; // the transfers of each request
+    QHash<quint32, QueueElement> m_pending;
+    quint32 m_nextId = 0;
+};
+
+QT_END_NAMESPACE
+
+#endif // QMODBUSINPROCESSCLIENT_P_H
@@ -3,6 +3,7 @@
 
 #include "qmodbuspdu.h"
 #include "qmodbus_symbols_p.h"
+#include "qmodbuspdubuffer_p.h"
 
 #include <QtCore/qdebug.h>
 #include <QtCore/qhash.h>
@@ -34,50 +35,8 @@ enum struct Type {
 */
 static int minimumDataSize(const QModbusPdu &pdu, Type type)
 {
-    if (pdu.isException())
-        return 1;
-
-    switch (pdu.functionCode()) {
-    case QModbusPdu::ReadCoils:
-    case QModbusPdu::ReadDiscreteInputs:
-        return type == Type::Request ? 4 : 2;
-    case QModbusPdu::WriteSingleCoil:
-    case QModbusPdu::WriteSingleRegister:
-        return 4;
-    case QModbusPdu::ReadHoldingRegisters:
-    case QModbusPdu::ReadInputRegisters:
-        return type == Type::Request ? 4 : 3;
-    case QModbusPdu::ReadExceptionStatus:
-        return type == Type::Request ? 0 : 1;
-    case QModbusPdu::Diagnostics:
-        return 4;
-    case QModbusPdu::GetCommEventCounter:
-        return type == Type::Request ? 0 : 4;
-    case QModbusPdu::GetCommEventLog:
-        return type == Type::Request ? 0 : 8;
-    case QModbusPdu::WriteMultipleCoils:
-        return type == Type::Request ? 6 : 4;
-    case QModbusPdu::WriteMultipleRegisters:
-        return type == Type::Request ? 7 : 4;
-    case QModbusPdu::ReportServerId:
-        return type == Type::Request ? 0 : 3;
-    case QModbusPdu::ReadFileRecord:
-        return type == Type::Request ? 8 : 5;
-    case QModbusPdu::WriteFileRecord:
-        return 10;
-    case QModbusPdu::MaskWriteRegister:
-        return 6;
-    case QModbusPdu::ReadWriteMultipleRegisters:
-        return type == Type::Request ? 11 : 3;
-    case QModbusPdu::ReadFifoQueue:
-        return type == Type::Request ? 2 : 6;
-    case QModbusPdu::EncapsulatedInterfaceTransport:
-        return 2;
-    case QModbusPdu::Invalid:
-    case QModbusPdu::UndefinedFunctionCode:
-        return -1;
-    }
-    return -1;
+    return QModbusPduView::minimumDataSize(quint8(pdu.m_code), type == Type::Request
+        ? QModbusPduView::Request : QModbusPduView::Response);
 }
 
 /*!
@@ -105,27 +64,26 @@ static QDataStream &pduFromStream(QDataStream &stream, Type type, QModbusPdu *pd
 
     constexpr const int MaxPduDataSize = 252; // in bytes
 
-    // The calculateDataSize(...) function might need some data inside the
-    // given PDU argument to be able to figure out the right data size (e.g.
-    // WriteMultipleCoils contains some kind of "header"). So fake fill the PDU
-    // with the maximum available data but no more than the allowed max PDU
-    // data size.
-    QByteArray data(MaxPduDataSize, Qt::Uninitialized);
-    int read = stream.device()->peek(data.data(), MaxPduDataSize);
-    if (read < 0)
+    // The size calculation might need some of the data following the function code to be able
+    // to figure out the right data size (e.g. WriteMultipleCoils contains some kind of "header").
+    // So peek at the maximum available data but no more than the allowed max PDU data size.
+    char buffer[MaxPduDataSize];
+    const qint64 peeked = stream.device()->peek(buffer, MaxPduDataSize);
+    if (peeked < 0)
         return stream;
 
-    data.resize(read);
-    pdu->setData(data);
-
     const bool isResponse = (type == Type::Response);
-    int size = isResponse ? QModbusResponse::calculateDataSize(*pdu)
-                          : QModbusRequest::calculateDataSize(*pdu);
+    const QModbusPduView::Type viewType = isResponse ? QModbusPduView::Response
+                                                     : QModbusPduView::Request;
+    const QModbusPduView view(quint8(code), buffer, peeked);
+    int size = view.expectedDataSize(viewType);
+    qint64 available = peeked;
 
     if (isResponse && (code == QModbusPdu::EncapsulatedInterfaceTransport)) {
         quint8 meiType;
-        pdu->decodeData(&meiType);
+        view.decode(&meiType);
         if (meiType == EncapsulatedInterfaceTransport::ReadDeviceIdentification) {
+            QByteArray data;
             int left = size, offset = 0;
             while ((left > 0) && (size <= MaxPduDataSize)) {
                 data.resize(size);
@@ -136,27 +94,28 @@ static QDataStream &pduFromStream(QDataStream &stream, Type type, QModbusPdu *pd
                     break; // error reading, bail, reset further down
                 }
                 offset += read;
-                left = QModbusResponse::calculateDataSize(QModbusResponse(code, data)) - offset;
+                left = QModbusPduView(quint8(code), data.constData(), data.size())
+                           .expectedDataSize(viewType) - offset;
                 size += left;
             }
             if ((stream.status() == QDataStream::Ok) && (size <= MaxPduDataSize)) {
                 raii = {};
                 pdu->setData(data);
-                return stream; // early return to avoid second read
             }
+            return stream; // early return to avoid second read
         } else {
-            data.resize(int(stream.device()->size() - 1)); // One byte for the function code.
+            available = stream.device()->size() - 1; // One byte for the function code.
         }
-    } else if (pdu->functionCode() == QModbusPdu::Diagnostics) {
+    } else if (view.functionCode() == QModbusPdu::Diagnostics) {
         quint16 subCode;
-        pdu->decodeData(&subCode);
+        view.decode(&subCode);
         if (subCode == Diagnostics::ReturnQueryData)
-            data.resize(int(stream.device()->size() - 1)); // One byte for the function code.
+            available = stream.device()->size() - 1; // One byte for the function code.
     }
 
-    if (data.size() <= MaxPduDataSize) {
-        data.resize(size);
-        if (stream.readRawData(data.data(), data.size()) == size) {
+    if (available <= MaxPduDataSize && size >= 0) {
+        QByteArray data(size, Qt::Uninitialized);
+        if (stream.readRawData(data.data(), size) == size) {
             raii = {};
             pdu->setData(data);
         }
@@ -541,45 +500,7 @@ int QModbusRequest::calculateDataSize(const QModbusRequest &request)
         if (auto ptr = requestSizeCalculators()->value(quint8(request.functionCode()), nullptr))
             return ptr(request);
     }
-
-    if (request.isException())
-        return 1;
-
-    int size = -1;
-    int minimum = QModbusPduPrivate::minimumDataSize(request, QModbusPduPrivate::Type::Request);
-    if (minimum < 0)
-        return size;
-
-    switch (request.functionCode()) {
-    case QModbusPdu::WriteMultipleCoils:
-        minimum -= 1; // first payload payload byte
-        if (request.dataSize() >= minimum)
-            size = minimum + quint8(request.data().at(minimum - 1)) /*byte count*/;
-        break;
-    case QModbusPdu::WriteMultipleRegisters:
-    case QModbusPdu::ReadWriteMultipleRegisters:
-        minimum -= 2; // first 2 payload payload bytes
-        if (request.dataSize() >= minimum)
-            size = minimum + quint8(request.data().at(minimum - 1)) /*byte count*/;
-        break;
-    case QModbusPdu::ReadFileRecord:
-    case QModbusPdu::WriteFileRecord:
-        if (request.dataSize() >= 1)
-            size = 1 /*byte count*/ + quint8(request.data().at(0)) /*actual bytes*/;
-        break;
-    case QModbusPdu::EncapsulatedInterfaceTransport: {
-        if (request.dataSize() < minimum)
-            break;  // can't calculate, let's return -1 to indicate error
-        quint8 meiType;
-        request.decodeData(&meiType);
-        // ReadDeviceIdentification -> 3 == MEI type + Read device ID + Object Id
-        size = (meiType == EncapsulatedInterfaceTransport::ReadDeviceIdentification) ? 3 : minimum;
-    }   break;
-    default:
-        size = minimum;
-        break;
-    }
-    return size;
+    return QModbusPduView(request).calculateDataSize(QModbusPduView::Request);
 }
 
 /*!
@@ -719,75 +640,7 @@ int QModbusResponse::calculateDataSize(const QModbusResponse &response)
         if (auto ptr = responseSizeCalculators()->value(quint8(response.functionCode()), nullptr))
             return ptr(response);
     }
-
-    if (response.isException())
-        return 1;
-
-    int size = -1;
-    int minimum = QModbusPduPrivate::minimumDataSize(response, QModbusPduPrivate::Type::Response);
-    if (minimum < 0)
-        return size;
-
-    switch (response.functionCode()) {
-    case QModbusResponse::ReadCoils:
-    case QModbusResponse::ReadDiscreteInputs:
-    case QModbusResponse::ReadHoldingRegisters:
-    case QModbusResponse::ReadInputRegisters:
-    case QModbusResponse::GetCommEventLog:
-    case QModbusResponse::ReadFileRecord:
-    case QModbusResponse::WriteFileRecord:
-    case QModbusResponse::ReadWriteMultipleRegisters:
-    case QModbusResponse::ReportServerId:
-        if (response.dataSize() >= 1)
-            size = 1 /*byte count*/ + quint8(response.data().at(0)) /*actual bytes*/;
-        break;
-    case QModbusResponse::ReadFifoQueue: {
-        if (response.dataSize() >= 2) {
-            quint16 rawSize;
-            response.decodeData(&rawSize);
-            size = rawSize + 2; // 2 bytes size info
-        }
-    }   break;
-    case QModbusPdu::EncapsulatedInterfaceTransport: {
-        if (response.dataSize() < minimum)
-            break;  // can't calculate, let's return -1 to indicate error
-
-        quint8 meiType = 0;
-        response.decodeData(&meiType);
-
-        // update size, header 6 bytes: mei type + read device id + conformity level + more follows
-        //                              + next object id + number of object
-        // response data part  2 bytes: + object id + object size of the first object -> 8
-        size = (meiType == EncapsulatedInterfaceTransport::ReadDeviceIdentification) ? 8 : minimum;
-        if (meiType != EncapsulatedInterfaceTransport::ReadDeviceIdentification
-            || response.dataSize() < size) {
-            break; // TODO: calculate CanOpenGeneralReference instead of break
-        }
-
-        const QByteArray data = response.data();
-        quint8 numOfObjects = quint8(data[5]);
-        quint8 objectSize = quint8(data[7]);
-
-        // 6 byte header size + (2 * n bytes fixed per object) + first object size
-        size = 6 + (2 * numOfObjects) + objectSize;
-        if ((numOfObjects == 1) || (data.size() < size))
-            break;
-
-        // header + object id + object size + second object id (9 bytes) + first object size
-        int nextSizeField = 9 + objectSize;
-        for (int i = 1; i < numOfObjects; ++i) {
-            if (data.size() <= nextSizeField)
-                break;
-            objectSize = quint8(data[nextSizeField]);
-            size += objectSize;
-            nextSizeField += objectSize + 2; // object size + object id field + object size field
-        }
-    }   break;
-    default:
-        size = minimum;
-        break;
-    }
-    return size;
+    return QModbusPduView(response).calculateDataSize(QModbusPduView::Response);
 }
 
 /*!
@@ -806,6 +659,29 @@ void QModbusResponse::registerDataSizeCalculator(FunctionCode fc, CalcFuncPtr ca
     responseSizeCalculators()->insert(quint8(fc), calculator);
 }
 
+/*!
+    \internal
+
+    Returns the data size of the viewed PDU of the given \a type, using the
+    size calculator registered for its function code if there is one. Unlike
+    QModbusRequest::calculateDataSize() and QModbusResponse::calculateDataSize(),
+    the PDU is only copied if a custom calculator needs it.
+*/
+int QModbusPduView::expectedDataSize(Type type) const
+{
+    const quint8 key = quint8(functionCode());
+    if (type == Request) {
+        if (requestSizeCalculators.exists()) {
+            if (auto calculator = requestSizeCalculators()->value(key, nullptr))
+                return calculator(toPdu<QModbusRequest>());
+        }
+    } else if (responseSizeCalculators.exists()) {
+        if (auto calculator = responseSizeCalculators()->value(key, nullptr))
+            return calculator(toPdu<QModbusResponse>());
+    }
+    return calculateDataSize(type);
+}
+
 /*!
     \relates QModbusResponse
 
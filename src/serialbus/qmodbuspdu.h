@@ -4,6 +4,7 @@
 #define QMODBUSPDU_H
 
 #include <QtCore/qdatastream.h>
+#include <QtCore/qendian.h>
 #include <QtCore/qiodevice.h>
 #include <QtCore/qlist.h>
 #include <QtCore/qmetatype.h>
@@ -112,41 +113,50 @@ private:
     template <typename T>
     using is_pod = std::integral_constant<bool, std::is_trivial<T>::value && std::is_standard_layout<T>::value>;
 
-    template <typename T> void encode(QDataStream *stream, const T &t) {
+    // The values are written in big-endian byte order, directly into the data. Unlike going
+    // through a QDataStream, this allocates the data once and nothing else.
+    template <typename T> static constexpr qsizetype encodedSize(const T &) {
         static_assert(is_pod<T>::value, "Only POD types supported.");
         static_assert(IsType<T, quint8, quint16>::value, "Only quint8 and quint16 supported.");
-        (*stream) << t;
+        return qsizetype(sizeof(T));
     }
-    template <typename T> void decode(QDataStream *stream, T &t) const {
-        static_assert(is_pod<T>::value, "Only POD types supported.");
-        static_assert(IsType<T, quint8 *, quint16 *>::value, "Only quint8* and quint16* supported.");
-        (*stream) >> *t;
+    template <typename T> static qsizetype encodedSize(const QList<T> &vector) {
+        return encodedSize(T()) * vector.size();
     }
-    template<typename T>
-    void encode(QDataStream *stream, const QList<T> &vector)
-    {
+    template <typename T> static void encode(char **out, const T &t) {
+        qToBigEndian<T>(t, *out);
+        *out += sizeof(T);
+    }
+    template <typename T> static void encode(char **out, const QList<T> &vector) {
+        for (const T &t : vector)
+            encode(out, t);
+    }
+    template <typename T> void decode(qsizetype *offset, T t) const {
         static_assert(is_pod<T>::value, "Only POD types supported.");
-        static_assert(IsType<T, quint8, quint16>::value, "Only quint8 and quint16 supported.");
-        for (int i = 0; i < vector.size(); ++i)
-            (*stream) << vector[i];
+        static_assert(IsType<T, quint8 *, quint16 *>::value, "Only quint8* and quint16* supported.");
+        using Value = std::remove_pointer_t<T>;
+        if (*offset + qsizetype(sizeof(Value)) > m_data.size()) {
+            *t = 0; // like reading past the end of a QDataStream
+            *offset = m_data.size();
+            return;
+        }
+        *t = qFromBigEndian<Value>(m_data.constData() + *offset);
+        *offset += sizeof(Value);
     }
 
     template<typename ... Args> void encode(Args ... newData) {
         m_data.clear();
-        constexpr size_t argCount = sizeof...(Args);
-        if constexpr (argCount > 0) {
-            QDataStream stream(&m_data, QIODevice::WriteOnly);
-            char tmp[argCount] = { (encode(&stream, newData), void(), '0')... };
-            Q_UNUSED(tmp);
+        if constexpr (sizeof...(Args) > 0) {
+            m_data.resize((encodedSize(newData) + ...));
+            char *out = m_data.data();
+            (encode(&out, newData), ...);
         }
     }
     template<typename ... Args> void decode(Args ... newData) const {
-        constexpr size_t argCount = sizeof...(Args);
-        if constexpr (argCount > 0) {
+        if constexpr (sizeof...(Args) > 0) {
             if (!m_data.isEmpty()) {
-                QDataStream stream(m_data);
-                char tmp[argCount] = { (decode(&stream, newData), void(), '0')... };
-                Q_UNUSED(tmp);
+                qsizetype offset = 0;
+                (decode(&offset, newData), ...);
             }
         }
     }
@@ -155,6 +165,7 @@ private:
     FunctionCode m_code = Invalid;
     QByteArray m_data;
     friend class QModbusSerialAdu;
+    friend class QModbusPduView;
     friend struct QModbusPduPrivate;
 };
 Q_SERIALBUS_EXPORT QDebug operator<<(QDebug debug, const QModbusPdu &pdu);
@@ -0,0 +1,373 @@
+// Copyright (C) 2023 The Qt Company Ltd.
+// SPDX-License-Identifier: LicenseRef-Qt-Commercial OR LGPL-3.0-only OR GPL-2.0-only OR GPL-3.0-only
+
+#ifndef QMODBUSPDUBUFFER_P_H
+#define QMODBUSPDUBUFFER_P_H
+
+#include <QtCore/qendian.h>
+#include <QtCore/qlist.h>
+#include <QtSerialBus/qmodbuspdu.h>
+#include <QtCore/private/qglobal_p.h>
+
+#include <private/qmodbus_symbols_p.h>
+
+#include <array>
+#include <cstring>
+
+//
+//  W A R N I N G
+//  -------------
+//
+// This file is not part of the Qt API. It exists purely as an
+// implementation detail. This header file may change from version to
+// version without notice, or even be removed.
+//
+// We mean it.
+//
+
+QT_BEGIN_NAMESPACE
+
+namespace QModbusPduSizes {
+
+enum Kind : quint8 {
+    Unknown,    // not a standard function code
+    Fixed,      // the minimum data size
+    ByteCount,  // offset + 1 + the byte at offset
+    WordCount,  // offset + 2 + the big-endian word at offset
+    Encapsulated
+};
+
+struct Entry
+{
+    qint8 minimum = -1;
+    Kind kind = Unknown;
+    quint8 offset = 0;
+};
+
+struct FunctionEntry
+{
+    Entry request;
+    Entry response;
+};
+
+// Indexed by the function code without the exception bit.
+using Table = std::array<FunctionEntry, 128>;
+
+constexpr Table makeTable()
+{
+    Table table {};
+    auto set = [&table](QModbusPdu::FunctionCode code, Entry request, Entry response) {
+        table[code] = { request, response };
+    };
+    set(QModbusPdu::ReadCoils, { 4, Fixed }, { 2, ByteCount, 0 });
+    set(QModbusPdu::ReadDiscreteInputs, { 4, Fixed }, { 2, ByteCount, 0 });
+    set(QModbusPdu::ReadHoldingRegisters, { 4, Fixed }, { 3, ByteCount, 0 });
+    set(QModbusPdu::ReadInputRegisters, { 4, Fixed }, { 3, ByteCount, 0 });
+    set(QModbusPdu::WriteSingleCoil, { 4, Fixed }, { 4, Fixed });
+    set(QModbusPdu::WriteSingleRegister, { 4, Fixed }, { 4, Fixed });
+    set(QModbusPdu::ReadExceptionStatus, { 0, Fixed }, { 1, Fixed });
+    set(QModbusPdu::Diagnostics, { 4, Fixed }, { 4, Fixed });
+    set(QModbusPdu::GetCommEventCounter, { 0, Fixed }, { 4, Fixed });
+    set(QModbusPdu::GetCommEventLog, { 0, Fixed }, { 8, ByteCount, 0 });
+    set(QModbusPdu::WriteMultipleCoils, { 6, ByteCount, 4 }, { 4, Fixed });
+    set(QModbusPdu::WriteMultipleRegisters, { 7, ByteCount, 4 }, { 4, Fixed });
+    set(QModbusPdu::ReportServerId, { 0, Fixed }, { 3, ByteCount, 0 });
+    set(QModbusPdu::ReadFileRecord, { 8, ByteCount, 0 }, { 5, ByteCount, 0 });
+    set(QModbusPdu::WriteFileRecord, { 10, ByteCount, 0 }, { 10, ByteCount, 0 });
+    set(QModbusPdu::MaskWriteRegister, { 6, Fixed }, { 6, Fixed });
+    set(QModbusPdu::ReadWriteMultipleRegisters, { 11, ByteCount, 8 }, { 3, ByteCount, 0 });
+    set(QModbusPdu::ReadFifoQueue, { 2, Fixed }, { 6, WordCount, 0 });
+    set(QModbusPdu::EncapsulatedInterfaceTransport, { 2, Encapsulated }, { 2, Encapsulated });
+    return table;
+}
+
+inline constexpr Table table = makeTable();
+
+constexpr Entry entry(quint8 functionCode, bool request)
+{
+    const FunctionEntry &function = table[functionCode & ~QModbusPdu::ExceptionByte];
+    return request ? function.request : function.response;
+}
+
+} // namespace QModbusPduSizes
+
+/*
+    A non-owning view of a PDU: the function code as transmitted, including
+    the exception bit, and the data following it. Decoding and the size
+    calculations work on the raw bytes and do not allocate.
+*/
+class QModbusPduView
+{
+public:
+    enum Type { Request, Response };
+
+    static constexpr qsizetype MaxDataSize = 252;
+
+    constexpr QModbusPduView() noexcept = default;
+    constexpr QModbusPduView(quint8 functionCode, const char *data, qsizetype size) noexcept
+        : m_code(functionCode), m_data(data), m_size(size)
+    {}
+    QModbusPduView(const QModbusPdu &pdu) noexcept
+        : m_code(quint8(pdu.m_code)), m_data(pdu.m_data.constData()), m_size(pdu.m_data.size())
+    {}
+
+    // The function code is the first byte of pdu, the PDU must not be empty.
+    static constexpr QModbusPduView fromRawPdu(const char *pdu, qsizetype size) noexcept
+    {
+        return QModbusPduView(quint8(pdu[0]), pdu + 1, size - 1);
+    }
+
+    constexpr quint8 rawFunctionCode() const noexcept { return m_code; }
+    constexpr QModbusPdu::FunctionCode functionCode() const noexcept
+    {
+        return QModbusPdu::FunctionCode(m_code & ~QModbusPdu::ExceptionByte);
+    }
+    constexpr bool isException() const noexcept { return m_code & QModbusPdu::ExceptionByte; }
+
+    constexpr const char *data() const noexcept { return m_data; }
+    constexpr qsizetype dataSize() const noexcept { return m_size; }
+    constexpr qsizetype size() const noexcept { return m_size + 1; }
+
+    constexpr quint8 byteAt(qsizetype index) const noexcept { return quint8(m_data[index]); }
+    constexpr quint16 wordAt(qsizetype index) const noexcept
+    {
+        return quint16(byteAt(index) << 8 | byteAt(index + 1));
+    }
+
+    /*
+        Reads big-endian quint8 and quint16 values from the start of the data,
+        like QModbusPdu::decodeData(). Returns false, and sets the values that
+        could not be read to 0, if the data is too short.
+    */
+    template <typename ... Args>
+    bool decode(Args *... values) const noexcept
+    {
+        qsizetype offset = 0;
+        bool ok = true;
+        ((ok = read(&offset, values) && ok), ...);
+        return ok;
+    }
+
+    // Copies the function code and data to out, which must hold size() bytes.
+    qsizetype copyTo(char *out) const noexcept
+    {
+        out[0] = char(m_code);
+        if (m_size > 0)
+            memcpy(out + 1, m_data, size_t(m_size));
+        return size();
+    }
+
+    template <typename Pdu>
+    Pdu toPdu() const
+    {
+        return Pdu(QModbusPdu::FunctionCode(m_code), QByteArray(m_data, m_size));
+    }
+
+    static constexpr int minimumDataSize(quint8 functionCode, Type type) noexcept
+    {
+        if (functionCode & QModbusPdu::ExceptionByte)
+            return 1;
+        return QModbusPduSizes::entry(functionCode, type == Request).minimum;
+    }
+
+    /*
+        Returns the data size of the PDU as defined by the function code and the
+        leading data bytes, or -1 if the function code is not a standard one or
+        more data is needed. Size calculators registered with the PDU classes are
+        not taken into account, see expectedDataSize().
+    */
+    constexpr int calculateDataSize(Type type) const noexcept
+    {
+        if (isException())
+            return 1;
+
+        const QModbusPduSizes::Entry entry = QModbusPduSizes::entry(m_code, type == Request);
+        switch (entry.kind) {
+        case QModbusPduSizes::Unknown:
+            return -1;
+        case QModbusPduSizes::Fixed:
+            return entry.minimum;
+        case QModbusPduSizes::ByteCount:
+            if (m_size <= entry.offset)
+                return -1;
+            return entry.offset + 1 + byteAt(entry.offset);
+        case QModbusPduSizes::WordCount:
+            if (m_size < entry.offset + 2)
+                return -1;
+            return entry.offset + 2 + wordAt(entry.offset);
+        case QModbusPduSizes::Encapsulated:
+            if (m_size < entry.minimum)
+                return -1;
+            return type == Request ? encapsulatedRequestSize(entry.minimum)
+                                   : encapsulatedResponseSize(entry.minimum);
+        }
+        return -1;
+    }
+
+    /*
+        Like calculateDataSize(), but a size calculator registered for the
+        function code is used instead if there is one.
+    */
+    Q_SERIALBUS_EXPORT int expectedDataSize(Type type) const;
+
+private:
+    template <typename T>
+    constexpr bool read(qsizetype *offset, T *value) const noexcept
+    {
+        static_assert(std::is_same_v<T, quint8> || std::is_same_v<T, quint16>,
+                      "Only quint8* and quint16* supported.");
+        if (*offset + qsizetype(sizeof(T)) > m_size) {
+            *value = 0;
+            *offset = m_size;
+            return false;
+        }
+        if constexpr (sizeof(T) == 1)
+            *value = byteAt(*offset);
+        else
+            *value = wordAt(*offset);
+        *offset += sizeof(T);
+        return true;
+    }
+
+    constexpr int encapsulatedRequestSize(int minimum) const noexcept
+    {
+        // ReadDeviceIdentification: MEI type + read device id code + object id
+        return byteAt(0) == EncapsulatedInterfaceTransport::ReadDeviceIdentification ? 3 : minimum;
+    }
+
+    constexpr int encapsulatedResponseSize(int minimum) const noexcept
+    {
+        if (byteAt(0) != EncapsulatedInterfaceTransport::ReadDeviceIdentification)
+            return minimum; // TODO: calculate CanOpenGeneralReference
+
+        // header 6 bytes: MEI type + read device id + conformity level + more follows + next
+        // object id + number of objects; first object 2 bytes: object id + object size
+        if (m_size < 8)
+            return 8;
+
+        const quint8 numberOfObjects = byteAt(5);
+        quint8 objectSize = byteAt(7);
+        // 6 bytes header + (2 * n bytes fixed per object) + first object size
+        int size = 6 + (2 * numberOfObjects) + objectSize;
+        if (numberOfObjects == 1 || m_size < size)
+            return size;
+
+        // header + object id + object size + second object id (9 bytes) + first object size
+        qsizetype nextSizeField = 9 + objectSize;
+        for (int i = 1; i < numberOfObjects; ++i) {
+            if (m_size <= nextSizeField)
+                break;
+            objectSize = byteAt(nextSizeField);
+            size += objectSize;
+            nextSizeField += objectSize + 2; // object size + object id field + object size field
+        }
+        return size;
+    }
+
+    quint8 m_code = 0;
+    const char *m_data = nullptr;
+    qsizetype m_size = 0;
+};
+
+/*
+    A PDU built in a fixed buffer of the maximum PDU size, without heap
+    allocations. Values that do not fit anymore are dropped and mark the
+    buffer as overflowed.
+*/
+class QModbusPduBuffer
+{
+public:
+    static constexpr qsizetype MaxDataSize = QModbusPduView::MaxDataSize;
+
+    constexpr QModbusPduBuffer() noexcept = default;
+    explicit constexpr QModbusPduBuffer(quint8 functionCode) noexcept
+        : m_code(functionCode)
+    {}
+    template <typename ... Args>
+    QModbusPduBuffer(QModbusPdu::FunctionCode code, Args ... values) noexcept
+        : m_code(quint8(code))
+    {
+        (append(values), ...);
+    }
+
+    constexpr quint8 rawFunctionCode() const noexcept { return m_code; }
+    constexpr void setRawFunctionCode(quint8 code) noexcept { m_code = code; }
+
+    constexpr const char *data() const noexcept { return m_data.data(); }
+    constexpr qsizetype dataSize() const noexcept { return m_size; }
+    constexpr qsizetype size() const noexcept { return m_size + 1; }
+    constexpr bool hasOverflow() const noexcept { return m_overflow; }
+
+    constexpr void clear() noexcept
+    {
+        m_size = 0;
+        m_overflow = false;
+    }
+
+    constexpr void append(quint8 value) noexcept
+    {
+        if (!reserve(1))
+            return;
+        m_data[m_size++] = char(value);
+    }
+    constexpr void append(quint16 value) noexcept
+    {
+        if (!reserve(2))
+            return;
+        m_data[m_size++] = char(value >> 8);
+        m_data[m_size++] = char(value & 0xff);
+    }
+    template <typename T>
+    void append(const QList<T> &values) noexcept
+    {
+        static_assert(std::is_same_v<T, quint8> || std::is_same_v<T, quint16>,
+                      "Only quint8 and quint16 supported.");
+        if (!reserve(qsizetype(sizeof(T)) * values.size()))
+            return;
+        for (T value : values) {
+            qToBigEndian<T>(value, m_data.data() + m_size);
+            m_size += sizeof(T);
+        }
+    }
+    void append(const QByteArray &bytes) noexcept { append(bytes.constData(), bytes.size()); }
+    void append(const char *data, qsizetype size) noexcept
+    {
+        if (!reserve(size))
+            return;
+        memcpy(m_data.data() + m_size, data, size_t(size));
+        m_size += size;
+    }
+
+    template <typename ... Args>
+    void encodeData(Args ... values) noexcept
+    {
+        clear();
+        (append(values), ...);
+    }
+
+    constexpr QModbusPduView view() const noexcept
+    {
+        return QModbusPduView(m_code, m_data.data(), m_size);
+    }
+
+    template <typename Pdu>
+    Pdu toPdu() const { return view().toPdu<Pdu>(); }
+
+private:
+    constexpr bool reserve(qsizetype size) noexcept
+    {
+        if (m_size + size <= MaxDataSize)
+            return true;
+        m_overflow = true;
+        return false;
+    }
+
+    quint8 m_code = 0;
+    bool m_overflow = false;
+    qsizetype m_size = 0;
+    std::array<char, MaxDataSize> m_data {};
+};
+
+QT_END_NAMESPACE
+
+#endif // QMODBUSPDUBUFFER_P_H
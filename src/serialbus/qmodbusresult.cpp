@@ -0,0 +1,226 @@
+// Copyright (C) 2023 The Qt Company Ltd.
+// SPDX-License-Identifier: LicenseRef-Qt-Commercial OR LGPL-3.0-only OR GPL-2.0-only OR GPL-3.0-only
+
+#include "qmodbusresult.h"
+#include "qmodbusresult_p.h"
+
+QT_BEGIN_NAMESPACE
+
+/*!
+    \class QModbusResult
+    \inmodule QtSerialBus
+    \since 6.7
+
+    \brief The QModbusResult class holds the outcome of a Modbus request sent
+    with a result handler.
+
+    QModbusResult carries the same information as a finished \l QModbusReply,
+    as a plain value. It is passed to the handler given to one of the
+    QModbusClient functions taking a handler, for example
+    \l {QModbusClient::}{sendReadRequest()}. No QObject is created for such
+    requests, so there are no signal connections and no deferred deletion per
+    request, which matters for applications issuing many requests per second.
+    The handler, the state shared by the transport and the result are still
+    allocated on the heap for every request.
+
+    \sa QModbusReply, QModbusClient::ResultHandler
+*/
+
+/*!
+    Constructs an empty result of type \l QModbusReply::Raw, without error.
+    The server address is set to \c -1.
+*/
+QModbusResult::QModbusResult()
+    : d_ptr(new QModbusResultPrivate)
+{
+}
+
+/*!
+    Constructs a result of the given \a type for a request sent to
+    \a serverAddress.
+*/
+QModbusResult::QModbusResult(QModbusReply::ReplyType type, int serverAddress)
+    : d_ptr(new QModbusResultPrivate)
+{
+    d_ptr->type = type;
+    d_ptr->serverAddress = serverAddress;
+}
+
+/*!
+    Constructs a copy of \a other.
+*/
+QModbusResult::QModbusResult(const QModbusResult &) = default;
+
+/*!
+    \fn QModbusResult::QModbusResult(QModbusResult &&other)
+
+    Move-constructs a result from \a other.
+
+    \note The moved-from QModbusResult object can only be destroyed or
+    assigned to.
+*/
+
+/*!
+    Destroys the result.
+*/
+QModbusResult::~QModbusResult() = default;
+
+/*!
+    Assigns \a other to this result and returns a reference to this result.
+*/
+QModbusResult &QModbusResult::operator=(const QModbusResult &) = default;
+
+/*!
+    \fn QModbusResult &QModbusResult::operator=(QModbusResult &&other)
+
+    Move-assigns \a other to this result.
+*/
+
+/*!
+    \fn void QModbusResult::swap(QModbusResult &other)
+
+    Swaps this result with \a other. This operation is very fast and never
+    fails.
+*/
+
+/*!
+    Returns the type of the request this result belongs to.
+
+    \sa setType()
+*/
+QModbusReply::ReplyType QModbusResult::type() const
+{
+    return d_ptr->type;
+}
+
+/*!
+    Sets the request type of the result to \a type.
+
+    \sa type()
+*/
+void QModbusResult::setType(QModbusReply::ReplyType type)
+{
+    d_ptr->type = type;
+}
+
+/*!
+    Returns the address of the server the request was sent to.
+
+    \sa setServerAddress()
+*/
+int QModbusResult::serverAddress() const
+{
+    return d_ptr->serverAddress;
+}
+
+/*!
+    Sets the address of the server the request was sent to to
+    \a serverAddress.
+
+    \sa serverAddress()
+*/
+void QModbusResult::setServerAddress(int serverAddress)
+{
+    d_ptr->serverAddress = serverAddress;
+}
+
+/*!
+    Returns the preprocessed result of the request, see
+    \l QModbusReply::result(). The returned unit is invalid for broadcasts,
+    failed requests and write requests.
+
+    \sa setResult(), rawResult()
+*/
+QModbusDataUnit QModbusResult::result() const
+{
+    return d_ptr->type != QModbusReply::Broadcast ? d_ptr->unit : QModbusDataUnit();
+}
+
+/*!
+    Sets the preprocessed result of the request to \a unit.
+
+    \sa result()
+*/
+void QModbusResult::setResult(const QModbusDataUnit &unit)
+{
+    d_ptr->unit = unit;
+}
+
+/*!
+    Returns the raw response of the server. In case of a
+    \l QModbusDevice::ProtocolError, it holds the exception response.
+
+    \sa setRawResult(), result()
+*/
+QModbusResponse QModbusResult::rawResult() const
+{
+    return d_ptr->response;
+}
+
+/*!
+    Sets the raw response of the server to \a response.
+
+    \sa rawResult()
+*/
+void QModbusResult::setRawResult(const QModbusResponse &response)
+{
+    d_ptr->response = response;
+}
+
+/*!
+    Returns the error of the request, or \l QModbusDevice::NoError if the
+    request succeeded.
+
+    \sa errorString(), setError()
+*/
+QModbusDevice::Error QModbusResult::error() const
+{
+    return d_ptr->error;
+}
+
+/*!
+    Returns the textual representation of error(), or an empty string if the
+    request succeeded.
+
+    \sa error()
+*/
+QString QModbusResult::errorString() const
+{
+    return d_ptr->errorText;
+}
+
+/*!
+    Sets the error of the request to \a error and its textual representation
+    to \a errorText.
+
+    \sa error(), errorString()
+*/
+void QModbusResult::setError(QModbusDevice::Error error, const QString &errorText)
+{
+    d_ptr->error = error;
+    d_ptr->errorText = errorText;
+}
+
+/*!
+    Returns the errors that occurred while processing the request, but did not
+    result in a failure, for example a response with a wrong checksum that was
+    followed by a valid one.
+
+    \sa addIntermediateError(), QModbusReply::intermediateErrors()
+*/
+QList<QModbusDevice::IntermediateError> QModbusResult::intermediateErrors() const
+{
+    return d_ptr->intermediateErrors;
+}
+
+/*!
+    Adds \a error to the list of intermediate errors.
+
+    \sa intermediateErrors()
+*/
+void QModbusResult::addIntermediateError(QModbusDevice::IntermediateError error)
+{
+    d_ptr->intermediateErrors.append(error);
+}
+
+QT_END_NAMESPACE
@@ -0,0 +1,62 @@
+// Copyright (C) 2023 The Qt Company Ltd.
+// SPDX-License-Identifier: LicenseRef-Qt-Commercial OR LGPL-3.0-only OR GPL-2.0-only OR GPL-3.0-only
+
+#ifndef QMODBUSRESULT_H
+#define QMODBUSRESULT_H
+
+#include <QtCore/qlist.h>
+#include <QtCore/qshareddata.h>
+#include <QtCore/qstring.h>
+#include <QtSerialBus/qmodbusdataunit.h>
+#include <QtSerialBus/qmodbusdevice.h>
+#include <QtSerialBus/qmodbuspdu.h>
+#include <QtSerialBus/qmodbusreply.h>
+
+QT_BEGIN_NAMESPACE
+
+class QModbusResultPrivate;
+
+class Q_SERIALBUS_EXPORT QModbusResult
+{
+public:
+    QModbusResult();
+    QModbusResult(QModbusReply::ReplyType type, int serverAddress);
+    QModbusResult(const QModbusResult &other);
+    QModbusResult(QModbusResult &&other) noexcept = default;
+    ~QModbusResult();
+
+    QModbusResult &operator=(const QModbusResult &other);
+    QT_MOVE_ASSIGNMENT_OPERATOR_IMPL_VIA_PURE_SWAP(QModbusResult)
+
+    void swap(QModbusResult &other) noexcept { d_ptr.swap(other.d_ptr); }
+
+    QModbusReply::ReplyType type() const;
+    void setType(QModbusReply::ReplyType type);
+
+    int serverAddress() const;
+    void setServerAddress(int serverAddress);
+
+    QModbusDataUnit result() const;
+    void setResult(const QModbusDataUnit &unit);
+
+    QModbusResponse rawResult() const;
+    void setRawResult(const QModbusResponse &response);
+
+    QModbusDevice::Error error() const;
+    QString errorString() const;
+    void setError(QModbusDevice::Error error, const QString &errorText);
+
+    QList<QModbusDevice::IntermediateError> intermediateErrors() const;
+    void addIntermediateError(QModbusDevice::IntermediateError error);
+
+private:
+    QSharedDataPointer<QModbusResultPrivate> d_ptr;
+};
+
+Q_DECLARE_SHARED(QModbusResult)
+
+QT_END_NAMESPACE
+
+Q_DECLARE_METATYPE(QModbusResult)
+
+#endif // QMODBUSRESULT_H
@@ -0,0 +1,42 @@
+// Copyright (C) 2023 The Qt Company Ltd.
+// SPDX-License-Identifier: LicenseRef-Qt-Commercial OR LGPL-3.0-only OR GPL-2.0-only OR GPL-3.0-only
+
+#ifndef QMODBUSRESULT_P_H
+#define QMODBUSRESULT_P_H
+
+#include <QtCore/qlist.h>
+#include <QtCore/qshareddata.h>
+#include <QtCore/qstring.h>
+#include <QtSerialBus/qmodbusdataunit.h>
+#include <QtSerialBus/qmodbusdevice.h>
+#include <QtSerialBus/qmodbuspdu.h>
+#include <QtSerialBus/qmodbusreply.h>
+
+//
+//  W A R N I N G
+//  -------------
+//
+// This file is not part of the Qt API. It exists purely as an
+// implementation detail. This header file may change from version to
+// version without notice, or even be removed.
+//
+// We mean it.
+//
+
+QT_BEGIN_NAMESPACE
+
+class QModbusResultPrivate : public QSharedData
+{
+public:
+    QModbusReply::ReplyType type = QModbusReply::Raw;
+    int serverAddress = -1;
+    QModbusDevice::Error error = QModbusDevice::NoError;
+    QModbusDataUnit unit;
+    QModbusResponse response;
+    QString errorText;
+    QList<QModbusDevice::IntermediateError> intermediateErrors;
+};
+
+QT_END_NAMESPACE
+
+#endif // QMODBUSRESULT_P_H
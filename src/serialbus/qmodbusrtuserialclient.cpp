@@ -51,7 +51,7 @@ QModbusRtuSerialClient::~QModbusRtuSerialClient()
 int QModbusRtuSerialClient::interFrameDelay() const
 {
     Q_D(const QModbusRtuSerialClient);
-    return d->m_interFrameDelayMilliseconds * 1000;
+    return d->m_interFrameDelayMicroseconds;
 }
 
 /*!
@@ -66,7 +66,55 @@ int QModbusRtuSerialClient::interFrameDelay() const
 void QModbusRtuSerialClient::setInterFrameDelay(int microseconds)
 {
     Q_D(QModbusRtuSerialClient);
-    d->m_interFrameDelayMilliseconds = qCeil(qreal(microseconds) / 1000.);
+    d->m_requestedInterFrameDelay = microseconds;
+    d->calculateInterFrameDelay();
+}
+
+/*!
+    \since 6.7
+
+    Returns \c true if the low latency mode is enabled; otherwise \c false.
+    The low latency mode is disabled by default.
+
+    \sa setLowLatencyEnabled()
+*/
+bool QModbusRtuSerialClient::isLowLatencyEnabled() const
+{
+    Q_D(const QModbusRtuSerialClient);
+    return d->m_lowLatencyMode;
+}
+
+/*!
+    \since 6.7
+
+    Enables the low latency mode if \a enabled is \c true; otherwise disables
+    it. A active or running connection is not affected by such changes.
+
+    By default, the silent interval between two Modbus messages is fixed to
+    1.75 milliseconds (approximated as 2 milliseconds) for baud rates of
+    19200 and above, as recommended by the Modbus specification. In low latency
+    mode, the interval is 3.5 times the character time of the configured serial
+    settings instead, for example about 335 microseconds at 115200 baud with 8
+    data bits, even parity and one stop bit. The interval is measured from the
+    end of the last frame, so the time spent processing a reply already counts
+    towards it, allowing the line to run close to its maximum request rate.
+    The remaining interval is waited for with a timer, which has a resolution
+    of one millisecond: the interval is rounded up to the next full
+    millisecond, so the line may stay idle up to one millisecond longer than
+    required.
+
+    On Linux, the serial driver is additionally asked to pass on received
+    characters immediately, if it supports it.
+
+    \note All devices on the serial line need to detect frame boundaries with
+    the shorter silent interval.
+
+    \sa interFrameDelay()
+*/
+void QModbusRtuSerialClient::setLowLatencyEnabled(bool enabled)
+{
+    Q_D(QModbusRtuSerialClient);
+    d->m_lowLatencyMode = enabled;
     d->calculateInterFrameDelay();
 }
 
@@ -123,6 +171,7 @@ bool QModbusRtuSerialClient::open()
     if (d->m_serialPort->open(QIODevice::ReadWrite)) {
         setState(QModbusDevice::ConnectedState);
         d->m_serialPort->clear(); // only possible after open
+        d->enableLowLatencyMode(d->m_serialPort);
     } else {
         setError(d->m_serialPort->errorString(), QModbusDevice::ConnectionError);
     }
@@ -141,16 +190,18 @@ void QModbusRtuSerialClient::close()
 
     Q_D(QModbusRtuSerialClient);
 
-    if (d->m_serialPort->isOpen())
+    if (d->m_serialPort->isOpen()) {
+        d->restoreLatencyMode(d->m_serialPort);
         d->m_serialPort->close();
+    }
 
     int numberOfAborts = 0;
     while (!d->m_queue.isEmpty()) {
         // Finish each open reply and forget them
         QModbusRtuSerialClientPrivate::QueueElement elem = d->m_queue.dequeue();
-        if (!elem.reply.isNull()) {
-            elem.reply->setError(QModbusDevice::ReplyAbortedError,
-                                 QModbusClient::tr("Reply aborted due to connection closure."));
+        if (!elem.isAbandoned()) {
+            elem.setError(QModbusDevice::ReplyAbortedError,
+                          QModbusClient::tr("Reply aborted due to connection closure."));
             numberOfAborts++;
         }
     }
@@ -27,6 +27,9 @@ public:
     int interFrameDelay() const;
     void setInterFrameDelay(int microseconds);
 
+    bool isLowLatencyEnabled() const;
+    void setLowLatencyEnabled(bool enabled);
+
     int turnaroundDelay() const;
     void setTurnaroundDelay(int turnaroundDelay);
 
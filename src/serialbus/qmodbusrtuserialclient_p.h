@@ -4,6 +4,7 @@
 #ifndef QMODBUSRTUSERIALCLIENT_P_H
 #define QMODBUSRTUSERIALCLIENT_P_H
 
+#include <QtCore/qelapsedtimer.h>
 #include <QtCore/qloggingcategory.h>
 #include <QtCore/qmath.h>
 #include <QtCore/qpointer.h>
@@ -13,6 +14,7 @@
 #include <QtSerialPort/qserialport.h>
 
 #include <private/qmodbusadu_p.h>
+#include <private/qmodbuspdubuffer_p.h>
 #include <private/qmodbusclient_p.h>
 #include <private/qmodbus_symbols_p.h>
 
@@ -76,6 +78,8 @@ public:
     void onReadyRead()
     {
         m_responseBuffer += m_serialPort->read(m_serialPort->bytesAvailable());
+        m_lineIdle.start(); // the line was busy until the last character arrived
+        m_lineIdleOffset = 0;
         qCDebug(QT_MODBUS_LOW) << "(RTU client) Response buffer:" << m_responseBuffer.toHex();
 
         if (m_responseBuffer.size() < 2) {
@@ -84,11 +88,14 @@ public:
         }
 
         const QModbusSerialAdu tmpAdu(QModbusSerialAdu::Rtu, m_responseBuffer);
-        int pduSizeWithoutFcode = QModbusResponse::calculateDataSize(tmpAdu.pdu());
+        // The PDU follows the server address, the size is calculated in place.
+        const QModbusPduView pduView = QModbusPduView::fromRawPdu(m_responseBuffer.constData() + 1,
+                                                                  m_responseBuffer.size() - 1);
+        int pduSizeWithoutFcode = pduView.expectedDataSize(QModbusPduView::Response);
         if (pduSizeWithoutFcode < 0) {
             // wait for more data
             qCDebug(QT_MODBUS) << "(RTU client) Cannot calculate PDU size for function code:"
-                << tmpAdu.pdu().functionCode() << ", delaying pending frame";
+                << pduView.functionCode() << ", delaying pending frame";
             return;
         }
 
@@ -105,7 +112,7 @@ public:
 
         // Special case for Diagnostics:ReturnQueryData. The response has no
         // length indicator and is just a simple echo of what we have send.
-        if (tmpAdu.pdu().functionCode() == QModbusPdu::Diagnostics) {
+        if (pduView.functionCode() == QModbusPdu::Diagnostics) {
             const QModbusResponse response = tmpAdu.pdu();
             if (canMatchRequestAndResponse(response, tmpAdu.serverAddress())) {
                 quint16 subCode = 0xffff;
@@ -132,7 +139,9 @@ public:
             qCWarning(QT_MODBUS) << "(RTU client) Discarding response with wrong CRC, received:"
                 << adu.checksum<quint16>() << ", calculated CRC:"
                 << QModbusSerialAdu::calculateCRC(adu.data(), adu.size());
-            m_queue.first().reply->addIntermediateError(QModbusClient::ResponseCrcError);
+            if (!current.isAbandoned())
+                recordCrcError(current);
+            current.addIntermediateError(QModbusClient::ResponseCrcError);
             return;
         }
 
@@ -140,7 +149,7 @@ public:
         if (!canMatchRequestAndResponse(response, adu.serverAddress())) {
             qCWarning(QT_MODBUS) << "(RTU client) Cannot match response with open request, "
                 "ignoring";
-            m_queue.first().reply->addIntermediateError(QModbusClient::ResponseRequestMismatch);
+            current.addIntermediateError(QModbusClient::ResponseRequestMismatch);
             return;
         }
 
@@ -148,10 +157,11 @@ public:
         m_responseTimer.stop();
         current.m_timerId = INT_MIN;
 
+        recordResponse(current, response);
         processQueueElement(response, m_queue.dequeue());
 
         m_state = Idle;
-        scheduleNextRequest(m_interFrameDelayMilliseconds);
+        scheduleNextRequest(interFrameSilence());
     }
 
     void onAboutToClose()
@@ -175,16 +185,16 @@ public:
 
         qCDebug(QT_MODBUS) << "(RTU client) Receive timeout:" << current.requestPdu;
 
+        if (!current.isAbandoned())
+            recordTimeout(current, current.numberOfRetries <= 0);
+
         if (current.numberOfRetries <= 0) {
             auto item = m_queue.dequeue();
-            if (item.reply) {
-                item.reply->setError(QModbusDevice::TimeoutError,
-                    QModbusClient::tr("Request timeout."));
-            }
+            item.setError(QModbusDevice::TimeoutError, QModbusClient::tr("Request timeout."));
         }
 
         m_state = Idle;
-        scheduleNextRequest(m_interFrameDelayMilliseconds);
+        scheduleNextRequest(interFrameSilence());
     }
 
     void onBytesWritten(qint64 bytes)
@@ -199,13 +209,21 @@ public:
 
         qCDebug(QT_MODBUS) << "(RTU client) Send successful:" << current.requestPdu;
 
-        if (!current.reply.isNull() && current.reply->type() == QModbusReply::Broadcast) {
+        // The last characters may still be waiting in the transmit buffer of the driver. Assume
+        // the whole frame is, the line is not silent before it was transmitted.
+        m_lineIdle.start();
+        m_lineIdleOffset = current.adu.size() * characterDuration();
+
+        if (!current.isAbandoned() && current.type() == QModbusReply::Broadcast) {
             m_state = ProcessReply;
             processQueueElement({}, m_queue.dequeue());
             m_state = Idle;
-            scheduleNextRequest(m_turnaroundDelay);
+            scheduleNextRequest(qint64(m_turnaroundDelay) * 1000000);
         } else {
-            current.m_timerId = m_responseTimer.start(m_responseTimeoutDuration);
+            current.attempts++;
+            current.sent.start();
+            current.m_timerId = m_responseTimer.start(current.isAbandoned()
+                ? m_responseTimeoutDuration : responseTimeout(current.serverAddress()));
         }
     }
 
@@ -298,6 +316,7 @@ public:
         calculateInterFrameDelay();
 
         m_responseBuffer.clear();
+        m_lineIdle.invalidate();
         m_state = QModbusRtuSerialClientPrivate::Idle;
     }
 
@@ -308,25 +327,71 @@ public:
 
         auto reply = new QModbusReply(serverAddress == 0 ? QModbusReply::Broadcast : type,
             serverAddress, q);
-        QueueElement element(reply, request, unit, m_numberOfRetries + 1);
-        element.adu = QModbusSerialAdu::create(QModbusSerialAdu::Rtu, serverAddress, request);
+        enqueueElement(QueueElement(reply, request, unit, 0));
+        return reply;
+    }
+
+    bool enqueueElement(QueueElement element) override
+    {
+        const int serverAddress = element.serverAddress();
+        if (element.completion && serverAddress == 0)
+            element.completion->result.setType(QModbusReply::Broadcast);
+
+        element.numberOfRetries = m_numberOfRetries + 1;
+        element.adu = QModbusSerialAdu::create(QModbusSerialAdu::Rtu, serverAddress,
+                                               element.requestPdu);
         m_queue.enqueue(element);
+        recordRequest(element, m_queue.size());
 
-        scheduleNextRequest(m_interFrameDelayMilliseconds);
+        scheduleNextRequest(interFrameSilence());
+        return true;
+    }
 
-        return reply;
+    void dropAbandoned() override
+    {
+        // The first request may be on the line, it finishes as usual.
+        for (qsizetype i = m_queue.size() - 1; i > 0; --i) {
+            if (m_queue.at(i).isAbandoned())
+                m_queue.removeAt(i);
+        }
     }
 
-    void scheduleNextRequest(int delay)
+    qint64 interFrameSilence() const
+    {
+        return qint64(m_interFrameDelayMicroseconds) * 1000;
+    }
+
+    // Sends the next request once the line has been silent for silence nanoseconds, measured
+    // from the end of the last frame sent or received. Time spent processing that frame
+    // already counts towards the silence.
+    void scheduleNextRequest(qint64 silence)
     {
         Q_Q(QModbusRtuSerialClient);
 
         if (m_state == Idle && !m_queue.isEmpty()) {
             m_state = WaitingForReplay;
-            QTimer::singleShot(delay, q, [this]() { processQueue(); });
+            m_requiredSilence = silence;
+            QMetaObject::invokeMethod(q, [this]() { waitForSilence(); }, Qt::QueuedConnection);
         }
     }
 
+    // Waits for the rest of the silence with a single precise timer. Timers only have
+    // millisecond resolution, so the wait is rounded up to the next millisecond and the
+    // line may stay idle up to one millisecond longer than the silence requires.
+    void waitForSilence()
+    {
+        Q_Q(QModbusRtuSerialClient);
+
+        const qint64 remaining = m_lineIdle.isValid()
+            ? m_lineIdleOffset + m_requiredSilence - m_lineIdle.nsecsElapsed() : 0;
+        if (remaining <= 0) {
+            processQueue();
+            return;
+        }
+        QTimer::singleShot(qCeil(qreal(remaining) / 1000000.), Qt::PreciseTimer, q,
+                           [this]() { processQueue(); });
+    }
+
     void processQueue()
     {
         m_responseBuffer.clear();
@@ -336,10 +401,19 @@ public:
             return;
         auto &current = m_queue.first();
 
-        if (current.reply.isNull()) {
+        if (current.isAbandoned()) {
             m_queue.dequeue();
             m_state = Idle;
-            scheduleNextRequest(m_interFrameDelayMilliseconds);
+            scheduleNextRequest(interFrameSilence());
+        } else if (isServerDown(current.serverAddress())) {
+            // The server stopped responding after this request was queued. Nothing is sent,
+            // so the next request does not need to wait for the bus to be silent again.
+            qCDebug(QT_MODBUS) << "(RTU client) Server" << current.serverAddress()
+                << "is unavailable, not sending request:" << current.requestPdu;
+            auto item = m_queue.dequeue();
+            item.setError(QModbusDevice::TimeoutError, QModbusClient::tr("Server is unavailable."));
+            m_state = Idle;
+            scheduleNextRequest(0);
         } else {
             current.bytesWritten = 0;
             current.numberOfRetries--;
@@ -357,15 +431,17 @@ public:
             return false;
         const auto &current = m_queue.first();
 
-        if (current.reply.isNull())
+        if (current.isAbandoned())
             return false;   // reply deleted
-        if (current.reply->serverAddress() != sendingServer)
+        if (current.serverAddress() != sendingServer)
             return false;   // server mismatch
         if (current.requestPdu.functionCode() != response.functionCode())
             return false;   // request for different function code
         return true;
     }
 
+    qsizetype queueDepth() const override { return m_queue.size(); }
+
     bool isOpen() const override
     {
         if (m_serialPort)
@@ -382,6 +458,10 @@ public:
     QSerialPort *m_serialPort = nullptr;
 
     int m_turnaroundDelay = 100; // Recommended value is between 100 and 200 msec.
+
+    QElapsedTimer m_lineIdle; // started at the end of the last frame on the line
+    qint64 m_lineIdleOffset = 0; // nanoseconds the frame was still being transmitted
+    qint64 m_requiredSilence = 0;
 };
 
 QT_END_NAMESPACE
@@ -73,7 +73,7 @@ bool QModbusRtuSerialServer::processesBroadcast() const
 int QModbusRtuSerialServer::interFrameDelay() const
 {
     Q_D(const QModbusRtuSerialServer);
-    return d->m_interFrameDelayMilliseconds * 1000;
+    return d->m_interFrameDelayMicroseconds;
 }
 
 /*!
@@ -90,7 +90,50 @@ int QModbusRtuSerialServer::interFrameDelay() const
 void QModbusRtuSerialServer::setInterFrameDelay(int microseconds)
 {
     Q_D(QModbusRtuSerialServer);
-    d->m_interFrameDelayMilliseconds = qCeil(qreal(microseconds) / 1000.);
+    d->m_requestedInterFrameDelay = microseconds;
+    d->calculateInterFrameDelay();
+}
+
+/*!
+    \since 6.7
+
+    Returns \c true if the low latency mode is enabled; otherwise \c false.
+    The low latency mode is disabled by default.
+
+    \sa setLowLatencyEnabled()
+*/
+bool QModbusRtuSerialServer::isLowLatencyEnabled() const
+{
+    Q_D(const QModbusRtuSerialServer);
+    return d->m_lowLatencyMode;
+}
+
+/*!
+    \since 6.7
+
+    Enables the low latency mode if \a enabled is \c true; otherwise disables
+    it. A active or running connection is not affected by such changes.
+
+    By default, the silent interval between two Modbus messages is fixed to
+    1.75 milliseconds (approximated as 2 milliseconds) for baud rates of
+    19200 and above, as recommended by the Modbus specification. In low latency
+    mode, the interval is 3.5 times the character time of the configured serial
+    settings instead, for example about 335 microseconds at 115200 baud with 8
+    data bits, even parity and one stop bit. Frame boundaries are detected with
+    sub-millisecond precision.
+
+    On Linux, the serial driver is additionally asked to pass on received
+    characters immediately, if it supports it.
+
+    \note All devices on the serial line need to detect frame boundaries with
+    the shorter silent interval.
+
+    \sa interFrameDelay()
+*/
+void QModbusRtuSerialServer::setLowLatencyEnabled(bool enabled)
+{
+    Q_D(QModbusRtuSerialServer);
+    d->m_lowLatencyMode = enabled;
     d->calculateInterFrameDelay();
 }
 
@@ -110,6 +153,7 @@ bool QModbusRtuSerialServer::open()
     if (d->m_serialPort->open(QIODevice::ReadWrite)) {
         setState(QModbusDevice::ConnectedState);
         d->m_serialPort->clear(); // only possible after open
+        d->enableLowLatencyMode(d->m_serialPort);
     } else {
         setError(d->m_serialPort->errorString(), QModbusDevice::ConnectionError);
     }
@@ -125,8 +169,10 @@ void QModbusRtuSerialServer::close()
         return;
 
     Q_D(QModbusRtuSerialServer);
-    if (d->m_serialPort->isOpen())
+    if (d->m_serialPort->isOpen()) {
+        d->restoreLatencyMode(d->m_serialPort);
         d->m_serialPort->close();
+    }
 
     setState(QModbusDevice::UnconnectedState);
 }
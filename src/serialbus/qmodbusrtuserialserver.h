@@ -29,6 +29,9 @@ public:
     int interFrameDelay() const;
     void setInterFrameDelay(int microseconds);
 
+    bool isLowLatencyEnabled() const;
+    void setLowLatencyEnabled(bool enabled);
+
 protected:
     QModbusRtuSerialServer(QModbusRtuSerialServerPrivate &dd, QObject *parent = nullptr);
 
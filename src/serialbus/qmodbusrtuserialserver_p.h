@@ -13,6 +13,7 @@
 #include <QtSerialPort/qserialport.h>
 
 #include <private/qmodbusadu_p.h>
+#include <private/qmodbuspdubuffer_p.h>
 #include <private/qmodbusserver_p.h>
 
 //
@@ -43,15 +44,17 @@ public:
         m_serialPort = new QSerialPort(q);
         QObject::connect(m_serialPort, &QSerialPort::readyRead, q, [this]() {
 
-            if (m_interFrameTimer.isValid()
-                    && m_interFrameTimer.elapsed() > m_interFrameDelayMilliseconds
+            // Measured in nanoseconds, a silent interval may be shorter than a millisecond.
+            const qint64 silence = m_interFrameTimer.isValid() ? m_interFrameTimer.nsecsElapsed()
+                                                               : 0;
+            if (silence > qint64(m_interFrameDelayMicroseconds) * 1000
                     && !m_requestBuffer.isEmpty()) {
                 // This permits response buffer clearing if it contains garbage
                 // but still permits cases where very slow baud rates can cause
                 // chunked and delayed packets
                 qCDebug(QT_MODBUS_LOW) << "(RTU server) Dropping older ADU fragments due to larger than 3.5 char delay (expected:"
-                                       << m_interFrameDelayMilliseconds << ", max:"
-                                       << m_interFrameTimer.elapsed() << ")";
+                                       << m_interFrameDelayMicroseconds << "us, max:"
+                                       << silence / 1000 << "us)";
                 m_requestBuffer.clear();
             }
 
@@ -90,7 +93,10 @@ public:
             if (q->processesBroadcast())
                 event |= QModbusCommEvent::ReceiveFlag::BroadcastReceived;
 
-            const int pduSizeWithoutFcode = QModbusRequest::calculateDataSize(adu.pdu());
+            // The PDU is everything between the server address and the CRC.
+            const QModbusPduView pduView(quint8(m_requestBuffer.at(1)),
+                                         m_requestBuffer.constData() + 2, adu.size() - 2);
+            const int pduSizeWithoutFcode = pduView.expectedDataSize(QModbusPduView::Request);
 
             // server address byte + function code byte + PDU size + 2 bytes CRC
             if ((pduSizeWithoutFcode < 0) || ((2 + pduSizeWithoutFcode + 2) != adu.rawSize())) {
@@ -120,131 +126,13 @@ public:
                 return;
             }
 
-            // The quantity of messages that the remote device has detected on the communications
-            // system since its last restart, clear counters operation, or power-up.
-            incrementCounter(QModbusServerPrivate::Counter::BusMessage);
-
-            // If we do not process a Broadcast ...
+            // A broadcast is processed by every hosted unit, as if each received it.
             if (!q->processesBroadcast()) {
-                // check if the server address matches ...
-                if (q->serverAddress() != adu.serverAddress()) {
-                    // no, not our address! Ignore!
-                    qCDebug(QT_MODBUS) << "(RTU server) Wrong server address, expected"
-                        << q->serverAddress() << "got" << adu.serverAddress();
-                    return;
-                }
-            } // else { Broadcast -> Server address will never match, deliberately ignore }
-
-            storeModbusCommEvent(event); // store the final event before processing
-
-            const QModbusRequest req = adu.pdu();
-            qCDebug(QT_MODBUS) << "(RTU server) Request PDU:" << req;
-            QModbusResponse response; // If the device ...
-            if (q->value(QModbusServer::DeviceBusy).value<quint16>() == 0xffff) {
-                // is busy, update the quantity of messages addressed to the remote device for
-                // which it returned a Server Device Busy exception response, since its last
-                // restart, clear counters operation, or power-up.
-                incrementCounter(QModbusServerPrivate::Counter::ServerBusy);
-                response = QModbusExceptionResponse(req.functionCode(),
-                    QModbusExceptionResponse::ServerDeviceBusy);
-            } else {
-                // is not busy, update the quantity of messages addressed to the remote device,
-                // or broadcast, that the remote device has processed since its last restart,
-                // clear counters operation, or power-up.
-                incrementCounter(QModbusServerPrivate::Counter::ServerMessage);
-                response = q->processRequest(req);
-            }
-            qCDebug(QT_MODBUS) << "(RTU server) Response PDU:" << response;
-
-            event = QModbusCommEvent::SentEvent; // reset event after processing
-            if (q->value(QModbusServer::ListenOnlyMode).toBool())
-                event |= QModbusCommEvent::SendFlag::CurrentlyInListenOnlyMode;
-
-            if ((!response.isValid())
-                || q->processesBroadcast()
-                || q->value(QModbusServer::ListenOnlyMode).toBool()) {
-                // The quantity of messages addressed to the remote device for which it has
-                // returned no response (neither a normal response nor an exception response),
-                // since its last restart, clear counters operation, or power-up.
-                incrementCounter(QModbusServerPrivate::Counter::ServerNoResponse);
-                storeModbusCommEvent(event);
+                processUnitRequest(adu, adu.serverAddress(), event);
                 return;
             }
-
-            const QByteArray result = QModbusSerialAdu::create(QModbusSerialAdu::Rtu,
-                                                               q->serverAddress(), response);
-
-            qCDebug(QT_MODBUS_LOW) << "(RTU server) Response ADU:" << result.toHex();
-
-            if (!m_serialPort->isOpen()) {
-                qCDebug(QT_MODBUS) << "(RTU server) Requesting serial port has closed.";
-                q->setError(QModbusRtuSerialServer::tr("Requesting serial port is closed"),
-                            QModbusDevice::WriteError);
-                incrementCounter(QModbusServerPrivate::Counter::ServerNoResponse);
-                storeModbusCommEvent(event);
-                return;
-            }
-
-            qint64 writtenBytes = m_serialPort->write(result);
-            if ((writtenBytes == -1) || (writtenBytes < result.size())) {
-                qCDebug(QT_MODBUS) << "(RTU server) Cannot write requested response to serial port.";
-                q->setError(QModbusRtuSerialServer::tr("Could not write response to client"),
-                            QModbusDevice::WriteError);
-                incrementCounter(QModbusServerPrivate::Counter::ServerNoResponse);
-                storeModbusCommEvent(event);
-                m_serialPort->clear(QSerialPort::Output);
-                return;
-            }
-
-            if (response.isException()) {
-                switch (response.exceptionCode()) {
-                case QModbusExceptionResponse::IllegalFunction:
-                case QModbusExceptionResponse::IllegalDataAddress:
-                case QModbusExceptionResponse::IllegalDataValue:
-                    event |= QModbusCommEvent::SendFlag::ReadExceptionSent;
-                    break;
-
-                case QModbusExceptionResponse::ServerDeviceFailure:
-                    event |= QModbusCommEvent::SendFlag::ServerAbortExceptionSent;
-                    break;
-
-                case QModbusExceptionResponse::ServerDeviceBusy:
-                    // The quantity of messages addressed to the remote device for which it
-                    // returned a server device busy exception response, since its last restart,
-                    // clear counters operation, or power-up.
-                    incrementCounter(QModbusServerPrivate::Counter::ServerBusy);
-                    event |= QModbusCommEvent::SendFlag::ServerBusyExceptionSent;
-                    break;
-
-                case  QModbusExceptionResponse::NegativeAcknowledge:
-                    // The quantity of messages addressed to the remote device for which it
-                    // returned a negative acknowledge (NAK) exception response, since its last
-                    // restart, clear counters operation, or power-up.
-                    incrementCounter(QModbusServerPrivate::Counter::ServerNAK);
-                    event |= QModbusCommEvent::SendFlag::ServerProgramNAKExceptionSent;
-                    break;
-
-                default:
-                    break;
-                }
-                // The quantity of Modbus exception responses returned by the remote device since
-                // its last restart, clear counters operation, or power-up.
-                incrementCounter(QModbusServerPrivate::Counter::BusExceptionError);
-            } else {
-                switch (quint16(req.functionCode())) {
-                case 0x0a: // Poll 484 (not in the official Modbus specification) *1
-                case 0x0e: // Poll Controller (not in the official Modbus specification) *1
-                case QModbusRequest::GetCommEventCounter: // fall through and bail out
-                    break;
-                default:
-                    // The device's event counter is incremented once for each successful message
-                    // completion. Do not increment for exception responses, poll commands, or fetch
-                    // event counter commands.            *1 but mentioned here ^^^
-                    incrementCounter(QModbusServerPrivate::Counter::CommEvent);
-                    break;
-                }
-            }
-            storeModbusCommEvent(event); // store the final event after processing
+            for (int serverAddress : hostedServerAddresses())
+                processUnitRequest(adu, serverAddress, event);
         });
 
         QObject::connect(m_serialPort, &QSerialPort::errorOccurred, q,
@@ -304,6 +192,146 @@ public:
         });
     }
 
+    /*
+        Processes the request in \a adu for the unit \a serverAddress and
+        answers it, unless it is a broadcast. \a event is the receive event
+        of the request.
+    */
+    void processUnitRequest(const QModbusSerialAdu &adu, int serverAddress,
+                            QModbusCommEvent event)
+    {
+        Q_Q(QModbusRtuSerialServer);
+
+        // From here on, the counters and the event log are those of the addressed unit.
+        const UnitScope unitScope(this, serverAddress);
+
+        // The quantity of messages that the remote device has detected on the communications
+        // system since its last restart, clear counters operation, or power-up.
+        incrementCounter(QModbusServerPrivate::Counter::BusMessage);
+
+        // If we do not process a Broadcast ...
+        if (!q->processesBroadcast()) {
+            // check if the server address matches ...
+            if (!hasServerAddress(serverAddress)) {
+                // no, not our address! Ignore!
+                qCDebug(QT_MODBUS) << "(RTU server) Wrong server address, expected"
+                    << q->serverAddress() << "got" << serverAddress;
+                return;
+            }
+        } // else { Broadcast -> Server address will never match, deliberately ignore }
+
+        storeModbusCommEvent(event); // store the final event before processing
+
+        const QModbusRequest req = adu.pdu();
+        qCDebug(QT_MODBUS) << "(RTU server) Request PDU:" << req;
+        QModbusResponse response; // If the device ...
+        if (q->value(QModbusServer::DeviceBusy).value<quint16>() == 0xffff) {
+            // is busy, update the quantity of messages addressed to the remote device for
+            // which it returned a Server Device Busy exception response, since its last
+            // restart, clear counters operation, or power-up.
+            incrementCounter(QModbusServerPrivate::Counter::ServerBusy);
+            response = QModbusExceptionResponse(req.functionCode(),
+                QModbusExceptionResponse::ServerDeviceBusy);
+        } else {
+            // is not busy, update the quantity of messages addressed to the remote device,
+            // or broadcast, that the remote device has processed since its last restart,
+            // clear counters operation, or power-up.
+            incrementCounter(QModbusServerPrivate::Counter::ServerMessage);
+            response = q->processRequest(req);
+        }
+        qCDebug(QT_MODBUS) << "(RTU server) Response PDU:" << response;
+
+        event = QModbusCommEvent::SentEvent; // reset event after processing
+        if (q->value(QModbusServer::ListenOnlyMode).toBool())
+            event |= QModbusCommEvent::SendFlag::CurrentlyInListenOnlyMode;
+
+        if ((!response.isValid())
+            || q->processesBroadcast()
+            || q->value(QModbusServer::ListenOnlyMode).toBool()) {
+            // The quantity of messages addressed to the remote device for which it has
+            // returned no response (neither a normal response nor an exception response),
+            // since its last restart, clear counters operation, or power-up.
+            incrementCounter(QModbusServerPrivate::Counter::ServerNoResponse);
+            storeModbusCommEvent(event);
+            return;
+        }
+
+        const QByteArray result = QModbusSerialAdu::create(QModbusSerialAdu::Rtu,
+                                                           adu.serverAddress(), response);
+
+        qCDebug(QT_MODBUS_LOW) << "(RTU server) Response ADU:" << result.toHex();
+
+        if (!m_serialPort->isOpen()) {
+            qCDebug(QT_MODBUS) << "(RTU server) Requesting serial port has closed.";
+            q->setError(QModbusRtuSerialServer::tr("Requesting serial port is closed"),
+                        QModbusDevice::WriteError);
+            incrementCounter(QModbusServerPrivate::Counter::ServerNoResponse);
+            storeModbusCommEvent(event);
+            return;
+        }
+
+        qint64 writtenBytes = m_serialPort->write(result);
+        if ((writtenBytes == -1) || (writtenBytes < result.size())) {
+            qCDebug(QT_MODBUS) << "(RTU server) Cannot write requested response to serial port.";
+            q->setError(QModbusRtuSerialServer::tr("Could not write response to client"),
+                        QModbusDevice::WriteError);
+            incrementCounter(QModbusServerPrivate::Counter::ServerNoResponse);
+            storeModbusCommEvent(event);
+            m_serialPort->clear(QSerialPort::Output);
+            return;
+        }
+
+        if (response.isException()) {
+            switch (response.exceptionCode()) {
+            case QModbusExceptionResponse::IllegalFunction:
+            case QModbusExceptionResponse::IllegalDataAddress:
+            case QModbusExceptionResponse::IllegalDataValue:
+                event |= QModbusCommEvent::SendFlag::ReadExceptionSent;
+                break;
+
+            case QModbusExceptionResponse::ServerDeviceFailure:
+                event |= QModbusCommEvent::SendFlag::ServerAbortExceptionSent;
+                break;
+
+            case QModbusExceptionResponse::ServerDeviceBusy:
+                // The quantity of messages addressed to the remote device for which it
+                // returned a server device busy exception response, since its last restart,
+                // clear counters operation, or power-up.
+                incrementCounter(QModbusServerPrivate::Counter::ServerBusy);
+                event |= QModbusCommEvent::SendFlag::ServerBusyExceptionSent;
+                break;
+
+            case  QModbusExceptionResponse::NegativeAcknowledge:
+                // The quantity of messages addressed to the remote device for which it
+                // returned a negative acknowledge (NAK) exception response, since its last
+                // restart, clear counters operation, or power-up.
+                incrementCounter(QModbusServerPrivate::Counter::ServerNAK);
+                event |= QModbusCommEvent::SendFlag::ServerProgramNAKExceptionSent;
+                break;
+
+            default:
+                break;
+            }
+            // The quantity of Modbus exception responses returned by the remote device since
+            // its last restart, clear counters operation, or power-up.
+            incrementCounter(QModbusServerPrivate::Counter::BusExceptionError);
+        } else {
+            switch (quint16(req.functionCode())) {
+            case 0x0a: // Poll 484 (not in the official Modbus specification) *1
+            case 0x0e: // Poll Controller (not in the official Modbus specification) *1
+            case QModbusRequest::GetCommEventCounter: // fall through and bail out
+                break;
+            default:
+                // The device's event counter is incremented once for each successful message
+                // completion. Do not increment for exception responses, poll commands, or fetch
+                // event counter commands.            *1 but mentioned here ^^^
+                incrementCounter(QModbusServerPrivate::Counter::CommEvent);
+                break;
+            }
+        }
+        storeModbusCommEvent(event); // store the final event after processing
+    }
+
     void setupEnvironment()
     {
         if (m_serialPort) {
@@ -5,11 +5,13 @@
 #include "qmodbusserver.h"
 #include "qmodbusserver_p.h"
 #include "qmodbus_symbols_p.h"
+#include "qmodbuspdubuffer_p.h"
 
 #include <QtCore/qbitarray.h>
 #include <QtCore/qdebug.h>
 #include <QtCore/qlist.h>
 #include <QtCore/qloggingcategory.h>
+#include <QtCore/qtimer.h>
 
 #include <algorithm>
 
@@ -97,12 +99,22 @@ bool QModbusServer::setMap(const QModbusDataUnitMap &map)
 /*!
     Sets the address for this Modbus server instance to \a serverAddress.
 
-    \sa serverAddress()
+    Since Qt 6.7, an address added by addServerAddress() is rejected and the
+    server address is left unchanged.
+
+    \sa serverAddress(), addServerAddress()
 */
 void QModbusServer::setServerAddress(int serverAddress)
 {
     Q_D(QModbusServer);
-    d->m_serverAddress = serverAddress;
+    QWriteLocker locker(&d->m_unitsLock);
+    if (serverAddress >= 0 && serverAddress < int(d->m_units.size())
+        && d->m_units[serverAddress]) {
+        qCWarning(QT_MODBUS) << "(Server) Cannot use the added address" << serverAddress
+                             << "as server address";
+        return;
+    }
+    d->m_serverAddress.storeRelaxed(serverAddress);
 }
 
 /*!
@@ -114,7 +126,7 @@ int QModbusServer::serverAddress() const
 {
     Q_D(const QModbusServer);
 
-    return d->m_serverAddress;
+    return d->m_serverAddress.loadRelaxed();
 }
 
 /*!
@@ -175,29 +187,29 @@ QVariant QModbusServer::value(int option) const
 
     switch (option) {
         case DiagnosticRegister:
-            return d->m_serverOptions.value(option, quint16(0x0000));
+            return d->option(option, quint16(0x0000));
         case ExceptionStatusOffset:
-            return d->m_serverOptions.value(option, quint16(0x0000));
+            return d->option(option, quint16(0x0000));
         case DeviceBusy:
-            return d->m_serverOptions.value(option, quint16(0x0000));
+            return d->option(option, quint16(0x0000));
         case AsciiInputDelimiter:
-            return d->m_serverOptions.value(option, '\n');
+            return d->option(option, '\n');
         case ListenOnlyMode:
-            return d->m_serverOptions.value(option, false);
+            return d->option(option, false);
         case ServerIdentifier:
-            return d->m_serverOptions.value(option, quint8(0x0a));
+            return d->option(option, quint8(0x0a));
         case RunIndicatorStatus:
-            return d->m_serverOptions.value(option, quint8(0xff));
+            return d->option(option, quint8(0xff));
         case AdditionalData:
-            return d->m_serverOptions.value(option, QByteArray("Qt Modbus Server"));
+            return d->option(option, QByteArray("Qt Modbus Server"));
         case DeviceIdentification:
-            return d->m_serverOptions.value(option, QVariant());
+            return d->option(option, QVariant());
     };
 
     if (option < UserOption)
         return QVariant();
 
-    return d->m_serverOptions.value(option, QVariant());
+    return d->option(option, QVariant());
 }
 
 /*!
@@ -286,7 +298,7 @@ bool QModbusServer::setValue(int option, const QVariant &newValue)
     switch (option) {
     case DiagnosticRegister:
         CHECK_INT_OR_UINT(newValue);
-        d->m_serverOptions.insert(option, newValue);
+        d->setOption(option, newValue);
         return true;
     case ExceptionStatusOffset: {
         CHECK_INT_OR_UINT(newValue);
@@ -294,7 +306,7 @@ bool QModbusServer::setValue(int option, const QVariant &newValue)
         QModbusDataUnit coils(QModbusDataUnit::Coils, tmp, 8);
         if (!data(&coils))
             return false;
-        d->m_serverOptions.insert(option, tmp);
+        d->setOption(option, tmp);
         return true;
     }
     case DeviceBusy: {
@@ -302,7 +314,7 @@ bool QModbusServer::setValue(int option, const QVariant &newValue)
         const quint16 tmp = newValue.value<quint16>();
         if ((tmp != 0x0000) && (tmp != 0xffff))
             return false;
-        d->m_serverOptions.insert(option, tmp);
+        d->setOption(option, tmp);
         return true;
     }
     case AsciiInputDelimiter: {
@@ -310,25 +322,25 @@ bool QModbusServer::setValue(int option, const QVariant &newValue)
         bool ok = false;
         if (newValue.toUInt(&ok) > 0xff || !ok)
             return false;
-        d->m_serverOptions.insert(option, newValue);
+        d->setOption(option, newValue);
         return true;
     }
     case ListenOnlyMode: {
         if (newValue.typeId() != QMetaType::Type::Bool)
             return false;
-        d->m_serverOptions.insert(option, newValue);
+        d->setOption(option, newValue);
         return true;
     }
     case ServerIdentifier:
         CHECK_INT_OR_UINT(newValue);
-        d->m_serverOptions.insert(option, newValue);
+        d->setOption(option, newValue);
         return true;
     case RunIndicatorStatus: {
         CHECK_INT_OR_UINT(newValue);
         const quint8 tmp = newValue.value<quint8>();
         if ((tmp != 0x00) && (tmp != 0xff))
             return false;
-        d->m_serverOptions.insert(option, tmp);
+        d->setOption(option, tmp);
         return true;
     }
     case AdditionalData: {
@@ -337,13 +349,13 @@ bool QModbusServer::setValue(int option, const QVariant &newValue)
         const QByteArray additionalData = newValue.toByteArray();
         if (additionalData.size() > 249)
             return false;
-        d->m_serverOptions.insert(option, additionalData);
+        d->setOption(option, additionalData);
         return true;
     }
     case DeviceIdentification:
         if (!newValue.canConvert<QModbusDeviceIdentification>())
             return false;
-        d->m_serverOptions.insert(option, newValue);
+        d->setOption(option, newValue);
         return true;
     default:
         break;
@@ -351,7 +363,7 @@ bool QModbusServer::setValue(int option, const QVariant &newValue)
 
     if (option < UserOption)
         return false;
-    d->m_serverOptions.insert(option, newValue);
+    d->setOption(option, newValue);
     return true;
 
 #undef CHECK_INT_OR_UINT
@@ -449,10 +461,12 @@ bool QModbusServer::setData(const QModbusDataUnit &newData)
 bool QModbusServer::writeData(const QModbusDataUnit &newData)
 {
     Q_D(QModbusServer);
-    if (!d->m_modbusDataUnitMap.contains(newData.registerType()))
+    QWriteLocker locker(&d->m_dataLock);
+    QModbusDataUnitMap &map = d->dataUnitMap();
+    if (!map.contains(newData.registerType()))
         return false;
 
-    QModbusDataUnit &current = d->m_modbusDataUnitMap[newData.registerType()];
+    QModbusDataUnit &current = map[newData.registerType()];
     if (!current.isValid())
         return false;
 
@@ -475,9 +489,12 @@ bool QModbusServer::writeData(const QModbusDataUnit &newData)
         changeRequired |= (current.value(translatedIndex) != newValue);
         current.setValue(translatedIndex, newValue);
     }
+    locker.unlock(); // do not hold the lock while receivers run
 
-    if (changeRequired)
-        emit dataWritten(newData.registerType(), newData.startAddress(), newData.valueCount());
+    if (changeRequired) {
+        d->notifyDataWritten(newData.registerType(), newData.startAddress(),
+                             int(newData.valueCount()));
+    }
     return true;
 }
 
@@ -495,11 +512,13 @@ bool QModbusServer::writeData(const QModbusDataUnit &newData)
 bool QModbusServer::readData(QModbusDataUnit *newData) const
 {
     Q_D(const QModbusServer);
+    QReadLocker locker(&d->m_dataLock);
 
-    if ((!newData) || (!d->m_modbusDataUnitMap.contains(newData->registerType())))
+    const QModbusDataUnitMap &map = d->dataUnitMap();
+    if ((!newData) || (!map.contains(newData->registerType())))
         return false;
 
-    const QModbusDataUnit &current = d->m_modbusDataUnitMap.value(newData->registerType());
+    const QModbusDataUnit &current = map.value(newData->registerType());
     if (!current.isValid())
         return false;
 
@@ -540,6 +559,204 @@ bool QModbusServer::readData(QModbusDataUnit *newData) const
     due to no change in value.
 */
 
+/*!
+    \since 6.7
+
+    Adds \a serverAddress to the addresses this server responds to and
+    assigns it the register map \a map. Returns \c true on success;
+    otherwise \c false.
+
+    A server hosting several addresses answers requests for each of them
+    as if they came from independent devices: every address has its own
+    register map, diagnostic counters and communication event log.
+    Options, such as \l QModbusServer::DeviceBusy or
+    \l QModbusServer::ListenOnlyMode, are shared. This is useful to
+    simulate many devices behind a single port or TCP connection.
+
+    The address must be in the range \c 1 to \c 255 and differ from
+    serverAddress(). Adding an address that is already present replaces
+    its register map and resets its counters.
+
+    Changes to the registers of an added address are reported by the
+    \l serverAddressDataWritten() signal, instead of \l dataWritten().
+
+    On transports with broadcasts, such as Modbus RTU, a broadcast request
+    is processed by serverAddress() and by every added address.
+
+    \sa removeServerAddress(), serverAddresses(), data(), setData()
+*/
+bool QModbusServer::addServerAddress(int serverAddress, const QModbusDataUnitMap &map)
+{
+    Q_D(QModbusServer);
+    if (serverAddress < 1 || serverAddress > 255)
+        return false;
+
+    auto unit = std::make_shared<QModbusServerPrivate::Unit>();
+    unit->serverAddress = serverAddress;
+    unit->map = map;
+
+    QWriteLocker locker(&d->m_unitsLock);
+    if (serverAddress == d->m_serverAddress.loadRelaxed())
+        return false;
+    d->m_units[serverAddress] = std::move(unit);
+    return true;
+}
+
+/*!
+    \since 6.7
+
+    Removes \a serverAddress and its register map from the server.
+    Returns \c true if the address was added before; otherwise \c false.
+
+    \sa addServerAddress()
+*/
+bool QModbusServer::removeServerAddress(int serverAddress)
+{
+    Q_D(QModbusServer);
+    if (serverAddress < 1 || serverAddress > 255)
+        return false;
+
+    QWriteLocker locker(&d->m_unitsLock);
+    if (!d->m_units[serverAddress])
+        return false;
+    d->m_units[serverAddress].reset();
+    return true;
+}
+
+/*!
+    \since 6.7
+
+    Returns the addresses added by addServerAddress() in ascending order.
+    The list does not contain serverAddress().
+
+    \sa addServerAddress(), removeServerAddress()
+*/
+QList<int> QModbusServer::serverAddresses() const
+{
+    Q_D(const QModbusServer);
+    QList<int> addresses;
+    QReadLocker locker(&d->m_unitsLock);
+    for (const auto &unit : d->m_units) {
+        if (unit)
+            addresses.append(unit->serverAddress);
+    }
+    return addresses;
+}
+
+/*!
+    \since 6.7
+
+    Returns the values in the register range given by \a newData from the
+    register map of \a serverAddress. Returns \c false if the address is
+    neither serverAddress() nor added by addServerAddress(), or the range
+    is invalid.
+
+    \sa data(QModbusDataUnit *) const, addServerAddress()
+*/
+bool QModbusServer::data(int serverAddress, QModbusDataUnit *newData) const
+{
+    Q_D(const QModbusServer);
+    if (!d->hasServerAddress(serverAddress))
+        return false;
+
+    const QModbusServerPrivate::UnitScope scope(d, serverAddress);
+    return readData(newData);
+}
+
+/*!
+    \since 6.7
+
+    Writes \a unit to the register map of \a serverAddress. Returns
+    \c false if the address is neither serverAddress() nor added by
+    addServerAddress(), or the range is outside of the map range.
+
+    \sa setData(const QModbusDataUnit &), serverAddressDataWritten()
+*/
+bool QModbusServer::setData(int serverAddress, const QModbusDataUnit &unit)
+{
+    Q_D(QModbusServer);
+    if (!d->hasServerAddress(serverAddress))
+        return false;
+
+    const QModbusServerPrivate::UnitScope scope(d, serverAddress);
+    return writeData(unit);
+}
+
+/*!
+    \fn void QModbusServer::serverAddressDataWritten(int serverAddress, QModbusDataUnit::RegisterType table, int address, int size)
+    \since 6.7
+
+    This signal is emitted when a Modbus client has written one or more
+    fields of data to the register map of \a serverAddress, an address
+    added by addServerAddress(). The signal contains information about
+    the fields that were written:
+    \list
+     \li Register type (\a table) that was written,
+     \li \a address of the first field that was written,
+     \li and \a size of consecutive fields that were written starting from \a address.
+    \endlist
+
+    The signal is not emitted when the written fields have not changed.
+    Changes to added addresses are not coalesced.
+
+    \sa addServerAddress(), dataWritten()
+*/
+
+/*!
+    \fn void QModbusServer::dataWrittenCoalesced(const QList<QModbusDataUnit> &ranges)
+    \since 6.7
+
+    This signal is emitted instead of \l dataWritten() if coalescing is enabled,
+    see setCoalescingInterval(). \a ranges lists every register range that
+    changed since the previous emission. Overlapping and adjacent writes to the
+    same register type are merged into one range.
+
+    Each entry carries the register type, start address and value count of a
+    range; its values() are empty. Use data() to read the current values. The
+    entries are sorted by register type and start address.
+*/
+
+/*!
+    \since 6.7
+
+    Returns the interval in milliseconds within which data written to the
+    server is reported by one \l dataWrittenCoalesced() signal, or \c -1 if
+    coalescing is disabled. The default value is \c -1.
+
+    \sa setCoalescingInterval()
+*/
+int QModbusServer::coalescingInterval() const
+{
+    Q_D(const QModbusServer);
+    return d->m_coalescingInterval.loadRelaxed();
+}
+
+/*!
+    \since 6.7
+
+    Sets the coalescing interval of change notifications to \a msec.
+
+    By default, \a msec is \c -1 and every successful write that changes
+    the register map emits \l dataWritten(). A client issuing many write
+    requests in quick succession therefore causes as many signal emissions.
+
+    If \a msec is \c 0 or greater, writes no longer emit dataWritten().
+    Instead, the written ranges are collected and reported by a single
+    \l dataWrittenCoalesced() signal, \a msec milliseconds after the first
+    write of the batch. With an interval of \c 0, all writes that happen
+    within one event loop iteration are reported together.
+
+    \note Reimplementations of writeData() that emit dataWritten() themselves
+    are not affected by this setting.
+
+    \sa coalescingInterval(), dataWrittenCoalesced()
+*/
+void QModbusServer::setCoalescingInterval(int msec)
+{
+    Q_D(QModbusServer);
+    d->m_coalescingInterval.storeRelaxed(qMax(-1, msec));
+}
+
 /*!
     Processes a Modbus client \a request and returns a Modbus response.
     This function returns a \l QModbusResponse or \l QModbusExceptionResponse depending
@@ -594,10 +811,46 @@ QModbusResponse QModbusServer::processPrivateRequest(const QModbusPdu &request)
 
 bool QModbusServerPrivate::setMap(const QModbusDataUnitMap &map)
 {
+    QWriteLocker locker(&m_dataLock);
     m_modbusDataUnitMap = map;
     return true;
 }
 
+/*
+    Processes a request handed over without a transport by QModbusInProcessClient, for the
+    unit addressed by \a serverAddress, or as a broadcast if \a serverAddress is \c 0. Returns
+    an invalid response if the server does not answer, as for broadcasts and in listen only
+    mode.
+*/
+QModbusResponse QModbusServerPrivate::processInProcessRequest(int serverAddress,
+                                                              const QModbusRequest &request)
+{
+    Q_Q(QModbusServer);
+
+    const auto process = [this, q, &request](int unitAddress) -> QModbusResponse {
+        const UnitScope unitScope(this, unitAddress);
+        if (q->value(QModbusServer::DeviceBusy).value<quint16>() == 0xffff) {
+            // If the device is busy, send an exception response without processing.
+            incrementCounter(QModbusServerPrivate::Counter::ServerBusy);
+            return QModbusExceptionResponse(request.functionCode(),
+                                            QModbusExceptionResponse::ServerDeviceBusy);
+        }
+        return q->processRequest(request);
+    };
+
+    if (serverAddress == 0) {
+        // Every hosted unit processes a broadcast, none of them answers.
+        for (int hostedAddress : hostedServerAddresses())
+            process(hostedAddress);
+        return {};
+    }
+
+    const QModbusResponse response = process(serverAddress);
+    if (q->value(QModbusServer::ListenOnlyMode).toBool())
+        return {};
+    return response;
+}
+
 QModbusResponse QModbusServerPrivate::processRequest(const QModbusPdu &request)
 {
     switch (request.functionCode()) {
@@ -830,8 +1083,10 @@ QModbusResponse QModbusServerPrivate::processDiagnosticsRequest(const QModbusReq
         // function is the only way to remotely clear the listen only mode and bring the device
         // back into communication. If data is 0xff00, the event log history is also cleared.
         q_func()->disconnectDevice();
-        if (data == 0xff00)
-            m_commEventLog.clear();
+        if (data == 0xff00) {
+            QMutexLocker locker(&m_counterMutex);
+            commEventLog().clear();
+        }
 
         resetCommunicationCounters();
         q_func()->setValue(QModbusServer::ListenOnlyMode, false);
@@ -872,14 +1127,19 @@ QModbusResponse QModbusServerPrivate::processDiagnosticsRequest(const QModbusReq
     case Diagnostics::ReturnServerNoResponseCount:
     case Diagnostics::ReturnServerNAKCount:
     case Diagnostics::ReturnServerBusyCount:
-    case Diagnostics::ReturnBusCharacterOverrunCount:
+    case Diagnostics::ReturnBusCharacterOverrunCount: {
         CHECK_SIZE_AND_CONDITION(request, (data != 0x0000));
+        QMutexLocker locker(&m_counterMutex);
         return QModbusResponse(request.functionCode(), subFunctionCode,
-                               m_counters[static_cast<Counter> (subFunctionCode)]);
+                               counters()[static_cast<Counter> (subFunctionCode)]);
+    }
 
     case Diagnostics::ClearOverrunCounterAndFlag: {
         CHECK_SIZE_AND_CONDITION(request, (data != 0x0000));
-        m_counters[Diagnostics::ReturnBusCharacterOverrunCount] = 0;
+        {
+            QMutexLocker locker(&m_counterMutex);
+            counters()[Diagnostics::ReturnBusCharacterOverrunCount] = 0;
+        }
         quint16 reg = q_func()->value(QModbusServer::DiagnosticRegister).value<quint16>();
         q_func()->setValue(QModbusServer::DiagnosticRegister, reg &~ 1); // clear first bit
         return QModbusResponse(request.functionCode(), request.data());
@@ -900,7 +1160,8 @@ QModbusResponse QModbusServerPrivate::processGetCommEventCounterRequest(const QM
             QModbusExceptionResponse::ServerDeviceFailure);
     }
     const quint16 deviceBusy = tmp.value<quint16>();
-    return QModbusResponse(request.functionCode(), deviceBusy, m_counters[Counter::CommEvent]);
+    QMutexLocker locker(&m_counterMutex);
+    return QModbusResponse(request.functionCode(), deviceBusy, counters()[Counter::CommEvent]);
 }
 
 QModbusResponse QModbusServerPrivate::processGetCommEventLogRequest(const QModbusRequest &request)
@@ -913,12 +1174,14 @@ QModbusResponse QModbusServerPrivate::processGetCommEventLogRequest(const QModbu
     }
     const quint16 deviceBusy = tmp.value<quint16>();
 
-    QList<quint8> eventLog(int(m_commEventLog.size()));
-    std::copy(m_commEventLog.cbegin(), m_commEventLog.cend(), eventLog.begin());
+    QMutexLocker locker(&m_counterMutex);
+    const std::deque<quint8> &log = commEventLog();
+    QList<quint8> eventLog(int(log.size()));
+    std::copy(log.cbegin(), log.cend(), eventLog.begin());
 
     // 6 -> 3 x 2 Bytes (Status, Event Count and Message Count)
     return QModbusResponse(request.functionCode(), quint8(eventLog.size() + 6), deviceBusy,
-        m_counters[Counter::CommEvent], m_counters[Counter::BusMessage], eventLog);
+        counters()[Counter::CommEvent], counters()[Counter::BusMessage], eventLog);
 }
 
 QModbusResponse QModbusServerPrivate::processWriteMultipleCoilsRequest(const QModbusRequest &request)
@@ -999,15 +1262,11 @@ QModbusResponse QModbusServerPrivate::processWriteMultipleRegistersRequest(
             QModbusExceptionResponse::IllegalDataAddress);
     }
 
-    const QByteArray pduData = request.data().remove(0,5);
-    QDataStream stream(pduData);
-
-    QList<quint16> values;
-    quint16 tmp;
-    for (int i = 0; i < numberOfRegisters; i++) {
-        stream >> tmp;
-        values.append(tmp);
-    }
+    // The values follow the 5 header bytes, their count was checked above.
+    const QModbusPduView pdu(request);
+    QList<quint16> values(numberOfRegisters);
+    for (int i = 0; i < numberOfRegisters; i++)
+        values[i] = pdu.wordAt(5 + 2 * i);
 
     registers.setValues(values);
 
@@ -1098,15 +1357,11 @@ QModbusResponse QModbusServerPrivate::processReadWriteMultipleRegistersRequest(
             QModbusExceptionResponse::IllegalDataAddress);
     }
 
-    const QByteArray pduData = request.data().remove(0,9);
-    QDataStream stream(pduData);
-
-    QList<quint16> values;
-    quint16 tmp;
-    for (int i = 0; i < writeQuantity; i++) {
-        stream >> tmp;
-        values.append(tmp);
-    }
+    // The values follow the 9 header bytes, their count was checked above.
+    const QModbusPduView pdu(request);
+    QList<quint16> values(writeQuantity);
+    for (int i = 0; i < writeQuantity; i++)
+        values[i] = pdu.wordAt(9 + 2 * i);
 
     writeRegisters.setValues(values);
 
@@ -1266,14 +1521,135 @@ QModbusResponse QModbusServerPrivate::processEncapsulatedInterfaceTransportReque
         QModbusExceptionResponse::IllegalFunction);
 }
 
+namespace {
+struct ActiveUnit
+{
+    const QModbusServerPrivate *server = nullptr;
+    QModbusServerPrivate::Unit *unit = nullptr;
+};
+thread_local ActiveUnit t_activeUnit;
+}
+
+QModbusServerPrivate::UnitScope::UnitScope(const QModbusServerPrivate *d, int serverAddress)
+    : m_previousServer(t_activeUnit.server)
+    , m_previousUnit(t_activeUnit.unit)
+{
+    if (serverAddress != d->m_serverAddress.loadRelaxed())
+        m_unit = d->unit(serverAddress);
+    t_activeUnit = { d, m_unit.get() };
+}
+
+QModbusServerPrivate::UnitScope::UnitScope(const QModbusServerPrivate *d)
+    : m_previousServer(t_activeUnit.server)
+    , m_previousUnit(t_activeUnit.unit)
+{
+    t_activeUnit = { d, nullptr };
+}
+
+QModbusServerPrivate::UnitScope::~UnitScope()
+{
+    t_activeUnit = { m_previousServer, m_previousUnit };
+}
+
+/*
+    Returns serverAddress() followed by the addresses added by addServerAddress(), the units
+    that process a broadcast.
+*/
+QList<int> QModbusServerPrivate::hostedServerAddresses() const
+{
+    QList<int> addresses { m_serverAddress.loadRelaxed() };
+    QReadLocker locker(&m_unitsLock);
+    for (const auto &unit : m_units) {
+        if (unit)
+            addresses.append(unit->serverAddress);
+    }
+    return addresses;
+}
+
+QModbusServerPrivate::Unit *QModbusServerPrivate::activeUnit() const
+{
+    return t_activeUnit.server == this ? t_activeUnit.unit : nullptr;
+}
+
+void QModbusServerPrivate::notifyDataWritten(QModbusDataUnit::RegisterType table, int address,
+                                             int size)
+{
+    Q_Q(QModbusServer);
+    if (const Unit *unit = activeUnit()) {
+        const int serverAddress = unit->serverAddress;
+        // Receivers may access any register map, the unit must not be selected for them.
+        const UnitScope defaultScope(this);
+        emit q->serverAddressDataWritten(serverAddress, table, address, size);
+        return;
+    }
+
+    if (m_coalescingInterval.loadRelaxed() < 0 || quint32(table) >= m_writtenRanges.size()) {
+        emit q->dataWritten(table, address, size);
+        return;
+    }
+
+    {
+        QMutexLocker locker(&m_writtenRangesMutex);
+
+        // Merge [address, address + size) with every overlapping or adjacent range.
+        AddressRanges &ranges = m_writtenRanges[table];
+        int start = address;
+        int end = address + size;
+        auto first = std::lower_bound(ranges.begin(), ranges.end(), start,
+            [](const std::pair<int, int> &range, int value) { return range.second < value; });
+        auto last = first;
+        for (; last != ranges.end() && last->first <= end; ++last) {
+            start = qMin(start, last->first);
+            end = qMax(end, last->second);
+        }
+        first = ranges.erase(first, last);
+        ranges.insert(first, { start, end });
+
+        if (m_coalescedNotificationPending)
+            return;
+        m_coalescedNotificationPending = true;
+    }
+
+    // Writes may happen on a worker thread, the timer needs to run in the server's thread.
+    QMetaObject::invokeMethod(q, [this]() {
+        Q_Q(QModbusServer);
+        QTimer::singleShot(qMax(0, m_coalescingInterval.loadRelaxed()), q, [this]() {
+            emitCoalescedDataWritten();
+        });
+    }, Qt::AutoConnection);
+}
+
+void QModbusServerPrivate::emitCoalescedDataWritten()
+{
+    QList<QModbusDataUnit> units;
+    {
+        QMutexLocker locker(&m_writtenRangesMutex);
+        m_coalescedNotificationPending = false;
+        for (size_t type = 0; type < m_writtenRanges.size(); ++type) {
+            for (const auto &range : std::as_const(m_writtenRanges[type])) {
+                QModbusDataUnit unit(QModbusDataUnit::RegisterType(type));
+                unit.setStartAddress(range.first);
+                unit.setValueCount(range.second - range.first);
+                units.append(unit);
+            }
+            m_writtenRanges[type].clear();
+        }
+    }
+
+    if (!units.isEmpty())
+        emit q_func()->dataWrittenCoalesced(units);
+}
+
 void QModbusServerPrivate::storeModbusCommEvent(const QModbusCommEvent &eventByte)
 {
     // Inserts an event byte at the start of the event log. If the event log
     // is already full, the byte at the end of the log will be removed. The
     // event log size is 64 bytes, starting at index 0.
-    m_commEventLog.push_front(eventByte);
-    if (m_commEventLog.size() > 64)
-        m_commEventLog.pop_back();
+    QMutexLocker locker(&m_counterMutex);
+    std::deque<quint8> &log = commEventLog();
+    log.push_front(eventByte);
+    if (log.size() > 64)
+        log.pop_back();
 }
 
 #undef CHECK_SIZE_EQUALS
@@ -53,8 +53,21 @@ public:
     bool setData(QModbusDataUnit::RegisterType table, quint16 address, quint16 data);
     bool data(QModbusDataUnit::RegisterType table, quint16 address, quint16 *data) const;
 
+    bool addServerAddress(int serverAddress, const QModbusDataUnitMap &map);
+    bool removeServerAddress(int serverAddress);
+    QList<int> serverAddresses() const;
+
+    bool data(int serverAddress, QModbusDataUnit *newData) const;
+    bool setData(int serverAddress, const QModbusDataUnit &unit);
+
+    int coalescingInterval() const;
+    void setCoalescingInterval(int msec);
+
 Q_SIGNALS:
     void dataWritten(QModbusDataUnit::RegisterType table, int address, int size);
+    void dataWrittenCoalesced(const QList<QModbusDataUnit> &ranges);
+    void serverAddressDataWritten(int serverAddress, QModbusDataUnit::RegisterType table,
+                                  int address, int size);
 
 protected:
     QModbusServer(QModbusServerPrivate &dd, QObject *parent = nullptr);
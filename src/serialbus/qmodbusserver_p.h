@@ -4,6 +4,9 @@
 #ifndef QMODBUSERVER_P_H
 #define QMODBUSERVER_P_H
 
+#include <QtCore/qatomic.h>
+#include <QtCore/qmutex.h>
+#include <QtCore/qreadwritelock.h>
 #include <QtSerialBus/qmodbusdataunit.h>
 #include <QtSerialBus/qmodbusserver.h>
 
@@ -13,6 +16,9 @@
 
 #include <array>
 #include <deque>
+#include <memory>
+#include <utility>
+#include <vector>
 
 //
 //  W A R N I N G
@@ -44,6 +50,41 @@ public:
         BusCharacterOverrun = Diagnostics::ReturnBusCharacterOverrunCount
     };
 
+    /*
+        A unit hosted in addition to the server address, see
+        QModbusServer::addServerAddress(). It has its own register map,
+        diagnostic counters and communication event log.
+    */
+    struct Unit
+    {
+        int serverAddress = 0;
+        QModbusDataUnitMap map;
+        std::array<quint16, 20> counters = {};
+        std::deque<quint8> commEventLog;
+    };
+
+    /*
+        Selects the unit the current thread processes a request for. While
+        the scope is alive, processRequest(), readData() and writeData() as
+        well as the counters and the event log operate on the unit addressed
+        by \a serverAddress. The server address itself selects the default
+        register map, as does the constructor without an address.
+    */
+    class UnitScope
+    {
+        Q_DISABLE_COPY_MOVE(UnitScope)
+
+    public:
+        UnitScope(const QModbusServerPrivate *d, int serverAddress);
+        explicit UnitScope(const QModbusServerPrivate *d);
+        ~UnitScope();
+
+    private:
+        std::shared_ptr<Unit> m_unit;
+        const QModbusServerPrivate *m_previousServer = nullptr;
+        Unit *m_previousUnit = nullptr;
+    };
+
     QModbusServerPrivate()
         : m_counters()
     {
@@ -51,10 +92,65 @@ public:
 
     bool setMap(const QModbusDataUnitMap &map);
 
-    void resetCommunicationCounters() { m_counters.fill(0u); }
-    void incrementCounter(QModbusServerPrivate::Counter counter) { m_counters[counter]++; }
+    bool hasServerAddress(int serverAddress) const
+    {
+        return serverAddress == m_serverAddress.loadRelaxed() || unit(serverAddress);
+    }
+    std::shared_ptr<Unit> unit(int serverAddress) const
+    {
+        if (serverAddress < 0 || serverAddress >= int(m_units.size()))
+            return {};
+        QReadLocker locker(&m_unitsLock);
+        return m_units[serverAddress];
+    }
+    QList<int> hostedServerAddresses() const;
+    Unit *activeUnit() const;
+
+    QModbusDataUnitMap &dataUnitMap()
+    {
+        Unit *unit = activeUnit();
+        return unit ? unit->map : m_modbusDataUnitMap;
+    }
+    const QModbusDataUnitMap &dataUnitMap() const
+    {
+        const Unit *unit = activeUnit();
+        return unit ? unit->map : m_modbusDataUnitMap;
+    }
+    std::array<quint16, 20> &counters()
+    {
+        Unit *unit = activeUnit();
+        return unit ? unit->counters : m_counters;
+    }
+    std::deque<quint8> &commEventLog()
+    {
+        Unit *unit = activeUnit();
+        return unit ? unit->commEventLog : m_commEventLog;
+    }
+
+    void resetCommunicationCounters()
+    {
+        QMutexLocker locker(&m_counterMutex);
+        counters().fill(0u);
+    }
+    void incrementCounter(QModbusServerPrivate::Counter counter)
+    {
+        QMutexLocker locker(&m_counterMutex);
+        counters()[counter]++;
+    }
+
+    QVariant option(int key, const QVariant &defaultValue) const
+    {
+        QReadLocker locker(&m_optionsLock);
+        return m_serverOptions.value(key, defaultValue);
+    }
+    void setOption(int key, const QVariant &value)
+    {
+        QWriteLocker locker(&m_optionsLock);
+        m_serverOptions.insert(key, value);
+    }
 
     QModbusResponse processRequest(const QModbusPdu &request);
+    QModbusResponse processInProcessRequest(int serverAddress, const QModbusRequest &request);
 
     QModbusResponse processReadCoilsRequest(const QModbusRequest &request);
     QModbusResponse processReadDiscreteInputsRequest(const QModbusRequest &request);
@@ -82,11 +178,34 @@ public:
 
     void storeModbusCommEvent(const QModbusCommEvent &eventByte);
 
-    int m_serverAddress = 1;
+    void notifyDataWritten(QModbusDataUnit::RegisterType table, int address, int size);
+    void emitCoalescedDataWritten();
+
+    QAtomicInt m_serverAddress { 1 };
     std::array<quint16, 20> m_counters;
     QHash<int, QVariant> m_serverOptions;
     QModbusDataUnitMap m_modbusDataUnitMap;
     std::deque<quint8> m_commEventLog;
+
+    // Requests may be processed on several threads at once (see
+    // QModbusTcpServer::setWorkerThreadCount()), so the register map,
+    // the options, the counters and the event log are guarded.
+    mutable QReadWriteLock m_dataLock;
+    mutable QReadWriteLock m_optionsLock;
+    QMutex m_counterMutex; // guards the counters and the event log
+
+    // Additional units, indexed by server address. The table is dense so that
+    // dispatching a request costs one lookup, however many units are hosted.
+    std::array<std::shared_ptr<Unit>, 256> m_units;
+    mutable QReadWriteLock m_unitsLock;
+
+    // Half-open [start, end) address intervals written since the last coalesced
+    // notification, sorted and merged, one list per QModbusDataUnit::RegisterType.
+    using AddressRanges = std::vector<std::pair<int, int>>;
+    std::array<AddressRanges, QModbusDataUnit::HoldingRegisters + 1> m_writtenRanges;
+    QAtomicInt m_coalescingInterval { -1 };
+    bool m_coalescedNotificationPending = false;
+    QMutex m_writtenRangesMutex;
 };
 
 QT_END_NAMESPACE
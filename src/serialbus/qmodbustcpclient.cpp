@@ -16,6 +16,23 @@ QT_BEGIN_NAMESPACE
     \brief The QModbusTcpClient class is the interface class for Modbus TCP client device.
 
     QModbusTcpClient communicates with the Modbus backend providing users with a convenient API.
+
+    \section1 Connection Pooling
+
+    Many Modbus TCP servers and gateways process the requests received on one
+    connection strictly in order. A single connection then limits the client to
+    one request per round trip. Since Qt 6.7, the client can open several
+    connections to the same server, see setConnectionCount(). Each request is
+    sent on the connected member of the pool with the fewest pending requests.
+    Every connection numbers its transactions independently.
+
+    The client enters \l {QModbusDevice::}{ConnectedState} as soon as the first
+    connection is established. If a connection of the pool fails while others
+    are still connected, its pending requests fail with
+    \l {QModbusDevice::}{ReplyAbortedError} and the connection is opened again
+    after a short delay, without changing the state of the client. The delay
+    doubles with every failed attempt, up to 30 seconds. The client becomes
+    unconnected only once the last connection is lost.
 */
 
 /*!
@@ -55,8 +72,10 @@ bool QModbusTcpClient::open()
         return true;
 
     Q_D(QModbusTcpClient);
-    if (d->m_socket->state() != QAbstractSocket::UnconnectedState)
-        return false;
+    for (int i = 0; i < d->connectionTotal(); ++i) {
+        if (d->socket(i)->state() != QAbstractSocket::UnconnectedState)
+            return false;
+    }
 
     const QUrl url = QUrl::fromUserInput(d->m_networkAddress + QStringLiteral(":")
         + QString::number(d->m_networkPort));
@@ -69,7 +88,13 @@ bool QModbusTcpClient::open()
         return false;
     }
 
-    d->m_socket->connectToHost(url.host(), url.port());
+    d->m_host = url.host();
+    d->m_port = quint16(url.port());
+    d->m_activeConnections = d->m_connectionCount;
+    while (d->connectionTotal() < d->m_activeConnections)
+        d->addPoolMember();
+    for (int i = 0; i < d->m_activeConnections; ++i)
+        d->socket(i)->connectToHost(d->m_host, d->m_port);
 
     return true;
 }
@@ -83,7 +108,38 @@ void QModbusTcpClient::close()
         return;
 
     Q_D(QModbusTcpClient);
-    d->m_socket->disconnectFromHost();
+    for (int i = 0; i < d->connectionTotal(); ++i)
+        d->socket(i)->disconnectFromHost();
+}
+
+/*!
+    \since 6.7
+
+    Returns the number of connections the client opens to the server. The
+    default is \c 1.
+
+    \sa setConnectionCount()
+*/
+int QModbusTcpClient::connectionCount() const
+{
+    Q_D(const QModbusTcpClient);
+    return d->m_connectionCount;
+}
+
+/*!
+    \since 6.7
+
+    Sets the number of connections the client opens to the server to \a count.
+    Requests are distributed to the connection with the fewest pending
+    requests. Values less than \c 1 are treated as \c 1. The count takes
+    effect the next time the client connects.
+
+    \sa connectionCount(), {Connection Pooling}
+*/
+void QModbusTcpClient::setConnectionCount(int count)
+{
+    Q_D(QModbusTcpClient);
+    d->m_connectionCount = qMax(1, count);
 }
 
 QT_END_NAMESPACE
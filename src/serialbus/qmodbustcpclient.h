@@ -19,6 +19,9 @@ public:
     explicit QModbusTcpClient(QObject *parent = nullptr);
     ~QModbusTcpClient();
 
+    int connectionCount() const;
+    void setConnectionCount(int count);
+
 protected:
     QModbusTcpClient(QModbusTcpClientPrivate &dd, QObject *parent = nullptr);
 
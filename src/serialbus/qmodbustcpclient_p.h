@@ -4,12 +4,23 @@
 #ifndef QMODBUSTCPCLIENT_P_H
 #define QMODBUSTCPCLIENT_P_H
 
+#include <QtCore/qcoreevent.h>
+#include <QtCore/qendian.h>
+#include <QtCore/qhash.h>
 #include <QtCore/qloggingcategory.h>
+#include <QtCore/qtimer.h>
+#include <QtCore/qvarlengtharray.h>
 #include <QtNetwork/qhostaddress.h>
 #include <QtNetwork/qtcpsocket.h>
 #include "QtSerialBus/qmodbustcpclient.h"
 
 #include "private/qmodbusclient_p.h"
+#include "private/qmodbuspdubuffer_p.h"
+
+#include <functional>
+#include <memory>
+#include <utility>
+#include <vector>
 
 //
 //  W A R N I N G
@@ -27,208 +38,494 @@ QT_BEGIN_NAMESPACE
 Q_DECLARE_LOGGING_CATEGORY(QT_MODBUS)
 Q_DECLARE_LOGGING_CATEGORY(QT_MODBUS_LOW)
 
+/*
+    Runs the response timers of all pending transactions, without creating a
+    QTimer for every request.
+*/
+class QModbusTcpClientTimers : public QObject
+{
+public:
+    using QObject::QObject;
+
+    int start(quint16 transactionId, int msec)
+    {
+        const int timerId = startTimer(msec);
+        if (timerId > 0)
+            m_transactions.insert(timerId, transactionId);
+        return timerId;
+    }
+    void stop(int timerId)
+    {
+        if (m_transactions.remove(timerId))
+            killTimer(timerId);
+    }
+
+    std::function<void(quint16 transactionId)> timeout;
+
+protected:
+    void timerEvent(QTimerEvent *event) override
+    {
+        const int timerId = event->timerId();
+        killTimer(timerId);
+        const auto it = m_transactions.constFind(timerId);
+        if (it == m_transactions.cend())
+            return;
+        const quint16 transactionId = *it;
+        m_transactions.erase(it);
+        if (timeout)
+            timeout(transactionId);
+    }
+
+private:
+    QHash<int, quint16> m_transactions;
+};
+
 class QModbusTcpClientPrivate : public QModbusClientPrivate
 {
     Q_DECLARE_PUBLIC(QModbusTcpClient)
 
 public:
+    // Reconnecting a lost member of the pool, see scheduleReconnect().
+    struct ReconnectState
+    {
+        int failures = 0; // since the member was last connected
+        bool pending = false;
+    };
+
+    // Additional connections of a pooled client. The first connection of the pool lives in
+    // m_socket, m_timers, responseBuffer, m_transactionStore, m_transactionId and m_reconnect.
+    struct PoolMember
+    {
+        QTcpSocket *socket = nullptr;
+        QModbusTcpClientTimers *timers = nullptr;
+        QByteArray responseBuffer;
+        QHash<quint16, QueueElement> transactionStore;
+        quint16 transactionId = 0;
+        ReconnectState reconnect;
+    };
+
+    struct Connection
+    {
+        QTcpSocket *socket;
+        QModbusTcpClientTimers *timers;
+        QByteArray &responseBuffer;
+        QHash<quint16, QueueElement> &transactionStore;
+        quint16 &transactionId;
+        ReconnectState &reconnect;
+    };
+
+    Connection connection(int index)
+    {
+        if (index == 0) {
+            return { m_socket, m_timers, responseBuffer, m_transactionStore, m_transactionId,
+                     m_reconnect };
+        }
+        PoolMember &member = *m_pool[index - 1];
+        return { member.socket, member.timers, member.responseBuffer, member.transactionStore,
+                 member.transactionId, member.reconnect };
+    }
+    QTcpSocket *socket(int index) const
+    {
+        return index == 0 ? m_socket : m_pool[index - 1]->socket;
+    }
+    int connectionTotal() const { return 1 + int(m_pool.size()); }
+
     void setupTcpSocket()
     {
         Q_Q(QModbusTcpClient);
 
         m_socket = new QTcpSocket(q);
+        m_timers = new QModbusTcpClientTimers(q);
+        setupConnection(0);
+
+        QObject::connect(q, &QModbusClient::timeoutChanged, q, [this]() {
+            // Pending requests wait for the changed timeout, starting over.
+            for (int i = 0; i < connectionTotal(); ++i) {
+                Connection c = connection(i);
+                for (auto it = c.transactionStore.begin(); it != c.transactionStore.end(); ++it) {
+                    if (it->m_timerId == INT_MIN)
+                        continue;
+                    c.timers->stop(it->m_timerId);
+                    it->m_timerId = c.timers->start(it.key(), responseTimeout(it->serverAddress()));
+                }
+            }
+        });
+    }
 
-        QObject::connect(m_socket, &QAbstractSocket::connected, q, [this]() {
-            qCDebug(QT_MODBUS) << "(TCP client) Connected to" << m_socket->peerAddress()
-                               << "on port" << m_socket->peerPort();
+    void addPoolMember()
+    {
+        Q_Q(QModbusTcpClient);
+
+        auto member = std::make_unique<PoolMember>();
+        member->socket = new QTcpSocket(q);
+        member->timers = new QModbusTcpClientTimers(q);
+        m_pool.push_back(std::move(member));
+        setupConnection(int(m_pool.size()));
+    }
+
+    void setupConnection(int index)
+    {
+        Q_Q(QModbusTcpClient);
+
+        const Connection c = connection(index);
+        c.timers->timeout = [this, index](quint16 tId) { onResponseTimeout(index, tId); };
+
+        QObject::connect(c.socket, &QAbstractSocket::connected, q, [this, index]() {
             Q_Q(QModbusTcpClient);
-            responseBuffer.clear();
+            const Connection c = connection(index);
+            if (index > 0 && q->state() != QModbusDevice::ConnectingState
+                    && q->state() != QModbusDevice::ConnectedState) {
+                c.socket->abort();
+                return;
+            }
+            qCDebug(QT_MODBUS) << "(TCP client) Connected to" << c.socket->peerAddress()
+                               << "on port" << c.socket->peerPort();
+            c.responseBuffer.clear();
+            c.reconnect.failures = 0;
             q->setState(QModbusDevice::ConnectedState);
         });
 
-        QObject::connect(m_socket, &QAbstractSocket::disconnected, q, [this]() {
+        QObject::connect(c.socket, &QAbstractSocket::disconnected, q, [this, index]() {
            qCDebug(QT_MODBUS)  << "(TCP client) Connection closed.";
-           Q_Q(QModbusTcpClient);
-           q->setState(QModbusDevice::UnconnectedState);
-           cleanupTransactionStore();
+           const bool pooled = isPooledElsewhere(index);
+           connectionLost(index, pooled);
+           cleanupTransactionStore(index);
         });
 
-        QObject::connect(m_socket, &QAbstractSocket::errorOccurred, q,
-                         [this](QAbstractSocket::SocketError /*error*/)
+        QObject::connect(c.socket, &QAbstractSocket::errorOccurred, q,
+                         [this, index](QAbstractSocket::SocketError /*error*/)
         {
             Q_Q(QModbusTcpClient);
 
-            if (m_socket->state() == QAbstractSocket::UnconnectedState) {
-                cleanupTransactionStore();
-                q->setState(QModbusDevice::UnconnectedState);
+            const Connection c = connection(index);
+            const bool pooled = isPooledElsewhere(index);
+            // A member that cannot reconnect fails again on every attempt, warn once.
+            const bool firstFailure = c.reconnect.failures == 0;
+            if (c.socket->state() == QAbstractSocket::UnconnectedState) {
+                cleanupTransactionStore(index);
+                connectionLost(index, pooled);
+            }
+            if (pooled) {
+                if (firstFailure) {
+                    qCWarning(QT_MODBUS) << "(TCP client) Pool connection" << index << "failed:"
+                                         << c.socket->errorString();
+                } else {
+                    qCDebug(QT_MODBUS) << "(TCP client) Pool connection" << index
+                                       << "failed again:" << c.socket->errorString();
+                }
+                return;
             }
-            q->setError(QModbusClient::tr("TCP socket error (%1).").arg(m_socket->errorString()),
+            q->setError(QModbusClient::tr("TCP socket error (%1).").arg(c.socket->errorString()),
                         QModbusDevice::ConnectionError);
         });
 
-        QObject::connect(m_socket, &QIODevice::readyRead, q, [this](){
-            responseBuffer += m_socket->read(m_socket->bytesAvailable());
-            qCDebug(QT_MODBUS_LOW) << "(TCP client) Response buffer:" << responseBuffer.toHex();
-
-            while (!responseBuffer.isEmpty()) {
-                // can we read enough for Modbus ADU header?
-                if (responseBuffer.size() < mbpaHeaderSize) {
-                    qCDebug(QT_MODBUS_LOW) << "(TCP client) MBPA header too short. Waiting for more data.";
-                    return;
-                }
+        QObject::connect(c.socket, &QIODevice::readyRead, q, [this, index]() {
+            onReadyRead(index);
+        });
+    }
 
-                quint8 serverAddress;
-                quint16 transactionId, bytesPdu, protocolId;
-                QDataStream input(responseBuffer);
-                input >> transactionId >> protocolId >> bytesPdu >> serverAddress;
+    void onReadyRead(int index)
+    {
+        const Connection c = connection(index);
+        c.responseBuffer += c.socket->read(c.socket->bytesAvailable());
+        qCDebug(QT_MODBUS_LOW) << "(TCP client) Response buffer:" << c.responseBuffer.toHex();
+
+        while (!c.responseBuffer.isEmpty()) {
+            // can we read enough for Modbus ADU header?
+            if (c.responseBuffer.size() < mbpaHeaderSize) {
+                qCDebug(QT_MODBUS_LOW) << "(TCP client) MBPA header too short. Waiting for more "
+                                          "data.";
+                return;
+            }
 
-                // stop the timer as soon as we know enough about the transaction
-                const bool knownTransaction = m_transactionStore.contains(transactionId);
-                if (knownTransaction && m_transactionStore[transactionId].timer)
-                    m_transactionStore[transactionId].timer->stop();
+            quint8 serverAddress;
+            quint16 transactionId, bytesPdu, protocolId;
+            QDataStream input(c.responseBuffer);
+            input >> transactionId >> protocolId >> bytesPdu >> serverAddress;
+
+            // stop the timer as soon as we know enough about the transaction
+            const auto known = c.transactionStore.find(transactionId);
+            const bool knownTransaction = (known != c.transactionStore.end());
+            if (knownTransaction) {
+                c.timers->stop(known->m_timerId);
+                known->m_timerId = INT_MIN;
+            }
 
-                qCDebug(QT_MODBUS) << "(TCP client) tid:" << Qt::hex << transactionId << "size:"
-                    << bytesPdu << "server address:" << serverAddress;
+            qCDebug(QT_MODBUS) << "(TCP client) tid:" << Qt::hex << transactionId << "size:"
+                << bytesPdu << "server address:" << serverAddress;
 
-                // The length field is the byte count of the following fields, including the Unit
-                // Identifier and the PDU, so we remove on byte.
-                bytesPdu--;
+            // The length field is the byte count of the following fields, including the Unit
+            // Identifier and the PDU, so we remove on byte.
+            bytesPdu--;
 
-                int tcpAduSize = mbpaHeaderSize + bytesPdu;
-                if (responseBuffer.size() < tcpAduSize) {
-                    qCDebug(QT_MODBUS) << "(TCP client) PDU too short. Waiting for more data";
-                    return;
-                }
+            int tcpAduSize = mbpaHeaderSize + bytesPdu;
+            if (c.responseBuffer.size() < tcpAduSize) {
+                qCDebug(QT_MODBUS) << "(TCP client) PDU too short. Waiting for more data";
+                return;
+            }
 
-                QModbusResponse responsePdu;
-                input >> responsePdu;
-                qCDebug(QT_MODBUS) << "(TCP client) Received PDU:" << responsePdu.functionCode()
-                                   << responsePdu.data().toHex();
+            QModbusResponse responsePdu;
+            input >> responsePdu;
+            qCDebug(QT_MODBUS) << "(TCP client) Received PDU:" << responsePdu.functionCode()
+                               << responsePdu.data().toHex();
+
+            c.responseBuffer.remove(0, tcpAduSize);
+
+            if (!knownTransaction) {
+                qCDebug(QT_MODBUS) << "(TCP client) No pending request for response with "
+                    "given transaction ID, ignoring response message.";
+            } else {
+                const QueueElement element = c.transactionStore.take(transactionId);
+                if (!element.isAbandoned())
+                    recordResponse(element, responsePdu);
+                processQueueElement(responsePdu, element);
+            }
+        }
+    }
 
-                responseBuffer.remove(0, tcpAduSize);
+    // Returns true if the client stays usable through other connections of the pool when the
+    // connection at index is lost.
+    bool isPooledElsewhere(int index) const
+    {
+        Q_Q(const QModbusTcpClient);
 
-                if (!knownTransaction) {
-                    qCDebug(QT_MODBUS) << "(TCP client) No pending request for response with "
-                        "given transaction ID, ignoring response message.";
-                } else {
-                    processQueueElement(responsePdu, m_transactionStore[transactionId]);
-                }
+        const QModbusDevice::State state = q->state();
+        if (state != QModbusDevice::ConnectingState && state != QModbusDevice::ConnectedState)
+            return false;
+        for (int i = 0; i < m_activeConnections; ++i) {
+            if (i == index)
+                continue;
+            const QAbstractSocket::SocketState other = socket(i)->state();
+            if (other == QAbstractSocket::ConnectedState)
+                return true;
+            // While connecting, the client waits for the remaining members to succeed.
+            if (state == QModbusDevice::ConnectingState
+                    && other != QAbstractSocket::UnconnectedState) {
+                return true;
             }
+        }
+        return false;
+    }
+
+    void connectionLost(int index, bool pooled)
+    {
+        Q_Q(QModbusTcpClient);
+
+        if (pooled) {
+            scheduleReconnect(index);
+            return;
+        }
+        q->setState(QModbusDevice::UnconnectedState);
+        // Stop pending reconnects of the other members, connected ones close on their own.
+        for (int i = 0; i < connectionTotal(); ++i) {
+            QTcpSocket *other = socket(i);
+            if (i != index && other->state() != QAbstractSocket::ConnectedState)
+                other->abort();
+        }
+    }
+
+    /*
+        Reconnects the member at \a index of the pool after a delay that doubles
+        with every failed attempt, from ReconnectDelay up to MaximumReconnectDelay.
+    */
+    void scheduleReconnect(int index)
+    {
+        const Connection c = connection(index);
+        if (c.reconnect.pending)
+            return; // both errorOccurred() and disconnected() report a lost connection
+
+        const int delay = qMin(ReconnectDelay << qMin(c.reconnect.failures, 6),
+                               MaximumReconnectDelay);
+        ++c.reconnect.failures;
+        c.reconnect.pending = true;
+
+        QTcpSocket *member = c.socket;
+        qCDebug(QT_MODBUS) << "(TCP client) Reconnecting pool connection" << index << "in"
+                           << delay << "ms.";
+        QTimer::singleShot(delay, member, [this, index, member]() {
+            Q_Q(QModbusTcpClient);
+            connection(index).reconnect.pending = false;
+            const QModbusDevice::State state = q->state();
+            if (state != QModbusDevice::ConnectingState && state != QModbusDevice::ConnectedState)
+                return;
+            if (member->state() == QAbstractSocket::UnconnectedState)
+                member->connectToHost(m_host, m_port);
         });
     }
 
+    bool writeToSocket(QTcpSocket *socket, quint16 tId, const QModbusRequest &request,
+                       int address)
+    {
+        // Built on the stack, the socket copies the bytes into its write buffer anyway.
+        QVarLengthArray<char, mbpaHeaderSize + 1 + QModbusPduView::MaxDataSize> buffer(
+            mbpaHeaderSize + request.size());
+        qToBigEndian<quint16>(tId, buffer.data());
+        qToBigEndian<quint16>(0, buffer.data() + 2);
+        qToBigEndian<quint16>(quint16(request.size() + 1), buffer.data() + 4);
+        buffer[6] = char(address);
+        QModbusPduView(request).copyTo(buffer.data() + mbpaHeaderSize);
+
+        const qint64 writtenBytes = socket->write(buffer.constData(), buffer.size());
+        if (writtenBytes == -1 || writtenBytes < buffer.size()) {
+            Q_Q(QModbusTcpClient);
+            qCDebug(QT_MODBUS) << "(TCP client) Cannot write request to socket.";
+            q->setError(QModbusTcpClient::tr("Could not write request to socket."),
+                        QModbusDevice::WriteError);
+            return false;
+        }
+        qCDebug(QT_MODBUS_LOW) << "(TCP client) Sent TCP ADU:"
+            << QByteArray::fromRawData(buffer.constData(), buffer.size()).toHex();
+        qCDebug(QT_MODBUS) << "(TCP client) Sent TCP PDU:" << request << "with tId:" <<Qt:: hex
+            << tId;
+        return true;
+    }
+
     QModbusReply *enqueueRequest(const QModbusRequest &request, int serverAddress,
                                  const QModbusDataUnit &unit,
                                  QModbusReply::ReplyType type) override
     {
-        auto writeToSocket = [this](quint16 tId, const QModbusRequest &request, int address) {
-            QByteArray buffer;
-            QDataStream output(&buffer, QIODevice::WriteOnly);
-            output << tId << quint16(0) << quint16(request.size() + 1) << quint8(address) << request;
-
-            int writtenBytes = m_socket->write(buffer);
-            if (writtenBytes == -1 || writtenBytes < buffer.size()) {
-                Q_Q(QModbusTcpClient);
-                qCDebug(QT_MODBUS) << "(TCP client) Cannot write request to socket.";
-                q->setError(QModbusTcpClient::tr("Could not write request to socket."),
-                            QModbusDevice::WriteError);
-                return false;
-            }
-            qCDebug(QT_MODBUS_LOW) << "(TCP client) Sent TCP ADU:" << buffer.toHex();
-            qCDebug(QT_MODBUS) << "(TCP client) Sent TCP PDU:" << request << "with tId:" <<Qt:: hex
-                << tId;
-            return true;
-        };
-
-        const int tId = transactionId();
-        if (!writeToSocket(tId, request, serverAddress))
-            return nullptr;
-
         Q_Q(QModbusTcpClient);
         auto reply = new QModbusReply(type, serverAddress, q);
-        const auto element = QueueElement{ reply, request, unit, m_numberOfRetries,
-            m_responseTimeoutDuration };
-        m_transactionStore.insert(tId, element);
+        if (!enqueueElement(QueueElement(reply, request, unit, 0))) {
+            delete reply;
+            return nullptr;
+        }
+        return reply;
+    }
 
-        q->connect(reply, &QObject::destroyed, q, [this, tId](QObject *) {
-            if (!m_transactionStore.contains(tId))
-                return;
-            const QueueElement element = m_transactionStore.take(tId);
-            if (element.timer)
-                element.timer->stop();
-        });
+    // The connected member of the pool with the fewest pending requests, the first one if
+    // none is connected.
+    int leastBusyConnection() const
+    {
+        int index = 0;
+        qsizetype pending = -1;
+        for (int i = 0; i < m_activeConnections; ++i) {
+            if (socket(i)->state() != QAbstractSocket::ConnectedState)
+                continue;
+            const qsizetype size = i == 0 ? m_transactionStore.size()
+                                          : m_pool[i - 1]->transactionStore.size();
+            if (pending < 0 || size < pending) {
+                index = i;
+                pending = size;
+            }
+        }
+        return index;
+    }
 
-        if (element.timer) {
-            q->connect(q, &QModbusClient::timeoutChanged,
-                       element.timer.data(), QOverload<int>::of(&QTimer::setInterval));
-            QObject::connect(element.timer.data(), &QTimer::timeout, q, [this, writeToSocket, tId]() {
-                if (!m_transactionStore.contains(tId))
-                    return;
-
-                QueueElement elem = m_transactionStore.take(tId);
-                if (elem.reply.isNull())
-                    return;
-
-                if (elem.numberOfRetries > 0) {
-                    elem.numberOfRetries--;
-                    if (!writeToSocket(tId, elem.requestPdu, elem.reply->serverAddress()))
-                        return;
-                    m_transactionStore.insert(tId, elem);
-                    elem.timer->start();
-                    qCDebug(QT_MODBUS) << "(TCP client) Resend request with tId:" << Qt::hex << tId;
-                } else {
-                    qCDebug(QT_MODBUS) << "(TCP client) Timeout of request with tId:" <<Qt::hex << tId;
-                    elem.reply->setError(QModbusDevice::TimeoutError,
-                        QModbusClient::tr("Request timeout."));
-                }
-            });
-            element.timer->start();
+    bool enqueueElement(QueueElement element) override
+    {
+        const Connection c = connection(leastBusyConnection());
+        const quint16 tId = c.transactionId;
+        const int serverAddress = element.serverAddress();
+        if (!writeToSocket(c.socket, tId, element.requestPdu, serverAddress))
+            return false;
+
+        element.numberOfRetries = m_numberOfRetries;
+        element.attempts = 1;
+        element.sent.start();
+        element.m_timerId = c.timers->start(tId, responseTimeout(serverAddress));
+        c.transactionStore.insert(tId, element);
+        c.transactionId++; // This doesn't overflow, it rather "wraps around". Expected.
+        recordRequest(element, queueDepth());
+        return true;
+    }
+
+    void onResponseTimeout(int index, quint16 tId)
+    {
+        const Connection c = connection(index);
+        if (!c.transactionStore.contains(tId))
+            return;
+
+        QueueElement elem = c.transactionStore.take(tId);
+        if (elem.isAbandoned())
+            return;
+
+        const int serverAddress = elem.serverAddress();
+        recordTimeout(elem, elem.numberOfRetries <= 0);
+        if (elem.numberOfRetries > 0) {
+            elem.numberOfRetries--;
+            if (!writeToSocket(c.socket, tId, elem.requestPdu, serverAddress))
+                return;
+            elem.attempts++;
+            elem.sent.start();
+            elem.m_timerId = c.timers->start(tId, responseTimeout(serverAddress));
+            c.transactionStore.insert(tId, elem);
+            qCDebug(QT_MODBUS) << "(TCP client) Resend request with tId:" << Qt::hex << tId;
         } else {
-            qCWarning(QT_MODBUS) << "(TCP client) No response timeout timer for request with tId:"
-                << Qt::hex << tId << ". Expected timeout:" << m_responseTimeoutDuration;
+            qCDebug(QT_MODBUS) << "(TCP client) Timeout of request with tId:" <<Qt::hex << tId;
+            elem.setError(QModbusDevice::TimeoutError, QModbusClient::tr("Request timeout."));
         }
-        incrementTransactionId();
+    }
 
-        return reply;
+    qsizetype queueDepth() const override
+    {
+        qsizetype depth = m_transactionStore.size();
+        for (const auto &member : m_pool)
+            depth += member->transactionStore.size();
+        return depth;
     }
 
     // TODO: Review once we have a transport layer in place.
     bool isOpen() const override
     {
-        if (m_socket)
-            return m_socket->isOpen();
+        if (!m_socket)
+            return false;
+        for (int i = 0; i < connectionTotal(); ++i) {
+            if (socket(i)->isOpen())
+                return true;
+        }
         return false;
     }
 
-    void cleanupTransactionStore()
+    void cleanupTransactionStore(int index)
     {
-        if (m_transactionStore.isEmpty())
+        const Connection c = connection(index);
+        if (c.transactionStore.isEmpty())
             return;
 
         qCDebug(QT_MODBUS) << "(TCP client) Cleanup of pending requests";
 
-        for (const auto &elem : std::as_const(m_transactionStore)) {
-            if (elem.reply.isNull())
+        // Answering a request may send the next one, work on a copy.
+        const QHash<quint16, QueueElement> pending = std::exchange(c.transactionStore, {});
+        for (const auto &elem : pending) {
+            c.timers->stop(elem.m_timerId);
+            if (elem.isAbandoned())
                 continue;
-            elem.reply->setError(QModbusDevice::ReplyAbortedError,
-                                 QModbusClient::tr("Reply aborted due to connection closure."));
+            elem.setError(QModbusDevice::ReplyAbortedError,
+                          QModbusClient::tr("Reply aborted due to connection closure."));
         }
-        m_transactionStore.clear();
     }
 
-    // This doesn't overflow, it rather "wraps around". Expected.
-    inline void incrementTransactionId() { m_transactionId++; }
-    inline int transactionId() const { return m_transactionId; }
+    void dropAbandoned() override
+    {
+        for (int i = 0; i < connectionTotal(); ++i) {
+            const Connection c = connection(i);
+            c.transactionStore.removeIf([&c](const auto &entry) {
+                if (!entry.value().isAbandoned())
+                    return false;
+                c.timers->stop(entry.value().m_timerId);
+                return true;
+            });
+        }
+    }
 
     QIODevice *device() const override { return m_socket; }
 
     QTcpSocket *m_socket = nullptr;
+    QModbusTcpClientTimers *m_timers = nullptr;
     QByteArray responseBuffer;
     QHash<quint16, QueueElement> m_transactionStore;
-    int mbpaHeaderSize = 7;
-
-private:   // Private to avoid using the wrong id inside the timer lambda,
-    quint16 m_transactionId = 0; // capturing 'this' will not copy the id.
+    quint16 m_transactionId = 0;
+    ReconnectState m_reconnect;
+    static constexpr int mbpaHeaderSize = 7;
+
+    std::vector<std::unique_ptr<PoolMember>> m_pool;
+    int m_connectionCount = 1;
+    int m_activeConnections = 1;
+    QString m_host;
+    quint16 m_port = 0;
+    static constexpr int ReconnectDelay = 500;
+    static constexpr int MaximumReconnectDelay = 30000;
 };
 
 QT_END_NAMESPACE
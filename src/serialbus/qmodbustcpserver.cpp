@@ -42,6 +42,9 @@ QModbusTcpServer::QModbusTcpServer(QObject *parent)
 QModbusTcpServer::~QModbusTcpServer()
 {
     close();
+
+    Q_D(QModbusTcpServer);
+    d->stopWorkers();
 }
 
 /*!
@@ -77,6 +80,7 @@ bool QModbusTcpServer::open()
         return false;
     }
 
+    d->startWorkers();
     if (d->m_tcpServer->listen(QHostAddress(url.host()), quint16(url.port())))
         setState(QModbusDevice::ConnectedState);
     else
@@ -102,6 +106,7 @@ void QModbusTcpServer::close()
             d->m_tcpServer->findChildren<QTcpSocket *>(Qt::FindDirectChildrenOnly);
     for (auto socket : childSockets)
         socket->disconnectFromHost();
+    d->disconnectWorkerSockets();
 
     setState(QModbusDevice::UnconnectedState);
 }
@@ -159,6 +164,59 @@ void QModbusTcpServer::installConnectionObserver(QModbusTcpConnectionObserver *o
     d->m_observer.reset(observer);
 }
 
+/*!
+    Returns the number of worker threads serving client connections. The
+    default value is \c 0.
+
+    \sa setWorkerThreadCount()
+    \since 6.7
+*/
+int QModbusTcpServer::workerThreadCount() const
+{
+    Q_D(const QModbusTcpServer);
+    return d->m_workerThreadCount;
+}
+
+/*!
+    Sets the number of worker threads serving client connections to \a count.
+
+    With a \a count of \c 0, the default, every connection is handled on the
+    thread this server lives in. Otherwise a pool of \a count threads, each
+    running its own event loop, is started when the server connects. Every
+    accepted connection is assigned to the worker with the fewest connections
+    and keeps that affinity until it closes; its requests are read, passed to
+    processRequest() and answered on that worker thread.
+
+    The connection observer is still asked to accept new connections, and
+    \l modbusClientDisconnected() is still emitted, on this server's thread.
+    The dataWritten() signal is emitted from the worker thread that processed
+    the write request.
+
+    \note Reimplementations of processRequest(), processPrivateRequest(),
+    readData() and writeData() must be thread-safe if worker threads are
+    used. The default implementations are.
+
+    \note The new value takes effect the next time the server connects. It is
+    ignored while the server is connected.
+
+    \sa workerThreadCount()
+    \since 6.7
+*/
+void QModbusTcpServer::setWorkerThreadCount(int count)
+{
+    if (count < 0)
+        return;
+
+    if (state() != QModbusDevice::UnconnectedState) {
+        qCWarning(QT_MODBUS) << "(TCP server) Cannot change the worker thread count while"
+            " connected.";
+        return;
+    }
+
+    Q_D(QModbusTcpServer);
+    d->m_workerThreadCount = count;
+}
+
 /*!
     \class QModbusTcpConnectionObserver
     \inmodule QtSerialBus
@@ -31,6 +31,9 @@ public:
 
     void installConnectionObserver(QModbusTcpConnectionObserver *observer);
 
+    int workerThreadCount() const;
+    void setWorkerThreadCount(int count);
+
 Q_SIGNALS:
     void modbusClientDisconnected(QTcpSocket *modbusClient);
 
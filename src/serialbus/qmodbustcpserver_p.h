@@ -6,8 +6,13 @@
 
 #include <QtCore/qdatastream.h>
 #include <QtCore/qdebug.h>
+#include <QtCore/qendian.h>
+#include <QtCore/qhash.h>
 #include <QtCore/qloggingcategory.h>
+#include <QtCore/qmutex.h>
 #include <QtCore/qobject.h>
+#include <QtCore/qreadwritelock.h>
+#include <QtCore/qthread.h>
 #include <QtNetwork/qhostaddress.h>
 #include <QtNetwork/qtcpserver.h>
 #include <QtNetwork/qtcpsocket.h>
@@ -15,7 +20,9 @@
 
 #include <private/qmodbusserver_p.h>
 
+#include <functional>
 #include <memory>
+#include <vector>
 
 //
 //  W A R N I N G
@@ -33,11 +40,69 @@ QT_BEGIN_NAMESPACE
 Q_DECLARE_LOGGING_CATEGORY(QT_MODBUS)
 Q_DECLARE_LOGGING_CATEGORY(QT_MODBUS_LOW)
 
+/*
+    Holds the framing state of one client connection. Incoming bytes are read
+    straight into \c readBuffer and consumed by advancing \c readOffset, so a
+    complete MBAP frame is always contiguous and can be decoded in place. The
+    unconsumed tail is moved to the front once per readyRead(), not once per
+    frame. Responses are assembled into \c writeBuffer, which keeps its
+    capacity between reads.
+*/
+struct QModbusTcpConnection
+{
+    QModbusTcpConnection()
+    {
+        readBuffer.reserve(InitialCapacity);
+        writeBuffer.reserve(InitialCapacity);
+    }
+
+    qsizetype bytesAvailable() const { return readBuffer.size() - readOffset; }
+    const char *frame() const { return readBuffer.constData() + readOffset; }
+    void consume(qsizetype size) { readOffset += size; }
+
+    bool read(QIODevice *device)
+    {
+        const qint64 available = device->bytesAvailable();
+        if (available <= 0)
+            return false;
+
+        const qsizetype oldSize = readBuffer.size();
+        readBuffer.resize(oldSize + available);
+        const qint64 read = device->read(readBuffer.data() + oldSize, available);
+        readBuffer.resize(oldSize + qMax<qint64>(read, 0));
+        return read > 0;
+    }
+
+    void compact()
+    {
+        if (readOffset == 0)
+            return;
+
+        const qsizetype left = bytesAvailable();
+        if (left > 0)
+            memmove(readBuffer.data(), readBuffer.constData() + readOffset, size_t(left));
+        readBuffer.resize(left); // keeps the capacity
+        readOffset = 0;
+    }
+
+    static constexpr qsizetype InitialCapacity = 4096;
+
+    QByteArray readBuffer;
+    qsizetype readOffset = 0;
+    QByteArray writeBuffer;
+    quint64 id = 0; // see QModbusTcpServerPrivate::m_connections
+};
+
 class QModbusTcpServerPrivate : public QModbusServerPrivate
 {
     Q_DECLARE_PUBLIC(QModbusTcpServer)
 
 public:
+    ~QModbusTcpServerPrivate() override
+    {
+        stopWorkers();
+    }
+
     /*
         This function is a workaround since 2nd level lambda below cannot
         call protected QModbusTcpServer::processRequest(..) function on VS2013.
@@ -57,10 +122,18 @@ public:
     /*
         This function is a workaround since 2nd level lambda below cannot
         call protected QModbusDevice::setError(..) function on VS2013.
+
+        Errors raised on a worker thread are handed over to the server's thread.
     */
     void forwardError(const QString &errorText, QModbusDevice::Error error)
     {
         Q_Q(QModbusTcpServer);
+        if (QThread::currentThread() != q->thread()) {
+            QMetaObject::invokeMethod(q, [this, errorText, error]() {
+                forwardError(errorText, error);
+            }, Qt::QueuedConnection);
+            return;
+        }
         q->setError(errorText, error);
     }
 
@@ -71,7 +144,7 @@ public:
     bool matchingServerAddress(quint8 unitId) const
     {
         Q_Q(const QModbusTcpServer);
-        if (q->serverAddress() == unitId)
+        if (hasServerAddress(unitId))
             return true;
 
         // No, not our address! Ignore!
@@ -84,7 +157,6 @@ public:
     {
         m_tcpServer = new QTcpServer(q_func());
         QObject::connect(m_tcpServer, &QTcpServer::newConnection, q_func(), [this]() {
-            Q_Q(QModbusTcpServer);
             auto *socket = m_tcpServer->nextPendingConnection();
             if (!socket)
                 return;
@@ -99,84 +171,7 @@ public:
                 return;
             }
 
-            auto buffer = new QByteArray();
-
-            QObject::connect(socket, &QObject::destroyed, socket, [buffer]() {
-                // cleanup buffer
-                delete buffer;
-            });
-            QObject::connect(socket, &QTcpSocket::disconnected, q, [socket, this]() {
-                Q_Q(QModbusTcpServer);
-                emit q->modbusClientDisconnected(socket);
-                socket->deleteLater();
-            });
-            QObject::connect(socket, &QTcpSocket::readyRead, q, [buffer, socket, this]() {
-                if (!socket)
-                    return;
-
-                buffer->append(socket->readAll());
-                while (!buffer->isEmpty()) {
-                    qCDebug(QT_MODBUS_LOW).noquote() << "(TCP server) Read buffer: 0x"
-                        + buffer->toHex();
-
-                    if (buffer->size() < mbpaHeaderSize) {
-                        qCDebug(QT_MODBUS) << "(TCP server) MBPA header too short. Waiting for more data.";
-                        return;
-                    }
-
-                    quint8 unitId;
-                    quint16 transactionId, bytesPdu, protocolId;
-                    QDataStream input(*buffer);
-                    input >> transactionId >> protocolId >> bytesPdu >> unitId;
-
-                    qCDebug(QT_MODBUS_LOW) << "(TCP server) Request MBPA:" << "Transaction Id:"
-                        << Qt::hex << transactionId << "Protocol Id:" << protocolId << "PDU bytes:"
-                        << bytesPdu << "Unit Id:" << unitId;
-
-                    // The length field is the byte count of the following fields, including the Unit
-                    // Identifier and the PDU, so we remove on byte.
-                    bytesPdu--;
-
-                    const quint16 current = mbpaHeaderSize + bytesPdu;
-                    if (buffer->size() < current) {
-                        qCDebug(QT_MODBUS) << "(TCP server) PDU too short. Waiting for more data";
-                        return;
-                    }
-
-                    QModbusRequest request;
-                    input >> request;
-
-                    buffer->remove(0, current);
-
-                    if (!matchingServerAddress(unitId))
-                        continue;
-
-                    qCDebug(QT_MODBUS) << "(TCP server) Request PDU:" << request;
-                    const QModbusResponse response = forwardProcessRequest(request);
-                    qCDebug(QT_MODBUS) << "(TCP server) Response PDU:" << response;
-
-                    QByteArray result;
-                    QDataStream output(&result, QIODevice::WriteOnly);
-                    // The length field is the byte count of the following fields, including the Unit
-                    // Identifier and PDU fields, so we add one byte to the response size.
-                    output << transactionId << protocolId << quint16(response.size() + 1)
-                           << unitId << response;
-
-                    if (!socket->isOpen()) {
-                        qCDebug(QT_MODBUS) << "(TCP server) Requesting socket has closed.";
-                        forwardError(QModbusTcpServer::tr("Requesting socket is closed"),
-                                     QModbusDevice::WriteError);
-                        return;
-                    }
-
-                    qint64 writtenBytes = socket->write(result);
-                    if (writtenBytes == -1 || writtenBytes < result.size()) {
-                        qCDebug(QT_MODBUS) << "(TCP server) Cannot write requested response to socket.";
-                        forwardError(QModbusTcpServer::tr("Could not write response to client"),
-                                     QModbusDevice::WriteError);
-                    }
-                }
-            });
+            setupConnection(socket);
         });
 
         QObject::connect(m_tcpServer, &QTcpServer::acceptError, q_func(),
@@ -188,10 +183,366 @@ public:
         });
     }
 
+    void setupConnection(QTcpSocket *socket)
+    {
+        Q_Q(QModbusTcpServer);
+        auto connection = new QModbusTcpConnection;
+
+        // Handlers run in the socket's thread, which is a worker thread if the
+        // connection has been assigned to one.
+        Worker *worker = nextWorker();
+        QObject *context = worker ? static_cast<QObject *>(socket) : q;
+
+        const quint64 id = ++m_lastConnectionId;
+        connection->id = id;
+        {
+            QMutexLocker locker(&m_connectionsMutex);
+            m_connections.insert(id, { socket, worker ? worker->context : q });
+        }
+
+        // Direct, the socket might be deleted from the server's thread once its worker stopped.
+        QObject::connect(socket, &QObject::destroyed, socket, [connection, worker, id, this]() {
+            // cleanup connection state
+            {
+                QMutexLocker locker(&m_connectionsMutex);
+                m_connections.remove(id);
+            }
+            delete connection;
+            if (worker)
+                worker->connections.deref();
+        }, Qt::DirectConnection);
+        QObject::connect(socket, &QTcpSocket::disconnected, context, [socket, id, this]() {
+            Q_Q(QModbusTcpServer);
+            if (QThread::currentThread() == q->thread()) {
+                emit q->modbusClientDisconnected(socket);
+                socket->deleteLater();
+                return;
+            }
+            // The socket is deleted with its worker if the workers stop before the signal
+            // is emitted on the server's thread, so look it up again there.
+            QMetaObject::invokeMethod(q, [id, this]() {
+                QTcpSocket *socket = connectionSocket(id);
+                if (!socket)
+                    return;
+                Q_Q(QModbusTcpServer);
+                emit q->modbusClientDisconnected(socket);
+                socket->deleteLater();
+            }, Qt::QueuedConnection);
+        });
+        QObject::connect(socket, &QTcpSocket::readyRead, context, [connection, socket, this]() {
+            if (!socket)
+                return;
+            processReadyRead(socket, connection);
+        });
+
+        if (!worker)
+            return;
+
+        worker->connections.ref();
+        socket->setParent(nullptr);
+        socket->moveToThread(worker->thread);
+        QMetaObject::invokeMethod(worker->context, [connection, socket, worker, this]() {
+            // Reparent inside the worker thread, the context's children are not guarded.
+            socket->setParent(worker->context);
+            if (socket->bytesAvailable() > 0)
+                processReadyRead(socket, connection);
+        }, Qt::QueuedConnection);
+    }
+
+    /*
+        Returns the socket of the connection \a id, or \c nullptr if the socket
+        has been destroyed. Sockets are only deleted on their own thread, or on
+        the server's thread once their worker stopped, so the result may be
+        used on either of these threads.
+    */
+    QTcpSocket *connectionSocket(quint64 id) const
+    {
+        QMutexLocker locker(&m_connectionsMutex);
+        return m_connections.value(id).socket;
+    }
+
+    /*
+        Returns the id of the connection using \a socket, or \c 0 if there is
+        none.
+    */
+    quint64 connectionId(const QTcpSocket *socket) const
+    {
+        QMutexLocker locker(&m_connectionsMutex);
+        for (auto it = m_connections.cbegin(); it != m_connections.cend(); ++it) {
+            if (it->socket == socket)
+                return it.key();
+        }
+        return 0;
+    }
+
+    /*
+        Every worker owns a thread running its own event loop. Accepted sockets
+        are moved to the worker with the fewest connections and stay there for
+        their whole lifetime. The context object lives in the worker thread and
+        parents the sockets, so they are deleted together with the worker.
+    */
+    struct Worker
+    {
+        QThread *thread = nullptr;
+        QObject *context = nullptr;
+        QAtomicInt connections;
+    };
+
+    Worker *nextWorker() const
+    {
+        Worker *next = nullptr;
+        for (const auto &worker : m_workers) {
+            if (!next || worker->connections.loadRelaxed() < next->connections.loadRelaxed())
+                next = worker.get();
+        }
+        return next;
+    }
+
+    void startWorkers()
+    {
+        if (int(m_workers.size()) == m_workerThreadCount)
+            return;
+
+        stopWorkers();
+        for (int i = 0; i < m_workerThreadCount; ++i) {
+            auto worker = std::make_unique<Worker>();
+            worker->thread = new QThread;
+            worker->thread->setObjectName(QStringLiteral("QModbusTcpServer worker %1").arg(i));
+            worker->context = new QObject;
+            worker->context->moveToThread(worker->thread);
+            worker->thread->start();
+            m_workers.push_back(std::move(worker));
+        }
+    }
+
+    void stopWorkers()
+    {
+        for (const auto &worker : m_workers) {
+            worker->thread->quit();
+            worker->thread->wait();
+            delete worker->context; // deletes the remaining sockets, the thread has finished
+            delete worker->thread;
+
+            // Sockets that were not reparented yet are not deleted with the context.
+            QMutexLocker locker(&m_connectionsMutex);
+            m_connections.removeIf([context = worker->context](const auto &entry) {
+                return entry.value().context == context;
+            });
+        }
+        m_workers.clear();
+    }
+
+    void disconnectWorkerSockets()
+    {
+        for (const auto &worker : m_workers) {
+            QObject *context = worker->context;
+            QMetaObject::invokeMethod(context, [context]() {
+                const auto sockets = context->findChildren<QTcpSocket *>(
+                    Qt::FindDirectChildrenOnly);
+                for (auto socket : sockets)
+                    socket->disconnectFromHost();
+            }, Qt::QueuedConnection);
+        }
+    }
+
+    void processReadyRead(QTcpSocket *socket, QModbusTcpConnection *connection)
+    {
+        connection->read(socket);
+        qCDebug(QT_MODBUS_LOW).noquote() << "(TCP server) Read buffer: 0x"
+            + QByteArray::fromRawData(connection->frame(), connection->bytesAvailable()).toHex();
+
+        while (connection->bytesAvailable() > 0) {
+            if (connection->bytesAvailable() < mbpaHeaderSize) {
+                qCDebug(QT_MODBUS) << "(TCP server) MBPA header too short. Waiting for more data.";
+                break;
+            }
+
+            const char *frame = connection->frame();
+            const quint16 transactionId = qFromBigEndian<quint16>(frame);
+            const quint16 protocolId = qFromBigEndian<quint16>(frame + 2);
+            quint16 bytesPdu = qFromBigEndian<quint16>(frame + 4);
+            const quint8 unitId = quint8(frame[6]);
+
+            qCDebug(QT_MODBUS_LOW) << "(TCP server) Request MBPA:" << "Transaction Id:"
+                << Qt::hex << transactionId << "Protocol Id:" << protocolId << "PDU bytes:"
+                << bytesPdu << "Unit Id:" << unitId;
+
+            if (bytesPdu < 2) {
+                // The length field must at least cover the Unit Identifier and the function code.
+                qCDebug(QT_MODBUS) << "(TCP server) Invalid MBPA length field, skipping frame.";
+                connection->consume(qMin<qsizetype>(mbpaHeaderSize + qMax(bytesPdu - 1, 0),
+                                                    connection->bytesAvailable()));
+                continue;
+            }
+
+            // The length field is the byte count of the following fields, including the Unit
+            // Identifier and the PDU, so we remove on byte.
+            bytesPdu--;
+
+            const qsizetype current = mbpaHeaderSize + bytesPdu;
+            if (connection->bytesAvailable() < current) {
+                qCDebug(QT_MODBUS) << "(TCP server) PDU too short. Waiting for more data";
+                break;
+            }
+
+            // The PDU is decoded in place, the function code is followed by bytesPdu - 1 bytes.
+            const QModbusRequest request(QModbusPdu::FunctionCode(quint8(frame[mbpaHeaderSize])),
+                QByteArray(frame + mbpaHeaderSize + 1, bytesPdu - 1));
+            connection->consume(current);
+
+            {
+                QReadLocker locker(&m_requestHandlerLock);
+                if (m_requestHandler
+                    && m_requestHandler(connection->id, transactionId, protocolId, unitId,
+                                        request)) {
+                    continue; // answered later through postResponse()
+                }
+            }
+
+            if (!matchingServerAddress(unitId))
+                continue;
+            const UnitScope unitScope(this, unitId);
+
+            qCDebug(QT_MODBUS) << "(TCP server) Request PDU:" << request;
+            const QModbusResponse response = forwardProcessRequest(request);
+            qCDebug(QT_MODBUS) << "(TCP server) Response PDU:" << response;
+
+            appendResponse(&connection->writeBuffer, transactionId, protocolId, unitId, response);
+        }
+        connection->compact();
+
+        if (connection->writeBuffer.isEmpty())
+            return;
+
+        if (!socket->isOpen()) {
+            qCDebug(QT_MODBUS) << "(TCP server) Requesting socket has closed.";
+            forwardError(QModbusTcpServer::tr("Requesting socket is closed"),
+                         QModbusDevice::WriteError);
+            connection->writeBuffer.resize(0);
+            return;
+        }
+
+        // Write through the raw data overload, so the socket copies the bytes instead of
+        // sharing (and later detaching) our buffer.
+        const qint64 size = connection->writeBuffer.size();
+        const qint64 writtenBytes = socket->write(connection->writeBuffer.constData(), size);
+        if (writtenBytes == -1 || writtenBytes < size) {
+            qCDebug(QT_MODBUS) << "(TCP server) Cannot write requested response to socket.";
+            forwardError(QModbusTcpServer::tr("Could not write response to client"),
+                         QModbusDevice::WriteError);
+        }
+        connection->writeBuffer.resize(0); // keeps the capacity
+    }
+
+    /*
+        Writes a response that was produced outside of processReadyRead(),
+        see m_requestHandler. Must be called on the server's thread. The
+        response is written on the thread of the connection \a connectionId,
+        and dropped if the connection has been closed in the meantime.
+    */
+    void postResponse(quint64 connectionId, quint16 transactionId, quint16 protocolId,
+                      quint8 unitId, const QModbusResponse &response)
+    {
+        QObject *context = nullptr;
+        {
+            QMutexLocker locker(&m_connectionsMutex);
+            context = m_connections.value(connectionId).context;
+        }
+        if (!context)
+            return;
+
+        QMetaObject::invokeMethod(context, [this, connectionId, transactionId, protocolId,
+                                            unitId, response]() {
+            if (QTcpSocket *socket = connectionSocket(connectionId))
+                writeResponse(socket, transactionId, protocolId, unitId, response);
+        }, Qt::AutoConnection);
+    }
+
+    /*
+        Writes \a response to \a socket. Must be called on the socket's thread.
+    */
+    void writeResponse(QTcpSocket *socket, quint16 transactionId, quint16 protocolId,
+                       quint8 unitId, const QModbusResponse &response)
+    {
+        if (!socket->isOpen()) {
+            qCDebug(QT_MODBUS) << "(TCP server) Requesting socket has closed.";
+            forwardError(QModbusTcpServer::tr("Requesting socket is closed"),
+                         QModbusDevice::WriteError);
+            return;
+        }
+
+        qCDebug(QT_MODBUS) << "(TCP server) Response PDU:" << response;
+        QByteArray buffer;
+        appendResponse(&buffer, transactionId, protocolId, unitId, response);
+        const qint64 writtenBytes = socket->write(buffer);
+        if (writtenBytes == -1 || writtenBytes < buffer.size()) {
+            qCDebug(QT_MODBUS) << "(TCP server) Cannot write requested response to socket.";
+            forwardError(QModbusTcpServer::tr("Could not write response to client"),
+                         QModbusDevice::WriteError);
+        }
+    }
+
+    static void appendResponse(QByteArray *buffer, quint16 transactionId, quint16 protocolId,
+                               quint8 unitId, const QModbusResponse &response)
+    {
+        const QByteArray data = response.data();
+        const qsizetype offset = buffer->size();
+        buffer->resize(offset + mbpaHeaderSize + 1 + data.size());
+
+        char *out = buffer->data() + offset;
+        qToBigEndian<quint16>(transactionId, out);
+        qToBigEndian<quint16>(protocolId, out + 2);
+        // The length field is the byte count of the following fields, including the Unit
+        // Identifier and PDU fields, so we add one byte to the response size.
+        qToBigEndian<quint16>(quint16(response.size() + 1), out + 4);
+        out[6] = char(unitId);
+        out[mbpaHeaderSize] = char(response.isException()
+            ? (response.functionCode() | QModbusPdu::ExceptionByte) : response.functionCode());
+        if (!data.isEmpty())
+            memcpy(out + mbpaHeaderSize + 1, data.constData(), size_t(data.size()));
+    }
+
     QTcpServer *m_tcpServer { nullptr };
 
     std::unique_ptr<QModbusTcpConnectionObserver> m_observer;
 
+    /*
+        Lets QModbusGateway take over requests before they are processed
+        locally. Called on the thread that owns the requesting socket, with
+        m_requestHandlerLock locked for reading. If the handler returns true,
+        it is responsible for answering the request through postResponse().
+    */
+    using RequestHandler = std::function<bool(quint64 connectionId, quint16 transactionId,
+        quint16 protocolId, quint8 unitId, const QModbusRequest &request)>;
+
+    void setRequestHandler(RequestHandler handler)
+    {
+        QWriteLocker locker(&m_requestHandlerLock);
+        m_requestHandler = std::move(handler);
+    }
+
+    RequestHandler m_requestHandler;
+    QReadWriteLock m_requestHandlerLock; // waits for running handlers when replacing one
+
+    int m_workerThreadCount = 0;
+    std::vector<std::unique_ptr<Worker>> m_workers;
+
+    /*
+        Open connections by id. A QPointer to a socket living on a worker
+        thread cannot be checked safely from another thread, so code that
+        outlives a connection keeps its id instead, see connectionSocket().
+        The context is the object events for the socket's thread are posted
+        to.
+    */
+    struct ConnectionEntry
+    {
+        QTcpSocket *socket = nullptr;
+        QObject *context = nullptr;
+    };
+    mutable QMutex m_connectionsMutex;
+    QHash<quint64, ConnectionEntry> m_connections;
+    quint64 m_lastConnectionId = 0; // only used on the server's thread
+
     static const qint8 mbpaHeaderSize = 7;
     static const qint16 maxBytesModbusADU = 260;
 };
@@ -6,10 +6,14 @@
 #include <QCoreApplication>
 #include <QTextStream>
 
-CanBusUtil::CanBusUtil(QTextStream &output, QCoreApplication &app, QObject *parent) :
+#include <algorithm>
+
+CanBusUtil::CanBusUtil(QTextStream &output, QTextStream &errors, QCoreApplication &app,
+                       QObject *parent) :
     QObject(parent),
     m_canBus(QCanBus::instance()),
     m_output(output),
+    m_errors(errors),
     m_app(app),
     m_readTask(new ReadTask(output, this))
 {
@@ -25,6 +29,39 @@ void CanBusUtil::setShowFlags(bool showFlags)
     m_readTask->setShowFlags(showFlags);
 }
 
+void CanBusUtil::setStats(bool stats)
+{
+    m_stats = stats;
+}
+
+void CanBusUtil::setCapture(const QString &fileName, CaptureTask::Format format)
+{
+    m_captureFileName = fileName;
+    m_captureFormat = format;
+}
+
+void CanBusUtil::setMaximumFrames(qint64 maximumFrames)
+{
+    m_maximumFrames = maximumFrames;
+}
+
+void CanBusUtil::setDuration(int msecs)
+{
+    m_duration = msecs;
+}
+
+void CanBusUtil::setReplay(const QString &fileName, double speed, bool looping)
+{
+    m_replayFileName = fileName;
+    m_replaySpeed = speed;
+    m_replayLooping = looping;
+}
+
+void CanBusUtil::setGenerator(const GeneratorTask::Settings &settings)
+{
+    m_generatorSettings = settings;
+}
+
 void CanBusUtil::setConfigurationParameter(QCanBusDevice::ConfigurationKey key,
                                            const QVariant &value)
 {
@@ -34,29 +71,103 @@ void CanBusUtil::setConfigurationParameter(QCanBusDevice::ConfigurationKey key,
 bool CanBusUtil::start(const QString &pluginName, const QString &deviceName, const QString &data)
 {
     if (!m_canBus) {
-        m_output << tr("Error: Cannot create QCanBus.") << Qt::endl;
+        diagnostics() << tr("Error: Cannot create QCanBus.") << Qt::endl;
         return false;
     }
 
     m_pluginName = pluginName;
     m_deviceName = deviceName;
     m_data = data;
-    m_listening = data.isEmpty();
+    m_listening = data.isEmpty() && m_replayFileName.isEmpty() && !m_generatorSettings;
+
+    if (!m_replayFileName.isEmpty()) {
+        m_replayer = new QCanBusReplayer(this);
+        if (!m_replayer->load(m_replayFileName)) {
+            m_output << m_replayer->errorString() << Qt::endl;
+            return false;
+        }
+        m_replayer->setSpeed(m_replaySpeed);
+        m_replayer->setLooping(m_replayLooping);
+    }
+
+    if (m_listening && !m_captureFileName.isEmpty()) {
+        m_captureTask = new CaptureTask(m_errors, this);
+        if (!m_captureTask->open(m_captureFileName, m_captureFormat, m_deviceName))
+            return false;
+        m_captureTask->setMaximumFrames(m_maximumFrames);
+    }
+
+    if (m_listening && m_stats && !m_captureTask) {
+        m_statsTask = new StatsTask(m_output, this);
+        m_statsTask->setBitRates(
+                m_configurationParameter.value(QCanBusDevice::BitRateKey).toInt(),
+                m_configurationParameter.value(QCanBusDevice::DataBitRateKey).toInt());
+        m_statsTask->setMaximumFrames(m_maximumFrames);
+    }
+
+    if (m_generatorSettings) {
+        GeneratorTask::Settings settings = *m_generatorSettings;
+        settings.maximumFrames = m_maximumFrames;
+        m_generatorTask = new GeneratorTask(m_output, this);
+        m_generatorTask->setSettings(settings);
+    }
 
     if (!connectCanDevice())
         return false;
 
-    if (m_listening) {
+    if (m_captureTask) {
+        // The capture runs until the frame count is reached, the duration has passed,
+        // or the user interrupts it. In all cases the remaining frames are written.
+        connect(m_canDevice.get(), &QCanBusDevice::framesReceived,
+                m_captureTask, &CaptureTask::handleFrames);
+        connect(m_captureTask, &CaptureTask::finished, &m_app, QCoreApplication::quit);
+        connect(&m_app, &QCoreApplication::aboutToQuit, m_captureTask, &CaptureTask::close);
+    } else if (m_statsTask) {
+        connect(m_canDevice.get(), &QCanBusDevice::framesReceived,
+                m_statsTask, &StatsTask::handleFrames);
+        connect(m_statsTask, &StatsTask::finished, &m_app, QCoreApplication::quit);
+        m_statsTask->start();
+    } else if (m_listening) {
         if (m_readTask->isShowFlags())
              m_canDevice->setConfigurationParameter(QCanBusDevice::CanFdKey, true);
+        m_readTask->setMaximumFrames(m_maximumFrames);
         connect(m_canDevice.get(), &QCanBusDevice::framesReceived,
                 m_readTask, &ReadTask::handleFrames);
+        connect(m_readTask, &ReadTask::finished, &m_app, QCoreApplication::quit);
+    } else if (m_replayer) {
+        const QList<QCanBusFrame> frames = m_replayer->frames();
+        const bool canFd = std::any_of(frames.cbegin(), frames.cend(), [](const QCanBusFrame &f) {
+            return f.hasFlexibleDataRateFormat();
+        });
+        if (canFd)
+            m_canDevice->setConfigurationParameter(QCanBusDevice::CanFdKey, true);
+
+        m_replayer->setDevice(m_canDevice.get());
+        connect(m_replayer, &QCanBusReplayer::finished, &m_app, QCoreApplication::quit);
+        connect(m_replayer, &QCanBusReplayer::errorOccurred, this, [this]() {
+            m_output << tr("Replay error: '%1'").arg(m_replayer->errorString()) << Qt::endl;
+            m_app.exit(1);
+        });
+        connect(&m_app, &QCoreApplication::aboutToQuit, this, [this]() {
+            m_output << tr("Replayed %1 frames, timing error average %2 us, maximum %3 us.")
+                        .arg(m_replayer->framesReplayed())
+                        .arg(m_replayer->averageTimingError())
+                        .arg(m_replayer->maximumTimingError()) << Qt::endl;
+        });
+        m_replayer->start();
+    } else if (m_generatorTask) {
+        connect(m_generatorTask, &GeneratorTask::finished, &m_app, QCoreApplication::quit);
+        connect(&m_app, &QCoreApplication::aboutToQuit, m_generatorTask, &GeneratorTask::stop);
+        m_generatorTask->start(m_canDevice.get());
     } else {
         if (!sendData())
             return false;
         QTimer::singleShot(0, &m_app, QCoreApplication::quit);
     }
 
+    if ((m_listening || m_generatorTask) && m_duration > 0)
+        QTimer::singleShot(m_duration, &m_app, QCoreApplication::quit);
+
     return true;
 }
 
@@ -165,13 +276,13 @@ bool CanBusUtil::setFrameFromPayload(QString payload, QCanBusFrame *frame)
 bool CanBusUtil::connectCanDevice()
 {
     if (!m_canBus->plugins().contains(m_pluginName)) {
-        m_output << tr("Cannot find CAN bus plugin '%1'.").arg(m_pluginName) << Qt::endl;
+        diagnostics() << tr("Cannot find CAN bus plugin '%1'.").arg(m_pluginName) << Qt::endl;
         return false;
     }
 
     m_canDevice.reset(m_canBus->createDevice(m_pluginName, m_deviceName));
     if (!m_canDevice) {
-        m_output << tr("Cannot create CAN bus device: '%1'").arg(m_deviceName) << Qt::endl;
+        diagnostics() << tr("Cannot create CAN bus device: '%1'").arg(m_deviceName) << Qt::endl;
         return false;
     }
 
@@ -179,9 +290,22 @@ bool CanBusUtil::connectCanDevice()
     for (auto i = m_configurationParameter.constBegin(); i != constEnd; ++i)
         m_canDevice->setConfigurationParameter(i.key(), i.value());
 
-    connect(m_canDevice.get(), &QCanBusDevice::errorOccurred, m_readTask, &ReadTask::handleError);
+    // A capture may be written to stdout, it reports errors on stderr.
+    if (m_captureTask) {
+        connect(m_canDevice.get(), &QCanBusDevice::errorOccurred,
+                m_captureTask, &CaptureTask::handleError);
+    } else if (m_statsTask) {
+        connect(m_canDevice.get(), &QCanBusDevice::errorOccurred,
+                m_statsTask, &StatsTask::handleError);
+    } else if (m_generatorTask) {
+        connect(m_canDevice.get(), &QCanBusDevice::errorOccurred,
+                m_generatorTask, &GeneratorTask::handleError);
+    } else {
+        connect(m_canDevice.get(), &QCanBusDevice::errorOccurred,
+                m_readTask, &ReadTask::handleError);
+    }
     if (!m_canDevice->connectDevice()) {
-        m_output << tr("Cannot create CAN bus device: '%1'").arg(m_deviceName) << Qt::endl;
+        diagnostics() << tr("Cannot create CAN bus device: '%1'").arg(m_deviceName) << Qt::endl;
         return false;
     }
 
@@ -212,3 +336,9 @@ bool CanBusUtil::sendData()
 
     return m_canDevice->writeFrame(frame);
 }
+
+// Diagnostics must not end up in a capture written to stdout.
+QTextStream &CanBusUtil::diagnostics()
+{
+    return m_captureFileName == QLatin1String("-") ? m_errors : m_output;
+}
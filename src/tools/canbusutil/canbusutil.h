@@ -4,10 +4,15 @@
 #ifndef CANBUSUTIL_H
 #define CANBUSUTIL_H
 
+#include "capturetask.h"
+#include "generatortask.h"
 #include "readtask.h"
+#include "statstask.h"
 
 #include <QObject>
 
+#include <optional>
+
 QT_BEGIN_NAMESPACE
 
 class QCanBusFrame;
@@ -20,14 +25,22 @@ class CanBusUtil : public QObject
 {
     Q_OBJECT
 public:
-    explicit CanBusUtil(QTextStream &output, QCoreApplication &app, QObject *parent = nullptr);
+    explicit CanBusUtil(QTextStream &output, QTextStream &errors, QCoreApplication &app,
+                        QObject *parent = nullptr);
 
     void setShowTimeStamp(bool showTimeStamp);
     void setShowFlags(bool showFlags);
+    void setStats(bool stats);
+    void setCapture(const QString &fileName, CaptureTask::Format format);
+    void setMaximumFrames(qint64 maximumFrames);
+    void setDuration(int msecs);
+    void setReplay(const QString &fileName, double speed, bool looping);
+    void setGenerator(const GeneratorTask::Settings &settings);
     void setConfigurationParameter(QCanBusDevice::ConfigurationKey key, const QVariant &value);
     bool start(const QString &pluginName, const QString &deviceName, const QString &data = QString());
     int  printPlugins();
     int  printDevices(const QString &pluginName);
+    QTextStream &diagnostics();
 
 private:
     bool parseDataField(QCanBusFrame::FrameId &id, QString &payload);
@@ -38,6 +51,7 @@ private:
 private:
     QCanBus *m_canBus = nullptr;
     QTextStream &m_output;
+    QTextStream &m_errors;
     QCoreApplication &m_app;
     bool m_listening = false;
     QString m_pluginName;
@@ -45,6 +59,19 @@ private:
     QString m_data;
     std::unique_ptr<QCanBusDevice> m_canDevice;
     ReadTask *m_readTask = nullptr;
+    StatsTask *m_statsTask = nullptr;
+    bool m_stats = false;
+    CaptureTask *m_captureTask = nullptr;
+    QString m_captureFileName;
+    CaptureTask::Format m_captureFormat = CaptureTask::Format::Binary;
+    qint64 m_maximumFrames = 0;
+    int m_duration = 0;
+    QCanBusReplayer *m_replayer = nullptr;
+    QString m_replayFileName;
+    double m_replaySpeed = 1.0;
+    bool m_replayLooping = false;
+    GeneratorTask *m_generatorTask = nullptr;
+    std::optional<GeneratorTask::Settings> m_generatorSettings;
     using ConfigurationParameter = QHash<QCanBusDevice::ConfigurationKey, QVariant>;
     ConfigurationParameter m_configurationParameter;
 };
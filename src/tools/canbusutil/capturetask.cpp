@@ -0,0 +1,122 @@
+// Copyright (C) 2023 The Qt Company Ltd.
+// SPDX-License-Identifier: LicenseRef-Qt-Commercial OR LGPL-3.0-only OR GPL-2.0-only OR GPL-3.0-only
+
+#include "capturetask.h"
+
+#include <QtSerialBus/private/qcanbuslog_p.h>
+
+// Frames are collected in memory and written in chunks of this size, a saturated CAN FD bus
+// thereby costs a few write calls per second instead of one per frame.
+static constexpr qsizetype FlushThreshold = 1024 * 1024;
+// A quiet bus takes long to fill the buffer, so it is also written at this interval, in ms.
+static constexpr int FlushInterval = 1000;
+
+CaptureTask::CaptureTask(QTextStream &errors, QObject *parent) :
+    QObject(parent),
+    m_errors(errors)
+{
+    m_flushTimer.setInterval(FlushInterval);
+    connect(&m_flushTimer, &QTimer::timeout, this, &CaptureTask::flush);
+}
+
+bool CaptureTask::open(const QString &fileName, Format format, const QString &interfaceName)
+{
+    bool ok = false;
+    if (fileName == QLatin1String("-")) {
+        ok = m_file.open(stdout, QIODevice::WriteOnly);
+    } else {
+        m_file.setFileName(fileName);
+        ok = m_file.open(QIODevice::WriteOnly | QIODevice::Truncate);
+    }
+    if (!ok) {
+        m_errors << tr("Cannot open capture file '%1': %2").arg(fileName, m_file.errorString())
+                 << Qt::endl;
+        return false;
+    }
+
+    m_format = format;
+    m_interfaceName = interfaceName.toLocal8Bit();
+    m_buffer.reserve(FlushThreshold + QCanBusLog::MaximumRecordSize * 4
+                     + m_interfaceName.size());
+    if (m_format == Format::Binary)
+        QCanBusLog::appendHeader(&m_buffer);
+    m_frames = 0;
+    m_elapsed.start();
+    m_flushTimer.start();
+    return true;
+}
+
+void CaptureTask::setMaximumFrames(qint64 maximumFrames)
+{
+    m_maximumFrames = maximumFrames;
+}
+
+void CaptureTask::close()
+{
+    if (!m_file.isOpen())
+        return;
+
+    m_flushTimer.stop();
+    flush();
+    m_file.close();
+
+    const qint64 msecs = m_elapsed.elapsed();
+    const double seconds = msecs / 1000.0;
+    m_errors << tr("Captured %1 frames in %2 s (%3 frames/s).")
+                .arg(m_frames)
+                .arg(seconds, 0, 'f', 3)
+                .arg(msecs > 0 ? m_frames / seconds : 0.0, 0, 'f', 0)
+             << Qt::endl;
+}
+
+void CaptureTask::handleFrames()
+{
+    auto canDevice = qobject_cast<QCanBusDevice *>(QObject::sender());
+    if (canDevice == nullptr) {
+        qWarning("CaptureTask::handleFrames: Unknown sender.");
+        return;
+    }
+
+    if (!m_file.isOpen())
+        return;
+
+    const QList<QCanBusFrame> frames = canDevice->readAllFrames();
+    for (const QCanBusFrame &frame : frames) {
+        if (m_format == Format::Binary)
+            QCanBusLog::appendBinary(&m_buffer, frame);
+        else
+            QCanBusLog::appendCandump(&m_buffer, frame, m_interfaceName);
+
+        if (m_buffer.size() >= FlushThreshold)
+            flush();
+
+        if (++m_frames == m_maximumFrames) {
+            close();
+            emit finished();
+            return;
+        }
+    }
+}
+
+void CaptureTask::handleError(QCanBusDevice::CanBusError /*error*/)
+{
+    auto canDevice = qobject_cast<QCanBusDevice *>(QObject::sender());
+    if (canDevice == nullptr) {
+        qWarning("CaptureTask::handleError: Unknown sender.");
+        return;
+    }
+
+    m_errors << tr("Read error: '%1'").arg(canDevice->errorString()) << Qt::endl;
+}
+
+void CaptureTask::flush()
+{
+    if (m_buffer.isEmpty())
+        return;
+
+    if (m_file.write(m_buffer) != m_buffer.size() && !m_writeFailed) {
+        m_writeFailed = true;
+        m_errors << tr("Cannot write capture file: %1").arg(m_file.errorString()) << Qt::endl;
+    }
+    m_buffer.resize(0);
+}
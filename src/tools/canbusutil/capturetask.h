@@ -0,0 +1,47 @@
+// Copyright (C) 2023 The Qt Company Ltd.
+// SPDX-License-Identifier: LicenseRef-Qt-Commercial OR LGPL-3.0-only OR GPL-2.0-only OR GPL-3.0-only
+
+#ifndef CAPTURETASK_H
+#define CAPTURETASK_H
+
+#include <QElapsedTimer>
+#include <QFile>
+#include <QObject>
+#include <QTimer>
+#include <QtSerialBus>
+
+class CaptureTask : public QObject
+{
+    Q_OBJECT
+public:
+    enum class Format { Binary, Candump };
+
+    explicit CaptureTask(QTextStream &errors, QObject *parent = nullptr);
+
+    bool open(const QString &fileName, Format format, const QString &interfaceName);
+    void setMaximumFrames(qint64 maximumFrames);
+    void close();
+
+signals:
+    void finished();
+
+public slots:
+    void handleFrames();
+    void handleError(QCanBusDevice::CanBusError /*error*/);
+
+private:
+    void flush();
+
+    QTextStream &m_errors; // the capture may be written to stdout
+    QFile m_file;
+    QByteArray m_buffer;
+    QTimer m_flushTimer; // writes out slow captures, see FlushInterval
+    QByteArray m_interfaceName;
+    QElapsedTimer m_elapsed;
+    Format m_format = Format::Binary;
+    qint64 m_frames = 0;
+    qint64 m_maximumFrames = 0;
+    bool m_writeFailed = false;
+};
+
+#endif // CAPTURETASK_H
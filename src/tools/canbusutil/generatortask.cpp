@@ -0,0 +1,174 @@
+// Copyright (C) 2023 The Qt Company Ltd.
+// SPDX-License-Identifier: LicenseRef-Qt-Commercial OR LGPL-3.0-only OR GPL-2.0-only OR GPL-3.0-only
+
+#include "generatortask.h"
+
+#include <QTimer>
+
+#include <cstring>
+
+// Frames written per event loop iteration. Larger batches cost fewer wake ups, smaller ones
+// keep the event loop responsive to the signals of the device.
+static constexpr qint64 BatchSize = 256;
+
+GeneratorTask::GeneratorTask(QTextStream &output, QObject *parent) :
+    QObject(parent),
+    m_output(output),
+    m_timer(new QTimer(this)),
+    m_random(QRandomGenerator::securelySeeded())
+{
+    m_timer->setSingleShot(true);
+    m_timer->setTimerType(Qt::PreciseTimer);
+    connect(m_timer, &QTimer::timeout, this, &GeneratorTask::writeBatch);
+}
+
+void GeneratorTask::setSettings(const Settings &settings)
+{
+    m_settings = settings;
+}
+
+void GeneratorTask::start(QCanBusDevice *device)
+{
+    m_device = device;
+
+    m_frame = QCanBusFrame();
+    m_frame.setExtendedFrameFormat(m_settings.extended);
+    m_frame.setFlexibleDataRateFormat(m_settings.flexibleDataRate);
+    m_frame.setBitrateSwitch(m_settings.flexibleDataRate && m_settings.bitrateSwitch);
+    m_frame.setFrameId(m_settings.id);
+    m_payload = m_settings.data;
+    m_sent = 0;
+    m_writeErrors = 0;
+
+    // Buffering devices report written frames, which frees room for the next batch.
+    connect(m_device, &QCanBusDevice::framesWritten, this, &GeneratorTask::writeBatch);
+
+    m_elapsed.start();
+    writeBatch();
+}
+
+void GeneratorTask::stop()
+{
+    if (!m_elapsed.isValid())
+        return;
+
+    m_timer->stop();
+    if (m_device)
+        disconnect(m_device, &QCanBusDevice::framesWritten, this, &GeneratorTask::writeBatch);
+
+    const qint64 msecs = m_elapsed.elapsed();
+    m_elapsed.invalidate();
+    const double seconds = msecs / 1000.0;
+    m_output << tr("Sent %1 frames in %2 s (%3 frames/s), %4 write errors.")
+                .arg(m_sent)
+                .arg(seconds, 0, 'f', 3)
+                .arg(msecs > 0 ? m_sent / seconds : 0.0, 0, 'f', 0)
+                .arg(m_writeErrors);
+    if (!m_lastError.isEmpty())
+        m_output << ' ' << tr("Last error: '%1'").arg(m_lastError);
+    m_output << Qt::endl;
+}
+
+void GeneratorTask::handleError(QCanBusDevice::CanBusError error)
+{
+    auto canDevice = qobject_cast<QCanBusDevice *>(QObject::sender());
+    if (canDevice == nullptr) {
+        qWarning("GeneratorTask::handleError: Unknown sender.");
+        return;
+    }
+
+    // Write errors are counted, printing each would slow the generator down.
+    m_lastError = canDevice->errorString();
+    if (error != QCanBusDevice::WriteError)
+        m_output << tr("Error: '%1'").arg(m_lastError) << Qt::endl;
+}
+
+void GeneratorTask::writeBatch()
+{
+    if (!m_elapsed.isValid() || !m_device)
+        return;
+
+    // At a target rate, frame n is due n / rate seconds after the start. Otherwise, keep the
+    // write queue of the device filled.
+    qint64 budget = 0;
+    if (m_settings.rate > 0) {
+        const qint64 due = qint64(m_elapsed.nsecsElapsed() / 1e9 * m_settings.rate) + 1;
+        budget = due - m_sent;
+    } else {
+        budget = BatchSize - m_device->framesToWrite();
+    }
+    if (m_settings.maximumFrames > 0)
+        budget = qMin(budget, m_settings.maximumFrames - m_sent);
+    budget = qMin(budget, BatchSize);
+
+    bool failed = false;
+    for (qint64 i = 0; i < budget; ++i) {
+        nextFrame();
+        if (!m_device->writeFrame(m_frame)) {
+            ++m_writeErrors;
+            failed = true;
+            break;
+        }
+        ++m_sent;
+    }
+
+    if (m_settings.maximumFrames > 0 && m_sent >= m_settings.maximumFrames) {
+        stop();
+        emit finished();
+        return;
+    }
+
+    if (m_settings.rate > 0) {
+        const qint64 nextDue = qint64(m_sent / m_settings.rate * 1e9);
+        const qint64 remaining = nextDue - m_elapsed.nsecsElapsed();
+        m_timer->start(remaining > 0 ? int(remaining / 1000000) : 0);
+    } else {
+        // Back off a little when the device rejects frames or its queue is full.
+        m_timer->start(failed || budget <= 0 ? 1 : 0);
+    }
+}
+
+void GeneratorTask::nextFrame()
+{
+    const QCanBusFrame::FrameId idMask = m_settings.extended ? 0x1FFFFFFF : 0x7FF;
+    switch (m_settings.idMode) {
+    case Mode::Random:
+        m_frame.setFrameId(m_random.generate() & idMask);
+        break;
+    case Mode::Increment:
+        m_frame.setFrameId(m_sent & idMask);
+        break;
+    case Mode::Fixed:
+        break;
+    }
+
+    if (m_settings.dataMode == Mode::Fixed) {
+        m_frame.setPayload(m_payload);
+        return;
+    }
+
+    int length = m_settings.length;
+    if (length < 0) {
+        static constexpr int fdLengths[] = { 0, 1, 2, 3, 4, 5, 6, 7, 8, 12, 16, 20, 24, 32, 48,
+                                             64 };
+        length = m_settings.flexibleDataRate ? fdLengths[m_random.bounded(16)]
+                                             : int(m_random.bounded(9));
+    }
+
+    m_payload.resize(length);
+    char *data = m_payload.data();
+    if (m_settings.dataMode == Mode::Random) {
+        for (int i = 0; i < length; i += 4) {
+            const quint32 value = m_random.generate();
+            std::memcpy(data + i, &value, size_t(qMin(4, length - i)));
+        }
+    } else {
+        // The frame counter in little-endian order, as cangen -D i does with its first byte.
+        quint64 counter = quint64(m_sent);
+        for (int i = 0; i < length; ++i) {
+            data[i] = char(counter & 0xff);
+            counter >>= 8;
+        }
+    }
+    m_frame.setPayload(m_payload);
+}
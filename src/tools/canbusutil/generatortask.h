@@ -0,0 +1,65 @@
+// Copyright (C) 2023 The Qt Company Ltd.
+// SPDX-License-Identifier: LicenseRef-Qt-Commercial OR LGPL-3.0-only OR GPL-2.0-only OR GPL-3.0-only
+
+#ifndef GENERATORTASK_H
+#define GENERATORTASK_H
+
+#include <QElapsedTimer>
+#include <QObject>
+#include <QRandomGenerator>
+#include <QtSerialBus>
+
+QT_BEGIN_NAMESPACE
+class QTimer;
+QT_END_NAMESPACE
+
+class GeneratorTask : public QObject
+{
+    Q_OBJECT
+public:
+    enum class Mode { Random, Increment, Fixed };
+
+    struct Settings
+    {
+        Mode idMode = Mode::Random;
+        QCanBusFrame::FrameId id = 0;
+        Mode dataMode = Mode::Random;
+        QByteArray data;
+        int length = 8; // -1 for random lengths
+        bool extended = false;
+        bool flexibleDataRate = false;
+        bool bitrateSwitch = false;
+        double rate = 0; // frames per second, 0 to saturate the bus
+        qint64 maximumFrames = 0;
+    };
+
+    explicit GeneratorTask(QTextStream &output, QObject *parent = nullptr);
+
+    void setSettings(const Settings &settings);
+    void start(QCanBusDevice *device);
+    void stop();
+
+signals:
+    void finished();
+
+public slots:
+    void handleError(QCanBusDevice::CanBusError error);
+
+private:
+    void writeBatch();
+    void nextFrame();
+
+    QTextStream &m_output;
+    Settings m_settings;
+    QCanBusDevice *m_device = nullptr;
+    QTimer *m_timer = nullptr;
+    QElapsedTimer m_elapsed;
+    QRandomGenerator m_random;
+    QCanBusFrame m_frame;
+    QByteArray m_payload;
+    qint64 m_sent = 0;
+    qint64 m_writeErrors = 0;
+    QString m_lastError;
+};
+
+#endif // GENERATORTASK_H
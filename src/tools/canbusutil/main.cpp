@@ -10,6 +10,17 @@
 
 #include <signal.h>
 
+// CAN FD frames carry 0 to 8, 12, 16, 20, 24, 32, 48 or 64 bytes. Devices reject other sizes.
+static bool isValidPayloadLength(qsizetype length, bool flexibleDataRate)
+{
+    if (length >= 0 && length <= 8)
+        return true;
+    if (!flexibleDataRate)
+        return false;
+    return length == 12 || length == 16 || length == 20 || length == 24 || length == 32
+            || length == 48 || length == 64;
+}
+
 int main(int argc, char *argv[])
 {
     QCoreApplication app(argc, argv);
@@ -22,12 +33,17 @@ int main(int argc, char *argv[])
     QObject::connect(s.get(), &SigTermHandler::sigTermSignal, &app, &QCoreApplication::quit);
 
     QTextStream output(stdout);
-    CanBusUtil util(output, app);
+    QTextStream errorOutput(stderr);
+    CanBusUtil util(output, errorOutput, app);
 
     QCommandLineParser parser;
     parser.setApplicationDescription(CanBusUtil::tr(
         "Sends arbitrary CAN bus frames.\n"
-        "If the -l option is set, all received CAN bus frames are dumped."));
+        "If the -l option is set, all received CAN bus frames are dumped.\n"
+        "If the --stats option is set, bus load and per-identifier statistics are shown.\n"
+        "If the -C option is set, all received CAN bus frames are captured to a file.\n"
+        "If the -r option is set, the CAN bus frames of a log file are replayed.\n"
+        "If the -g option is set, generated CAN bus frames are sent for load testing."));
     parser.addHelpOption();
     parser.addVersionOption();
 
@@ -39,7 +55,7 @@ int main(int argc, char *argv[])
 
     parser.addPositionalArgument(QStringLiteral("data"),
             CanBusUtil::tr(
-                "Data to send if -l is not specified. Format:\n"
+                "Data to send if none of -l, -C, -r and -g is specified. Format:\n"
                 "\t\t<id>#{payload}          (CAN 2.0 data frames),\n"
                 "\t\t<id>#Rxx                (CAN 2.0 RTR frames with xx bytes data length),\n"
                 "\t\t<id>##[flags]{payload}  (CAN FD data frames),\n"
@@ -70,7 +86,7 @@ int main(int argc, char *argv[])
     parser.addOption(listDevicesOption);
 
     const QCommandLineOption canFdOption({"f", "can-fd"},
-            CanBusUtil::tr("Enable CAN FD functionality when listening."));
+            CanBusUtil::tr("Enable CAN FD functionality when listening or generating."));
     parser.addOption(canFdOption);
 
     const QCommandLineOption loopbackOption({"c", "local-loopback"},
@@ -91,6 +107,90 @@ int main(int argc, char *argv[])
             QStringLiteral("bitrate"));
     parser.addOption(dataBitrateOption);
 
+    const QCommandLineOption statsOption("stats",
+            CanBusUtil::tr("Show the bus load and the rate, cycle time, cycle time jitter and "
+                           "changing payload bytes of each identifier, refreshed every second. "
+                           "Set the bit rates with -b and -a to get the correct bus load. "
+                           "Implies -l, cannot be combined with -C."));
+    parser.addOption(statsOption);
+
+    const QCommandLineOption captureOption({"C", "capture"},
+            CanBusUtil::tr("Capture all received CAN bus frames to the given file, "
+                           "or to stdout if the file is '-'. Implies -l."),
+            QStringLiteral("file"));
+    parser.addOption(captureOption);
+
+    const QCommandLineOption formatOption("format",
+            CanBusUtil::tr("Set the format of the capture file: 'binary' (default) for the "
+                           "native binary log, or 'candump' for the candump log format."),
+            QStringLiteral("format"), QStringLiteral("binary"));
+    parser.addOption(formatOption);
+
+    const QCommandLineOption countOption({"n", "count"},
+            CanBusUtil::tr("Stop listening or generating after the given number of "
+                           "CAN bus frames."),
+            QStringLiteral("count"));
+    parser.addOption(countOption);
+
+    const QCommandLineOption durationOption("duration",
+            CanBusUtil::tr("Stop listening or generating after the given number of milliseconds."),
+            QStringLiteral("msecs"));
+    parser.addOption(durationOption);
+
+    const QCommandLineOption replayOption({"r", "replay"},
+            CanBusUtil::tr("Replay the CAN bus frames of the given log file with their original "
+                           "timing. Reads candump, Vector ASC and binary capture logs."),
+            QStringLiteral("file"));
+    parser.addOption(replayOption);
+
+    const QCommandLineOption speedOption("speed",
+            CanBusUtil::tr("Replay faster or slower by the given factor, e.g. 2 for twice "
+                           "the original speed."),
+            QStringLiteral("factor"), QStringLiteral("1"));
+    parser.addOption(speedOption);
+
+    const QCommandLineOption loopOption("loop",
+            CanBusUtil::tr("Restart the replay after the last frame until interrupted."));
+    parser.addOption(loopOption);
+
+    const QCommandLineOption generateOption({"g", "generate"},
+            CanBusUtil::tr("Send generated CAN bus frames as fast as possible, or at the rate "
+                           "given with --rate, and print the achieved frame rate."));
+    parser.addOption(generateOption);
+
+    const QCommandLineOption generateIdOption("gen-id",
+            CanBusUtil::tr("Set the identifiers of generated frames: 'r' (default) for random, "
+                           "'i' for incrementing, or a fixed hex identifier."),
+            QStringLiteral("id"), QStringLiteral("r"));
+    parser.addOption(generateIdOption);
+
+    const QCommandLineOption generateDataOption("gen-data",
+            CanBusUtil::tr("Set the payload of generated frames: 'r' (default) for random, "
+                           "'i' for an incrementing counter, or a fixed hex payload."),
+            QStringLiteral("data"), QStringLiteral("r"));
+    parser.addOption(generateDataOption);
+
+    const QCommandLineOption generateLengthOption("gen-length",
+            CanBusUtil::tr("Set the payload length of generated frames: a number of bytes "
+                           "(default 8), or 'r' for random lengths. CAN FD frames carry "
+                           "0 to 8, 12, 16, 20, 24, 32, 48 or 64 bytes."),
+            QStringLiteral("length"), QStringLiteral("8"));
+    parser.addOption(generateLengthOption);
+
+    const QCommandLineOption generateExtendedOption("gen-extended",
+            CanBusUtil::tr("Generate frames with 29-bit identifiers."));
+    parser.addOption(generateExtendedOption);
+
+    const QCommandLineOption generateBitrateSwitchOption("gen-brs",
+            CanBusUtil::tr("Generate CAN FD frames with the bitrate switch flag. Implies -f."));
+    parser.addOption(generateBitrateSwitchOption);
+
+    const QCommandLineOption rateOption("rate",
+            CanBusUtil::tr("Generate the given number of frames per second instead of "
+                           "saturating the bus."),
+            QStringLiteral("frames"));
+    parser.addOption(rateOption);
+
     parser.process(app);
 
     if (parser.isSet(listOption))
@@ -114,9 +214,131 @@ int main(int argc, char *argv[])
                                        parser.value(dataBitrateOption).toInt());
     }
 
-    if (parser.isSet(listeningOption)) {
+    // The frame count and duration limits of listening and generating.
+    const auto setLimits = [&]() {
+        bool ok = true;
+        if (parser.isSet(countOption)) {
+            const qint64 count = parser.value(countOption).toLongLong(&ok);
+            if (!ok || count <= 0) {
+                util.diagnostics() << CanBusUtil::tr("Invalid frame count: '%1'.")
+                                      .arg(parser.value(countOption)) << Qt::endl;
+                return false;
+            }
+            util.setMaximumFrames(count);
+        }
+        if (parser.isSet(durationOption)) {
+            const int duration = parser.value(durationOption).toInt(&ok);
+            if (!ok || duration <= 0) {
+                util.diagnostics() << CanBusUtil::tr("Invalid duration: '%1'.")
+                                      .arg(parser.value(durationOption)) << Qt::endl;
+                return false;
+            }
+            util.setDuration(duration);
+        }
+        return true;
+    };
+
+    if (parser.isSet(listeningOption) || parser.isSet(captureOption)
+            || parser.isSet(statsOption)) {
         util.setShowTimeStamp(parser.isSet(showTimeStampOption));
         util.setShowFlags(parser.isSet(showFlagsOption));
+        util.setStats(parser.isSet(statsOption));
+
+        if (parser.isSet(captureOption)) {
+            // Set first, so that diagnostics() does not write into a capture on stdout.
+            const QString format = parser.value(formatOption);
+            util.setCapture(parser.value(captureOption), format == QLatin1String("candump")
+                            ? CaptureTask::Format::Candump : CaptureTask::Format::Binary);
+            if (format != QLatin1String("binary") && format != QLatin1String("candump")) {
+                util.diagnostics() << CanBusUtil::tr("Invalid capture format: '%1'.").arg(format)
+                                   << Qt::endl;
+                return 1;
+            }
+            // Both read the frames of the device, and the table would end up in a capture
+            // written to stdout.
+            if (parser.isSet(statsOption)) {
+                util.diagnostics() << CanBusUtil::tr("Cannot show statistics while capturing.")
+                                   << Qt::endl;
+                return 1;
+            }
+        }
+
+        if (!setLimits())
+            return 1;
+    } else if (parser.isSet(generateOption)) {
+        GeneratorTask::Settings settings;
+        bool ok = true;
+
+        const QString id = parser.value(generateIdOption);
+        if (id == QLatin1String("r")) {
+            settings.idMode = GeneratorTask::Mode::Random;
+        } else if (id == QLatin1String("i")) {
+            settings.idMode = GeneratorTask::Mode::Increment;
+        } else {
+            settings.idMode = GeneratorTask::Mode::Fixed;
+            settings.id = id.toUInt(&ok, 16);
+            if (!ok || settings.id > 0x1FFFFFFF) {
+                output << CanBusUtil::tr("Invalid identifier: '%1'.").arg(id) << Qt::endl;
+                return 1;
+            }
+        }
+
+        settings.flexibleDataRate = parser.isSet(canFdOption)
+                || parser.isSet(generateBitrateSwitchOption);
+        settings.bitrateSwitch = parser.isSet(generateBitrateSwitchOption);
+        if (settings.flexibleDataRate)
+            util.setConfigurationParameter(QCanBusDevice::CanFdKey, true);
+        settings.extended = parser.isSet(generateExtendedOption)
+                || (settings.idMode == GeneratorTask::Mode::Fixed && settings.id > 0x7FF);
+
+        const QString length = parser.value(generateLengthOption);
+        if (length == QLatin1String("r")) {
+            settings.length = -1;
+        } else {
+            settings.length = length.toInt(&ok);
+            if (!ok || !isValidPayloadLength(settings.length, settings.flexibleDataRate)) {
+                output << CanBusUtil::tr("Invalid payload length: '%1'.").arg(length)
+                       << Qt::endl;
+                return 1;
+            }
+        }
+
+        const QString payload = parser.value(generateDataOption);
+        if (payload == QLatin1String("r")) {
+            settings.dataMode = GeneratorTask::Mode::Random;
+        } else if (payload == QLatin1String("i")) {
+            settings.dataMode = GeneratorTask::Mode::Increment;
+        } else {
+            settings.dataMode = GeneratorTask::Mode::Fixed;
+            settings.data = QByteArray::fromHex(payload.toLatin1());
+            if (settings.data.size() * 2 != payload.size()
+                    || !isValidPayloadLength(settings.data.size(), settings.flexibleDataRate)) {
+                output << CanBusUtil::tr("Invalid payload: '%1'.").arg(payload) << Qt::endl;
+                return 1;
+            }
+        }
+
+        if (parser.isSet(rateOption)) {
+            settings.rate = parser.value(rateOption).toDouble(&ok);
+            if (!ok || settings.rate <= 0) {
+                output << CanBusUtil::tr("Invalid frame rate: '%1'.")
+                          .arg(parser.value(rateOption)) << Qt::endl;
+                return 1;
+            }
+        }
+
+        util.setGenerator(settings);
+        if (!setLimits())
+            return 1;
+    } else if (parser.isSet(replayOption)) {
+        bool ok = false;
+        const double speed = parser.value(speedOption).toDouble(&ok);
+        if (!ok || speed <= 0) {
+            output << CanBusUtil::tr("Invalid replay speed: '%1'.")
+                      .arg(parser.value(speedOption)) << Qt::endl;
+            return 1;
+        }
+        util.setReplay(parser.value(replayOption), speed, parser.isSet(loopOption));
     } else if (args.size() == 3) {
         data = args.at(2);
     } else if (args.size() == 1 && parser.isSet(listDevicesOption)) {
@@ -22,6 +22,11 @@ void ReadTask::setShowFlags(bool showFlags)
     m_showFlags = showFlags;
 }
 
+void ReadTask::setMaximumFrames(qint64 maximumFrames)
+{
+    m_maximumFrames = maximumFrames;
+}
+
 void ReadTask::handleFrames() {
     auto canDevice = qobject_cast<QCanBusDevice *>(QObject::sender());
     if (canDevice == nullptr) {
@@ -29,9 +34,12 @@ void ReadTask::handleFrames() {
         return;
     }
 
-    while (canDevice->framesAvailable()) {
-        const QCanBusFrame frame = canDevice->readFrame();
+    if (m_maximumFrames > 0 && m_frames >= m_maximumFrames)
+        return;
 
+    // Flush once per batch, not per frame, to keep up with busy buses.
+    const QList<QCanBusFrame> frames = canDevice->readAllFrames();
+    for (const QCanBusFrame &frame : frames) {
         QString view;
 
         if (m_showTimeStamp) {
@@ -58,8 +66,15 @@ void ReadTask::handleFrames() {
         else
             view += frame.toString();
 
-        m_output << view << Qt::endl;
+        m_output << view << '\n';
+
+        if (++m_frames == m_maximumFrames) {
+            m_output.flush();
+            emit finished();
+            return;
+        }
     }
+    m_output.flush();
 }
 
 void ReadTask::handleError(QCanBusDevice::CanBusError /*error*/)
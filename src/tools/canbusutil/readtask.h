@@ -16,6 +16,10 @@ public:
     void setShowTimeStamp(bool showStamp);
     bool isShowFlags() const;
     void setShowFlags(bool isShowFlags);
+    void setMaximumFrames(qint64 maximumFrames);
+
+signals:
+    void finished();
 
 public slots:
     void handleFrames();
@@ -25,6 +29,8 @@ private:
     QTextStream &m_output;
     bool m_showTimeStamp = false;
     bool m_showFlags = false;
+    qint64 m_frames = 0;
+    qint64 m_maximumFrames = 0;
 };
 
 #endif // READTASK_H
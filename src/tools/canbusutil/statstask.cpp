@@ -0,0 +1,244 @@
+// Copyright (C) 2023 The Qt Company Ltd.
+// SPDX-License-Identifier: LicenseRef-Qt-Commercial OR LGPL-3.0-only OR GPL-2.0-only OR GPL-3.0-only
+
+#include "statstask.h"
+
+#include <QTimer>
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+// Terminal control sequences, as used by cansniffer.
+static constexpr char ClearScreen[] = "\x1b[2J\x1b[H";
+static constexpr char Highlight[] = "\x1b[7m";
+static constexpr char Normal[] = "\x1b[0m";
+
+StatsTask::StatsTask(QTextStream &output, QObject *parent) :
+    QObject(parent),
+    m_output(output),
+    m_timer(new QTimer(this)),
+    m_standardIndex(0x800, -1)
+{
+    connect(m_timer, &QTimer::timeout, this, &StatsTask::refresh);
+}
+
+void StatsTask::setBitRates(int bitRate, int dataBitRate)
+{
+    if (bitRate > 0)
+        m_bitRate = bitRate;
+    m_dataBitRate = dataBitRate > 0 ? dataBitRate : m_bitRate;
+}
+
+void StatsTask::setMaximumFrames(qint64 maximumFrames)
+{
+    m_maximumFrames = maximumFrames;
+}
+
+void StatsTask::start(int refreshInterval)
+{
+    m_clock.start();
+    m_lastRefresh = 0;
+    m_timer->start(refreshInterval);
+}
+
+void StatsTask::handleFrames()
+{
+    auto canDevice = qobject_cast<QCanBusDevice *>(QObject::sender());
+    if (canDevice == nullptr) {
+        qWarning("StatsTask::handleFrames: Unknown sender.");
+        return;
+    }
+
+    if (m_maximumFrames > 0 && m_receivedFrames >= m_maximumFrames)
+        return;
+
+    // Only counters are updated here, the table is built once per refresh interval.
+    const QList<QCanBusFrame> frames = canDevice->readAllFrames();
+    const qint64 now = m_clock.nsecsElapsed() / 1000;
+    for (const QCanBusFrame &frame : frames) {
+        countFrame(frame, now);
+
+        if (++m_receivedFrames == m_maximumFrames) {
+            m_timer->stop();
+            refresh(); // the final table includes the last frames
+            emit finished();
+            return;
+        }
+    }
+}
+
+void StatsTask::countFrame(const QCanBusFrame &frame, qint64 now)
+{
+    if (frame.frameType() == QCanBusFrame::ErrorFrame) {
+        ++m_errorFrames;
+        return;
+    }
+    if (frame.frameType() != QCanBusFrame::DataFrame
+        && frame.frameType() != QCanBusFrame::RemoteRequestFrame) {
+        return;
+    }
+
+    ++m_frames;
+    m_busTime += busTime(frame);
+
+    Entry &entry = m_entries[entryIndex(frame)];
+    ++entry.frames;
+
+    // Devices without hardware time stamps report none, the time of reception is
+    // the best approximation then.
+    const QCanBusFrame::TimeStamp stamp = frame.timeStamp();
+    qint64 timeStamp = stamp.seconds() * 1000000 + stamp.microSeconds();
+    if (timeStamp == 0)
+        timeStamp = now;
+    if (entry.lastTimeStamp >= 0) {
+        const qint64 cycle = timeStamp - entry.lastTimeStamp;
+        ++entry.cycles;
+        entry.cycleSum += cycle;
+        entry.cycleSquareSum += double(cycle) * cycle;
+    }
+    entry.lastTimeStamp = timeStamp;
+
+    const QByteArray payload = frame.payload();
+    const int length = int(qMin(payload.size(), qsizetype(entry.payload.size())));
+    const uchar *data = reinterpret_cast<const uchar *>(payload.constData());
+    for (int i = 0; i < length; ++i) {
+        if (entry.payload[i] != data[i] || i >= entry.length)
+            entry.changed |= quint64(1) << i;
+    }
+    std::memcpy(entry.payload.data(), data, size_t(length));
+    entry.length = length;
+}
+
+void StatsTask::handleError(QCanBusDevice::CanBusError /*error*/)
+{
+    auto canDevice = qobject_cast<QCanBusDevice *>(QObject::sender());
+    if (canDevice == nullptr) {
+        qWarning("StatsTask::handleError: Unknown sender.");
+        return;
+    }
+
+    m_output << tr("Read error: '%1'").arg(canDevice->errorString()) << Qt::endl;
+}
+
+int StatsTask::entryIndex(const QCanBusFrame &frame)
+{
+    const QCanBusFrame::FrameId id = frame.frameId();
+    const bool extended = frame.hasExtendedFrameFormat();
+
+    // Standard identifiers, the common case, are found without hashing.
+    if (!extended) {
+        int &index = m_standardIndex[id & 0x7FF];
+        if (index < 0) {
+            index = int(m_entries.size());
+            m_entries.push_back(Entry{ id, false });
+        }
+        return index;
+    }
+
+    const auto it = m_extendedIndex.constFind(id);
+    if (it != m_extendedIndex.constEnd())
+        return *it;
+    const int index = int(m_entries.size());
+    m_entries.push_back(Entry{ id, true });
+    m_extendedIndex.insert(id, index);
+    return index;
+}
+
+// Returns the time the frame occupies the bus in nanoseconds. The bit counts include the
+// interframe space but no dynamic stuff bits, like the exact mode of canbusload.
+qint64 StatsTask::busTime(const QCanBusFrame &frame) const
+{
+    const qint64 payloadBits = frame.frameType() == QCanBusFrame::RemoteRequestFrame
+            ? 0 : 8 * frame.payload().size();
+
+    if (!frame.hasFlexibleDataRateFormat()) {
+        const qint64 bits = (frame.hasExtendedFrameFormat() ? 67 : 47) + payloadBits;
+        return bits * 1000000000 / m_bitRate;
+    }
+
+    // Arbitration and acknowledge phases at the nominal bit rate, the data phase with the
+    // DLC, the stuff count and the CRC at the data bit rate if the bitrate switch is set.
+    const qint64 nominalBits = (frame.hasExtendedFrameFormat() ? 36 : 17) + 13;
+    const qint64 dataBits = 5 + payloadBits + (frame.payload().size() <= 16 ? 28 : 33);
+    const int dataBitRate = frame.hasBitrateSwitch() ? m_dataBitRate : m_bitRate;
+    return nominalBits * 1000000000 / m_bitRate + dataBits * 1000000000 / dataBitRate;
+}
+
+void StatsTask::refresh()
+{
+    const qint64 now = m_clock.nsecsElapsed();
+    const qint64 interval = qMax(now - m_lastRefresh, qint64(1));
+    const double seconds = interval / 1e9;
+    m_lastRefresh = now;
+
+    const double load = 100.0 * double(m_busTime) / double(interval);
+    m_peakLoad = qMax(m_peakLoad, load);
+    m_totalFrames += m_frames;
+    m_totalErrorFrames += m_errorFrames;
+
+    m_output << ClearScreen;
+    m_output << tr("Bus load %1 % (peak %2 %), %3 frames/s, %4 error frames/s, "
+                   "bit rate %5/%6, %7 frames and %8 error frames total")
+                .arg(load, 0, 'f', 1)
+                .arg(m_peakLoad, 0, 'f', 1)
+                .arg(m_frames / seconds, 0, 'f', 0)
+                .arg(m_errorFrames / seconds, 0, 'f', 0)
+                .arg(m_bitRate)
+                .arg(m_dataBitRate)
+                .arg(m_totalFrames)
+                .arg(m_totalErrorFrames) << '\n' << '\n';
+    m_output << tr("        ID  Frames/s  Cycle ms  Jitter ms  Len  Data") << '\n';
+
+    std::vector<int> order(m_entries.size());
+    for (int i = 0; i < int(order.size()); ++i)
+        order[i] = i;
+    std::sort(order.begin(), order.end(), [this](int left, int right) {
+        const Entry &l = m_entries[left];
+        const Entry &r = m_entries[right];
+        return l.extended != r.extended ? r.extended : l.id < r.id;
+    });
+
+    for (int i : order) {
+        Entry &entry = m_entries[i];
+        const QString id = QString::number(entry.id, 16).toUpper();
+        m_output << QStringLiteral("%1").arg(id, 10)
+                 << QStringLiteral("%1").arg(entry.frames / seconds, 10, 'f', 1);
+
+        // The jitter is the standard deviation of the cycle time within the interval.
+        if (entry.cycles > 0) {
+            const double mean = entry.cycleSum / entry.cycles;
+            const double variance = qMax(entry.cycleSquareSum / entry.cycles - mean * mean, 0.0);
+            m_output << QStringLiteral("%1").arg(mean / 1000, 10, 'f', 2)
+                     << QStringLiteral("%1").arg(std::sqrt(variance) / 1000, 11, 'f', 3);
+        } else {
+            m_output << QStringLiteral("%1%2").arg(QStringLiteral("-"), 10)
+                        .arg(QStringLiteral("-"), 11);
+        }
+        m_output << QStringLiteral("%1  ").arg(entry.length, 5);
+
+        // Bytes changed within the interval are highlighted.
+        for (int byte = 0; byte < entry.length; ++byte) {
+            const bool changed = entry.changed & (quint64(1) << byte);
+            if (changed)
+                m_output << Highlight;
+            m_output << QStringLiteral("%1").arg(uint(entry.payload[byte]), 2, 16, QLatin1Char('0'))
+                        .toUpper();
+            if (changed)
+                m_output << Normal;
+            m_output << ' ';
+        }
+        m_output << '\n';
+
+        entry.frames = 0;
+        entry.cycles = 0;
+        entry.cycleSum = 0;
+        entry.cycleSquareSum = 0;
+        entry.changed = 0;
+    }
+    m_output.flush();
+
+    m_frames = 0;
+    m_errorFrames = 0;
+    m_busTime = 0;
+}
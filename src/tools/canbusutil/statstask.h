@@ -0,0 +1,79 @@
+// Copyright (C) 2023 The Qt Company Ltd.
+// SPDX-License-Identifier: LicenseRef-Qt-Commercial OR LGPL-3.0-only OR GPL-2.0-only OR GPL-3.0-only
+
+#ifndef STATSTASK_H
+#define STATSTASK_H
+
+#include <QElapsedTimer>
+#include <QHash>
+#include <QObject>
+#include <QtSerialBus>
+
+#include <array>
+#include <vector>
+
+QT_BEGIN_NAMESPACE
+class QTimer;
+QT_END_NAMESPACE
+
+class StatsTask : public QObject
+{
+    Q_OBJECT
+public:
+    explicit StatsTask(QTextStream &output, QObject *parent = nullptr);
+
+    void setBitRates(int bitRate, int dataBitRate);
+    void setMaximumFrames(qint64 maximumFrames);
+    void start(int refreshInterval = 1000);
+
+signals:
+    void finished();
+
+public slots:
+    void handleFrames();
+    void handleError(QCanBusDevice::CanBusError /*error*/);
+
+private:
+    // One entry per identifier seen. The counters cover the current refresh interval and are
+    // reset after each refresh.
+    struct Entry
+    {
+        QCanBusFrame::FrameId id = 0;
+        bool extended = false;
+        qint64 frames = 0;
+        qint64 lastTimeStamp = -1; // microseconds
+        qint64 cycles = 0;
+        double cycleSum = 0;
+        double cycleSquareSum = 0;
+        quint64 changed = 0; // one bit per payload byte changed in the interval
+        int length = 0;
+        std::array<uchar, 64> payload = {};
+    };
+
+    void countFrame(const QCanBusFrame &frame, qint64 now);
+    int entryIndex(const QCanBusFrame &frame);
+    qint64 busTime(const QCanBusFrame &frame) const;
+    void refresh();
+
+    QTextStream &m_output;
+    QTimer *m_timer = nullptr;
+    QElapsedTimer m_clock;
+    qint64 m_lastRefresh = 0;
+    int m_bitRate = 500000;
+    int m_dataBitRate = 500000;
+
+    std::vector<Entry> m_entries;
+    std::vector<int> m_standardIndex; // entry of each 11-bit identifier, or -1
+    QHash<QCanBusFrame::FrameId, int> m_extendedIndex;
+
+    qint64 m_frames = 0;
+    qint64 m_busTime = 0; // nanoseconds of bus time in the interval
+    qint64 m_errorFrames = 0;
+    qint64 m_totalFrames = 0;
+    qint64 m_totalErrorFrames = 0;
+    double m_peakLoad = 0;
+    qint64 m_receivedFrames = 0; // all frames, for the --count limit
+    qint64 m_maximumFrames = 0;
+};
+
+#endif // STATSTASK_H
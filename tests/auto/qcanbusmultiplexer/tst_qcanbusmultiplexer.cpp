@@ -0,0 +1,247 @@
+// Copyright (C) 2023 The Qt Company Ltd.
+// SPDX-License-Identifier: LicenseRef-Qt-Commercial OR LGPL-3.0-only OR GPL-2.0-only OR GPL-3.0-only
+
+#include <QtSerialBus/qcanbusdevice.h>
+#include <QtSerialBus/qcanbusframe.h>
+#include <QtSerialBus/qcanbusmultiplexer.h>
+
+#include <QtTest/qsignalspy.h>
+#include <QtTest/qtest.h>
+
+class FakeBackend : public QCanBusDevice
+{
+    Q_OBJECT
+public:
+    bool open() override
+    {
+        setState(QCanBusDevice::ConnectedState);
+        return true;
+    }
+    void close() override
+    {
+        setState(QCanBusDevice::UnconnectedState);
+    }
+    bool writeFrame(const QCanBusFrame &) override
+    {
+        return true;
+    }
+    QString interpretErrorFrame(const QCanBusFrame &) override
+    {
+        return QString();
+    }
+
+    void receive(const QList<QCanBusFrame> &frames)
+    {
+        enqueueReceivedFrames(frames);
+    }
+};
+
+static QCanBusFrame frameAt(qint64 microseconds, QCanBusFrame::FrameId id)
+{
+    QCanBusFrame frame(id, QByteArray(1, char(id)));
+    frame.setTimeStamp(QCanBusFrame::TimeStamp::fromMicroSeconds(microseconds));
+    return frame;
+}
+
+static QList<QCanBusFrame::FrameId> frameIds(const QList<QCanBusFrame> &frames)
+{
+    QList<QCanBusFrame::FrameId> ids;
+    for (const QCanBusFrame &frame : frames)
+        ids.append(frame.frameId());
+    return ids;
+}
+
+class tst_QCanBusMultiplexer : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void devices();
+    void mergeOrder();
+    void sources();
+    void maximumLatency();
+    void removeDevice();
+    void destroyedDevice();
+    void flush();
+};
+
+void tst_QCanBusMultiplexer::devices()
+{
+    QCanBusMultiplexer multiplexer;
+    auto a = new FakeBackend;
+    auto b = new FakeBackend;
+
+    multiplexer.addDevice(a);
+    multiplexer.addDevice(b);
+    multiplexer.addDevice(a);
+    multiplexer.addDevice(nullptr);
+
+    QCOMPARE(multiplexer.devices(), (QList<QCanBusDevice *>{ a, b }));
+    QCOMPARE(a->parent(), static_cast<QObject *>(&multiplexer));
+    QCOMPARE(b->parent(), static_cast<QObject *>(&multiplexer));
+    QCOMPARE(multiplexer.maximumLatency(), 100);
+}
+
+void tst_QCanBusMultiplexer::mergeOrder()
+{
+    QCanBusMultiplexer multiplexer;
+    multiplexer.setMaximumLatency(60000);
+    auto a = new FakeBackend;
+    auto b = new FakeBackend;
+    multiplexer.addDevice(a);
+    multiplexer.addDevice(b);
+    QSignalSpy spy(&multiplexer, &QCanBusMultiplexer::framesReceived);
+
+    // Nothing can be merged before every device has delivered a frame.
+    a->receive({ frameAt(100, 0x1), frameAt(300, 0x3) });
+    QCOMPARE(multiplexer.framesAvailable(), Q_INT64_C(0));
+    QCOMPARE(multiplexer.framesPending(), Q_INT64_C(2));
+    QCOMPARE(spy.size(), 0);
+
+    b->receive({ frameAt(200, 0x2) });
+    QCOMPARE(spy.size(), 1);
+    QCOMPARE(multiplexer.framesPending(), Q_INT64_C(1));
+    QCOMPARE(frameIds(multiplexer.readAllFrames()), (QList<QCanBusFrame::FrameId>{ 0x1, 0x2 }));
+
+    b->receive({ frameAt(400, 0x4), frameAt(500, 0x5) });
+    QCOMPARE(spy.size(), 2);
+    QCOMPARE(frameIds(multiplexer.readAllFrames()), (QList<QCanBusFrame::FrameId>{ 0x3 }));
+
+    a->receive({ frameAt(450, 0x6) });
+    QCOMPARE(frameIds(multiplexer.readAllFrames()), (QList<QCanBusFrame::FrameId>{ 0x4, 0x6 }));
+    QCOMPARE(multiplexer.framesPending(), Q_INT64_C(1));
+
+    QCOMPARE(multiplexer.readFrame().frameType(), QCanBusFrame::InvalidFrame);
+}
+
+void tst_QCanBusMultiplexer::sources()
+{
+    QCanBusMultiplexer multiplexer;
+    multiplexer.setMaximumLatency(60000);
+    auto a = new FakeBackend;
+    auto b = new FakeBackend;
+    multiplexer.addDevice(a);
+    multiplexer.addDevice(b);
+
+    a->receive({ frameAt(100, 0x1), frameAt(300, 0x3) });
+    b->receive({ frameAt(200, 0x2), frameAt(400, 0x4) });
+    QCOMPARE(multiplexer.framesAvailable(), Q_INT64_C(3));
+
+    QCanBusDevice *source = nullptr;
+    QCOMPARE(multiplexer.readFrame(&source).frameId(), 0x1u);
+    QCOMPARE(source, static_cast<QCanBusDevice *>(a));
+
+    QList<QCanBusDevice *> sources;
+    const QList<QCanBusFrame> frames = multiplexer.readAllFrames(&sources);
+    QCOMPARE(frameIds(frames), (QList<QCanBusFrame::FrameId>{ 0x2, 0x3 }));
+    QCOMPARE(sources, (QList<QCanBusDevice *>{ b, a }));
+}
+
+void tst_QCanBusMultiplexer::maximumLatency()
+{
+    QCanBusMultiplexer multiplexer;
+    multiplexer.setMaximumLatency(20);
+    auto a = new FakeBackend;
+    auto quiet = new FakeBackend;
+    multiplexer.addDevice(a);
+    multiplexer.addDevice(quiet);
+
+    // The quiet device holds back the frames only until the latency has passed.
+    a->receive({ frameAt(200, 0x2), frameAt(100, 0x1) });
+    QCOMPARE(multiplexer.framesAvailable(), Q_INT64_C(0));
+    QTRY_COMPARE(multiplexer.framesAvailable(), Q_INT64_C(2));
+    QCOMPARE(multiplexer.framesPending(), Q_INT64_C(0));
+    QCOMPARE(frameIds(multiplexer.readAllFrames()), (QList<QCanBusFrame::FrameId>{ 0x2, 0x1 }));
+
+    // Lowering the latency releases held back frames at once.
+    multiplexer.setMaximumLatency(60000);
+    a->receive({ frameAt(300, 0x3) });
+    QCOMPARE(multiplexer.framesAvailable(), Q_INT64_C(0));
+    multiplexer.setMaximumLatency(0);
+    QCOMPARE(multiplexer.framesAvailable(), Q_INT64_C(1));
+}
+
+void tst_QCanBusMultiplexer::removeDevice()
+{
+    QCanBusMultiplexer multiplexer;
+    multiplexer.setMaximumLatency(60000);
+    auto a = new FakeBackend;
+    auto b = new FakeBackend;
+    multiplexer.addDevice(a);
+    multiplexer.addDevice(b);
+
+    a->receive({ frameAt(100, 0x1) });
+    b->receive({ frameAt(50, 0x5), frameAt(200, 0x2) });
+    QCOMPARE(multiplexer.framesAvailable(), Q_INT64_C(2));
+    QCOMPARE(multiplexer.framesPending(), Q_INT64_C(1));
+
+    // Merged frames are kept, the frames held back for the removed device are discarded.
+    multiplexer.removeDevice(b);
+    QCOMPARE(multiplexer.devices(), (QList<QCanBusDevice *>{ a }));
+    QCOMPARE(b->parent(), nullptr);
+    QCOMPARE(multiplexer.framesPending(), Q_INT64_C(0));
+    QCOMPARE(frameIds(multiplexer.readAllFrames()), (QList<QCanBusFrame::FrameId>{ 0x5, 0x1 }));
+
+    b->receive({ frameAt(300, 0x3) });
+    QCOMPARE(multiplexer.framesPending(), Q_INT64_C(0));
+    QCOMPARE(multiplexer.framesAvailable(), Q_INT64_C(0));
+    delete b;
+
+    // A quiet device no longer holds back the frames of the others once it is removed.
+    auto quiet = new FakeBackend;
+    multiplexer.addDevice(quiet);
+    a->receive({ frameAt(400, 0x4) });
+    QCOMPARE(multiplexer.framesAvailable(), Q_INT64_C(0));
+    multiplexer.removeDevice(quiet);
+    QCOMPARE(frameIds(multiplexer.readAllFrames()), (QList<QCanBusFrame::FrameId>{ 0x4 }));
+    delete quiet;
+}
+
+void tst_QCanBusMultiplexer::destroyedDevice()
+{
+    QCanBusMultiplexer multiplexer;
+    multiplexer.setMaximumLatency(60000);
+    auto a = new FakeBackend;
+    auto b = new FakeBackend;
+    multiplexer.addDevice(a);
+    multiplexer.addDevice(b);
+
+    a->receive({ frameAt(100, 0x1), frameAt(300, 0x3) });
+    b->receive({ frameAt(200, 0x2) });
+    QCOMPARE(multiplexer.framesAvailable(), Q_INT64_C(2));
+
+    // The frames held back for the device are lost with it.
+    delete a;
+    QCOMPARE(multiplexer.devices(), (QList<QCanBusDevice *>{ b }));
+    QCOMPARE(multiplexer.framesPending(), Q_INT64_C(0));
+
+    QCanBusDevice *source = b;
+    QCOMPARE(multiplexer.readFrame(&source).frameId(), 0x1u);
+    QCOMPARE(source, nullptr);
+    QCOMPARE(multiplexer.readFrame(&source).frameId(), 0x2u);
+    QCOMPARE(source, static_cast<QCanBusDevice *>(b));
+}
+
+void tst_QCanBusMultiplexer::flush()
+{
+    QCanBusMultiplexer multiplexer;
+    multiplexer.setMaximumLatency(60000);
+    auto a = new FakeBackend;
+    auto b = new FakeBackend;
+    multiplexer.addDevice(a);
+    multiplexer.addDevice(b);
+
+    a->receive({ frameAt(300, 0x3), frameAt(400, 0x4) });
+    b->receive({ frameAt(100, 0x1) });
+    QCOMPARE(multiplexer.framesAvailable(), Q_INT64_C(1));
+    QCOMPARE(multiplexer.framesPending(), Q_INT64_C(2));
+
+    multiplexer.flush();
+    QCOMPARE(multiplexer.framesPending(), Q_INT64_C(0));
+    QCOMPARE(frameIds(multiplexer.readAllFrames()),
+             (QList<QCanBusFrame::FrameId>{ 0x1, 0x3, 0x4 }));
+}
+
+QTEST_MAIN(tst_QCanBusMultiplexer)
+
+#include "tst_qcanbusmultiplexer.moc"
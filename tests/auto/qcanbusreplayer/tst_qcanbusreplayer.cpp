@@ -0,0 +1,394 @@
+// Copyright (C) 2023 The Qt Company Ltd.
+// SPDX-License-Identifier: LicenseRef-Qt-Commercial OR LGPL-3.0-only OR GPL-2.0-only OR GPL-3.0-only
+
+#include <QtSerialBus/qcanbusdevice.h>
+#include <QtSerialBus/qcanbusframe.h>
+#include <QtSerialBus/qcanbusreplayer.h>
+#include <QtSerialBus/private/qcanbuslog_p.h>
+
+#include <QtCore/qelapsedtimer.h>
+#include <QtCore/qfile.h>
+#include <QtCore/qtemporarydir.h>
+#include <QtTest/qsignalspy.h>
+#include <QtTest/qtest.h>
+
+class RecordingBackend : public QCanBusDevice
+{
+    Q_OBJECT
+public:
+    bool open() override
+    {
+        setState(QCanBusDevice::ConnectedState);
+        return true;
+    }
+    void close() override
+    {
+        setState(QCanBusDevice::UnconnectedState);
+    }
+    bool writeFrame(const QCanBusFrame &frame) override
+    {
+        if (state() != QCanBusDevice::ConnectedState) {
+            setError(QStringLiteral("Cannot write frame as device is not connected"),
+                     QCanBusDevice::OperationError);
+            return false;
+        }
+        written.append(frame);
+        writtenAt.append(clock.isValid() ? clock.nsecsElapsed() / 1000 : 0);
+        return true;
+    }
+    QString interpretErrorFrame(const QCanBusFrame &) override
+    {
+        return QString();
+    }
+
+    QElapsedTimer clock;
+    QList<QCanBusFrame> written;
+    QList<qint64> writtenAt; // microseconds since clock started
+};
+
+static QCanBusFrame frameAt(qint64 microseconds, QCanBusFrame::FrameId id,
+                            const QByteArray &payload)
+{
+    QCanBusFrame frame(id, payload);
+    frame.setTimeStamp(QCanBusFrame::TimeStamp::fromMicroSeconds(microseconds));
+    return frame;
+}
+
+class tst_QCanBusReplayer : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void initTestCase();
+
+    void readCandump();
+    void readBinaryRoundTrip();
+    void readAsc();
+    void readInvalid();
+
+    void loadErrors();
+    void replayTiming();
+    void replaySpeed();
+    void replayLoop();
+    void replayWriteError();
+
+private:
+    QString writeLog(const QString &name, const QByteArray &contents);
+
+    QTemporaryDir m_dir;
+};
+
+void tst_QCanBusReplayer::initTestCase()
+{
+    QVERIFY(m_dir.isValid());
+}
+
+QString tst_QCanBusReplayer::writeLog(const QString &name, const QByteArray &contents)
+{
+    const QString fileName = m_dir.filePath(name);
+    QFile file(fileName);
+    if (!file.open(QIODevice::WriteOnly) || file.write(contents) != contents.size())
+        return QString();
+    return fileName;
+}
+
+void tst_QCanBusReplayer::readCandump()
+{
+    const QByteArray log =
+            "(1700000000.000100) can0 123#DEADBEEF\n"
+            "(1700000000.000200) can0 12345678#\n"
+            "(1700000000.000300) can0 7FF#R\n"
+            "(1700000000.000400) can0 100#R4\n"
+            "(1700000000.000500) can1 0AB##3112233\n"
+            "\n"
+            "(1700000000.000600) can0 20000004#0000000000000000\n";
+
+    QCOMPARE(QCanBusLog::detectFormat(log), QCanBusLog::Format::Candump);
+    QList<QCanBusFrame> frames;
+    QVERIFY(QCanBusLog::read(log, &frames));
+    QCOMPARE(frames.size(), 6);
+
+    QCOMPARE(frames.at(0).frameId(), 0x123u);
+    QCOMPARE(frames.at(0).payload(), QByteArray::fromHex("deadbeef"));
+    QVERIFY(!frames.at(0).hasExtendedFrameFormat());
+    QCOMPARE(frames.at(0).timeStamp().seconds(), Q_INT64_C(1700000000));
+    QCOMPARE(frames.at(0).timeStamp().microSeconds(), Q_INT64_C(100));
+
+    QCOMPARE(frames.at(1).frameId(), 0x12345678u);
+    QVERIFY(frames.at(1).hasExtendedFrameFormat());
+    QVERIFY(frames.at(1).payload().isEmpty());
+
+    QCOMPARE(frames.at(2).frameType(), QCanBusFrame::RemoteRequestFrame);
+    QCOMPARE(frames.at(3).frameType(), QCanBusFrame::RemoteRequestFrame);
+    QCOMPARE(frames.at(3).payload().size(), 4);
+
+    QVERIFY(frames.at(4).hasFlexibleDataRateFormat());
+    QVERIFY(frames.at(4).hasBitrateSwitch());
+    QVERIFY(frames.at(4).hasErrorStateIndicator());
+    QCOMPARE(frames.at(4).payload(), QByteArray::fromHex("112233"));
+
+    QCOMPARE(frames.at(5).frameType(), QCanBusFrame::ErrorFrame);
+    QCOMPARE(frames.at(5).error(), QCanBusFrame::FrameErrors(QCanBusFrame::ControllerError));
+
+    // Writing the frames reproduces the log, apart from the interface names.
+    QByteArray written;
+    for (const QCanBusFrame &frame : std::as_const(frames))
+        QCanBusLog::appendCandump(&written, frame, "can0");
+    QCOMPARE(written, QByteArray(log).replace("can1", "can0").replace("\n\n", "\n"));
+}
+
+void tst_QCanBusReplayer::readBinaryRoundTrip()
+{
+    QList<QCanBusFrame> frames;
+    frames.append(frameAt(10, 0x123, QByteArray::fromHex("0102")));
+    frames.append(frameAt(20, 0x1abcdef0, QByteArray()));
+    QCanBusFrame fd = frameAt(30, 0x7ff, QByteArray(64, 'x'));
+    fd.setFlexibleDataRateFormat(true);
+    fd.setBitrateSwitch(true);
+    fd.setLocalEcho(true);
+    frames.append(fd);
+    QCanBusFrame error(QCanBusFrame::ErrorFrame);
+    error.setError(QCanBusFrame::BusOffError | QCanBusFrame::ControllerError);
+    error.setTimeStamp(QCanBusFrame::TimeStamp::fromMicroSeconds(40));
+    frames.append(error);
+
+    QByteArray log;
+    QCanBusLog::appendHeader(&log);
+    for (const QCanBusFrame &frame : std::as_const(frames))
+        QCanBusLog::appendBinary(&log, frame);
+
+    QCOMPARE(QCanBusLog::detectFormat(log), QCanBusLog::Format::Binary);
+    QList<QCanBusFrame> read;
+    QVERIFY(QCanBusLog::read(log, &read));
+    QCOMPARE(read.size(), frames.size());
+    for (qsizetype i = 0; i < frames.size(); ++i) {
+        QCOMPARE(read.at(i).frameType(), frames.at(i).frameType());
+        QCOMPARE(read.at(i).frameId(), frames.at(i).frameId());
+        QCOMPARE(read.at(i).error(), frames.at(i).error());
+        QCOMPARE(read.at(i).payload(), frames.at(i).payload());
+        QCOMPARE(read.at(i).hasExtendedFrameFormat(), frames.at(i).hasExtendedFrameFormat());
+        QCOMPARE(read.at(i).hasFlexibleDataRateFormat(),
+                 frames.at(i).hasFlexibleDataRateFormat());
+        QCOMPARE(read.at(i).hasBitrateSwitch(), frames.at(i).hasBitrateSwitch());
+        QCOMPARE(read.at(i).hasLocalEcho(), frames.at(i).hasLocalEcho());
+        QCOMPARE(read.at(i).timeStamp().microSeconds(), frames.at(i).timeStamp().microSeconds());
+    }
+
+    // A truncated record is reported with its offset.
+    qsizetype position = -1;
+    QVERIFY(!QCanBusLog::read(QByteArrayView(log).chopped(1), &read, &position));
+    QCOMPARE(position, log.size() - QCanBusLog::RecordHeaderSize);
+}
+
+void tst_QCanBusReplayer::readAsc()
+{
+    QByteArray fullFdData;
+    for (int i = 0; i < 64; ++i)
+        fullFdData += ' ' + QByteArray::number(i, 16).rightJustified(2, '0');
+
+    const QByteArray log =
+            "date Mon Oct 16 10:00:00.000 am 2023\n"
+            "base hex  timestamps absolute\n"
+            "internal events logged\n"
+            "// version 13.0.0\n"
+            "Begin Triggerblock Mon Oct 16 10:00:00.000 am 2023\n"
+            "   0.000000 Start of measurement\n"
+            "   0.001000 1  123             Rx   d 3 01 02 03  Length = 0 BitCount = 0\n"
+            "   0.002500 2  1ABCDEFx        Tx   r 8\n"
+            "   0.003000 CANFD   1 Rx        7ff  Engine  1 0 c 12 "
+            "00 01 02 03 04 05 06 07 08 09 0a 0b\n"
+            "   0.004000 1  ErrorFrame\n"
+            "   0.005000 CANFD   1 Rx        100  Engine  1 0 f 64" + fullFdData + "\n"
+            "   0.006000 CANFD   2 Tx        18feef00x  0 1 f 64" + fullFdData + "\n"
+            "End TriggerBlock\n";
+
+    QCOMPARE(QCanBusLog::detectFormat(log), QCanBusLog::Format::Asc);
+    QList<QCanBusFrame> frames;
+    QVERIFY(QCanBusLog::read(log, &frames));
+    QCOMPARE(frames.size(), 6);
+
+    QCOMPARE(frames.at(0).frameId(), 0x123u);
+    QCOMPARE(frames.at(0).payload(), QByteArray::fromHex("010203"));
+    QCOMPARE(frames.at(0).timeStamp().microSeconds(), Q_INT64_C(1000));
+
+    QCOMPARE(frames.at(1).frameType(), QCanBusFrame::RemoteRequestFrame);
+    QCOMPARE(frames.at(1).frameId(), 0x1abcdefu);
+    QVERIFY(frames.at(1).hasExtendedFrameFormat());
+    QCOMPARE(frames.at(1).timeStamp().microSeconds(), Q_INT64_C(2500));
+
+    QVERIFY(frames.at(2).hasFlexibleDataRateFormat());
+    QVERIFY(frames.at(2).hasBitrateSwitch());
+    QCOMPARE(frames.at(2).payload().size(), 12);
+    QCOMPARE(frames.at(2).payload().at(11), '\x0b');
+
+    QCOMPARE(frames.at(3).frameType(), QCanBusFrame::ErrorFrame);
+
+    // 64-byte CAN FD frames, with and without a symbolic name
+    const QByteArray fullPayload = QByteArray::fromHex(fullFdData);
+    QCOMPARE(frames.at(4).frameId(), 0x100u);
+    QVERIFY(frames.at(4).hasFlexibleDataRateFormat());
+    QVERIFY(frames.at(4).hasBitrateSwitch());
+    QCOMPARE(frames.at(4).payload(), fullPayload);
+    QCOMPARE(frames.at(4).timeStamp().microSeconds(), Q_INT64_C(5000));
+
+    QCOMPARE(frames.at(5).frameId(), 0x18feef00u);
+    QVERIFY(frames.at(5).hasExtendedFrameFormat());
+    QVERIFY(!frames.at(5).hasBitrateSwitch());
+    QVERIFY(frames.at(5).hasErrorStateIndicator());
+    QCOMPARE(frames.at(5).payload(), fullPayload);
+}
+
+void tst_QCanBusReplayer::readInvalid()
+{
+    QList<QCanBusFrame> frames;
+    qsizetype position = 0;
+    QVERIFY(!QCanBusLog::read("(1.000000) can0 123#DEADBEEF\n(2.000000) can0 XYZ#00\n",
+                              &frames, &position));
+    QCOMPARE(position, qsizetype(2));
+    QVERIFY(!QCanBusLog::read("(1.000000) can0 123#ABC\n", &frames, &position));
+    QCOMPARE(position, qsizetype(1));
+    QCOMPARE(QCanBusLog::detectFormat("some text"), QCanBusLog::Format::Unknown);
+}
+
+void tst_QCanBusReplayer::loadErrors()
+{
+    QCanBusReplayer replayer;
+    QSignalSpy errors(&replayer, &QCanBusReplayer::errorOccurred);
+
+    QVERIFY(!replayer.load(m_dir.filePath(QStringLiteral("missing.log"))));
+    QCOMPARE(replayer.error(), QCanBusReplayer::ReadError);
+    QCOMPARE(errors.size(), 1);
+
+    const QString unknown = writeLog(QStringLiteral("unknown.log"), "hello\n");
+    QVERIFY(!replayer.load(unknown));
+    QCOMPARE(replayer.error(), QCanBusReplayer::FormatError);
+
+    const QString invalid = writeLog(QStringLiteral("invalid.log"),
+                                     "(1.000000) can0 123#00\n(1.000100) can0 123\n");
+    QVERIFY(!replayer.load(invalid));
+    QCOMPARE(replayer.error(), QCanBusReplayer::FormatError);
+    QVERIFY(replayer.errorString().contains(QLatin1String("line 2")));
+    QVERIFY(replayer.frames().isEmpty());
+
+    const QString valid = writeLog(QStringLiteral("valid.log"),
+                                   "(1.000000) can0 123#00\n(1.000100) can0 124#01\n");
+    QVERIFY(replayer.load(valid));
+    QCOMPARE(replayer.error(), QCanBusReplayer::NoError);
+    QCOMPARE(replayer.frames().size(), 2);
+
+    // Without a device, there is nothing to replay to.
+    replayer.start();
+    QCOMPARE(replayer.error(), QCanBusReplayer::WriteError);
+    QCOMPARE(replayer.state(), QCanBusReplayer::StoppedState);
+}
+
+void tst_QCanBusReplayer::replayTiming()
+{
+    RecordingBackend device;
+    QVERIFY(device.connectDevice());
+
+    QList<QCanBusFrame> frames;
+    frames.append(frameAt(5000000, 0x100, "a"));
+    frames.append(frameAt(5050000, 0x101, "b"));
+    frames.append(frameAt(5050000, 0x102, "c")); // burst
+    frames.append(frameAt(5040000, 0x103, "d")); // out of order, due right after its predecessor
+    frames.append(frameAt(5150000, 0x104, "e"));
+    QCanBusFrame error(QCanBusFrame::ErrorFrame);
+    error.setTimeStamp(QCanBusFrame::TimeStamp::fromMicroSeconds(5160000));
+    frames.append(error);
+
+    QCanBusReplayer replayer;
+    replayer.setDevice(&device);
+    replayer.setFrames(frames);
+    QSignalSpy finished(&replayer, &QCanBusReplayer::finished);
+    QSignalSpy states(&replayer, &QCanBusReplayer::stateChanged);
+
+    device.clock.start();
+    replayer.start();
+    QCOMPARE(replayer.state(), QCanBusReplayer::RunningState);
+    QVERIFY(finished.wait());
+    QCOMPARE(replayer.state(), QCanBusReplayer::StoppedState);
+    QCOMPARE(states.size(), 2);
+
+    QCOMPARE(device.written.size(), 5); // the error frame is skipped
+    QCOMPARE(replayer.framesReplayed(), Q_INT64_C(5));
+    for (qsizetype i = 0; i < 5; ++i)
+        QCOMPARE(device.written.at(i).frameId(), frames.at(i).frameId());
+
+    // Frames are never early; lateness is reported, not accumulated.
+    QVERIFY(device.writtenAt.at(1) >= 50000);
+    QVERIFY(device.writtenAt.at(3) >= 50000);
+    QVERIFY(device.writtenAt.at(4) >= 150000);
+    QVERIFY(replayer.maximumTimingError() >= replayer.averageTimingError());
+    QVERIFY(device.writtenAt.at(4) - 150000 <= replayer.maximumTimingError() + 1000);
+}
+
+void tst_QCanBusReplayer::replaySpeed()
+{
+    RecordingBackend device;
+    QVERIFY(device.connectDevice());
+
+    QCanBusReplayer replayer;
+    QCOMPARE(replayer.speed(), 1.0);
+    replayer.setSpeed(0.0);
+    QCOMPARE(replayer.speed(), 1.0);
+    replayer.setSpeed(10.0);
+    QCOMPARE(replayer.speed(), 10.0);
+
+    // One second of traffic at ten times the speed.
+    replayer.setFrames({ frameAt(0, 0x1, "a"), frameAt(1000000, 0x2, "b") });
+    replayer.setDevice(&device);
+    QSignalSpy finished(&replayer, &QCanBusReplayer::finished);
+
+    QElapsedTimer timer;
+    timer.start();
+    device.clock.start();
+    replayer.start();
+    QVERIFY(finished.wait());
+    QVERIFY(device.writtenAt.at(1) >= 100000);
+    QVERIFY(timer.elapsed() < 1000);
+}
+
+void tst_QCanBusReplayer::replayLoop()
+{
+    RecordingBackend device;
+    QVERIFY(device.connectDevice());
+
+    QCanBusReplayer replayer;
+    replayer.setDevice(&device);
+    replayer.setLooping(true);
+    QVERIFY(replayer.isLooping());
+    replayer.setFrames({ frameAt(0, 0x1, "a"), frameAt(10000, 0x2, "b") });
+    QSignalSpy finished(&replayer, &QCanBusReplayer::finished);
+
+    device.clock.start();
+    replayer.start();
+    QTRY_VERIFY(device.written.size() >= 6);
+    replayer.stop();
+    QCOMPARE(finished.size(), 0);
+    for (qsizetype i = 0; i < device.written.size(); ++i)
+        QCOMPARE(device.written.at(i).frameId(), QCanBusFrame::FrameId(i % 2 + 1));
+
+    // Rounds follow each other at the rate of the log: the third round starts at 40 ms.
+    QVERIFY(device.writtenAt.at(2) >= 20000);
+    QVERIFY(device.writtenAt.at(4) >= 40000);
+}
+
+void tst_QCanBusReplayer::replayWriteError()
+{
+    RecordingBackend device; // not connected
+    QCanBusReplayer replayer;
+    replayer.setDevice(&device);
+    replayer.setFrames({ frameAt(0, 0x1, "a") });
+    QSignalSpy errors(&replayer, &QCanBusReplayer::errorOccurred);
+
+    replayer.start();
+    QTRY_COMPARE(errors.size(), 1);
+    QCOMPARE(replayer.error(), QCanBusReplayer::WriteError);
+    QCOMPARE(replayer.state(), QCanBusReplayer::StoppedState);
+    QVERIFY(device.written.isEmpty());
+}
+
+QTEST_MAIN(tst_QCanBusReplayer)
+
+#include "tst_qcanbusreplayer.moc"
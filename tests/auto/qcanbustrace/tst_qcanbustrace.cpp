@@ -0,0 +1,240 @@
+// Copyright (C) 2023 The Qt Company Ltd.
+// SPDX-License-Identifier: LicenseRef-Qt-Commercial OR LGPL-3.0-only OR GPL-2.0-only OR GPL-3.0-only
+
+#include <QtSerialBus/qcanbusframe.h>
+#include <QtSerialBus/qcanbustracereader.h>
+#include <QtSerialBus/qcanbustracewriter.h>
+
+#include <QtCore/qfile.h>
+#include <QtCore/qtemporarydir.h>
+#include <QtTest/qtest.h>
+
+// Frame i has a time stamp of i milliseconds, an identifier of 0x100 + i % 16, and
+// alternates between two channels.
+static QCanBusFrame testFrame(int i)
+{
+    QCanBusFrame frame(0x100 + i % 16, QByteArray(i % 9, char(i)));
+    frame.setTimeStamp(QCanBusFrame::TimeStamp::fromMicroSeconds(qint64(i) * 1000));
+    return frame;
+}
+
+class tst_QCanBusTrace : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void initTestCase();
+
+    void roundTrip();
+    void timeWindow();
+    void identifierFilter();
+    void extendedAndSpecialFrames();
+    void latency();
+    void invalidFiles();
+
+private:
+    QString writeTrace(const QString &name, int count);
+
+    QTemporaryDir m_dir;
+};
+
+void tst_QCanBusTrace::initTestCase()
+{
+    QVERIFY(m_dir.isValid());
+}
+
+QString tst_QCanBusTrace::writeTrace(const QString &name, int count)
+{
+    const QString fileName = m_dir.filePath(name);
+    QCanBusTraceWriter writer;
+    writer.setBlockSize(4096);
+    if (!writer.open(fileName))
+        return QString();
+    for (int i = 0; i < count; ++i) {
+        if (!writer.writeFrame(testFrame(i), i % 2))
+            return QString();
+    }
+    writer.close();
+    return fileName;
+}
+
+void tst_QCanBusTrace::roundTrip()
+{
+    const int count = 2000;
+    const QString fileName = writeTrace(QStringLiteral("roundtrip.trc"), count);
+    QVERIFY(!fileName.isEmpty());
+
+    QCanBusTraceReader reader;
+    QVERIFY2(reader.open(fileName), qPrintable(reader.errorString()));
+    QVERIFY(reader.isOpen());
+    QCOMPARE(reader.frameCount(), qint64(count));
+    QVERIFY(reader.blockCount() > 1);
+    QCOMPARE(reader.startTime(), qint64(0));
+    QCOMPARE(reader.endTime(), qint64(count - 1) * 1000);
+
+    for (int i : { 0, 1, 17, 500, count - 1 }) {
+        int channel = -1;
+        const QCanBusFrame frame = reader.frameAt(i, &channel);
+        const QCanBusFrame expected = testFrame(i);
+        QCOMPARE(frame.frameId(), expected.frameId());
+        QCOMPARE(frame.payload(), expected.payload());
+        QCOMPARE(frame.timeStamp().microSeconds(), expected.timeStamp().microSeconds());
+        QCOMPARE(frame.timeStamp().seconds(), expected.timeStamp().seconds());
+        QCOMPARE(channel, i % 2);
+    }
+    QCOMPARE(reader.frameAt(count).frameType(), QCanBusFrame::InvalidFrame);
+    QCOMPARE(reader.frameAt(-1).frameType(), QCanBusFrame::InvalidFrame);
+
+    const QList<QCanBusFrame> all = reader.frames(reader.startTime(), reader.endTime() + 1);
+    QCOMPARE(all.size(), count);
+    for (int i = 0; i < count; ++i)
+        QCOMPARE(all.at(i).frameId(), testFrame(i).frameId());
+
+    reader.close();
+    QVERIFY(!reader.isOpen());
+    QCOMPARE(reader.frameCount(), qint64(0));
+}
+
+void tst_QCanBusTrace::timeWindow()
+{
+    const QString fileName = writeTrace(QStringLiteral("window.trc"), 3000);
+    QVERIFY(!fileName.isEmpty());
+
+    QCanBusTraceReader reader;
+    QVERIFY(reader.open(fileName));
+
+    // [1.5 s, 1.6 s) holds the frames 1500 to 1599.
+    const QList<QCanBusFrame> frames = reader.frames(1500000, 1600000);
+    QCOMPARE(frames.size(), 100);
+    QCOMPARE(frames.first().timeStamp().seconds(), qint64(1));
+    QCOMPARE(frames.first().timeStamp().microSeconds(), qint64(500000));
+    QCOMPARE(frames.last().timeStamp().microSeconds(), qint64(599000));
+
+    QVERIFY(reader.frames(-100, 0).isEmpty());
+    QVERIFY(reader.frames(3000000, 4000000).isEmpty());
+
+    // The handler stops the iteration.
+    int seen = 0;
+    const qint64 passed = reader.forEachFrame(0, 3000000, {}, [&seen](const QCanBusFrame &, int) {
+        return ++seen < 10;
+    });
+    QCOMPARE(passed, qint64(10));
+    QCOMPARE(seen, 10);
+}
+
+void tst_QCanBusTrace::identifierFilter()
+{
+    const QString fileName = writeTrace(QStringLiteral("filter.trc"), 1600);
+    QVERIFY(!fileName.isEmpty());
+
+    QCanBusTraceReader reader;
+    QVERIFY(reader.open(fileName));
+
+    const QList<QCanBusFrame> frames = reader.frames(0, 2000000, { 0x105, 0x10a });
+    QCOMPARE(frames.size(), 200);
+    for (const QCanBusFrame &frame : frames)
+        QVERIFY(frame.frameId() == 0x105 || frame.frameId() == 0x10a);
+
+    QList<int> channels;
+    reader.forEachFrame(0, 2000000, { 0x103 }, [&channels](const QCanBusFrame &, int channel) {
+        channels.append(channel);
+        return true;
+    });
+    QCOMPARE(channels.size(), 100);
+    QVERIFY(!channels.contains(0)); // 0x103 is written with odd indexes only
+
+    QVERIFY(reader.frames(0, 2000000, { 0x7ff }).isEmpty());
+}
+
+void tst_QCanBusTrace::extendedAndSpecialFrames()
+{
+    const QString fileName = m_dir.filePath(QStringLiteral("special.trc"));
+    QCanBusTraceWriter writer;
+    QVERIFY(writer.open(fileName));
+
+    QCanBusFrame extended(0x18fef100, QByteArray::fromHex("0102"));
+    extended.setTimeStamp(QCanBusFrame::TimeStamp::fromMicroSeconds(10));
+    QCanBusFrame fd(0x123, QByteArray(64, 'x'));
+    fd.setFlexibleDataRateFormat(true);
+    fd.setBitrateSwitch(true);
+    fd.setTimeStamp(QCanBusFrame::TimeStamp::fromMicroSeconds(20));
+    QCanBusFrame error(QCanBusFrame::ErrorFrame);
+    error.setError(QCanBusFrame::BusOffError);
+    error.setTimeStamp(QCanBusFrame::TimeStamp::fromMicroSeconds(30));
+    QVERIFY(writer.writeFrames({ extended, fd, error }, 7));
+    QVERIFY(!writer.writeFrame(extended, 256));
+    writer.close();
+
+    QCanBusTraceReader reader;
+    QVERIFY(reader.open(fileName));
+    QCOMPARE(reader.frameCount(), qint64(3));
+
+    const QList<QCanBusFrame> extendedOnly = reader.frames(0, 100, { 0x18fef100 });
+    QCOMPARE(extendedOnly.size(), 1);
+    QVERIFY(extendedOnly.first().hasExtendedFrameFormat());
+    QCOMPARE(extendedOnly.first().payload(), QByteArray::fromHex("0102"));
+
+    const QCanBusFrame readFd = reader.frameAt(1);
+    QVERIFY(readFd.hasFlexibleDataRateFormat());
+    QVERIFY(readFd.hasBitrateSwitch());
+    QCOMPARE(readFd.payload(), QByteArray(64, 'x'));
+
+    int channel = 0;
+    const QCanBusFrame readError = reader.frameAt(2, &channel);
+    QCOMPARE(readError.frameType(), QCanBusFrame::ErrorFrame);
+    QCOMPARE(readError.error(), QCanBusFrame::FrameErrors(QCanBusFrame::BusOffError));
+    QCOMPARE(channel, 7);
+
+    // Identifier filters never match error frames.
+    QVERIFY(reader.frames(0, 100, { 0 }).isEmpty());
+}
+
+void tst_QCanBusTrace::latency()
+{
+    const QString fileName = m_dir.filePath(QStringLiteral("latency.trc"));
+    QCanBusTraceWriter writer;
+    writer.setMaximumLatency(50);
+    QVERIFY(writer.open(fileName));
+    QVERIFY(writer.writeFrame(testFrame(0)));
+
+    // Nothing but the file header is written before the latency passed.
+    QCOMPARE(QFile(fileName).size(), qint64(32));
+
+    QCanBusTraceReader reader;
+    QTRY_VERIFY(reader.open(fileName) && reader.frameCount() == 1);
+
+    // The block is completed in place.
+    QVERIFY(writer.writeFrame(testFrame(1)));
+    QVERIFY(writer.flush());
+    QVERIFY(reader.open(fileName));
+    QCOMPARE(reader.frameCount(), qint64(2));
+    QCOMPARE(reader.blockCount(), qint64(1));
+
+    writer.setMaximumLatency(0);
+    QVERIFY(writer.writeFrame(testFrame(2)));
+    QVERIFY(reader.open(fileName));
+    QCOMPARE(reader.frameCount(), qint64(3));
+}
+
+void tst_QCanBusTrace::invalidFiles()
+{
+    QCanBusTraceReader reader;
+    QVERIFY(!reader.open(m_dir.filePath(QStringLiteral("missing.trc"))));
+    QVERIFY(!reader.errorString().isEmpty());
+
+    const QString fileName = m_dir.filePath(QStringLiteral("invalid.trc"));
+    QFile file(fileName);
+    QVERIFY(file.open(QIODevice::WriteOnly));
+    file.write(QByteArray(64, 'x'));
+    file.close();
+    QVERIFY(!reader.open(fileName));
+    QVERIFY(!reader.isOpen());
+
+    QCanBusTraceWriter writer;
+    QVERIFY(!writer.writeFrame(testFrame(0)));
+    QVERIFY(!writer.errorString().isEmpty());
+}
+
+QTEST_MAIN(tst_QCanBusTrace)
+
+#include "tst_qcanbustrace.moc"
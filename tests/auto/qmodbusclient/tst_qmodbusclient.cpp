@@ -2,11 +2,20 @@
 // SPDX-License-Identifier: LicenseRef-Qt-Commercial OR LGPL-3.0-only OR GPL-2.0-only OR GPL-3.0-only
 
 #include <QtSerialBus/qmodbusclient.h>
+#include <QtSerialBus/qmodbustcpclient.h>
+#include <QtSerialBus/qmodbustcpserver.h>
 #include <private/qmodbusclient_p.h>
 #include <private/qmodbus_symbols_p.h>
 
+#include <QtNetwork/qtcpsocket.h>
 #include <QtTest/QtTest>
 
+#include "qlocaltcpport_helpers.h"
+
+#include <algorithm>
+#include <limits>
+#include <numeric>
+
 class TestClient : public QModbusClient
 {
     Q_OBJECT
@@ -41,6 +50,61 @@ public:
     Q_DECLARE_PRIVATE(TestClient)
 };
 
+class CachingTestClient : public QModbusClient
+{
+    Q_OBJECT
+    class CachingTestClientPrivate : public QModbusClientPrivate
+    {
+        Q_DECLARE_PUBLIC(CachingTestClient)
+
+    public:
+        bool isOpen() const override { return true; }
+
+        QModbusReply *enqueueRequest(const QModbusRequest &request, int serverAddress,
+                                     const QModbusDataUnit &unit,
+                                     QModbusReply::ReplyType type) override
+        {
+            auto reply = new QModbusReply(type, serverAddress, q_func());
+            m_sent.append(QueueElement(reply, request, unit, 0));
+            return reply;
+        }
+
+        bool enqueueElement(QueueElement element) override
+        {
+            m_sent.append(element);
+            return true;
+        }
+
+        QList<QueueElement> m_sent;
+    };
+
+public:
+    CachingTestClient()
+        : QModbusClient(*new CachingTestClientPrivate)
+    {}
+    bool open() override {
+        setState(QModbusDevice::ConnectedState);
+        return true;
+    }
+    void close() override {
+        setState(QModbusDevice::UnconnectedState);
+    }
+
+    QModbusClientPrivate *priv() { return d_func(); }
+    qsizetype sentCount() const { return d_func()->m_sent.size(); }
+    void answer(qsizetype index, const QModbusResponse &response)
+    {
+        Q_D(CachingTestClient);
+        d->processQueueElement(response, d->m_sent.at(index));
+    }
+    void fail(qsizetype index, QModbusDevice::Error error)
+    {
+        Q_D(CachingTestClient);
+        d->m_sent.at(index).setError(error, QStringLiteral("Failed"));
+    }
+    Q_DECLARE_PRIVATE(CachingTestClient)
+};
+
 class tst_QModbusClient : public QObject
 {
     Q_OBJECT
@@ -538,6 +602,663 @@ private slots:
         QTEST(request.isValid(), "isValid");
     }
 
+    void testReadCache()
+    {
+        CachingTestClient client;
+        QVERIFY(client.connectDevice());
+        QCOMPARE(client.cacheTimeToLive(), 0);
+        client.setCacheTimeToLive(-1);
+        QCOMPARE(client.cacheTimeToLive(), 0);
+
+        const QModbusDataUnit range(QModbusDataUnit::HoldingRegisters, 10, 2);
+        const QModbusResponse response(QModbusResponse::ReadHoldingRegisters,
+                                       QByteArray::fromHex("0400010002"));
+
+        // Disabled by default, every read is sent.
+        QModbusReply *first = client.sendReadRequest(range, 1);
+        QModbusReply *second = client.sendReadRequest(range, 1);
+        QVERIFY(first && second);
+        QCOMPARE(client.sentCount(), 2);
+        client.answer(0, response);
+        client.answer(1, response);
+
+        client.setCacheTimeToLive(60000);
+        QCOMPARE(client.cacheTimeToLive(), 60000);
+
+        // The second read joins the first one in flight.
+        first = client.sendReadRequest(range, 1);
+        second = client.sendReadRequest(range, 1);
+        QVERIFY(first && second && first != second);
+        QCOMPARE(client.sentCount(), 3);
+        QVERIFY(!second->isFinished());
+        client.answer(2, response);
+        QVERIFY(first->isFinished());
+        QVERIFY(second->isFinished());
+        QCOMPARE(second->error(), QModbusDevice::NoError);
+        QCOMPARE(second->result().values(), QList<quint16>({ 1, 2 }));
+
+        // Answered from the cache, asynchronously.
+        QModbusReply *cached = client.sendReadRequest(range, 1);
+        QVERIFY(cached);
+        QVERIFY(!cached->isFinished());
+        QTRY_VERIFY(cached->isFinished());
+        QCOMPARE(client.sentCount(), 3);
+        QCOMPARE(cached->result().startAddress(), 10);
+        QCOMPARE(cached->result().values(), QList<quint16>({ 1, 2 }));
+
+        // Other servers, function codes and ranges are cached separately.
+        QVERIFY(client.sendReadRequest(range, 2));
+        QVERIFY(client.sendReadRequest({ QModbusDataUnit::InputRegisters, 10, 2 }, 1));
+        QVERIFY(client.sendReadRequest({ QModbusDataUnit::HoldingRegisters, 10, 1 }, 1));
+        QCOMPARE(client.sentCount(), 6);
+
+        // A write to an overlapping range of another server keeps the entry.
+        QVERIFY(client.sendWriteRequest({ QModbusDataUnit::HoldingRegisters, 11,
+                                          QList<quint16> { 7 } }, 2));
+        QCOMPARE(client.sentCount(), 7);
+        QVERIFY(client.sendReadRequest(range, 1));
+        QCOMPARE(client.sentCount(), 7);
+
+        // A write to an adjacent range keeps the entry, an overlapping one removes it.
+        QVERIFY(client.sendWriteRequest({ QModbusDataUnit::HoldingRegisters, 12,
+                                          QList<quint16> { 7 } }, 1));
+        QVERIFY(client.sendReadRequest(range, 1));
+        QCOMPARE(client.sentCount(), 8);
+        QVERIFY(client.sendWriteRequest({ QModbusDataUnit::HoldingRegisters, 11,
+                                          QList<quint16> { 7 } }, 1));
+        QVERIFY(client.sendReadRequest(range, 1));
+        QCOMPARE(client.sentCount(), 10);
+
+        // A write sent while the read is in flight keeps its response out of the cache.
+        client.answer(9, response);
+        QVERIFY(client.sendReadRequest(range, 1));
+        QCOMPARE(client.sentCount(), 10);
+        client.clearCache();
+        QVERIFY(client.sendReadRequest(range, 1));
+        QCOMPARE(client.sentCount(), 11);
+        QVERIFY(client.sendWriteRequest({ QModbusDataUnit::HoldingRegisters, 10,
+                                          QList<quint16> { 7 } }, 0));
+        client.answer(10, response);
+        QVERIFY(client.sendReadRequest(range, 1));
+        QCOMPARE(client.sentCount(), 13);
+
+        // Exception responses are not cached.
+        client.clearCache();
+        first = client.sendReadRequest(range, 3);
+        second = client.sendReadRequest(range, 3);
+        client.answer(13, QModbusExceptionResponse(QModbusResponse::ReadHoldingRegisters,
+                                                   QModbusExceptionResponse::IllegalDataAddress));
+        QCOMPARE(second->error(), QModbusDevice::ProtocolError);
+        QVERIFY(second->rawResult().isException());
+        QVERIFY(client.sendReadRequest(range, 3));
+        QCOMPARE(client.sentCount(), 15);
+
+        // Per-range settings take precedence, 0 disables caching within the range.
+        client.clearCache();
+        client.setCacheTimeToLive({ QModbusDataUnit::HoldingRegisters, 0, 100 }, 0);
+        QVERIFY(client.sendReadRequest(range, 1));
+        QVERIFY(client.sendReadRequest(range, 1));
+        QCOMPARE(client.sentCount(), 17);
+        client.setCacheTimeToLive({ QModbusDataUnit::HoldingRegisters, 0, 100 }, -1);
+        client.setCacheTimeToLive(0);
+        client.setCacheTimeToLive({ QModbusDataUnit::HoldingRegisters, 10, 2 }, 60000);
+        QVERIFY(client.sendReadRequest(range, 1));
+        QVERIFY(client.sendReadRequest(range, 1));
+        QCOMPARE(client.sentCount(), 18);
+        QVERIFY(client.sendReadRequest({ QModbusDataUnit::HoldingRegisters, 9, 2 }, 1));
+        QVERIFY(client.sendReadRequest({ QModbusDataUnit::HoldingRegisters, 9, 2 }, 1));
+        QCOMPARE(client.sentCount(), 20);
+    }
+
+    void testReadCacheAbandoned()
+    {
+        CachingTestClient client;
+        QVERIFY(client.connectDevice());
+        client.setCacheTimeToLive(60000);
+
+        const QModbusDataUnit range(QModbusDataUnit::HoldingRegisters, 10, 2);
+        const QModbusResponse response(QModbusResponse::ReadHoldingRegisters,
+                                       QByteArray::fromHex("0400010002"));
+
+        // Deleting the first reply keeps the read in flight, it is not sent a second time.
+        QModbusReply *first = client.sendReadRequest(range, 1);
+        QModbusReply *second = client.sendReadRequest(range, 1);
+        QVERIFY(first && second);
+        QCOMPARE(client.sentCount(), 1);
+        delete first;
+        QCOMPARE(client.sentCount(), 1);
+        QVERIFY(!second->isFinished());
+
+        QModbusReply *third = client.sendReadRequest(range, 1);
+        QVERIFY(third);
+        QCOMPARE(client.sentCount(), 1);
+        client.answer(0, response);
+        QVERIFY(second->isFinished());
+        QCOMPARE(second->result().values(), QList<quint16>({ 1, 2 }));
+        QVERIFY(third->isFinished());
+        QCOMPARE(third->result().values(), QList<quint16>({ 1, 2 }));
+
+        // Without joined reads, the read still completes and its response is cached.
+        client.clearCache();
+        delete client.sendReadRequest(range, 1);
+        QCOMPARE(client.sentCount(), 2);
+        client.answer(1, response);
+        QModbusReply *cached = client.sendReadRequest(range, 1);
+        QVERIFY(cached);
+        QCOMPARE(client.sentCount(), 2);
+        QTRY_VERIFY(cached->isFinished());
+        QCOMPARE(cached->result().values(), QList<quint16>({ 1, 2 }));
+
+        // A read that never finishes stops holding back the range after a while.
+        client.clearCache();
+        client.setTimeout(10);
+        client.setNumberOfRetries(0);
+        QVERIFY(client.sendReadRequest(range, 1));
+        QVERIFY(client.sendReadRequest(range, 1));
+        QCOMPARE(client.sentCount(), 3);
+        QTest::qWait(50);
+        QVERIFY(client.sendReadRequest(range, 1));
+        QCOMPARE(client.sentCount(), 4);
+    }
+
+    void testAdaptiveTimeout()
+    {
+        CachingTestClient client;
+        QVERIFY(client.connectDevice());
+        QCOMPARE(client.adaptiveTimeout(), false);
+        QCOMPARE(client.minimumTimeout(), 50);
+        client.setMinimumTimeout(9);
+        QCOMPARE(client.minimumTimeout(), 50);
+        QCOMPARE(client.timeout(1), 1000);
+
+        QModbusClientPrivate *d = client.priv();
+        d->updateRoundTrip(1, 100);
+        QCOMPARE(client.timeout(1), 1000); // not enabled
+
+        client.setAdaptiveTimeout(true);
+        QVERIFY(client.adaptiveTimeout());
+        QCOMPARE(client.timeout(1), 1000);
+
+        // RTT 100 ms, variation 50 ms
+        d->updateRoundTrip(1, 100);
+        QCOMPARE(client.timeout(1), 300);
+        // variation 37.5 ms
+        d->updateRoundTrip(1, 100);
+        QCOMPARE(client.timeout(1), 250);
+        QCOMPARE(client.timeout(2), 1000);
+
+        // Timeouts back off up to timeout().
+        d->recordTimeout(1, false);
+        QCOMPARE(client.timeout(1), 500);
+        d->recordTimeout(1, false);
+        QCOMPARE(client.timeout(1), 1000);
+        d->recordTimeout(1, true);
+        QCOMPARE(client.timeout(1), 1000);
+        QVERIFY(client.isServerAvailable(1)); // no failure threshold set
+
+        // Fast responses are bounded by minimumTimeout().
+        for (int i = 0; i < 100; ++i)
+            d->updateRoundTrip(1, 10);
+        QCOMPARE(client.timeout(1), 50);
+        client.setMinimumTimeout(80);
+        d->updateRoundTrip(1, 10);
+        QCOMPARE(client.timeout(1), 80);
+
+        // Responses to retried requests are not sampled.
+        QModbusClientPrivate::QueueElement element;
+        element.attempts = 2;
+        element.sent.start();
+        d->recordResponse(1, element);
+        QCOMPARE(client.timeout(1), 80);
+
+        client.setAdaptiveTimeout(false);
+        QCOMPARE(client.timeout(1), 1000);
+    }
+
+    void testServerFailureThreshold()
+    {
+        CachingTestClient client;
+        QVERIFY(client.connectDevice());
+        QCOMPARE(client.serverFailureThreshold(), 0);
+        QCOMPARE(client.serverRecoveryTime(), 10000);
+        client.setServerFailureThreshold(-1);
+        QCOMPARE(client.serverFailureThreshold(), 0);
+        client.setServerFailureThreshold(2);
+        client.setServerRecoveryTime(100);
+        QCOMPARE(client.serverFailureThreshold(), 2);
+        QCOMPARE(client.serverRecoveryTime(), 100);
+
+        QModbusClientPrivate *d = client.priv();
+        const QModbusDataUnit range(QModbusDataUnit::HoldingRegisters, 0, 1);
+
+        // Retries do not count, a response resets the count.
+        d->recordTimeout(3, false);
+        d->recordTimeout(3, true);
+        d->recordResponse(3, QModbusClientPrivate::QueueElement());
+        d->recordTimeout(3, true);
+        QVERIFY(client.isServerAvailable(3));
+        d->recordTimeout(3, true);
+        QVERIFY(!client.isServerAvailable(3));
+        QVERIFY(client.isServerAvailable(4));
+
+        QModbusReply *reply = client.sendReadRequest(range, 3);
+        QVERIFY(reply);
+        QCOMPARE(client.sentCount(), 0);
+        QVERIFY(!reply->isFinished());
+        QTRY_VERIFY(reply->isFinished());
+        QCOMPARE(reply->error(), QModbusDevice::TimeoutError);
+        QVERIFY(client.sendReadRequest(range, 4));
+        QCOMPARE(client.sentCount(), 1);
+
+        // After the recovery time, a single request probes the server.
+        QTRY_VERIFY(client.isServerAvailable(3));
+        QVERIFY(client.sendReadRequest(range, 3));
+        QCOMPARE(client.sentCount(), 2);
+        reply = client.sendReadRequest(range, 3);
+        QCOMPARE(client.sentCount(), 2);
+        QTRY_COMPARE(reply->error(), QModbusDevice::TimeoutError);
+
+        // The probe failed, the server is unavailable for another recovery time.
+        d->recordTimeout(3, true);
+        QVERIFY(!client.isServerAvailable(3));
+        QTRY_VERIFY(client.isServerAvailable(3));
+        QVERIFY(client.sendReadRequest(range, 3));
+        QCOMPARE(client.sentCount(), 3);
+        d->recordResponse(3, QModbusClientPrivate::QueueElement());
+        QVERIFY(client.sendReadRequest(range, 3));
+        QVERIFY(client.sendReadRequest(range, 3));
+        QCOMPARE(client.sentCount(), 5);
+    }
+
+    void testServerProbeFailure()
+    {
+        CachingTestClient client;
+        QVERIFY(client.connectDevice());
+        client.setServerFailureThreshold(1);
+        client.setServerRecoveryTime(10);
+
+        QModbusClientPrivate *d = client.priv();
+        const QModbusDataUnit range(QModbusDataUnit::HoldingRegisters, 0, 1);
+        d->recordTimeout(3, true);
+        QVERIFY(!client.isServerAvailable(3));
+        QTRY_VERIFY(client.isServerAvailable(3));
+
+        // A probe failing with another error than a timeout lets the next request probe.
+        QModbusReply *probe = client.sendReadRequest(range, 3);
+        QVERIFY(probe);
+        QCOMPARE(client.sentCount(), 1);
+        QModbusReply *rejected = client.sendReadRequest(range, 3);
+        QCOMPARE(client.sentCount(), 1);
+        QTRY_VERIFY(rejected->isFinished());
+        client.fail(0, QModbusDevice::ConnectionError);
+        QVERIFY(probe->isFinished());
+        QVERIFY(client.sendReadRequest(range, 3));
+        QCOMPARE(client.sentCount(), 2);
+
+        // So does a probe whose reply is deleted.
+        delete client.sendReadRequest(range, 3);
+        QCOMPARE(client.sentCount(), 2);
+        client.fail(1, QModbusDevice::ProtocolError);
+        probe = client.sendReadRequest(range, 3);
+        QCOMPARE(client.sentCount(), 3);
+        delete probe;
+        QVERIFY(client.sendReadRequest(range, 3));
+        QCOMPARE(client.sentCount(), 4);
+
+        // And a probe sent with a result handler.
+        client.fail(3, QModbusDevice::ReplyAbortedError);
+        QList<QModbusResult> results;
+        const auto handler = [&results](const QModbusResult &result) { results.append(result); };
+        QVERIFY(client.sendReadRequest(range, 3, this, handler));
+        QCOMPARE(client.sentCount(), 5);
+        client.fail(4, QModbusDevice::ConnectionError);
+        QCOMPARE(results.size(), 1);
+        QCOMPARE(results.at(0).error(), QModbusDevice::ConnectionError);
+        QVERIFY(client.sendReadRequest(range, 3, this, handler));
+        QCOMPARE(client.sentCount(), 6);
+    }
+
+    void testResultHandler()
+    {
+        CachingTestClient client;
+        QList<QModbusResult> results;
+        const auto handler = [&results](const QModbusResult &result) { results.append(result); };
+
+        const QModbusDataUnit range(QModbusDataUnit::HoldingRegisters, 10, 2);
+        QTest::ignoreMessage(QtWarningMsg, "(Client) Device is not connected");
+        QVERIFY(!client.sendReadRequest(range, 1, this, handler));
+        QVERIFY(client.connectDevice());
+
+        QVERIFY(client.sendReadRequest(range, 1, this, handler));
+        QCOMPARE(client.sentCount(), 1);
+        QVERIFY(results.isEmpty());
+        client.answer(0, QModbusResponse(QModbusResponse::ReadHoldingRegisters,
+                                         QByteArray::fromHex("0400010002")));
+        QCOMPARE(results.size(), 1);
+        QCOMPARE(results.at(0).error(), QModbusDevice::NoError);
+        QCOMPARE(results.at(0).type(), QModbusReply::Common);
+        QCOMPARE(results.at(0).serverAddress(), 1);
+        QCOMPARE(results.at(0).result().startAddress(), 10);
+        QCOMPARE(results.at(0).result().values(), QList<quint16>({ 1, 2 }));
+
+        // Answering twice does not call the handler again.
+        client.answer(0, QModbusResponse(QModbusResponse::ReadHoldingRegisters,
+                                         QByteArray::fromHex("0400010002")));
+        QCOMPARE(results.size(), 1);
+
+        // Exception responses are reported as protocol errors, with the raw response.
+        results.clear();
+        QVERIFY(client.sendRawRequest(QModbusRequest(QModbusRequest::ReadCoils, quint16(0),
+                                                     quint16(1)), 2, nullptr, handler));
+        const QModbusExceptionResponse exception(QModbusPdu::ReadCoils,
+                                                 QModbusPdu::IllegalDataAddress);
+        client.answer(1, exception);
+        QCOMPARE(results.size(), 1);
+        QCOMPARE(results.at(0).type(), QModbusReply::Raw);
+        QCOMPARE(results.at(0).error(), QModbusDevice::ProtocolError);
+        QCOMPARE(results.at(0).rawResult().exceptionCode(), QModbusPdu::IllegalDataAddress);
+
+        // The handler is not called once its context is gone.
+        results.clear();
+        auto context = new QObject;
+        QVERIFY(client.sendWriteRequest({ QModbusDataUnit::HoldingRegisters, 10,
+                                          QList<quint16> { 7 } }, 1, context, handler));
+        delete context;
+        client.answer(2, QModbusResponse(QModbusResponse::WriteSingleRegister,
+                                         QByteArray::fromHex("000a0007")));
+        QVERIFY(results.isEmpty());
+
+        // Cached reads work the same as for requests returning a reply.
+        client.setCacheTimeToLive(60000);
+        QVERIFY(client.sendReadRequest(range, 1, this, handler));
+        QModbusReply *joined = client.sendReadRequest(range, 1);
+        QVERIFY(client.sendReadRequest(range, 1, this, handler));
+        QCOMPARE(client.sentCount(), 4);
+        client.answer(3, QModbusResponse(QModbusResponse::ReadHoldingRegisters,
+                                         QByteArray::fromHex("0400030004")));
+        QCOMPARE(results.size(), 2);
+        QVERIFY(joined->isFinished());
+        QCOMPARE(joined->result().values(), QList<quint16>({ 3, 4 }));
+
+        QVERIFY(client.sendReadRequest(range, 1, this, handler));
+        QCOMPARE(results.size(), 2);
+        QTRY_COMPARE(results.size(), 3);
+        QCOMPARE(client.sentCount(), 4);
+        for (const QModbusResult &result : std::as_const(results))
+            QCOMPARE(result.result().values(), QList<quint16>({ 3, 4 }));
+    }
+
+    void testTcpResultHandler()
+    {
+        QModbusTcpServer server;
+        QModbusDataUnitMap map;
+        map.insert(QModbusDataUnit::HoldingRegisters,
+                   { QModbusDataUnit::HoldingRegisters, 0, 100 });
+        server.setMap(map);
+        server.setServerAddress(1);
+        for (quint16 i = 0; i < 100; ++i)
+            QVERIFY(server.setData(QModbusDataUnit::HoldingRegisters, i, quint16(1000 + i)));
+        const quint16 port = connectToFreeLocalTcpPort(&server);
+        QVERIFY(port);
+
+        QModbusTcpClient client;
+        client.setConnectionParameter(QModbusDevice::NetworkAddressParameter,
+                                      QStringLiteral("127.0.0.1"));
+        client.setConnectionParameter(QModbusDevice::NetworkPortParameter, int(port));
+        QVERIFY(client.connectDevice());
+        QTRY_COMPARE(client.state(), QModbusDevice::ConnectedState);
+
+        QList<quint16> values;
+        int failures = 0;
+        for (int i = 0; i < 100; ++i) {
+            QVERIFY(client.sendReadRequest({ QModbusDataUnit::HoldingRegisters, i, 1 }, 1, this,
+                                           [&](const QModbusResult &result) {
+                if (result.error() == QModbusDevice::NoError)
+                    values.append(result.result().value(0));
+                else
+                    ++failures;
+            }));
+        }
+        QTRY_COMPARE(values.size() + failures, 100);
+        QCOMPARE(failures, 0);
+        for (int i = 0; i < 100; ++i)
+            QCOMPARE(values.at(i), quint16(1000 + i));
+
+        // Unit 2 is not served, the request times out.
+        client.setTimeout(50);
+        client.setNumberOfRetries(0);
+        QModbusResult timedOut;
+        bool finished = false;
+        QVERIFY(client.sendReadRequest({ QModbusDataUnit::HoldingRegisters, 0, 1 }, 2, this,
+                                       [&](const QModbusResult &result) {
+            timedOut = result;
+            finished = true;
+        }));
+        QTRY_VERIFY(finished);
+        QCOMPARE(timedOut.error(), QModbusDevice::TimeoutError);
+
+        const QModbusClientMetrics metrics = client.metrics();
+        QCOMPARE(metrics.entries.size(), 2);
+        const QModbusClientMetrics::Entry served = metrics.entries.at(0);
+        QCOMPARE(served.serverAddress, 1);
+        QCOMPARE(served.functionCode, QModbusPdu::ReadHoldingRegisters);
+        QCOMPARE(served.requests, 100u);
+        QCOMPARE(served.responses, 100u);
+        QCOMPARE(served.timeouts, 0u);
+        QVERIFY(served.minimumLatency >= 0);
+        QVERIFY(served.maximumLatency >= served.minimumLatency);
+        QCOMPARE(metrics.entries.at(1).serverAddress, 2);
+        QCOMPARE(metrics.entries.at(1).timeouts, 1u);
+        QCOMPARE(metrics.queueDepth, 0);
+        QVERIFY(metrics.queueHighWaterMark >= 1);
+        QVERIFY(metrics.queueHighWaterMark <= 100);
+
+        // Requests are dropped once the context of their handler is gone, not on timeout.
+        client.setTimeout(60000);
+        auto context = new QObject;
+        for (int i = 0; i < 10; ++i) {
+            QVERIFY(client.sendReadRequest({ QModbusDataUnit::HoldingRegisters, 0, 1 }, 2,
+                                           context, [](const QModbusResult &) {}));
+        }
+        QCOMPARE(client.metrics().queueDepth, 10);
+        delete context;
+        QCOMPARE(client.metrics().queueDepth, 0);
+
+        client.disconnectDevice();
+        server.disconnectDevice();
+    }
+
+    void testTcpConnectionPool()
+    {
+        class Observer : public QModbusTcpConnectionObserver
+        {
+        public:
+            explicit Observer(QList<QPointer<QTcpSocket>> *accepted) : m_accepted(accepted) {}
+            bool acceptNewConnection(QTcpSocket *newClient) override
+            {
+                m_accepted->append(newClient);
+                return true;
+            }
+        private:
+            QList<QPointer<QTcpSocket>> *m_accepted;
+        };
+
+        QList<QPointer<QTcpSocket>> accepted;
+        QModbusTcpServer server;
+        server.installConnectionObserver(new Observer(&accepted));
+        QModbusDataUnitMap map;
+        map.insert(QModbusDataUnit::HoldingRegisters,
+                   { QModbusDataUnit::HoldingRegisters, 0, 100 });
+        server.setMap(map);
+        server.setServerAddress(1);
+        for (quint16 i = 0; i < 100; ++i)
+            QVERIFY(server.setData(QModbusDataUnit::HoldingRegisters, i, quint16(1000 + i)));
+        const quint16 port = connectToFreeLocalTcpPort(&server);
+        QVERIFY(port);
+
+        QModbusTcpClient client;
+        QCOMPARE(client.connectionCount(), 1);
+        client.setConnectionCount(0);
+        QCOMPARE(client.connectionCount(), 1);
+        client.setConnectionCount(3);
+        QCOMPARE(client.connectionCount(), 3);
+        client.setConnectionParameter(QModbusDevice::NetworkAddressParameter,
+                                      QStringLiteral("127.0.0.1"));
+        client.setConnectionParameter(QModbusDevice::NetworkPortParameter, int(port));
+        QList<QModbusDevice::State> states;
+        connect(&client, &QModbusDevice::stateChanged, this,
+                [&states](QModbusDevice::State state) { states.append(state); });
+        QVERIFY(client.connectDevice());
+        QTRY_COMPARE(client.state(), QModbusDevice::ConnectedState);
+        QTRY_COMPARE(accepted.size(), 3);
+
+        const QList<QTcpSocket *> sockets = client.findChildren<QTcpSocket *>();
+        QCOMPARE(sockets.size(), 3);
+        QHash<QTcpSocket *, qint64> written;
+        for (QTcpSocket *socket : sockets) {
+            QTRY_COMPARE(socket->state(), QAbstractSocket::ConnectedState);
+            connect(socket, &QIODevice::bytesWritten, this,
+                    [&written, socket](qint64 bytes) { written[socket] += bytes; });
+        }
+
+        // Sent back to back, the requests are spread evenly over the pool.
+        QList<quint16> values;
+        int failures = 0;
+        const auto handler = [&](const QModbusResult &result) {
+            if (result.error() == QModbusDevice::NoError)
+                values.append(result.result().value(0));
+            else
+                ++failures;
+        };
+        for (int i = 0; i < 30; ++i) {
+            QVERIFY(client.sendReadRequest({ QModbusDataUnit::HoldingRegisters, i, 1 }, 1, this,
+                                           handler));
+        }
+        QTRY_COMPARE(values.size() + failures, 30);
+        QCOMPARE(failures, 0);
+        std::sort(values.begin(), values.end());
+        for (int i = 0; i < 30; ++i)
+            QCOMPARE(values.at(i), quint16(1000 + i));
+        // Each read request is a seven byte MBAP header followed by a five byte PDU.
+        for (QTcpSocket *socket : sockets)
+            QCOMPARE(written.value(socket), qint64(10 * 12));
+
+        // A lost member of the pool is opened again, the client stays connected.
+        states.clear();
+        QVERIFY(accepted.first());
+        accepted.first()->abort();
+        QTRY_COMPARE(accepted.size(), 4);
+        for (QTcpSocket *socket : sockets)
+            QTRY_COMPARE(socket->state(), QAbstractSocket::ConnectedState);
+        QVERIFY(states.isEmpty());
+        QCOMPARE(client.state(), QModbusDevice::ConnectedState);
+
+        values.clear();
+        for (int i = 0; i < 30; ++i) {
+            QVERIFY(client.sendReadRequest({ QModbusDataUnit::HoldingRegisters, i, 1 }, 1, this,
+                                           handler));
+        }
+        QTRY_COMPARE(values.size() + failures, 30);
+        QCOMPARE(failures, 0);
+        QCOMPARE(client.metrics().aggregate().responses, 60u);
+
+        client.disconnectDevice();
+        QTRY_COMPARE(client.state(), QModbusDevice::UnconnectedState);
+        for (QTcpSocket *socket : sockets)
+            QCOMPARE(socket->state(), QAbstractSocket::UnconnectedState);
+        server.disconnectDevice();
+    }
+
+    void testMetricsHistogram()
+    {
+        using Metrics = QModbusClientMetrics;
+        for (int bucket = 0; bucket < Metrics::LatencyBucketCount; ++bucket) {
+            const qint64 lower = Metrics::latencyBucketLowerBound(bucket);
+            const qint64 upper = Metrics::latencyBucketUpperBound(bucket);
+            QVERIFY(lower < upper);
+            QCOMPARE(Metrics::latencyBucket(lower), bucket);
+            QCOMPARE(Metrics::latencyBucket(upper - 1), bucket);
+            QVERIFY(bucket < Metrics::SubBucketCount || (upper - lower) * 8 <= lower);
+        }
+        QCOMPARE(Metrics::latencyBucket(-1), 0);
+        QCOMPARE(Metrics::latencyBucket(std::numeric_limits<qint64>::max()),
+                 Metrics::LatencyBucketCount - 1);
+
+        Metrics::Entry entry;
+        QCOMPARE(Metrics::latencyPercentile(entry, 50), -1);
+        for (qint64 latency : { 100, 200, 300, 400, 10000 })
+            ++entry.latencyHistogram[Metrics::latencyBucket(latency)];
+        entry.maximumLatency = 10000;
+        QCOMPARE(Metrics::latencyPercentile(entry, 50),
+                 Metrics::latencyBucketUpperBound(Metrics::latencyBucket(300)));
+        QCOMPARE(Metrics::latencyPercentile(entry, 100), 10000);
+    }
+
+    void testMetrics()
+    {
+        CachingTestClient client;
+        QVERIFY(client.connectDevice());
+        QVERIFY(client.metrics().entries.isEmpty());
+
+        QModbusClientPrivate *d = client.priv();
+        const QModbusRequest read(QModbusRequest::ReadHoldingRegisters, quint16(0), quint16(1));
+        const QModbusRequest write(QModbusRequest::WriteSingleCoil, quint16(0), quint16(0xff00));
+        QModbusClientPrivate::QueueElement element(nullptr, read, {}, 0);
+        element.sent.start();
+
+        d->recordRequest(element, 3);
+        d->recordRequest(element, 1);
+        d->recordCrcError(element);
+        d->recordResponse(element, QModbusResponse(QModbusResponse::ReadHoldingRegisters,
+                                                   QByteArray::fromHex("020001")));
+        d->recordTimeout(element, false);
+        d->recordResponse(element, QModbusExceptionResponse(QModbusPdu::ReadHoldingRegisters,
+                          QModbusExceptionResponse::IllegalDataAddress));
+
+        QModbusClientPrivate::QueueElement other(nullptr, write, {}, 0);
+        d->recordRequest(other, 2);
+        d->recordTimeout(other, true);
+
+        QModbusClientMetrics metrics = client.metrics();
+        QCOMPARE(metrics.queueDepth, 0);
+        QCOMPARE(metrics.queueHighWaterMark, 3);
+        QCOMPARE(metrics.entries.size(), 2);
+
+        // Entries are sorted by function code, the server address is the same.
+        const QModbusClientMetrics::Entry reads = metrics.entries.at(0);
+        QCOMPARE(reads.functionCode, QModbusPdu::ReadHoldingRegisters);
+        QCOMPARE(reads.serverAddress, -1);
+        QCOMPARE(reads.requests, 2u);
+        QCOMPARE(reads.responses, 2u);
+        QCOMPARE(reads.exceptions, 1u);
+        QCOMPARE(reads.retries, 1u);
+        QCOMPARE(reads.timeouts, 0u);
+        QCOMPARE(reads.crcErrors, 1u);
+        QVERIFY(reads.minimumLatency >= 0);
+        QVERIFY(reads.maximumLatency >= reads.minimumLatency);
+        QVERIFY(reads.totalLatency >= reads.minimumLatency + reads.maximumLatency);
+        QCOMPARE(std::accumulate(reads.latencyHistogram.cbegin(), reads.latencyHistogram.cend(),
+                                 quint64(0)), 2u);
+
+        const QModbusClientMetrics::Entry writes = metrics.entries.at(1);
+        QCOMPARE(writes.functionCode, QModbusPdu::WriteSingleCoil);
+        QCOMPARE(writes.requests, 1u);
+        QCOMPARE(writes.responses, 0u);
+        QCOMPARE(writes.timeouts, 1u);
+        QCOMPARE(writes.minimumLatency, -1);
+
+        const QModbusClientMetrics::Entry total = metrics.aggregate();
+        QCOMPARE(total.requests, 3u);
+        QCOMPARE(total.timeouts, 1u);
+        QCOMPARE(total.minimumLatency, reads.minimumLatency);
+        QCOMPARE(metrics.aggregate(7).requests, 0u);
+
+        client.resetMetrics();
+        metrics = client.metrics();
+        QVERIFY(metrics.entries.isEmpty());
+        QCOMPARE(metrics.queueHighWaterMark, 0);
+    }
+
     void testPrivateSendRequest()
     {
         TestClient client;
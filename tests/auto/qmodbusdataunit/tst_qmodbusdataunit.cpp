@@ -14,6 +14,10 @@ private slots:
     void constructors();
     void setters();
     void testAPI();
+    void typedValues_data();
+    void typedValues();
+    void typedValuesBulk();
+    void typedValuesBounds();
 };
 
 tst_QModbusDataUnit::tst_QModbusDataUnit()
@@ -133,6 +137,114 @@ void tst_QModbusDataUnit::testAPI()
     QCOMPARE(unit.value(0), quint16(25));
 }
 
+void tst_QModbusDataUnit::typedValues_data()
+{
+    QTest::addColumn<QModbusDataUnit::ByteOrder>("order");
+    QTest::addColumn<QList<quint16>>("int32Registers");
+    QTest::addColumn<QList<quint16>>("int64Registers");
+    QTest::addColumn<QList<quint16>>("floatRegisters");
+
+    QTest::newRow("ABCD") << QModbusDataUnit::ByteOrder::BigEndian
+        << QList<quint16>{ 0x1122, 0x3344 }
+        << QList<quint16>{ 0x1122, 0x3344, 0x5566, 0x7788 }
+        << QList<quint16>{ 0x3f80, 0x0000 };
+    QTest::newRow("BADC") << QModbusDataUnit::ByteOrder::BigEndianByteSwap
+        << QList<quint16>{ 0x2211, 0x4433 }
+        << QList<quint16>{ 0x2211, 0x4433, 0x6655, 0x8877 }
+        << QList<quint16>{ 0x803f, 0x0000 };
+    QTest::newRow("CDAB") << QModbusDataUnit::ByteOrder::LittleEndianByteSwap
+        << QList<quint16>{ 0x3344, 0x1122 }
+        << QList<quint16>{ 0x7788, 0x5566, 0x3344, 0x1122 }
+        << QList<quint16>{ 0x0000, 0x3f80 };
+    QTest::newRow("DCBA") << QModbusDataUnit::ByteOrder::LittleEndian
+        << QList<quint16>{ 0x4433, 0x2211 }
+        << QList<quint16>{ 0x8877, 0x6655, 0x4433, 0x2211 }
+        << QList<quint16>{ 0x0000, 0x803f };
+}
+
+void tst_QModbusDataUnit::typedValues()
+{
+    QFETCH(QModbusDataUnit::ByteOrder, order);
+    QFETCH(QList<quint16>, int32Registers);
+    QFETCH(QList<quint16>, int64Registers);
+    QFETCH(QList<quint16>, floatRegisters);
+
+    QModbusDataUnit unit(QModbusDataUnit::HoldingRegisters, 0, int32Registers);
+    qint32 int32 = 0;
+    QVERIFY(unit.decodeValues(0, &int32, 1, order));
+    QCOMPARE(int32, qint32(0x11223344));
+
+    unit.setValues(int64Registers);
+    qint64 int64 = 0;
+    QVERIFY(unit.decodeValues(0, &int64, 1, order));
+    QCOMPARE(int64, Q_INT64_C(0x1122334455667788));
+
+    unit.setValues(floatRegisters);
+    float real = 0.0f;
+    QVERIFY(unit.decodeValues(0, &real, 1, order));
+    QCOMPARE(real, 1.0f);
+
+    // Encoding gives the registers back, growing the unit as needed.
+    QModbusDataUnit encoded(QModbusDataUnit::HoldingRegisters);
+    QVERIFY(encoded.encodeValues(1, &int32, 1, order));
+    QCOMPARE(encoded.valueCount(), 3);
+    QCOMPARE(encoded.values(), QList<quint16>{ 0 } + int32Registers);
+
+    encoded = QModbusDataUnit(QModbusDataUnit::HoldingRegisters);
+    QVERIFY(encoded.encodeValues(0, &int64, 1, order));
+    QCOMPARE(encoded.values(), int64Registers);
+
+    encoded = QModbusDataUnit(QModbusDataUnit::HoldingRegisters);
+    QVERIFY(encoded.encodeValues(0, &real, 1, order));
+    QCOMPARE(encoded.values(), floatRegisters);
+}
+
+void tst_QModbusDataUnit::typedValuesBulk()
+{
+    QList<double> doubles;
+    QList<qint32> integers;
+    for (int i = 0; i < 100; ++i) {
+        doubles.append(i * -1.25e10 + 0.5);
+        integers.append(i * -65537);
+    }
+
+    for (auto order : { QModbusDataUnit::ByteOrder::BigEndian,
+                        QModbusDataUnit::ByteOrder::BigEndianByteSwap,
+                        QModbusDataUnit::ByteOrder::LittleEndianByteSwap,
+                        QModbusDataUnit::ByteOrder::LittleEndian }) {
+        QModbusDataUnit unit(QModbusDataUnit::InputRegisters, 0, 4);
+        QVERIFY(unit.encodeValues(4, doubles.constData(), doubles.size(), order));
+        QVERIFY(unit.encodeValues(404, integers.constData(), integers.size(), order));
+        QCOMPARE(unit.valueCount(), 604);
+        QCOMPARE(unit.values().size(), 604);
+
+        QList<double> decodedDoubles(doubles.size());
+        QVERIFY(unit.decodeValues(4, decodedDoubles.data(), decodedDoubles.size(), order));
+        QCOMPARE(decodedDoubles, doubles);
+
+        QList<qint32> decodedIntegers(integers.size());
+        QVERIFY(unit.decodeValues(404, decodedIntegers.data(), decodedIntegers.size(), order));
+        QCOMPARE(decodedIntegers, integers);
+    }
+}
+
+void tst_QModbusDataUnit::typedValuesBounds()
+{
+    QModbusDataUnit unit(QModbusDataUnit::HoldingRegisters, 0, 5);
+    qint64 int64[2] = { 7, 7 };
+    QVERIFY(unit.decodeValues(1, int64, 1));
+    QVERIFY(!unit.decodeValues(2, int64, 1));
+    QVERIFY(!unit.decodeValues(0, int64, 2));
+    QVERIFY(!unit.decodeValues(-1, int64, 1));
+    QVERIFY(!unit.decodeValues(0, int64, -1));
+    QVERIFY(unit.decodeValues(5, int64, 0));
+    QCOMPARE(int64[1], Q_INT64_C(7));
+
+    QVERIFY(!unit.encodeValues(-1, int64, 1));
+    QVERIFY(!unit.encodeValues(0, int64, -1));
+    QCOMPARE(unit.valueCount(), 5);
+}
+
 QTEST_MAIN(tst_QModbusDataUnit)
 
 #include "tst_qmodbusdataunit.moc"
@@ -0,0 +1,184 @@
+// Copyright (C) 2023 The Qt Company Ltd.
+// SPDX-License-Identifier: LicenseRef-Qt-Commercial OR LGPL-3.0-only OR GPL-2.0-only OR GPL-3.0-only
+
+#include <QtSerialBus/qmodbusgateway.h>
+#include <QtSerialBus/qmodbusrtuserialclient.h>
+#include <QtSerialBus/qmodbustcpclient.h>
+#include <QtSerialBus/qmodbustcpserver.h>
+
+#include <QtCore/qsocketnotifier.h>
+#include <QtNetwork/qtcpsocket.h>
+#include <QtTest/QtTest>
+
+#include "qlocaltcpport_helpers.h"
+#include "qmodbuspseudoterminal_helpers.h"
+
+static QByteArray readHoldingRegisterRequest(quint16 transactionId, quint8 unitId,
+                                             quint16 address)
+{
+    QByteArray request;
+    QDataStream output(&request, QIODevice::WriteOnly);
+    output << transactionId << quint16(0) << quint16(6) << unitId
+           << quint8(QModbusPdu::ReadHoldingRegisters) << address << quint16(1);
+    return request;
+}
+
+class tst_QModbusGateway : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void testLines()
+    {
+        QModbusGateway gateway;
+        QVERIFY(gateway.server());
+        QCOMPARE(gateway.maximumQueueSize(), 16);
+        gateway.setMaximumQueueSize(0);
+        QCOMPARE(gateway.maximumQueueSize(), 16);
+        gateway.setMaximumQueueSize(4);
+        QCOMPARE(gateway.maximumQueueSize(), 4);
+
+        QModbusTcpClient first;
+        auto second = new QModbusTcpClient;
+
+        QVERIFY(!gateway.addLine(nullptr, { 1 }));
+        QVERIFY(gateway.addLine(&first, { 1, 2 }));
+        QVERIFY(!gateway.addLine(&first, { 3 }));
+        QVERIFY(!gateway.addLine(second, { 2, 3 }));
+        QVERIFY(!gateway.addLine(second, { 256 }));
+        QVERIFY(gateway.addLine(second, { 3 }));
+
+        QCOMPARE(gateway.lines(), QList<QModbusClient *>({ &first, second }));
+        QCOMPARE(gateway.line(1), &first);
+        QCOMPARE(gateway.line(2), &first);
+        QCOMPARE(gateway.line(3), second);
+        QCOMPARE(gateway.line(4), nullptr);
+
+        delete second;
+        QCOMPARE(gateway.lines(), QList<QModbusClient *>({ &first }));
+        QCOMPARE(gateway.line(3), nullptr);
+
+        gateway.removeLine(&first);
+        QVERIFY(gateway.lines().isEmpty());
+        QCOMPARE(gateway.line(1), nullptr);
+    }
+
+    void testForwardToPseudoTerminal()
+    {
+#ifndef QMODBUS_HAS_PSEUDOTERMINAL
+        QSKIP("Pseudo-terminals are not available on this platform.");
+#else
+        ModbusPseudoTerminal terminal;
+        QVERIFY(terminal.open());
+
+        // The simulated device answers unit 5 with the requested address as the register
+        // value and ignores every other unit.
+        QByteArray received;
+        QList<quint16> servedAddresses;
+        QSocketNotifier notifier(terminal.controllerDescriptor(), QSocketNotifier::Read);
+        connect(&notifier, &QSocketNotifier::activated, this, [&]() {
+            received += terminal.read();
+            while (received.size() >= 8) {
+                const QByteArray frame = received.left(8);
+                received.remove(0, 8);
+                if (modbusRtuFrame(frame.left(6)) != frame || frame.at(0) != 5)
+                    continue;
+                const quint16 address = quint16((quint8(frame.at(2)) << 8) | quint8(frame.at(3)));
+                servedAddresses.append(address);
+                terminal.write(modbusRtuFrame(QByteArray::fromHex("050302")
+                    + char(address >> 8) + char(address & 0xff)));
+            }
+        });
+
+        QModbusRtuSerialClient line;
+        line.setConnectionParameter(QModbusDevice::SerialPortNameParameter, terminal.portName());
+        line.setConnectionParameter(QModbusDevice::SerialBaudRateParameter, 115200);
+        line.setTimeout(200);
+        line.setNumberOfRetries(0);
+        QVERIFY(line.connectDevice());
+
+        QModbusGateway gateway;
+        QVERIFY(gateway.addLine(&line, { 5, 6 }));
+        const quint16 port = connectToFreeLocalTcpPort(gateway.server());
+        QVERIFY(port);
+
+        QTcpSocket first, second;
+        first.connectToHost(QHostAddress::LocalHost, port);
+        second.connectToHost(QHostAddress::LocalHost, port);
+        QVERIFY(first.waitForConnected(5000));
+        QVERIFY(second.waitForConnected(5000));
+
+        // Both connections pipeline three requests, using the same transaction identifiers.
+        for (quint16 i = 0; i < 3; ++i) {
+            first.write(readHoldingRegisterRequest(i, 5, i));
+            second.write(readHoldingRegisterRequest(i, 5, 10 + i));
+        }
+
+        QTRY_COMPARE_WITH_TIMEOUT(first.bytesAvailable(), qint64(3 * 11), 10000);
+        QTRY_COMPARE_WITH_TIMEOUT(second.bytesAvailable(), qint64(3 * 11), 10000);
+        QCOMPARE(servedAddresses.size(), 6);
+
+        // The connections take turns on the line, the second one is not starved.
+        QVERIFY(servedAddresses.indexOf(10) < servedAddresses.indexOf(2));
+
+        for (QTcpSocket *socket : { &first, &second }) {
+            QDataStream input(socket->readAll());
+            for (int i = 0; i < 3; ++i) {
+                quint16 transactionId, protocolId, length, value;
+                quint8 unitId, functionCode, byteCount;
+                input >> transactionId >> protocolId >> length >> unitId >> functionCode
+                      >> byteCount >> value;
+                QCOMPARE(transactionId, quint16(i));
+                QCOMPARE(protocolId, quint16(0));
+                QCOMPARE(length, quint16(5));
+                QCOMPARE(unitId, quint8(5));
+                QCOMPARE(functionCode, quint8(QModbusPdu::ReadHoldingRegisters));
+                QCOMPARE(byteCount, quint8(2));
+                QCOMPARE(value, quint16((socket == &first ? 0 : 10) + i));
+            }
+        }
+
+        // Unit 6 is routed to the line, but does not answer.
+        first.write(readHoldingRegisterRequest(42, 6, 0));
+        QTRY_COMPARE_WITH_TIMEOUT(first.bytesAvailable(), qint64(9), 5000);
+        QDataStream input(first.readAll());
+        quint16 transactionId, protocolId, length;
+        quint8 unitId, functionCode, exceptionCode;
+        input >> transactionId >> protocolId >> length >> unitId >> functionCode >> exceptionCode;
+        QCOMPARE(transactionId, quint16(42));
+        QCOMPARE(unitId, quint8(6));
+        QCOMPARE(functionCode,
+                 quint8(QModbusPdu::ReadHoldingRegisters | QModbusPdu::ExceptionByte));
+        QCOMPARE(exceptionCode,
+                 quint8(QModbusExceptionResponse::GatewayTargetDeviceFailedToRespond));
+
+        gateway.server()->disconnectDevice();
+        line.disconnectDevice();
+#endif
+    }
+
+    void testLineUnavailable()
+    {
+        QModbusTcpClient line; // never connected
+        QModbusGateway gateway;
+        QVERIFY(gateway.addLine(&line, { 7 }));
+        const quint16 port = connectToFreeLocalTcpPort(gateway.server());
+        QVERIFY(port);
+
+        QTcpSocket socket;
+        socket.connectToHost(QHostAddress::LocalHost, port);
+        QVERIFY(socket.waitForConnected(5000));
+        socket.write(readHoldingRegisterRequest(1, 7, 0));
+        QTRY_COMPARE(socket.bytesAvailable(), qint64(9));
+
+        const QByteArray response = socket.readAll();
+        QCOMPARE(quint8(response.at(7)),
+                 quint8(QModbusPdu::ReadHoldingRegisters | QModbusPdu::ExceptionByte));
+        QCOMPARE(quint8(response.at(8)), quint8(QModbusExceptionResponse::GatewayPathUnavailable));
+        gateway.server()->disconnectDevice();
+    }
+};
+
+QTEST_MAIN(tst_QModbusGateway)
+
+#include "tst_qmodbusgateway.moc"
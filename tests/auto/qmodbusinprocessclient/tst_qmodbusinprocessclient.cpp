@@ -0,0 +1,218 @@
+// Copyright (C) 2023 The Qt Company Ltd.
+// SPDX-License-Identifier: LicenseRef-Qt-Commercial OR LGPL-3.0-only OR GPL-2.0-only OR GPL-3.0-only
+
+#include <QtSerialBus/qmodbusinprocessclient.h>
+#include <QtSerialBus/qmodbustcpserver.h>
+#include <QtSerialBus/private/qmodbusinprocessclient_p.h>
+
+#include <QtCore/qelapsedtimer.h>
+#include <QtTest/QtTest>
+
+static void setupServer(QModbusServer *server, int serverAddress)
+{
+    QModbusDataUnitMap map;
+    map.insert(QModbusDataUnit::HoldingRegisters, { QModbusDataUnit::HoldingRegisters, 0, 10 });
+    server->setMap(map);
+    server->setServerAddress(serverAddress);
+}
+
+static bool isScheduleEmpty(QModbusInProcessClient *client)
+{
+    const auto d = static_cast<QModbusInProcessClientPrivate *>(QObjectPrivate::get(client));
+    return d->m_schedule.empty() && d->m_scheduled.isEmpty();
+}
+
+class tst_QModbusInProcessClient : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void testServers()
+    {
+        QModbusInProcessClient client;
+        QCOMPARE(client.latency(), 0);
+        QCOMPARE(client.jitter(), 0);
+        client.setLatency(-1);
+        client.setJitter(-1);
+        QCOMPARE(client.latency(), 0);
+        QCOMPARE(client.jitter(), 0);
+
+        QModbusTcpServer first;
+        auto second = new QModbusTcpServer;
+        QVERIFY(!client.addServer(nullptr));
+        QVERIFY(client.addServer(&first));
+        QVERIFY(!client.addServer(&first));
+        QVERIFY(client.addServer(second));
+        QCOMPARE(client.servers(), QList<QModbusServer *>({ &first, second }));
+
+        delete second;
+        QCOMPARE(client.servers(), QList<QModbusServer *>({ &first }));
+        client.removeServer(&first);
+        QVERIFY(client.servers().isEmpty());
+    }
+
+    void testReadWrite()
+    {
+        QModbusTcpServer server;
+        setupServer(&server, 1);
+        QVERIFY(server.setData(QModbusDataUnit::HoldingRegisters, 3, 0x1234));
+
+        QModbusInProcessClient client;
+        QVERIFY(client.addServer(&server));
+        QVERIFY(client.connectDevice());
+        QCOMPARE(client.state(), QModbusDevice::ConnectedState);
+
+        QModbusResult read;
+        bool finished = false;
+        QVERIFY(client.sendReadRequest({ QModbusDataUnit::HoldingRegisters, 3, 1 }, 1, this,
+                                       [&](const QModbusResult &result) {
+            read = result;
+            finished = true;
+        }));
+        // The response is delivered through the event loop.
+        QVERIFY(!finished);
+        QTRY_VERIFY(finished);
+        QCOMPARE(read.error(), QModbusDevice::NoError);
+        QCOMPARE(read.result().value(0), quint16(0x1234));
+
+        QModbusReply *reply = client.sendWriteRequest(
+            { QModbusDataUnit::HoldingRegisters, 4, QList<quint16>{ 7, 8 } }, 1);
+        QVERIFY(reply);
+        QTRY_VERIFY(reply->isFinished());
+        QCOMPARE(reply->error(), QModbusDevice::NoError);
+        quint16 value = 0;
+        QVERIFY(server.data(QModbusDataUnit::HoldingRegisters, 5, &value));
+        QCOMPARE(value, quint16(8));
+        delete reply;
+
+        // Exception responses are passed on.
+        reply = client.sendReadRequest({ QModbusDataUnit::HoldingRegisters, 9, 5 }, 1);
+        QVERIFY(reply);
+        QTRY_VERIFY(reply->isFinished());
+        QCOMPARE(reply->error(), QModbusDevice::ProtocolError);
+        QVERIFY(reply->rawResult().isException());
+        delete reply;
+
+        const QModbusClientMetrics::Entry total = client.metrics().aggregate(1);
+        QCOMPARE(total.requests, 3u);
+        QCOMPARE(total.responses, 3u);
+        QCOMPARE(total.exceptions, 1u);
+
+        // The response timeouts of answered requests do not stay scheduled.
+        QVERIFY(isScheduleEmpty(&client));
+    }
+
+    void testUnknownServer()
+    {
+        QModbusTcpServer server;
+        setupServer(&server, 1);
+
+        QModbusInProcessClient client;
+        client.setTimeout(50);
+        client.setNumberOfRetries(1);
+        QVERIFY(client.addServer(&server));
+        QVERIFY(client.connectDevice());
+
+        QModbusReply *reply = client.sendReadRequest({ QModbusDataUnit::HoldingRegisters, 0, 1 },
+                                                     2);
+        QVERIFY(reply);
+        QTRY_VERIFY(reply->isFinished());
+        QCOMPARE(reply->error(), QModbusDevice::TimeoutError);
+        delete reply;
+
+        const QModbusClientMetrics::Entry total = client.metrics().aggregate(2);
+        QCOMPARE(total.retries, 1u);
+        QCOMPARE(total.timeouts, 1u);
+        QVERIFY(isScheduleEmpty(&client));
+    }
+
+    void testBroadcast()
+    {
+        QModbusTcpServer first;
+        setupServer(&first, 1);
+        QModbusTcpServer second;
+        setupServer(&second, 2);
+        QModbusDataUnitMap map;
+        map.insert(QModbusDataUnit::HoldingRegisters, { QModbusDataUnit::HoldingRegisters, 0, 10 });
+        QVERIFY(second.addServerAddress(3, map));
+
+        QModbusInProcessClient client;
+        QVERIFY(client.addServer(&first));
+        QVERIFY(client.addServer(&second));
+        QVERIFY(client.connectDevice());
+
+        QModbusReply *reply = client.sendWriteRequest(
+            { QModbusDataUnit::HoldingRegisters, 2, QList<quint16>{ 42 } }, 0);
+        QVERIFY(reply);
+        QCOMPARE(reply->type(), QModbusReply::Broadcast);
+        QTRY_VERIFY(reply->isFinished());
+        QCOMPARE(reply->error(), QModbusDevice::NoError);
+        delete reply;
+
+        for (QModbusServer *server : { &first, &second }) {
+            quint16 value = 0;
+            QVERIFY(server->data(QModbusDataUnit::HoldingRegisters, 2, &value));
+            QCOMPARE(value, quint16(42));
+        }
+
+        // Every unit hosted by a server processes the broadcast.
+        QModbusDataUnit unit(QModbusDataUnit::HoldingRegisters, 2, 1);
+        QVERIFY(second.data(3, &unit));
+        QCOMPARE(unit.value(0), quint16(42));
+    }
+
+    void testLatency()
+    {
+        QModbusTcpServer server;
+        setupServer(&server, 1);
+
+        QModbusInProcessClient client;
+        client.setLatency(20);
+        client.setJitter(10);
+        QVERIFY(client.addServer(&server));
+        QVERIFY(client.connectDevice());
+
+        QElapsedTimer elapsed;
+        elapsed.start();
+        QModbusReply *reply = client.sendReadRequest({ QModbusDataUnit::HoldingRegisters, 0, 1 },
+                                                     1);
+        QVERIFY(reply);
+        QTRY_VERIFY(reply->isFinished());
+        QCOMPARE(reply->error(), QModbusDevice::NoError);
+        QVERIFY(elapsed.elapsed() >= 40);
+        delete reply;
+
+        // A response arriving after the timeout is dropped.
+        client.setTimeout(20);
+        client.setNumberOfRetries(0);
+        reply = client.sendReadRequest({ QModbusDataUnit::HoldingRegisters, 0, 1 }, 1);
+        QVERIFY(reply);
+        QTRY_VERIFY(reply->isFinished());
+        QCOMPARE(reply->error(), QModbusDevice::TimeoutError);
+        delete reply;
+    }
+
+    void testCloseAbortsRequests()
+    {
+        QModbusTcpServer server;
+        setupServer(&server, 1);
+
+        QModbusInProcessClient client;
+        client.setLatency(1000);
+        QVERIFY(client.addServer(&server));
+        QVERIFY(client.connectDevice());
+
+        QModbusReply *reply = client.sendReadRequest({ QModbusDataUnit::HoldingRegisters, 0, 1 },
+                                                     1);
+        QVERIFY(reply);
+        client.disconnectDevice();
+        QCOMPARE(client.state(), QModbusDevice::UnconnectedState);
+        QVERIFY(reply->isFinished());
+        QCOMPARE(reply->error(), QModbusDevice::ReplyAbortedError);
+        delete reply;
+    }
+};
+
+QTEST_MAIN(tst_QModbusInProcessClient)
+
+#include "tst_qmodbusinprocessclient.moc"
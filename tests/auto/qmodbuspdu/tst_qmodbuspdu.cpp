@@ -3,6 +3,7 @@
 
 #include <QtCore/qdebug.h>
 #include <QtSerialBus/qmodbuspdu.h>
+#include <private/qmodbuspdubuffer_p.h>
 
 #include <QtTest/QtTest>
 
@@ -830,6 +831,166 @@ private slots:
         const QModbusRequest wmrRequest(QModbusPdu::WriteMultipleRegisters, longData);
         QCOMPARE(QModbusRequest::calculateDataSize(wmrRequest), 1 + longData.size());
     }
+
+    void testPduViewSizes()
+    {
+        static_assert(QModbusPduView::minimumDataSize(QModbusPdu::ReadHoldingRegisters,
+                                                      QModbusPduView::Request) == 4);
+        static_assert(QModbusPduView::minimumDataSize(QModbusPdu::ReadHoldingRegisters,
+                                                      QModbusPduView::Response) == 3);
+        static_assert(QModbusPduView::minimumDataSize(0x83, QModbusPduView::Response) == 1);
+        static_assert(QModbusPduView::minimumDataSize(0x42, QModbusPduView::Request) == -1);
+
+        static constexpr char frame[] = { 0x10, 0x00, 0x01, 0x00, 0x02, 0x04, 0x00, 0x0a, 0x01, 0x02 };
+        constexpr QModbusPduView request = QModbusPduView::fromRawPdu(frame, sizeof(frame));
+        static_assert(request.functionCode() == QModbusPdu::WriteMultipleRegisters);
+        static_assert(request.calculateDataSize(QModbusPduView::Request) == 9);
+        static_assert(QModbusPduView::fromRawPdu(frame, 5).calculateDataSize(
+                          QModbusPduView::Request) == -1);
+    }
+
+    void testDataSizes_data()
+    {
+        QTest::addColumn<quint8>("code");
+        QTest::addColumn<QByteArray>("data");
+        QTest::addColumn<int>("requestMinimum");
+        QTest::addColumn<int>("responseMinimum");
+        QTest::addColumn<int>("requestSize");
+        QTest::addColumn<int>("responseSize");
+
+        // The sizes the PDU classes calculated before the tables were introduced.
+        const QByteArray sample = QByteArray::fromHex("0400020001020304");
+        QTest::newRow("Invalid") << quint8(0x00) << sample << -1 << -1 << -1 << -1;
+        QTest::newRow("ReadCoils") << quint8(0x01) << sample << 4 << 2 << 4 << 5;
+        QTest::newRow("ReadCoils empty") << quint8(0x01) << QByteArray() << 4 << 2 << 4 << -1;
+        QTest::newRow("ReadDiscreteInputs") << quint8(0x02) << sample << 4 << 2 << 4 << 5;
+        QTest::newRow("ReadHoldingRegisters") << quint8(0x03) << sample << 4 << 3 << 4 << 5;
+        QTest::newRow("ReadInputRegisters") << quint8(0x04) << sample << 4 << 3 << 4 << 5;
+        QTest::newRow("WriteSingleCoil") << quint8(0x05) << sample << 4 << 4 << 4 << 4;
+        QTest::newRow("WriteSingleRegister") << quint8(0x06) << sample << 4 << 4 << 4 << 4;
+        QTest::newRow("ReadExceptionStatus") << quint8(0x07) << sample << 0 << 1 << 0 << 1;
+        QTest::newRow("Diagnostics") << quint8(0x08) << sample << 4 << 4 << 4 << 4;
+        QTest::newRow("GetCommEventCounter") << quint8(0x0b) << sample << 0 << 4 << 0 << 4;
+        QTest::newRow("GetCommEventLog") << quint8(0x0c) << sample << 0 << 8 << 0 << 5;
+        QTest::newRow("WriteMultipleCoils") << quint8(0x0f) << QByteArray::fromHex("0013000a02cd01")
+            << 6 << 4 << 7 << 4;
+        QTest::newRow("WriteMultipleCoils empty") << quint8(0x0f) << QByteArray()
+            << 6 << 4 << -1 << 4;
+        QTest::newRow("WriteMultipleRegisters") << quint8(0x10)
+            << QByteArray::fromHex("0001000204000a0102") << 7 << 4 << 9 << 4;
+        QTest::newRow("ReportServerId") << quint8(0x11) << sample << 0 << 3 << 0 << 5;
+        QTest::newRow("ReadFileRecord") << quint8(0x14) << sample << 8 << 5 << 5 << 5;
+        QTest::newRow("WriteFileRecord") << quint8(0x15) << sample << 10 << 10 << 5 << 5;
+        QTest::newRow("MaskWriteRegister") << quint8(0x16) << sample << 6 << 6 << 6 << 6;
+        QTest::newRow("ReadWriteMultipleRegisters") << quint8(0x17)
+            << QByteArray::fromHex("00030006000000030600ff00ff00ff") << 11 << 3 << 15 << 1;
+        QTest::newRow("ReadWriteMultipleRegisters short") << quint8(0x17) << sample
+            << 11 << 3 << -1 << 5;
+        QTest::newRow("ReadFifoQueue") << quint8(0x18) << QByteArray::fromHex("0006000204d20929")
+            << 2 << 6 << 2 << 8;
+        QTest::newRow("EncapsulatedInterfaceTransport") << quint8(0x2b) << sample
+            << 2 << 2 << 2 << 2;
+        QTest::newRow("ReadDeviceIdentification short") << quint8(0x2b)
+            << QByteArray::fromHex("0e010100000102") << 2 << 2 << 3 << 8;
+        QTest::newRow("ReadDeviceIdentification one object") << quint8(0x2b)
+            << QByteArray::fromHex("0e01010000010003414243") << 2 << 2 << 3 << 11;
+        QTest::newRow("ReadDeviceIdentification two objects") << quint8(0x2b)
+            << QByteArray::fromHex("0e010100000200014101024243") << 2 << 2 << 3 << 13;
+        QTest::newRow("Undefined") << quint8(0x42) << sample << -1 << -1 << -1 << -1;
+        QTest::newRow("Exception") << quint8(0x83) << sample << 1 << 1 << 1 << 1;
+    }
+
+    void testDataSizes()
+    {
+        QFETCH(quint8, code);
+        QFETCH(QByteArray, data);
+        QFETCH(int, requestMinimum);
+        QFETCH(int, responseMinimum);
+        QFETCH(int, requestSize);
+        QFETCH(int, responseSize);
+
+        const QModbusRequest request(QModbusPdu::FunctionCode(code), data);
+        const QModbusResponse response(QModbusPdu::FunctionCode(code), data);
+
+        QCOMPARE(QModbusPduView::minimumDataSize(code, QModbusPduView::Request), requestMinimum);
+        QCOMPARE(QModbusPduView::minimumDataSize(code, QModbusPduView::Response),
+                 responseMinimum);
+        QCOMPARE(QModbusPduView(request).expectedDataSize(QModbusPduView::Request), requestSize);
+        QCOMPARE(QModbusPduView(response).expectedDataSize(QModbusPduView::Response),
+                 responseSize);
+
+        QCOMPARE(QModbusRequest::minimumDataSize(request), requestMinimum);
+        QCOMPARE(QModbusResponse::minimumDataSize(response), responseMinimum);
+        QCOMPARE(QModbusRequest::calculateDataSize(request), requestSize);
+        QCOMPARE(QModbusResponse::calculateDataSize(response), responseSize);
+    }
+
+    void testPduViewDecode()
+    {
+        const QModbusResponse response(QModbusPdu::ReadHoldingRegisters,
+                                       QByteArray::fromHex("04000a0102"));
+        const QModbusPduView view(response);
+        QCOMPARE(view.rawFunctionCode(), quint8(0x03));
+        QCOMPARE(view.dataSize(), 5);
+        QCOMPARE(view.wordAt(1), quint16(0x000a));
+        QCOMPARE(view.wordAt(3), quint16(0x0102));
+
+        quint8 count = 0;
+        quint16 first = 0, second = 0, third = 0xffff;
+        QVERIFY(view.decode(&count, &first, &second));
+        QCOMPARE(count, quint8(4));
+        QCOMPARE(first, quint16(0x000a));
+        QCOMPARE(second, quint16(0x0102));
+        QVERIFY(!view.decode(&count, &first, &second, &third));
+        QCOMPARE(third, quint16(0));
+
+        // Same result as decoding through the PDU.
+        quint8 pduCount = 0;
+        quint16 pduFirst = 0, pduSecond = 0, pduThird = 0xffff;
+        response.decodeData(&pduCount, &pduFirst, &pduSecond, &pduThird);
+        QCOMPARE(pduCount, count);
+        QCOMPARE(pduFirst, first);
+        QCOMPARE(pduSecond, second);
+        QCOMPARE(pduThird, third);
+
+        char out[6];
+        QCOMPARE(view.copyTo(out), 6);
+        QCOMPARE(QByteArray(out, 6), QByteArray::fromHex("0304000a0102"));
+    }
+
+    void testPduBuffer()
+    {
+        const QList<quint16> values { 0x000a, 0x0102 };
+        QModbusPduBuffer buffer(QModbusPdu::WriteMultipleRegisters, quint16(1), quint16(2),
+                                quint8(4));
+        buffer.append(values);
+        QVERIFY(!buffer.hasOverflow());
+        QCOMPARE(buffer.size(), 10);
+
+        const QModbusRequest request(QModbusPdu::WriteMultipleRegisters, quint16(1), quint16(2),
+                                     quint8(4), values);
+        const QModbusRequest built = buffer.toPdu<QModbusRequest>();
+        QCOMPARE(built.functionCode(), request.functionCode());
+        QCOMPARE(built.data(), request.data());
+        QCOMPARE(buffer.view().calculateDataSize(QModbusPduView::Request),
+                 QModbusRequest::calculateDataSize(request));
+
+        buffer.encodeData(quint8(0x02));
+        buffer.setRawFunctionCode(0x83);
+        const QModbusResponse exception = buffer.toPdu<QModbusResponse>();
+        QVERIFY(exception.isException());
+        QCOMPARE(exception.functionCode(), QModbusPdu::ReadHoldingRegisters);
+        QCOMPARE(exception.exceptionCode(), QModbusPdu::IllegalDataAddress);
+
+        buffer.clear();
+        for (int i = 0; i < QModbusPduBuffer::MaxDataSize / 2; ++i)
+            buffer.append(quint16(i));
+        QVERIFY(!buffer.hasOverflow());
+        QCOMPARE(buffer.size(), 253);
+        buffer.append(quint8(0));
+        QVERIFY(buffer.hasOverflow());
+        QCOMPARE(buffer.size(), 253);
+    }
 };
 
 QTEST_MAIN(tst_QModbusPdu)
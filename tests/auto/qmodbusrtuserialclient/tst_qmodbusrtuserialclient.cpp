@@ -3,8 +3,12 @@
 
 #include <QtSerialBus/qmodbusrtuserialclient.h>
 
+#include <QtCore/qsocketnotifier.h>
+#include <QtSerialPort/qserialport.h>
 #include <QtTest/QtTest>
 
+#include "qmodbuspseudoterminal_helpers.h"
+
 class tst_QModbusRtuSerialClient : public QObject
 {
     Q_OBJECT
@@ -21,6 +25,100 @@ private slots:
         qmrsm.setInterFrameDelay(-1);
         QCOMPARE(qmrsm.interFrameDelay(), 2000);
     }
+
+    void testLowLatencyInterFrameDelay()
+    {
+        QModbusRtuSerialClient client;
+        QVERIFY(!client.isLowLatencyEnabled());
+
+        // 3.5 characters of 11 bits at 19200 baud are 2005.2 microseconds.
+        client.setLowLatencyEnabled(true);
+        QVERIFY(client.isLowLatencyEnabled());
+        QCOMPARE(client.interFrameDelay(), 2006);
+
+        client.setConnectionParameter(QModbusDevice::SerialBaudRateParameter, 115200);
+        client.setInterFrameDelay(-1);
+        QCOMPARE(client.interFrameDelay(), 335);
+        client.setInterFrameDelay(1000);
+        QCOMPARE(client.interFrameDelay(), 1000);
+        client.setInterFrameDelay(100);
+        QCOMPARE(client.interFrameDelay(), 335);
+
+        // Without parity, a character has 10 bits.
+        client.setConnectionParameter(QModbusDevice::SerialParityParameter,
+                                      QSerialPort::NoParity);
+        client.setInterFrameDelay(-1);
+        QCOMPARE(client.interFrameDelay(), 304);
+
+        client.setLowLatencyEnabled(false);
+        QCOMPARE(client.interFrameDelay(), 2000);
+    }
+
+    void testInterFrameSilence_data()
+    {
+        QTest::addColumn<bool>("lowLatency");
+        QTest::newRow("fixed delay") << false;
+        QTest::newRow("low latency") << true;
+    }
+
+    void testInterFrameSilence()
+    {
+#ifndef QMODBUS_HAS_PSEUDOTERMINAL
+        QSKIP("Pseudo-terminals are not available on this platform.");
+#else
+        QFETCH(bool, lowLatency);
+
+        ModbusPseudoTerminal terminal;
+        QVERIFY(terminal.open());
+
+        QModbusRtuSerialClient client;
+        client.setConnectionParameter(QModbusDevice::SerialPortNameParameter,
+                                      terminal.portName());
+        client.setConnectionParameter(QModbusDevice::SerialBaudRateParameter, 115200);
+        client.setLowLatencyEnabled(lowLatency);
+        client.setTimeout(1000);
+        client.setNumberOfRetries(0);
+        QVERIFY(client.connectDevice());
+        const int interFrameDelay = client.interFrameDelay();
+        QCOMPARE(interFrameDelay, lowLatency ? 335 : 2000);
+
+        // The simulated server answers right away and measures the silence on the line
+        // between its response and the next request.
+        QByteArray received;
+        QElapsedTimer silence;
+        QList<qint64> silences;
+        QSocketNotifier notifier(terminal.controllerDescriptor(), QSocketNotifier::Read);
+        connect(&notifier, &QSocketNotifier::activated, this, [&]() {
+            const qint64 elapsed = silence.isValid() ? silence.nsecsElapsed() : -1;
+            received += terminal.read();
+            while (received.size() >= 8) {
+                received.remove(0, 8);
+                if (elapsed >= 0)
+                    silences.append(elapsed);
+                terminal.write(modbusRtuFrame(QByteArray::fromHex("0103020000")));
+                silence.start();
+            }
+        });
+
+        const int count = 20;
+        QList<QModbusReply *> replies;
+        for (int i = 0; i < count; ++i) {
+            replies.append(client.sendReadRequest(
+                QModbusDataUnit(QModbusDataUnit::HoldingRegisters, i, 1), 1));
+        }
+        for (QModbusReply *reply : std::as_const(replies)) {
+            QTRY_VERIFY_WITH_TIMEOUT(reply->isFinished(), 5000);
+            QCOMPARE(reply->error(), QModbusDevice::NoError);
+        }
+
+        QCOMPARE(silences.size(), count - 1);
+        for (qint64 measured : std::as_const(silences))
+            QVERIFY2(measured >= qint64(interFrameDelay) * 1000, QByteArray::number(measured));
+
+        qDeleteAll(replies);
+        client.disconnectDevice();
+#endif
+    }
 };
 
 QTEST_MAIN(tst_QModbusRtuSerialClient)
@@ -9,8 +9,12 @@
 #include <QtSerialBus/qmodbusdeviceidentification.h>
 
 #include <QtCore/qdebug.h>
+#include <QtNetwork/qtcpsocket.h>
 #include <QtTest/QtTest>
 
+#include "qlocaltcpport_helpers.h"
+#include "qmodbuspseudoterminal_helpers.h"
+
 class TestServer : public QModbusServer
 {
 public:
@@ -1200,6 +1204,313 @@ private slots:
         QCOMPARE(local.processRequest(request).exceptionCode(), QModbusPdu::IllegalFunction);
     }
 
+    void testCoalescedDataWritten()
+    {
+        TestServer local;
+        QModbusDataUnitMap map;
+        map.insert(QModbusDataUnit::Coils, { QModbusDataUnit::Coils, 0, 10 });
+        map.insert(QModbusDataUnit::HoldingRegisters, { QModbusDataUnit::HoldingRegisters, 0, 40 });
+        local.setMap(map);
+        QCOMPARE(local.coalescingInterval(), -1);
+
+        QSignalSpy writtenSpy(&local, &QModbusServer::dataWritten);
+        QSignalSpy coalescedSpy(&local, &QModbusServer::dataWrittenCoalesced);
+
+        local.setCoalescingInterval(0);
+        QCOMPARE(local.coalescingInterval(), 0);
+
+        local.setData(QModbusDataUnit::HoldingRegisters, 10, 1u);
+        local.setData(QModbusDataUnit::HoldingRegisters, 11, 2u);
+        local.setData(QModbusDataUnit::HoldingRegisters, 10, 3u);
+        local.setData(QModbusDataUnit::HoldingRegisters, 20, 4u);
+        local.setData(QModbusDataUnit::Coils, 5, true);
+        local.setData(QModbusDataUnit::HoldingRegisters, 12, 5u);
+        local.setData(QModbusDataUnit::HoldingRegisters, 12, 5u); // no change
+
+        QCOMPARE(writtenSpy.size(), 0);
+        QCOMPARE(coalescedSpy.size(), 0);
+        QTRY_COMPARE(coalescedSpy.size(), 1);
+
+        const auto ranges = coalescedSpy.at(0).at(0).value<QList<QModbusDataUnit>>();
+        QCOMPARE(ranges.size(), 3);
+        QCOMPARE(ranges.at(0).registerType(), QModbusDataUnit::Coils);
+        QCOMPARE(ranges.at(0).startAddress(), 5);
+        QCOMPARE(ranges.at(0).valueCount(), 1);
+        QCOMPARE(ranges.at(1).registerType(), QModbusDataUnit::HoldingRegisters);
+        QCOMPARE(ranges.at(1).startAddress(), 10);
+        QCOMPARE(ranges.at(1).valueCount(), 3);
+        QCOMPARE(ranges.at(2).registerType(), QModbusDataUnit::HoldingRegisters);
+        QCOMPARE(ranges.at(2).startAddress(), 20);
+        QCOMPARE(ranges.at(2).valueCount(), 1);
+
+        local.setData(QModbusDataUnit::HoldingRegisters, 30, 6u);
+        QTRY_COMPARE(coalescedSpy.size(), 2);
+        QCOMPARE(coalescedSpy.at(1).at(0).value<QList<QModbusDataUnit>>().size(), 1);
+
+        local.setCoalescingInterval(-1);
+        local.setData(QModbusDataUnit::HoldingRegisters, 30, 7u);
+        QCOMPARE(writtenSpy.size(), 1);
+        QCOMPARE(coalescedSpy.size(), 2);
+    }
+
+    void testTcpServerPipelinedRequests()
+    {
+        QModbusTcpServer local;
+        QModbusDataUnitMap map;
+        map.insert(QModbusDataUnit::HoldingRegisters, { QModbusDataUnit::HoldingRegisters, 0, 10 });
+        local.setMap(map);
+        local.setServerAddress(1);
+        QVERIFY(local.setData(QModbusDataUnit::HoldingRegisters, 3, 0x1234));
+        const quint16 port = connectToFreeLocalTcpPort(&local);
+        QVERIFY(port);
+
+        QTcpSocket socket;
+        socket.connectToHost(QHostAddress::LocalHost, port);
+        QVERIFY(socket.waitForConnected(5000));
+
+        // Read holding register 3, pipelined in one segment. The last frame is split
+        // to make sure a partial frame is kept until the remaining bytes arrive.
+        constexpr int requestCount = 300;
+        QByteArray requests;
+        for (int i = 0; i < requestCount; ++i) {
+            QDataStream output(&requests, QIODevice::Append);
+            output << quint16(i) << quint16(0) << quint16(6) << quint8(1)
+                   << quint8(QModbusPdu::ReadHoldingRegisters) << quint16(3) << quint16(1);
+        }
+        socket.write(requests.left(requests.size() - 5));
+        QTRY_COMPARE(socket.bytesAvailable(), qint64((requestCount - 1) * 11));
+        socket.write(requests.right(5));
+        QTRY_COMPARE(socket.bytesAvailable(), qint64(requestCount * 11));
+
+        const QByteArray responses = socket.readAll();
+        for (int i = 0; i < requestCount; ++i) {
+            QDataStream input(responses.mid(i * 11, 11));
+            quint16 transactionId, protocolId, length, value;
+            quint8 unitId, functionCode, byteCount;
+            input >> transactionId >> protocolId >> length >> unitId >> functionCode >> byteCount
+                  >> value;
+            QCOMPARE(transactionId, quint16(i));
+            QCOMPARE(protocolId, quint16(0));
+            QCOMPARE(length, quint16(5));
+            QCOMPARE(unitId, quint8(1));
+            QCOMPARE(functionCode, quint8(QModbusPdu::ReadHoldingRegisters));
+            QCOMPARE(byteCount, quint8(2));
+            QCOMPARE(value, quint16(0x1234));
+        }
+        local.disconnectDevice();
+    }
+
+    void testTcpServerWorkerThreads()
+    {
+        QModbusTcpServer local;
+        QCOMPARE(local.workerThreadCount(), 0);
+        local.setWorkerThreadCount(2);
+        QCOMPARE(local.workerThreadCount(), 2);
+
+        QModbusDataUnitMap map;
+        map.insert(QModbusDataUnit::HoldingRegisters, { QModbusDataUnit::HoldingRegisters, 0, 10 });
+        local.setMap(map);
+        local.setServerAddress(1);
+        const quint16 port = connectToFreeLocalTcpPort(&local);
+        QVERIFY(port);
+
+        local.setWorkerThreadCount(4); // ignored while connected
+        QCOMPARE(local.workerThreadCount(), 2);
+
+        QSignalSpy writtenSpy(&local, &QModbusServer::dataWritten);
+        QSignalSpy disconnectedSpy(&local, &QModbusTcpServer::modbusClientDisconnected);
+
+        // Write holding register i + 1 from connection i, then read it back.
+        QTcpSocket sockets[4];
+        for (int i = 0; i < 4; ++i) {
+            sockets[i].connectToHost(QHostAddress::LocalHost, port);
+            QVERIFY(sockets[i].waitForConnected(5000));
+
+            QByteArray request;
+            QDataStream output(&request, QIODevice::WriteOnly);
+            output << quint16(1) << quint16(0) << quint16(6) << quint8(1)
+                   << quint8(QModbusPdu::WriteSingleRegister) << quint16(i + 1) << quint16(i + 10);
+            output << quint16(2) << quint16(0) << quint16(6) << quint8(1)
+                   << quint8(QModbusPdu::ReadHoldingRegisters) << quint16(i + 1) << quint16(1);
+            sockets[i].write(request);
+        }
+
+        for (int i = 0; i < 4; ++i) {
+            // 12 bytes write single register echo + 11 bytes read response
+            QTRY_COMPARE(sockets[i].bytesAvailable(), qint64(12 + 11));
+            const QByteArray responses = sockets[i].readAll();
+            QDataStream input(responses.mid(12));
+            quint16 transactionId, protocolId, length, value;
+            quint8 unitId, functionCode, byteCount;
+            input >> transactionId >> protocolId >> length >> unitId >> functionCode >> byteCount
+                  >> value;
+            QCOMPARE(transactionId, quint16(2));
+            QCOMPARE(functionCode, quint8(QModbusPdu::ReadHoldingRegisters));
+            QCOMPARE(value, quint16(i + 10));
+        }
+        QTRY_COMPARE(writtenSpy.size(), 4);
+
+        for (int i = 0; i < 4; ++i) {
+            quint16 value = 0;
+            QVERIFY(local.data(QModbusDataUnit::HoldingRegisters, quint16(i + 1), &value));
+            QCOMPARE(value, quint16(i + 10));
+        }
+
+        sockets[0].disconnectFromHost();
+        QTRY_COMPARE(disconnectedSpy.size(), 1);
+
+        local.disconnectDevice();
+        for (int i = 1; i < 4; ++i)
+            QTRY_COMPARE(sockets[i].state(), QAbstractSocket::UnconnectedState);
+        QTRY_COMPARE(disconnectedSpy.size(), 4);
+    }
+
+    void testMultipleServerAddresses()
+    {
+        TestServer local;
+        local.setServerAddress(1);
+
+        QModbusDataUnitMap map;
+        map.insert(QModbusDataUnit::HoldingRegisters, { QModbusDataUnit::HoldingRegisters, 0, 10 });
+        local.setMap(map);
+
+        QVERIFY(!local.addServerAddress(0, map));
+        QVERIFY(!local.addServerAddress(1, map));
+        QVERIFY(!local.addServerAddress(256, map));
+        for (int address = 247; address > 1; --address)
+            QVERIFY(local.addServerAddress(address, map));
+        QCOMPARE(local.serverAddresses().size(), 246);
+        QCOMPARE(local.serverAddresses().first(), 2);
+        QCOMPARE(local.serverAddresses().last(), 247);
+
+        // An added address cannot become the server address.
+        local.setServerAddress(2);
+        QCOMPARE(local.serverAddress(), 1);
+
+        QSignalSpy writtenSpy(&local, &QModbusServer::dataWritten);
+        QSignalSpy unitWrittenSpy(&local, &QModbusServer::serverAddressDataWritten);
+
+        // Receivers of the signal access the default register map, not the written unit.
+        QList<quint16> defaultValues;
+        connect(&local, &QModbusServer::serverAddressDataWritten, this, [&local, &defaultValues] {
+            quint16 value = 0;
+            if (local.data(QModbusDataUnit::HoldingRegisters, 0, &value))
+                defaultValues.append(value);
+        });
+
+        QVERIFY(local.setData(1,
+            { QModbusDataUnit::HoldingRegisters, 0, QList<quint16> { 1u } }));
+        QVERIFY(local.setData(2,
+            { QModbusDataUnit::HoldingRegisters, 0, QList<quint16> { 2u } }));
+        QVERIFY(local.setData(100,
+            { QModbusDataUnit::HoldingRegisters, 5, QList<quint16> { 100u, 101u } }));
+        QVERIFY(!local.setData(100,
+            { QModbusDataUnit::HoldingRegisters, 9, QList<quint16> { 1u, 2u } }));
+        QVERIFY(!local.setData(248,
+            { QModbusDataUnit::HoldingRegisters, 0, QList<quint16> { 1u } }));
+
+        QCOMPARE(writtenSpy.size(), 1);
+        QCOMPARE(unitWrittenSpy.size(), 2);
+        QCOMPARE(unitWrittenSpy.at(1).at(0).toInt(), 100);
+        QCOMPARE(unitWrittenSpy.at(1).at(2).toInt(), 5);
+        QCOMPARE(unitWrittenSpy.at(1).at(3).toInt(), 2);
+        QCOMPARE(defaultValues, QList<quint16>({ 1u, 1u }));
+
+        quint16 value = 0;
+        QVERIFY(local.data(QModbusDataUnit::HoldingRegisters, 0, &value));
+        QCOMPARE(value, quint16(1));
+
+        QModbusDataUnit unit(QModbusDataUnit::HoldingRegisters, 0, 1);
+        QVERIFY(local.data(2, &unit));
+        QCOMPARE(unit.value(0), quint16(2));
+        QVERIFY(local.data(3, &unit));
+        QCOMPARE(unit.value(0), quint16(0));
+
+        unit = QModbusDataUnit(QModbusDataUnit::HoldingRegisters, 5, 2);
+        QVERIFY(local.data(100, &unit));
+        QCOMPARE(unit.values(), QList<quint16>({ 100u, 101u }));
+
+        QVERIFY(local.removeServerAddress(100));
+        QVERIFY(!local.removeServerAddress(100));
+        QVERIFY(!local.data(100, &unit));
+        QCOMPARE(local.serverAddresses().size(), 245);
+    }
+
+    void testTcpServerMultipleServerAddresses()
+    {
+        QModbusTcpServer local;
+        QModbusDataUnitMap map;
+        map.insert(QModbusDataUnit::HoldingRegisters, { QModbusDataUnit::HoldingRegisters, 0, 10 });
+        local.setMap(map);
+        local.setServerAddress(1);
+        QVERIFY(local.addServerAddress(2, map));
+        QVERIFY(local.setData(QModbusDataUnit::HoldingRegisters, 0, 0x1111));
+        QVERIFY(local.setData(2,
+            { QModbusDataUnit::HoldingRegisters, 0, QList<quint16> { 0x2222 } }));
+        const quint16 port = connectToFreeLocalTcpPort(&local);
+        QVERIFY(port);
+
+        QTcpSocket socket;
+        socket.connectToHost(QHostAddress::LocalHost, port);
+        QVERIFY(socket.waitForConnected(5000));
+
+        // Read holding register 0 from unit 1, 2 and 3. Unit 3 is not hosted, no response.
+        QByteArray requests;
+        for (quint8 unitId : { 1, 3, 2 }) {
+            QDataStream output(&requests, QIODevice::Append);
+            output << quint16(unitId) << quint16(0) << quint16(6) << unitId
+                   << quint8(QModbusPdu::ReadHoldingRegisters) << quint16(0) << quint16(1);
+        }
+        socket.write(requests);
+        QTRY_COMPARE(socket.bytesAvailable(), qint64(2 * 11));
+
+        QDataStream input(socket.readAll());
+        for (quint16 expected : { 0x1111, 0x2222 }) {
+            quint16 transactionId, protocolId, length, value;
+            quint8 unitId, functionCode, byteCount;
+            input >> transactionId >> protocolId >> length >> unitId >> functionCode >> byteCount
+                  >> value;
+            QCOMPARE(quint16(unitId), transactionId);
+            QCOMPARE(value, expected);
+        }
+        local.disconnectDevice();
+    }
+
+    void testRtuServerBroadcast()
+    {
+#if !QT_CONFIG(modbus_serialport) || !defined(QMODBUS_HAS_PSEUDOTERMINAL)
+        QSKIP("Pseudo-terminals are not available on this platform.");
+#else
+        ModbusPseudoTerminal terminal;
+        QVERIFY(terminal.open());
+
+        QModbusRtuSerialServer local;
+        QModbusDataUnitMap map;
+        map.insert(QModbusDataUnit::HoldingRegisters, { QModbusDataUnit::HoldingRegisters, 0, 10 });
+        local.setMap(map);
+        local.setServerAddress(1);
+        QVERIFY(local.addServerAddress(2, map));
+        local.setConnectionParameter(QModbusDevice::SerialPortNameParameter, terminal.portName());
+        local.setConnectionParameter(QModbusDevice::SerialBaudRateParameter, 115200);
+        QVERIFY(local.connectDevice());
+
+        // A broadcast writes holding register 2 of every hosted unit, without a response.
+        QVERIFY(terminal.write(modbusRtuFrame(QByteArray::fromHex("00060002002a"))));
+        for (int serverAddress : { 1, 2 }) {
+            QModbusDataUnit unit(QModbusDataUnit::HoldingRegisters, 2, 1);
+            QTRY_VERIFY(local.data(serverAddress, &unit) && unit.value(0) == 42);
+        }
+
+        // The first bytes on the line are the response to the following read.
+        QVERIFY(terminal.write(modbusRtuFrame(QByteArray::fromHex("020300020001"))));
+        QByteArray received;
+        const QByteArray expected = modbusRtuFrame(QByteArray::fromHex("020302002a"));
+        QTRY_VERIFY((received += terminal.read()).size() >= expected.size());
+        QCOMPARE(received, expected);
+        local.disconnectDevice();
+#endif
+    }
+
     void testQModbusServerOptions()
     {
         // TODO: Add a local class implementation to test value()/setValue with a different backing
@@ -0,0 +1,39 @@
+// Copyright (C) 2023 The Qt Company Ltd.
+// SPDX-License-Identifier: LicenseRef-Qt-Commercial OR LGPL-3.0-only OR GPL-2.0-only OR GPL-3.0-only
+
+#ifndef QLOCALTCPPORT_HELPERS_H
+#define QLOCALTCPPORT_HELPERS_H
+
+#include <QtSerialBus/qmodbusserver.h>
+
+#include <QtNetwork/qhostaddress.h>
+#include <QtNetwork/qtcpserver.h>
+
+QT_BEGIN_NAMESPACE
+
+// Returns a TCP port of the local host that is free at the time of the call, or 0.
+inline quint16 freeLocalTcpPort()
+{
+    QTcpServer portFinder;
+    if (!portFinder.listen(QHostAddress::LocalHost))
+        return 0;
+    return portFinder.serverPort();
+}
+
+// Connects the Modbus TCP server to a free port of the local host. Returns the port, or 0 if
+// the server could not be connected.
+inline quint16 connectToFreeLocalTcpPort(QModbusServer *server)
+{
+    const quint16 port = freeLocalTcpPort();
+    if (port == 0)
+        return 0;
+
+    server->setConnectionParameter(QModbusDevice::NetworkAddressParameter,
+                                   QStringLiteral("127.0.0.1"));
+    server->setConnectionParameter(QModbusDevice::NetworkPortParameter, int(port));
+    return server->connectDevice() ? port : 0;
+}
+
+QT_END_NAMESPACE
+
+#endif // QLOCALTCPPORT_HELPERS_H
@@ -0,0 +1,108 @@
+// Copyright (C) 2023 The Qt Company Ltd.
+// SPDX-License-Identifier: LicenseRef-Qt-Commercial OR LGPL-3.0-only OR GPL-2.0-only OR GPL-3.0-only
+
+#ifndef QMODBUSPSEUDOTERMINAL_HELPERS_H
+#define QMODBUSPSEUDOTERMINAL_HELPERS_H
+
+#include <QtCore/qbytearray.h>
+#include <QtCore/qglobal.h>
+#include <QtCore/qstring.h>
+
+#if defined(Q_OS_LINUX)
+#  define QMODBUS_HAS_PSEUDOTERMINAL
+#  include <fcntl.h>
+#  include <pty.h>
+#  include <termios.h>
+#  include <unistd.h>
+#elif defined(Q_OS_MACOS)
+#  define QMODBUS_HAS_PSEUDOTERMINAL
+#  include <fcntl.h>
+#  include <termios.h>
+#  include <unistd.h>
+#  include <util.h>
+#endif
+
+QT_BEGIN_NAMESPACE
+
+#ifdef QMODBUS_HAS_PSEUDOTERMINAL
+/*
+    A pseudo-terminal pair standing in for a serial line. The device side is
+    opened by QSerialPort through portName(), the test talks to it through
+    the controller side using read() and write().
+*/
+class ModbusPseudoTerminal
+{
+    Q_DISABLE_COPY_MOVE(ModbusPseudoTerminal)
+
+public:
+    ModbusPseudoTerminal() = default;
+    ~ModbusPseudoTerminal()
+    {
+        if (m_controller >= 0)
+            ::close(m_controller);
+        if (m_device >= 0)
+            ::close(m_device);
+    }
+
+    bool open()
+    {
+        char name[128] = {};
+        if (::openpty(&m_controller, &m_device, name, nullptr, nullptr) != 0)
+            return false;
+
+        termios attributes;
+        if (::tcgetattr(m_controller, &attributes) == 0) {
+            ::cfmakeraw(&attributes);
+            ::tcsetattr(m_controller, TCSANOW, &attributes);
+        }
+        ::fcntl(m_controller, F_SETFL, ::fcntl(m_controller, F_GETFL) | O_NONBLOCK);
+        m_portName = QString::fromLocal8Bit(name);
+        return true;
+    }
+
+    QString portName() const { return m_portName; }
+    int controllerDescriptor() const { return m_controller; }
+
+    QByteArray read()
+    {
+        QByteArray result;
+        char buffer[256];
+        qint64 bytes = 0;
+        while ((bytes = ::read(m_controller, buffer, sizeof(buffer))) > 0)
+            result.append(buffer, bytes);
+        return result;
+    }
+
+    bool write(const QByteArray &data)
+    {
+        return ::write(m_controller, data.constData(), size_t(data.size())) == data.size();
+    }
+
+private:
+    int m_controller = -1;
+    int m_device = -1; // kept open, so the controller side does not report a hang-up
+    QString m_portName;
+};
+#endif // QMODBUS_HAS_PSEUDOTERMINAL
+
+inline quint16 modbusRtuCrc(const QByteArray &data)
+{
+    quint16 crc = 0xffff;
+    for (char byte : data) {
+        crc ^= quint8(byte);
+        for (int bit = 0; bit < 8; ++bit)
+            crc = (crc & 1) ? quint16((crc >> 1) ^ 0xa001) : quint16(crc >> 1);
+    }
+    return crc;
+}
+
+// Appends the CRC, low byte first, as transmitted on the line.
+inline QByteArray modbusRtuFrame(const QByteArray &addressAndPdu)
+{
+    const quint16 crc = modbusRtuCrc(addressAndPdu);
+    return addressAndPdu + char(crc & 0xff) + char(crc >> 8);
+}
+
+QT_END_NAMESPACE
+
+#endif // QMODBUSPSEUDOTERMINAL_HELPERS_H
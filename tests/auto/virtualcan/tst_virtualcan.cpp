@@ -0,0 +1,360 @@
+// Copyright (C) 2023 The Qt Company Ltd.
+// SPDX-License-Identifier: LicenseRef-Qt-Commercial OR LGPL-3.0-only OR GPL-2.0-only OR GPL-3.0-only
+
+#include "virtualcanbackend.h"
+#include "virtualcanprotocol.h"
+
+#include <QtSerialBus/qcanbusframe.h>
+
+#include <QtNetwork/qtcpserver.h>
+#include <QtNetwork/qtcpsocket.h>
+
+#include <QtCore/qendian.h>
+#include <QtCore/qloggingcategory.h>
+#include <QtCore/qregularexpression.h>
+#include <QtTest/qsignalspy.h>
+#include <QtTest/qtest.h>
+
+#include "qlocaltcpport_helpers.h"
+
+QT_BEGIN_NAMESPACE
+Q_LOGGING_CATEGORY(QT_CANBUS_PLUGINS_VIRTUALCAN, "qt.canbus.plugins.virtualcan")
+QT_END_NAMESPACE
+
+using namespace VirtualCanProtocol;
+
+// Waits for a complete message from socket and reads it, returns an empty array on a timeout
+// or an invalid message.
+static QByteArray receiveMessage(QTcpSocket &socket)
+{
+    qsizetype size = 0;
+    QTest::qWaitFor([&socket, &size] {
+        const QByteArray available = socket.peek(socket.bytesAvailable());
+        size = messageSize(available.constData(), available.size());
+        return size != 0;
+    });
+    return size > 0 ? socket.read(size) : QByteArray();
+}
+
+class tst_VirtualCan : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void localBus();
+    void sharedMemoryBus();
+    void frameDuration_data();
+    void frameDuration();
+    void arbitrationPriority();
+    void messageSize_data();
+    void messageSize();
+    void frameEncoding_data();
+    void frameEncoding();
+    void serverRouting();
+    void serverVersionMismatch();
+    void clientVersionMismatch();
+
+private:
+    void checkBus(const QString &interface, qint64 queueSize);
+};
+
+// Two devices on the bus of interface, which buffers queueSize frames per device.
+void tst_VirtualCan::checkBus(const QString &interface, qint64 queueSize)
+{
+    VirtualCanBackend first(interface);
+    VirtualCanBackend second(interface);
+    QVERIFY(first.connectDevice());
+    QVERIFY(second.connectDevice());
+    QCOMPARE(first.state(), QCanBusDevice::ConnectedState);
+    QCOMPARE(second.state(), QCanBusDevice::ConnectedState);
+
+    const QCanBusFrame frame(0x123, QByteArray::fromHex("0102030405060708"));
+    QVERIFY(first.writeFrame(frame));
+    QTRY_COMPARE(second.framesAvailable(), qint64(1));
+    const QCanBusFrame received = second.readFrame();
+    QCOMPARE(received.frameId(), frame.frameId());
+    QCOMPARE(received.payload(), frame.payload());
+
+    // The answer arrives after the first frame would have, the sender does not get its own.
+    QVERIFY(second.writeFrame(QCanBusFrame(0x456, QByteArray::fromHex("ff"))));
+    QTRY_VERIFY(first.framesAvailable() > 0);
+    QCOMPARE(first.framesAvailable(), qint64(1));
+    QCOMPARE(first.readFrame().frameId(), 0x456u);
+
+    // Frames beyond the buffer of the receiver are lost and reported.
+    QSignalSpy errors(&second, &QCanBusDevice::errorOccurred);
+    for (qint64 i = 0; i < queueSize + 10; ++i)
+        QVERIFY(first.writeFrame(frame));
+    QTRY_COMPARE(errors.size(), 1);
+    QCOMPARE(second.error(), QCanBusDevice::ReadError);
+    QVERIFY(second.errorString().contains(QLatin1String("Dropped 10 ")));
+    QCOMPARE(second.framesAvailable(), queueSize);
+    QCOMPARE(first.framesAvailable(), qint64(0));
+
+    first.disconnectDevice();
+    second.disconnectDevice();
+}
+
+void tst_VirtualCan::localBus()
+{
+    checkBus(QStringLiteral("local:/can0"), qint64(VirtualCanLocalNode::QueueSize));
+}
+
+void tst_VirtualCan::sharedMemoryBus()
+{
+#if QT_CONFIG(sharedmemory)
+    // A name of its own, so that other test runs do not interfere.
+    const QString interface = QStringLiteral("shm://tst%1/can0")
+            .arg(QCoreApplication::applicationPid());
+    checkBus(interface, qint64(VirtualCanSharedMemoryBus::SlotCount));
+#else
+    QSKIP("Shared memory is not supported.");
+#endif
+}
+
+void tst_VirtualCan::frameDuration_data()
+{
+    QTest::addColumn<QCanBusFrame>("frame");
+    QTest::addColumn<qint64>("duration");
+
+    // 500 kbit/s, 2000 ns per bit. A standard data frame with 8 data bytes has 111 bits
+    // including the interframe space, and at most 24 stuff bits, of which 22 can occur
+    // with an actual CRC.
+    QTest::newRow("standard, no stuff bits")
+            << QCanBusFrame(0x086, QByteArray::fromHex("5555555555555555")) << qint64(111 * 2000);
+    QTest::newRow("standard, worst-case stuffing")
+            << QCanBusFrame(0x078, QByteArray::fromHex("01e1e1e1e1e1e00f"))
+            << qint64((111 + 22) * 2000);
+
+    // 30 bits at 500 kbit/s, and 549 bits from the ESI bit to the CRC at 2 Mbit/s: 5 bits
+    // for ESI and DLC, 512 data bits, and 32 bits of stuff count, CRC-21 and fixed stuff bits.
+    QCanBusFrame fd(0x123, QByteArray(64, 0x55));
+    fd.setFlexibleDataRateFormat(true);
+    fd.setBitrateSwitch(true);
+    QTest::newRow("CAN FD, 64 bytes, bitrate switch") << fd << qint64(30 * 2000 + 549 * 500);
+}
+
+void tst_VirtualCan::frameDuration()
+{
+    QFETCH(QCanBusFrame, frame);
+    QFETCH(qint64, duration);
+
+    QCOMPARE(VirtualCanBusSimulation::frameDuration(frame, 500000, 2000000), duration);
+}
+
+void tst_VirtualCan::arbitrationPriority()
+{
+    const QCanBusFrame standard(0x123, QByteArray(1, 0));
+    QCanBusFrame remote(0x123, QByteArray());
+    remote.setFrameType(QCanBusFrame::RemoteRequestFrame);
+    QCanBusFrame extended(0x123u << 18 | 0x048d1, QByteArray(1, 0));
+    extended.setExtendedFrameFormat(true);
+    QCanBusFrame lowExtended(0x123, QByteArray(1, 0));
+    lowExtended.setExtendedFrameFormat(true);
+
+    // Base identifier, RTR or SRR, IDE, identifier extension and RTR, most significant first.
+    QCOMPARE(VirtualCanBusSimulation::arbitrationPriority(standard), 0x24600000u);
+    QCOMPARE(VirtualCanBusSimulation::arbitrationPriority(remote), 0x24700000u);
+    QCOMPARE(VirtualCanBusSimulation::arbitrationPriority(extended), 0x247891a2u);
+    QCOMPARE(VirtualCanBusSimulation::arbitrationPriority(lowExtended), 0x00180246u);
+
+    // A data frame wins over a remote frame, and a standard frame over an extended frame
+    // with the same base identifier.
+    QVERIFY(VirtualCanBusSimulation::arbitrationPriority(standard)
+            < VirtualCanBusSimulation::arbitrationPriority(remote));
+    QVERIFY(VirtualCanBusSimulation::arbitrationPriority(remote)
+            < VirtualCanBusSimulation::arbitrationPriority(extended));
+}
+
+void tst_VirtualCan::messageSize_data()
+{
+    QTest::addColumn<QByteArray>("data");
+    QTest::addColumn<qsizetype>("size");
+
+    const QByteArray connect = connectMessage(1);
+    QTest::newRow("empty") << QByteArray() << qsizetype(0);
+    QTest::newRow("size field only") << connect.left(2) << qsizetype(0);
+    QTest::newRow("incomplete connect") << connect.left(7) << qsizetype(0);
+    QTest::newRow("connect") << connect << qsizetype(ConnectMessageSize);
+    QTest::newRow("connect and more") << connect + disconnectMessage(1)
+                                      << qsizetype(ConnectMessageSize);
+    // A later protocol version may append fields to the connect message.
+    QTest::newRow("extended connect") << QByteArray::fromHex("08000101564302000000")
+                                      << qsizetype(10);
+    QTest::newRow("disconnect") << disconnectMessage(0) << qsizetype(MessageHeaderSize);
+    QTest::newRow("configure") << configureMessage(0, 500000, 0)
+                               << qsizetype(ConfigureMessageSize);
+
+    QTest::newRow("too small") << QByteArray::fromHex("0100") << qsizetype(-1);
+    QTest::newRow("short connect") << QByteArray::fromHex("040001015643") << qsizetype(-1);
+    QTest::newRow("long disconnect") << QByteArray::fromHex("0300020000") << qsizetype(-1);
+    QTest::newRow("unknown type") << QByteArray::fromHex("02000900") << qsizetype(-1);
+    QTest::newRow("short frame") << QByteArray::fromHex("0e00030000") + QByteArray(14, 0)
+                                 << qsizetype(-1);
+    QTest::newRow("long frame") << QByteArray::fromHex("5000030000") + QByteArray(78, 0)
+                                << qsizetype(-1);
+}
+
+void tst_VirtualCan::messageSize()
+{
+    QFETCH(QByteArray, data);
+    QFETCH(qsizetype, size);
+
+    QCOMPARE(VirtualCanProtocol::messageSize(data.constData(), data.size()), size);
+}
+
+void tst_VirtualCan::frameEncoding_data()
+{
+    QTest::addColumn<QCanBusFrame>("frame");
+
+    QTest::newRow("data") << QCanBusFrame(0x123, QByteArray::fromHex("0102030405060708"));
+    QTest::newRow("empty") << QCanBusFrame(0x7ff, QByteArray());
+
+    QCanBusFrame remote(0x456, QByteArray());
+    remote.setFrameType(QCanBusFrame::RemoteRequestFrame);
+    QTest::newRow("remote request") << remote;
+
+    QCanBusFrame extended(0x1fffffff, QByteArray::fromHex("ff"));
+    extended.setExtendedFrameFormat(true);
+    QTest::newRow("extended") << extended;
+
+    QCanBusFrame fd(0x123, QByteArray(64, 0x55));
+    fd.setFlexibleDataRateFormat(true);
+    fd.setBitrateSwitch(true);
+    fd.setErrorStateIndicator(true);
+    QTest::newRow("CAN FD") << fd;
+
+    QCanBusFrame echo(0x321, QByteArray::fromHex("01"));
+    echo.setLocalEcho(true);
+    QTest::newRow("local echo") << echo;
+
+    QCanBusFrame error(QCanBusFrame::ErrorFrame);
+    error.setError(QCanBusFrame::ControllerError | QCanBusFrame::BusOffError);
+    error.setPayload(QByteArray::fromHex("0004000000000000"));
+    QTest::newRow("error") << error;
+}
+
+void tst_VirtualCan::frameEncoding()
+{
+    QFETCH(QCanBusFrame, frame);
+
+    char buffer[FrameHeaderSize + MaximumPayloadSize];
+    const qsizetype size = encodeFrame(buffer, 1, frame);
+    QCOMPARE(size, FrameHeaderSize + frame.payload().size());
+    QCOMPARE(VirtualCanProtocol::messageSize(buffer, size), size);
+    QCOMPARE(quint8(buffer[2]), quint8(FrameMessage));
+    QCOMPARE(quint8(buffer[3]), quint8(1));
+
+    // Frames are sent without a time stamp, the receiver sets its own.
+    const QCanBusFrame decoded = decodeFrame(buffer, size, 1234);
+    QCOMPARE(decoded.timeStamp().toMicroSeconds(), qint64(1234));
+    QCOMPARE(decoded.frameType(), frame.frameType());
+    QCOMPARE(decoded.frameId(), frame.frameId());
+    QCOMPARE(decoded.error(), frame.error());
+    QCOMPARE(decoded.payload(), frame.payload());
+    QCOMPARE(decoded.hasExtendedFrameFormat(), frame.hasExtendedFrameFormat());
+    QCOMPARE(decoded.hasFlexibleDataRateFormat(), frame.hasFlexibleDataRateFormat());
+    QCOMPARE(decoded.hasBitrateSwitch(), frame.hasBitrateSwitch());
+    QCOMPARE(decoded.hasErrorStateIndicator(), frame.hasErrorStateIndicator());
+    QCOMPARE(decoded.hasLocalEcho(), frame.hasLocalEcho());
+}
+
+void tst_VirtualCan::serverRouting()
+{
+    const quint16 port = freeLocalTcpPort();
+    QVERIFY(port);
+
+    VirtualCanServer server;
+    server.start(port);
+
+    // Two clients on channel 0, two on channel 1.
+    const quint8 channels[] = { 0, 0, 1, 1 };
+    QTcpSocket clients[std::size(channels)];
+    for (size_t i = 0; i < std::size(channels); ++i) {
+        clients[i].connectToHost(QHostAddress::LocalHost, port);
+        QVERIFY(clients[i].waitForConnected());
+        clients[i].write(connectMessage(channels[i]));
+        const QByteArray answer = receiveMessage(clients[i]);
+        QCOMPARE(answer.size(), qsizetype(ConnectMessageSize));
+        QCOMPARE(quint8(answer[2]), quint8(ConnectMessage));
+        QCOMPARE(protocolVersion(answer.constData()), quint16(ProtocolVersion));
+    }
+
+    const auto send = [](QTcpSocket &client, quint8 channel, quint32 id) {
+        char buffer[FrameHeaderSize + MaximumPayloadSize];
+        const qsizetype size = encodeFrame(buffer, channel,
+                                           QCanBusFrame(id, QByteArray::fromHex("01")));
+        client.write(buffer, size);
+    };
+    const auto receivedId = [](QTcpSocket &client) {
+        const QByteArray message = receiveMessage(client);
+        return message.isEmpty() ? 0u : qFromLittleEndian<quint32>(message.constData() + 5);
+    };
+
+    // The server keeps the order of the messages, so a frame the sender got back, or a frame
+    // routed to the wrong channel, would arrive before the frame expected next.
+    send(clients[0], 0, 0x100);
+    QCOMPARE(receivedId(clients[1]), 0x100u);
+    send(clients[1], 0, 0x101);
+    QCOMPARE(receivedId(clients[0]), 0x101u);
+    send(clients[2], 1, 0x200);
+    QCOMPARE(receivedId(clients[3]), 0x200u);
+    send(clients[3], 1, 0x201);
+    QCOMPARE(receivedId(clients[2]), 0x201u);
+
+    for (QTcpSocket &client : clients)
+        QCOMPARE(client.bytesAvailable(), qint64(0));
+}
+
+void tst_VirtualCan::serverVersionMismatch()
+{
+    const quint16 port = freeLocalTcpPort();
+    QVERIFY(port);
+
+    VirtualCanServer server;
+    server.start(port);
+
+    QTcpSocket client;
+    client.connectToHost(QHostAddress::LocalHost, port);
+    QVERIFY(client.waitForConnected());
+    QByteArray connect = connectMessage(0);
+    qToLittleEndian<quint16>(ProtocolVersion + 1, connect.data() + 6);
+
+    // The server answers with its own version and closes the connection.
+    QTest::ignoreMessage(QtWarningMsg,
+                         QRegularExpression(QStringLiteral("rejected a client with protocol "
+                                                           "version %1").arg(ProtocolVersion + 1)));
+    client.write(connect);
+    const QByteArray answer = receiveMessage(client);
+    QCOMPARE(answer.size(), qsizetype(ConnectMessageSize));
+    QCOMPARE(protocolVersion(answer.constData()), quint16(ProtocolVersion));
+    QTRY_COMPARE(client.state(), QAbstractSocket::UnconnectedState);
+}
+
+void tst_VirtualCan::clientVersionMismatch()
+{
+    // A server of another version, which the device connects to instead of starting its own.
+    QTcpServer server;
+    QVERIFY(server.listen(QHostAddress::LocalHost));
+    const quint16 port = server.serverPort();
+
+    VirtualCanBackend device(QStringLiteral("tcp://127.0.0.1:%1/can0").arg(port));
+    QVERIFY(device.connectDevice());
+    QTRY_VERIFY(server.hasPendingConnections());
+    QTcpSocket *socket = server.nextPendingConnection();
+    const QByteArray connect = receiveMessage(*socket);
+    QCOMPARE(connect.size(), qsizetype(ConnectMessageSize));
+    QCOMPARE(protocolVersion(connect.constData()), quint16(ProtocolVersion));
+
+    QByteArray answer = connect;
+    qToLittleEndian<quint16>(ProtocolVersion + 1, answer.data() + 6);
+    socket->write(answer);
+    QTRY_COMPARE(device.error(), QCanBusDevice::ConnectionError);
+    QVERIFY(device.errorString().contains(
+            QStringLiteral("protocol version %1").arg(ProtocolVersion + 1)));
+    QTRY_COMPARE(device.state(), QCanBusDevice::UnconnectedState);
+}
+
+QTEST_MAIN(tst_VirtualCan)
+
+#include "tst_virtualcan.moc"
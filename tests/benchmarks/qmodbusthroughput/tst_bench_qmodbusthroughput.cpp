@@ -0,0 +1,301 @@
+// Copyright (C) 2023 The Qt Company Ltd.
+// SPDX-License-Identifier: LicenseRef-Qt-Commercial OR LGPL-3.0-only OR GPL-2.0-only OR GPL-3.0-only
+
+#include <QtSerialBus/qmodbusclient.h>
+#include <QtSerialBus/qmodbusserver.h>
+#include <QtSerialBus/qmodbustcpclient.h>
+#include <QtSerialBus/qmodbustcpserver.h>
+#include <QtSerialBus/qtserialbusglobal.h>
+#if QT_CONFIG(modbus_serialport)
+#include <QtSerialBus/qmodbusrtuserialclient.h>
+#include <QtSerialBus/qmodbusrtuserialserver.h>
+#endif
+
+#include <QtCore/qeventloop.h>
+#include <QtCore/qsocketnotifier.h>
+#include <QtCore/qtimer.h>
+#include <QtTest/QtTest>
+
+#include "qlocaltcpport_helpers.h"
+#include "qmodbuspseudoterminal_helpers.h"
+
+#include <ctime>
+#include <memory>
+
+/*
+    Measures the request throughput of the Modbus clients against the Modbus
+    servers of this module, for every function code the servers handle:
+
+    - QModbusTcpClient and QModbusTcpServer over a loopback connection,
+    - QModbusRtuSerialClient and QModbusRtuSerialServer over two
+      pseudo-terminals relayed back to back, like a socat pty pair.
+
+    QBENCHMARK reports the time per batch of requests. Besides, every data row
+    logs the requests per second, the 50th and 99th latency percentile taken
+    from QModbusClient::metrics(), and the CPU time per request. Client and
+    server run in this process, so the CPU time covers both ends.
+*/
+
+static constexpr int ServerAddress = 1;
+static constexpr int TcpBatchSize = 100;
+static constexpr int RtuBatchSize = 20;
+
+#if QT_CONFIG(modbus_serialport) && defined(QMODBUS_HAS_PSEUDOTERMINAL)
+#  define QMODBUS_BENCHMARK_RTU
+
+/*
+    Connects two pseudo-terminals back to back. An RTU client opens one of
+    them, an RTU server the other one.
+*/
+class ModbusPseudoTerminalLink
+{
+    Q_DISABLE_COPY_MOVE(ModbusPseudoTerminalLink)
+
+public:
+    ModbusPseudoTerminalLink() = default;
+
+    bool open()
+    {
+        if (!m_first.open() || !m_second.open())
+            return false;
+        m_firstNotifier = relay(m_first, m_second);
+        m_secondNotifier = relay(m_second, m_first);
+        return true;
+    }
+
+    QString firstPortName() const { return m_first.portName(); }
+    QString secondPortName() const { return m_second.portName(); }
+
+private:
+    static std::unique_ptr<QSocketNotifier> relay(ModbusPseudoTerminal &from,
+                                                  ModbusPseudoTerminal &to)
+    {
+        auto notifier = std::make_unique<QSocketNotifier>(from.controllerDescriptor(),
+                                                          QSocketNotifier::Read);
+        QObject::connect(notifier.get(), &QSocketNotifier::activated, notifier.get(),
+                         [&from, &to]() {
+            const QByteArray data = from.read();
+            if (!data.isEmpty())
+                to.write(data);
+        });
+        return notifier;
+    }
+
+    ModbusPseudoTerminal m_first;
+    ModbusPseudoTerminal m_second;
+    std::unique_ptr<QSocketNotifier> m_firstNotifier;
+    std::unique_ptr<QSocketNotifier> m_secondNotifier;
+};
+#endif
+
+class tst_QModbusThroughput : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void initTestCase()
+    {
+        m_tcpServer = std::make_unique<QModbusTcpServer>();
+        setupServer(m_tcpServer.get());
+        const quint16 port = connectToFreeLocalTcpPort(m_tcpServer.get());
+        QVERIFY(port);
+
+        m_tcpClient = std::make_unique<QModbusTcpClient>();
+        m_tcpClient->setConnectionParameter(QModbusDevice::NetworkAddressParameter,
+                                            QStringLiteral("127.0.0.1"));
+        m_tcpClient->setConnectionParameter(QModbusDevice::NetworkPortParameter, int(port));
+        QVERIFY(m_tcpClient->connectDevice());
+        QTRY_COMPARE(m_tcpClient->state(), QModbusDevice::ConnectedState);
+
+#ifdef QMODBUS_BENCHMARK_RTU
+        m_link = std::make_unique<ModbusPseudoTerminalLink>();
+        if (!m_link->open()) {
+            m_link.reset();
+            return;
+        }
+
+        m_rtuServer = std::make_unique<QModbusRtuSerialServer>();
+        setupServer(m_rtuServer.get());
+        m_rtuServer->setConnectionParameter(QModbusDevice::SerialPortNameParameter,
+                                            m_link->secondPortName());
+        m_rtuServer->setConnectionParameter(QModbusDevice::SerialBaudRateParameter, 115200);
+        QVERIFY(m_rtuServer->connectDevice());
+
+        m_rtuClient = std::make_unique<QModbusRtuSerialClient>();
+        m_rtuClient->setConnectionParameter(QModbusDevice::SerialPortNameParameter,
+                                            m_link->firstPortName());
+        m_rtuClient->setConnectionParameter(QModbusDevice::SerialBaudRateParameter, 115200);
+        QVERIFY(m_rtuClient->connectDevice());
+        QTRY_COMPARE(m_rtuClient->state(), QModbusDevice::ConnectedState);
+#endif
+    }
+
+    void cleanupTestCase()
+    {
+        for (QModbusDevice *device : std::initializer_list<QModbusDevice *> {
+                 m_tcpClient.get(), m_tcpServer.get(), m_rtuClient.get(), m_rtuServer.get() }) {
+            if (device)
+                device->disconnectDevice();
+        }
+    }
+
+    void tcp_data() { addFunctionCodes(); }
+    void tcp()
+    {
+        QFETCH(QModbusPdu::FunctionCode, functionCode);
+        run(m_tcpClient.get(), functionCode, TcpBatchSize);
+    }
+
+    void rtu_data() { addFunctionCodes(); }
+    void rtu()
+    {
+        if (!m_rtuClient)
+            QSKIP("RTU benchmarks need serial port support and pseudo-terminals.");
+        QFETCH(QModbusPdu::FunctionCode, functionCode);
+        run(m_rtuClient.get(), functionCode, RtuBatchSize);
+    }
+
+private:
+    static void setupServer(QModbusServer *server)
+    {
+        QModbusDataUnitMap map;
+        map.insert(QModbusDataUnit::Coils, { QModbusDataUnit::Coils, 0, 100 });
+        map.insert(QModbusDataUnit::DiscreteInputs, { QModbusDataUnit::DiscreteInputs, 0, 100 });
+        map.insert(QModbusDataUnit::InputRegisters, { QModbusDataUnit::InputRegisters, 0, 100 });
+        map.insert(QModbusDataUnit::HoldingRegisters,
+                   { QModbusDataUnit::HoldingRegisters, 0, 100 });
+        server->setMap(map);
+        server->setServerAddress(ServerAddress);
+    }
+
+    static void addFunctionCodes()
+    {
+        QTest::addColumn<QModbusPdu::FunctionCode>("functionCode");
+        QTest::newRow("ReadCoils") << QModbusPdu::ReadCoils;
+        QTest::newRow("ReadDiscreteInputs") << QModbusPdu::ReadDiscreteInputs;
+        QTest::newRow("ReadHoldingRegisters") << QModbusPdu::ReadHoldingRegisters;
+        QTest::newRow("ReadInputRegisters") << QModbusPdu::ReadInputRegisters;
+        QTest::newRow("WriteSingleCoil") << QModbusPdu::WriteSingleCoil;
+        QTest::newRow("WriteSingleRegister") << QModbusPdu::WriteSingleRegister;
+        QTest::newRow("WriteMultipleCoils") << QModbusPdu::WriteMultipleCoils;
+        QTest::newRow("WriteMultipleRegisters") << QModbusPdu::WriteMultipleRegisters;
+        QTest::newRow("ReadWriteMultipleRegisters") << QModbusPdu::ReadWriteMultipleRegisters;
+    }
+
+    static bool send(QModbusClient *client, QModbusPdu::FunctionCode functionCode,
+                     const QObject *context, const QModbusClient::ResultHandler &handler)
+    {
+        switch (functionCode) {
+        case QModbusPdu::ReadCoils:
+            return client->sendReadRequest({ QModbusDataUnit::Coils, 0, 16 }, ServerAddress,
+                                           context, handler);
+        case QModbusPdu::ReadDiscreteInputs:
+            return client->sendReadRequest({ QModbusDataUnit::DiscreteInputs, 0, 16 },
+                                           ServerAddress, context, handler);
+        case QModbusPdu::ReadHoldingRegisters:
+            return client->sendReadRequest({ QModbusDataUnit::HoldingRegisters, 0, 10 },
+                                           ServerAddress, context, handler);
+        case QModbusPdu::ReadInputRegisters:
+            return client->sendReadRequest({ QModbusDataUnit::InputRegisters, 0, 10 },
+                                           ServerAddress, context, handler);
+        case QModbusPdu::WriteSingleCoil:
+            return client->sendWriteRequest({ QModbusDataUnit::Coils, 0, QList<quint16>{ 1 } },
+                                            ServerAddress, context, handler);
+        case QModbusPdu::WriteSingleRegister:
+            return client->sendWriteRequest(
+                { QModbusDataUnit::HoldingRegisters, 0, QList<quint16>{ 0x1234 } }, ServerAddress,
+                context, handler);
+        case QModbusPdu::WriteMultipleCoils:
+            return client->sendWriteRequest(
+                { QModbusDataUnit::Coils, 0, QList<quint16>(16, 1) }, ServerAddress, context,
+                handler);
+        case QModbusPdu::WriteMultipleRegisters:
+            return client->sendWriteRequest(
+                { QModbusDataUnit::HoldingRegisters, 0, QList<quint16>(10, 0x1234) },
+                ServerAddress, context, handler);
+        case QModbusPdu::ReadWriteMultipleRegisters:
+            return client->sendReadWriteRequest(
+                { QModbusDataUnit::HoldingRegisters, 0, 10 },
+                { QModbusDataUnit::HoldingRegisters, 10, QList<quint16>(10, 0x1234) },
+                ServerAddress, context, handler);
+        default:
+            break;
+        }
+        return false;
+    }
+
+    // Sends batchSize requests at once and waits for all of them to finish. Returns the number
+    // of failed requests, or -1 if the batch did not finish in time.
+    int runBatch(QModbusClient *client, QModbusPdu::FunctionCode functionCode, int batchSize)
+    {
+        QEventLoop loop;
+        int finished = 0;
+        int failures = 0;
+        const auto handler = [&](const QModbusResult &result) {
+            if (result.error() != QModbusDevice::NoError)
+                ++failures;
+            if (++finished == batchSize)
+                loop.quit();
+        };
+        for (int i = 0; i < batchSize; ++i) {
+            if (!send(client, functionCode, this, handler)) {
+                ++finished;
+                ++failures;
+            }
+        }
+        if (finished < batchSize) {
+            QTimer::singleShot(30000, &loop, [&loop]() { loop.exit(1); });
+            if (loop.exec() != 0)
+                return -1;
+        }
+        return failures;
+    }
+
+    void run(QModbusClient *client, QModbusPdu::FunctionCode functionCode, int batchSize)
+    {
+        QVERIFY(client);
+        QCOMPARE(client->state(), QModbusDevice::ConnectedState);
+
+        // Warm up, so that the first iteration does not pay for the connection setup.
+        QCOMPARE(runBatch(client, functionCode, batchSize), 0);
+        client->resetMetrics();
+
+        qint64 requests = 0;
+        QElapsedTimer wallTime;
+        wallTime.start();
+        const std::clock_t cpuStart = std::clock();
+        QBENCHMARK {
+            QCOMPARE(runBatch(client, functionCode, batchSize), 0);
+            requests += batchSize;
+        }
+        const double cpuSeconds = double(std::clock() - cpuStart) / CLOCKS_PER_SEC;
+        const double wallSeconds = double(wallTime.nsecsElapsed()) / 1e9;
+
+        const QModbusClientMetrics metrics = client->metrics();
+        const QModbusClientMetrics::Entry total = metrics.aggregate(ServerAddress);
+        QCOMPARE(total.responses, quint64(requests));
+        QCOMPARE(total.exceptions, 0u);
+
+        qInfo("%s: %lld requests, %.0f requests/s, p50 %lld us, p99 %lld us, "
+              "%.1f us CPU/request",
+              QTest::currentDataTag(), requests, requests / wallSeconds,
+              QModbusClientMetrics::latencyPercentile(total, 50),
+              QModbusClientMetrics::latencyPercentile(total, 99),
+              cpuSeconds * 1e6 / requests);
+    }
+
+    std::unique_ptr<QModbusTcpServer> m_tcpServer;
+    std::unique_ptr<QModbusTcpClient> m_tcpClient;
+#ifdef QMODBUS_BENCHMARK_RTU
+    std::unique_ptr<ModbusPseudoTerminalLink> m_link;
+    std::unique_ptr<QModbusRtuSerialServer> m_rtuServer;
+    std::unique_ptr<QModbusRtuSerialClient> m_rtuClient;
+#else
+    std::unique_ptr<QModbusServer> m_rtuServer;
+    std::unique_ptr<QModbusClient> m_rtuClient;
+#endif
+};
+
+QTEST_MAIN(tst_QModbusThroughput)
+
+#include "tst_bench_qmodbusthroughput.moc"